@@ -0,0 +1,167 @@
+#ifndef _CH_affine_h_
+#define _CH_affine_h_
+
+#include "CH_common.h"
+
+// Affine 3x4 transform (bone palettes, keyframes, particle transforms)
+// Stored transposed: r[i] is column i of the equivalent XMMATRIX, so a
+// point transforms as dot(r[i], (x, y, z, 1)) and the implicit fourth
+// row is (0, 0, 0, 1). 48 bytes instead of the 64 of an XMMATRIX.
+struct CHAffine {
+    XMVECTOR r[3];
+};
+
+// Identity transform
+inline CHAffine Affine_Identity()
+{
+    CHAffine result;
+    result.r[0] = g_XMIdentityR0;
+    result.r[1] = g_XMIdentityR1;
+    result.r[2] = g_XMIdentityR2;
+    return result;
+}
+
+// Convert from a 4x4 matrix (the projective column is dropped)
+inline CHAffine Affine_FromMatrix(const XMMATRIX& matrix)
+{
+    XMMATRIX transposed = XMMatrixTranspose(matrix);
+
+    CHAffine result;
+    result.r[0] = transposed.r[0];
+    result.r[1] = transposed.r[1];
+    result.r[2] = transposed.r[2];
+    return result;
+}
+
+// Convert back to a 4x4 matrix
+inline XMMATRIX Affine_ToMatrix(const CHAffine& affine)
+{
+    XMMATRIX transposed(affine.r[0], affine.r[1], affine.r[2], g_XMIdentityR3);
+    return XMMatrixTranspose(transposed);
+}
+
+// Compose: the result applies a first, then b (same order as XMMatrixMultiply)
+inline CHAffine Affine_Multiply(const CHAffine& a, const CHAffine& b)
+{
+    CHAffine result;
+    for (int i = 0; i < 3; i++)
+    {
+        XMVECTOR row = b.r[i];
+        XMVECTOR v = XMVectorMultiply(XMVectorSplatX(row), a.r[0]);
+        v = XMVectorMultiplyAdd(XMVectorSplatY(row), a.r[1], v);
+        v = XMVectorMultiplyAdd(XMVectorSplatZ(row), a.r[2], v);
+        // Fourth row of a is (0, 0, 0, 1), so b's translation adds to w only
+        result.r[i] = XMVectorAdd(v, XMVectorAndInt(row, g_XMMaskW));
+    }
+    return result;
+}
+
+// Inverse of any affine transform whose linear part is invertible: the
+// linear part is inverted through its adjugate, so scale and shear are
+// handled (not the transpose shortcut, which is only valid for rigid
+// transforms)
+inline CHAffine Affine_Inverse(const CHAffine& affine)
+{
+    XMVECTOR a0 = affine.r[0];
+    XMVECTOR a1 = affine.r[1];
+    XMVECTOR a2 = affine.r[2];
+
+    // Columns of the inverse linear part are the cross products / det
+    XMVECTOR c0 = XMVector3Cross(a1, a2);
+    XMVECTOR c1 = XMVector3Cross(a2, a0);
+    XMVECTOR c2 = XMVector3Cross(a0, a1);
+    XMVECTOR invDet = XMVectorReciprocal(XMVector3Dot(a0, c0));
+
+    XMMATRIX columns(XMVectorMultiply(c0, invDet), XMVectorMultiply(c1, invDet),
+        XMVectorMultiply(c2, invDet), XMVectorZero());
+    XMMATRIX rows = XMMatrixTranspose(columns);
+
+    // Translation (x, y, z) sits in the w lanes of the rows
+    XMMATRIX source = XMMatrixTranspose(XMMATRIX(a0, a1, a2, g_XMIdentityR3));
+    XMVECTOR translation = source.r[3];
+
+    CHAffine result;
+    for (int i = 0; i < 3; i++)
+    {
+        XMVECTOR w = XMVectorNegate(XMVector3Dot(rows.r[i], translation));
+        result.r[i] = XMVectorSelect(rows.r[i], w, g_XMMaskW);
+    }
+    return result;
+}
+
+// Transform a point (w is ignored, result w = 1); no perspective divide
+inline XMVECTOR Affine_TransformPoint(const CHAffine& affine, FXMVECTOR point)
+{
+    XMVECTOR p = XMVectorSelect(g_XMOne, point, g_XMSelect1110);
+    XMVECTOR x = XMVector4Dot(affine.r[0], p);
+    XMVECTOR y = XMVector4Dot(affine.r[1], p);
+    XMVECTOR z = XMVector4Dot(affine.r[2], p);
+
+    XMVECTOR result = XMVectorSelect(x, y, g_XMMaskY);
+    result = XMVectorSelect(result, z, g_XMMaskZ);
+    return XMVectorSelect(result, g_XMOne, g_XMMaskW);
+}
+
+// Transform four points held as SoA lanes (xs, ys, zs) in place
+inline void Affine_TransformSoA(const CHAffine& affine, XMVECTOR& xs, XMVECTOR& ys, XMVECTOR& zs)
+{
+    XMVECTOR out[3];
+    for (int i = 0; i < 3; i++)
+    {
+        XMVECTOR row = affine.r[i];
+        XMVECTOR v = XMVectorMultiplyAdd(XMVectorSplatX(row), xs, XMVectorSplatW(row));
+        v = XMVectorMultiplyAdd(XMVectorSplatY(row), ys, v);
+        out[i] = XMVectorMultiplyAdd(XMVectorSplatZ(row), zs, v);
+    }
+    xs = out[0];
+    ys = out[1];
+    zs = out[2];
+}
+
+// Transform a strided array of XMFLOAT3 points, four at a time
+inline void Affine_TransformPoints(const CHAffine& affine,
+    XMFLOAT3* dest, size_t destStride,
+    const XMFLOAT3* src, size_t srcStride,
+    size_t count)
+{
+    const BYTE* srcBytes = reinterpret_cast<const BYTE*>(src);
+    BYTE* destBytes = reinterpret_cast<BYTE*>(dest);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        XMMATRIX points(
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(srcBytes + (i + 0) * srcStride)),
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(srcBytes + (i + 1) * srcStride)),
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(srcBytes + (i + 2) * srcStride)),
+            XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(srcBytes + (i + 3) * srcStride)));
+        XMMATRIX lanes = XMMatrixTranspose(points);
+
+        Affine_TransformSoA(affine, lanes.r[0], lanes.r[1], lanes.r[2]);
+
+        points = XMMatrixTranspose(lanes);
+        for (size_t k = 0; k < 4; k++)
+        {
+            XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(destBytes + (i + k) * destStride), points.r[k]);
+        }
+    }
+
+    for (; i < count; i++)
+    {
+        XMVECTOR p = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(srcBytes + i * srcStride));
+        XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(destBytes + i * destStride),
+            Affine_TransformPoint(affine, p));
+    }
+}
+
+// Weighted sum used for linear blend skinning and keyframe blending
+inline CHAffine Affine_Blend(const CHAffine& a, const CHAffine& b, float t)
+{
+    CHAffine result;
+    result.r[0] = XMVectorLerp(a.r[0], b.r[0], t);
+    result.r[1] = XMVectorLerp(a.r[1], b.r[1], t);
+    result.r[2] = XMVectorLerp(a.r[2], b.r[2], t);
+    return result;
+}
+
+#endif // _CH_affine_h_
@@ -0,0 +1,531 @@
+#include "CH_atlas.h"
+#include "CH_sprite.h"
+#include "CH_main.h"
+#include "CH_datafile.h"
+#include <algorithm>
+
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "vendor/stb/stb_rect_pack.h"
+
+// Global atlas state
+BOOL CHAtlasInternal::g_bEnabled = TRUE;
+std::vector<CHAtlasPage*> CHAtlasInternal::g_Pages;
+std::unordered_map<std::string, CHAtlasEntry*> CHAtlasInternal::g_Entries;
+
+CH_CORE_DLL_API
+BOOL Atlas_LoadManifest(const char* lpName)
+{
+    if (!lpName)
+        return FALSE;
+
+    // Read the manifest from the packed data or a loose file
+    std::string text;
+    g_objDnFile.BeforeUseDnFile();
+    unsigned long dwSize = 0;
+    void* pBuf = g_objDnFile.GetMPtr(lpName, dwSize);
+    if (pBuf)
+    {
+        text.assign(static_cast<const char*>(pBuf), dwSize);
+        g_objDnFile.AfterUseDnFile();
+    }
+    else
+    {
+        g_objDnFile.AfterUseDnFile();
+
+        FILE* file = fopen(lpName, "rb");
+        if (!file)
+            return FALSE;
+
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            text.append(buffer, read);
+        fclose(file);
+    }
+
+    EnterCriticalSection(&g_CriticalSection);
+
+    CHAtlasPage* page = nullptr;
+    DWORD pageColorKey = 0;
+    DWORD images = 0;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string line = text.substr(pos, end - pos);
+        pos = end + 1;
+
+        size_t comment = line.find(';');
+        if (comment != std::string::npos)
+            line.resize(comment);
+
+        // The keyword is a whole first token, so images named "page..." are entries
+        char keyword[256];
+        int used = 0;
+        if (sscanf(line.c_str(), " %255s%n", keyword, &used) != 1)
+            continue;
+
+        char name[256];
+        int x, y, w, h;
+        unsigned long colorKey = 0;
+        if (strcmp(keyword, "page") == 0)
+        {
+            if (sscanf(line.c_str() + used, " %255s %lx", name, &colorKey) < 1)
+                continue;
+
+            page = new CHAtlasPage();
+            page->bManifest = TRUE;
+            pageColorKey = static_cast<DWORD>(colorKey);
+            if (Texture_Load(&page->lpTex, name, 1, CH_POOL_MANAGED, TRUE, pageColorKey) == -1)
+            {
+                delete page;
+                page = nullptr;
+                continue;
+            }
+            CHAtlasInternal::g_Pages.push_back(page);
+        }
+        else if (sscanf(line.c_str(), " %255s %d %d %d %d", name, &x, &y, &w, &h) == 5)
+        {
+            if (!page || x < 0 || y < 0 || w <= 0 || h <= 0 ||
+                static_cast<UINT>(x + w) > page->lpTex->Info.Width ||
+                static_cast<UINT>(y + h) > page->lpTex->Info.Height)
+                continue;
+
+            std::string key = CHAtlasInternal::MakeKey(name, pageColorKey);
+            if (CHAtlasInternal::g_Entries.count(key))
+                continue;
+
+            CHAtlasEntry* entry = new CHAtlasEntry();
+            entry->strName = key;
+            entry->lpPage = page;
+            entry->dwX = x;
+            entry->dwY = y;
+            entry->dwWidth = w;
+            entry->dwHeight = h;
+
+            page->Entries.push_back(entry);
+            page->dwUsedTexels += w * h;
+            CHAtlasInternal::g_Entries[key] = entry;
+            images++;
+        }
+    }
+
+    LeaveCriticalSection(&g_CriticalSection);
+    return images > 0;
+}
+
+CH_CORE_DLL_API
+void Atlas_Enable(BOOL bEnable)
+{
+    CHAtlasInternal::g_bEnabled = bEnable;
+}
+
+CH_CORE_DLL_API
+void Atlas_Evict()
+{
+    EnterCriticalSection(&g_CriticalSection);
+    CHAtlasInternal::EvictUnused();
+    LeaveCriticalSection(&g_CriticalSection);
+}
+
+CH_CORE_DLL_API
+void Atlas_GetStats(DWORD* lpPages, DWORD* lpImages, DWORD* lpUsedTexels)
+{
+    EnterCriticalSection(&g_CriticalSection);
+
+    DWORD texels = 0;
+    for (CHAtlasPage* page : CHAtlasInternal::g_Pages)
+        texels += page->dwUsedTexels;
+
+    if (lpPages)
+        *lpPages = static_cast<DWORD>(CHAtlasInternal::g_Pages.size());
+    if (lpImages)
+        *lpImages = static_cast<DWORD>(CHAtlasInternal::g_Entries.size());
+    if (lpUsedTexels)
+        *lpUsedTexels = texels;
+
+    LeaveCriticalSection(&g_CriticalSection);
+}
+
+// Internal implementation
+namespace CHAtlasInternal {
+
+    std::string MakeKey(const char* name, DWORD colorKey)
+    {
+        // Texture names compare case-insensitively
+        std::string key = name;
+        for (char& c : key)
+        {
+            if (c == '\\')
+                c = '/';
+            else
+                c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        }
+
+        if (colorKey != 0)
+        {
+            char suffix[16];
+            sprintf_s(suffix, "#%08lX", static_cast<unsigned long>(colorKey));
+            key += suffix;
+        }
+        return key;
+    }
+
+    CHAtlasEntry* AcquireSprite(CHSprite* sprite, const char* name, CHPool pool, DWORD colorKey, CHTexture** fallback)
+    {
+        *fallback = nullptr;
+
+        EnterCriticalSection(&g_CriticalSection);
+
+        // Already packed (or listed by a manifest)
+        std::string key = MakeKey(name, colorKey);
+        auto found = g_Entries.find(key);
+        if (found != g_Entries.end())
+        {
+            CHAtlasEntry* entry = found->second;
+            entry->Sprites.push_back(sprite);
+            sprite->lpTex = entry->lpPage->lpTex;
+            sprite->lpAtlas = entry;
+            LeaveCriticalSection(&g_CriticalSection);
+            return entry;
+        }
+
+        CHTexture* source = nullptr;
+        if (Texture_Load(&source, name, 1, pool, TRUE, colorKey) == -1)
+        {
+            LeaveCriticalSection(&g_CriticalSection);
+            return nullptr;
+        }
+
+        // Only small plain images are worth packing
+        if (!g_bEnabled ||
+            source->Info.Width > CH_ATLAS_MAX_IMAGE || source->Info.Height > CH_ATLAS_MAX_IMAGE ||
+            source->d3dDesc.MipLevels != 1 || source->dxgiFormat != DXGI_FORMAT_R8G8B8A8_UNORM)
+        {
+            *fallback = source;
+            LeaveCriticalSection(&g_CriticalSection);
+            return nullptr;
+        }
+
+        CHAtlasEntry* entry = new CHAtlasEntry();
+        entry->strName = key;
+        entry->dwWidth = source->Info.Width;
+        entry->dwHeight = source->Info.Height;
+
+        // Queued sprites must draw before pages move under them
+        CHSpriteInternal::g_SpriteBatch.Flush();
+
+        CHAtlasPage* target = nullptr;
+        for (int attempt = 0; attempt < 3 && !target; attempt++)
+        {
+            for (CHAtlasPage* page : g_Pages)
+            {
+                if (!page->bManifest && PackEntry(page, entry))
+                {
+                    target = page;
+                    break;
+                }
+            }
+
+            if (target)
+                break;
+
+            // Reclaim space held by unused images, then grow
+            if (attempt == 0 && EvictUnused())
+                continue;
+
+            DWORD packed = 0;
+            for (CHAtlasPage* page : g_Pages)
+            {
+                if (!page->bManifest)
+                    packed++;
+            }
+            if (packed >= CH_ATLAS_MAX_PAGES)
+                break;
+
+            CHAtlasPage* page = CreatePage(CH_ATLAS_PAGE_SIZE, CH_ATLAS_PAGE_SIZE);
+            if (!page)
+                break;
+            g_Pages.push_back(page);
+        }
+
+        if (!target)
+        {
+            delete entry;
+            *fallback = source;
+            LeaveCriticalSection(&g_CriticalSection);
+            return nullptr;
+        }
+
+        // Copy the image into the page on the GPU
+        D3D11_BOX box = { 0, 0, 0, entry->dwWidth, entry->dwHeight, 1 };
+        g_D3DContext->CopySubresourceRegion(target->lpTex->lpTex.Get(), 0, entry->dwX, entry->dwY, 0,
+            source->lpTex.Get(), 0, &box);
+        FillPadding(target->lpTex->lpTex.Get(), entry, source->lpTex.Get());
+        Texture_Unload(&source);
+
+        entry->lpPage = target;
+        entry->Sprites.push_back(sprite);
+        target->Entries.push_back(entry);
+        target->dwUsedTexels += entry->dwWidth * entry->dwHeight;
+        g_Entries[key] = entry;
+
+        sprite->lpTex = target->lpTex;
+        sprite->lpAtlas = entry;
+
+        LeaveCriticalSection(&g_CriticalSection);
+        return entry;
+    }
+
+    void ReleaseSprite(CHSprite* sprite)
+    {
+        CHAtlasEntry* entry = sprite->lpAtlas;
+        if (!entry)
+            return;
+
+        EnterCriticalSection(&g_CriticalSection);
+
+        // The image stays cached in its page until space is needed
+        auto it = std::find(entry->Sprites.begin(), entry->Sprites.end(), sprite);
+        if (it != entry->Sprites.end())
+            entry->Sprites.erase(it);
+
+        sprite->lpAtlas = nullptr;
+        sprite->lpTex = nullptr;
+
+        LeaveCriticalSection(&g_CriticalSection);
+    }
+
+    CHAtlasPage* CreatePage(DWORD width, DWORD height)
+    {
+        CHAtlasPage* page = new CHAtlasPage();
+        page->lpTex = new CHTexture;
+        Texture_Clear(page->lpTex);
+        page->lpTex->nDupCount = 1;
+
+        // Start fully transparent so padding never shows
+        std::vector<DWORD> pixels(width * height, 0);
+        if (!CreateTextureFromPixels(pixels.data(), width, height, page->lpTex))
+        {
+            delete page->lpTex;
+            delete page;
+            return nullptr;
+        }
+
+        InitPacker(page, width, height);
+        return page;
+    }
+
+    void InitPacker(CHAtlasPage* page, DWORD width, DWORD height)
+    {
+        page->lpNodes = new stbrp_node[width];
+        stbrp_init_target(&page->Context, width, height, page->lpNodes, width);
+    }
+
+    void ReleasePage(CHAtlasPage* page)
+    {
+        for (CHAtlasEntry* entry : page->Entries)
+        {
+            // Sprites still on the page lose their texture
+            for (CHSprite* sprite : entry->Sprites)
+            {
+                sprite->lpTex = nullptr;
+                sprite->lpAtlas = nullptr;
+            }
+            g_Entries.erase(entry->strName);
+            delete entry;
+        }
+        page->Entries.clear();
+
+        Texture_Unload(&page->lpTex);
+        delete[] page->lpNodes;
+        delete page;
+    }
+
+    BOOL PackRect(CHAtlasPage* page, DWORD width, DWORD height, DWORD* x, DWORD* y)
+    {
+        stbrp_rect rect = {};
+        rect.w = width + CH_ATLAS_PADDING * 2;
+        rect.h = height + CH_ATLAS_PADDING * 2;
+
+        stbrp_pack_rects(&page->Context, &rect, 1);
+        if (!rect.was_packed)
+            return FALSE;
+
+        *x = rect.x + CH_ATLAS_PADDING;
+        *y = rect.y + CH_ATLAS_PADDING;
+        return TRUE;
+    }
+
+    void FillPadding(ID3D11Texture2D* page, const CHAtlasEntry* entry, ID3D11Texture2D* image)
+    {
+        DWORD x = entry->dwX;
+        DWORD y = entry->dwY;
+        DWORD w = entry->dwWidth;
+        DWORD h = entry->dwHeight;
+
+        // Each padding ring repeats the image's outer column, row or corner texel
+        D3D11_BOX left = { 0, 0, 0, 1, h, 1 };
+        D3D11_BOX right = { w - 1, 0, 0, w, h, 1 };
+        D3D11_BOX top = { 0, 0, 0, w, 1, 1 };
+        D3D11_BOX bottom = { 0, h - 1, 0, w, h, 1 };
+        D3D11_BOX topLeft = { 0, 0, 0, 1, 1, 1 };
+        D3D11_BOX topRight = { w - 1, 0, 0, w, 1, 1 };
+        D3D11_BOX bottomLeft = { 0, h - 1, 0, 1, h, 1 };
+        D3D11_BOX bottomRight = { w - 1, h - 1, 0, w, h, 1 };
+
+        for (DWORD p = 1; p <= CH_ATLAS_PADDING; p++)
+        {
+            g_D3DContext->CopySubresourceRegion(page, 0, x - p, y, 0, image, 0, &left);
+            g_D3DContext->CopySubresourceRegion(page, 0, x + w - 1 + p, y, 0, image, 0, &right);
+            g_D3DContext->CopySubresourceRegion(page, 0, x, y - p, 0, image, 0, &top);
+            g_D3DContext->CopySubresourceRegion(page, 0, x, y + h - 1 + p, 0, image, 0, &bottom);
+
+            for (DWORD q = 1; q <= CH_ATLAS_PADDING; q++)
+            {
+                g_D3DContext->CopySubresourceRegion(page, 0, x - p, y - q, 0, image, 0, &topLeft);
+                g_D3DContext->CopySubresourceRegion(page, 0, x + w - 1 + p, y - q, 0, image, 0, &topRight);
+                g_D3DContext->CopySubresourceRegion(page, 0, x - p, y + h - 1 + q, 0, image, 0, &bottomLeft);
+                g_D3DContext->CopySubresourceRegion(page, 0, x + w - 1 + p, y + h - 1 + q, 0, image, 0, &bottomRight);
+            }
+        }
+    }
+
+    BOOL PackEntry(CHAtlasPage* page, CHAtlasEntry* entry)
+    {
+        return PackRect(page, entry->dwWidth, entry->dwHeight, &entry->dwX, &entry->dwY);
+    }
+
+    BOOL RepackPage(CHAtlasPage* page)
+    {
+        if (page->bManifest)
+            return FALSE;
+
+        DWORD width = page->lpTex->Info.Width;
+        DWORD height = page->lpTex->Info.Height;
+
+        // Pack every live image at once (stb sorts by height for a tight fit)
+        std::vector<stbrp_rect> rects(page->Entries.size());
+        for (size_t i = 0; i < rects.size(); i++)
+        {
+            rects[i].id = static_cast<int>(i);
+            rects[i].w = page->Entries[i]->dwWidth + CH_ATLAS_PADDING * 2;
+            rects[i].h = page->Entries[i]->dwHeight + CH_ATLAS_PADDING * 2;
+        }
+
+        stbrp_context context;
+        stbrp_node* nodes = new stbrp_node[width];
+        stbrp_init_target(&context, width, height, nodes, width);
+        if (!rects.empty() && !stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size())))
+        {
+            // Keep the current layout
+            delete[] nodes;
+            return FALSE;
+        }
+
+        CHTexture fresh;
+        Texture_Clear(&fresh);
+        std::vector<DWORD> pixels(width * height, 0);
+        if (!CreateTextureFromPixels(pixels.data(), width, height, &fresh))
+        {
+            delete[] nodes;
+            return FALSE;
+        }
+
+        CHSpriteInternal::g_SpriteBatch.Flush();
+
+        for (const stbrp_rect& rect : rects)
+        {
+            CHAtlasEntry* entry = page->Entries[rect.id];
+
+            // The padding moves with the image, its edge copies are already in place
+            D3D11_BOX box = { entry->dwX - CH_ATLAS_PADDING, entry->dwY - CH_ATLAS_PADDING, 0,
+                entry->dwX + entry->dwWidth + CH_ATLAS_PADDING, entry->dwY + entry->dwHeight + CH_ATLAS_PADDING, 1 };
+            g_D3DContext->CopySubresourceRegion(fresh.lpTex.Get(), 0, rect.x, rect.y, 0,
+                page->lpTex->lpTex.Get(), 0, &box);
+
+            DWORD oldX = entry->dwX;
+            DWORD oldY = entry->dwY;
+            entry->dwX = rect.x + CH_ATLAS_PADDING;
+            entry->dwY = rect.y + CH_ATLAS_PADDING;
+            RemapSprites(entry, oldX, oldY);
+        }
+
+        // Swap the contents, sprites keep pointing at the same page texture
+        page->lpTex->lpTex = fresh.lpTex;
+        page->lpTex->lpSRV = fresh.lpSRV;
+
+        delete[] page->lpNodes;
+        page->lpNodes = nodes;
+        page->Context = context;
+        return TRUE;
+    }
+
+    void RemoveEntry(CHAtlasEntry* entry)
+    {
+        CHAtlasPage* page = entry->lpPage;
+        auto it = std::find(page->Entries.begin(), page->Entries.end(), entry);
+        if (it != page->Entries.end())
+            page->Entries.erase(it);
+
+        page->dwUsedTexels -= entry->dwWidth * entry->dwHeight;
+        g_Entries.erase(entry->strName);
+        delete entry;
+    }
+
+    BOOL EvictUnused()
+    {
+        BOOL freed = FALSE;
+        for (CHAtlasPage* page : g_Pages)
+        {
+            // Manifest images are free to keep, their page is loaded anyway
+            if (page->bManifest)
+                continue;
+
+            std::vector<CHAtlasEntry*> unused;
+            for (CHAtlasEntry* entry : page->Entries)
+            {
+                if (entry->Sprites.empty())
+                    unused.push_back(entry);
+            }
+
+            if (unused.empty())
+                continue;
+
+            for (CHAtlasEntry* entry : unused)
+                RemoveEntry(entry);
+
+            if (RepackPage(page))
+                freed = TRUE;
+        }
+        return freed;
+    }
+
+    void RemapSprites(CHAtlasEntry* entry, DWORD oldX, DWORD oldY)
+    {
+        float du = (static_cast<float>(entry->dwX) - static_cast<float>(oldX)) /
+            static_cast<float>(entry->lpPage->lpTex->Info.Width);
+        float dv = (static_cast<float>(entry->dwY) - static_cast<float>(oldY)) /
+            static_cast<float>(entry->lpPage->lpTex->Info.Height);
+
+        for (CHSprite* sprite : entry->Sprites)
+        {
+            for (int v = 0; v < 4; v++)
+            {
+                sprite->vertex[v].u += du;
+                sprite->vertex[v].v += dv;
+            }
+        }
+    }
+
+    void Cleanup()
+    {
+        for (CHAtlasPage* page : g_Pages)
+            ReleasePage(page);
+        g_Pages.clear();
+        g_Entries.clear();
+    }
+
+} // namespace CHAtlasInternal
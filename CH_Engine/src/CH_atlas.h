@@ -0,0 +1,112 @@
+#ifndef _CH_atlas_h_
+#define _CH_atlas_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include "CH_texture.h"
+#include "vendor/stb/stb_rect_pack.h"
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// Atlas page size in texels
+#define CH_ATLAS_PAGE_SIZE  1024
+
+// Larger images keep their own texture
+#define CH_ATLAS_MAX_IMAGE  256
+
+// Texels around each packed image, filled with copies of its edge texels
+// so filtering at the border never blends in a neighbouring image
+#define CH_ATLAS_PADDING    2
+
+// Pages packed at runtime (manifest pages don't count)
+#define CH_ATLAS_MAX_PAGES  16
+
+struct CHSprite;
+struct CHAtlasPage;
+
+// Image packed into an atlas page
+struct CHAtlasEntry {
+    std::string strName;            // Lower case image name
+    CHAtlasPage* lpPage;
+    DWORD dwX, dwY;                 // Top left texel in the page
+    DWORD dwWidth, dwHeight;        // Image size
+    std::vector<CHSprite*> Sprites; // Sprites using the image (remapped on repack)
+};
+
+// Atlas page (one shared texture)
+struct CHAtlasPage {
+    CHTexture* lpTex;               // Bound by every sprite on the page
+    BOOL bManifest;                 // Prebuilt layout, never packed into or repacked
+    stbrp_context Context;
+    stbrp_node* lpNodes;
+    DWORD dwUsedTexels;             // Area of live entries
+    DWORD dwLastUse;                // Last access time (glyph pages)
+    std::vector<CHAtlasEntry*> Entries;
+};
+
+/*
+    Load a prebuilt atlas manifest
+    ------------------------------
+    Text file, one directive per line (';' starts a comment):
+        page <texture file> [<colour key, hex>]
+        <image name> <x> <y> <width> <height>
+    Images listed after a page line are served from that page by Sprite_Load
+    calls passing the same colour key.
+*/
+CH_CORE_DLL_API
+BOOL Atlas_LoadManifest(const char* lpName);
+
+// Pack small Sprite_Load images into atlas pages (default TRUE)
+CH_CORE_DLL_API
+void Atlas_Enable(BOOL bEnable);
+
+// Drop cached images no sprite uses and repack the pages they leave holes in
+CH_CORE_DLL_API
+void Atlas_Evict();
+
+CH_CORE_DLL_API
+void Atlas_GetStats(DWORD* lpPages, DWORD* lpImages, DWORD* lpUsedTexels);
+
+// Internal atlas management
+namespace CHAtlasInternal {
+    extern BOOL g_bEnabled;
+    extern std::vector<CHAtlasPage*> g_Pages;
+    extern std::unordered_map<std::string, CHAtlasEntry*> g_Entries;
+
+    // Images loaded with different colour keys are different entries
+    std::string MakeKey(const char* name, DWORD colorKey);
+
+    // Sprite binding: returns the entry the sprite now uses, or nullptr with
+    // the image's own texture in *fallback when it doesn't go into an atlas
+    CHAtlasEntry* AcquireSprite(CHSprite* sprite, const char* name, CHPool pool, DWORD colorKey, CHTexture** fallback);
+    void ReleaseSprite(CHSprite* sprite);
+
+    // Pages
+    CHAtlasPage* CreatePage(DWORD width, DWORD height);
+    void ReleasePage(CHAtlasPage* page);
+
+    // CPU only: rectangle packing state of a page (lpNodes is allocated here)
+    CH_CORE_DLL_API void InitPacker(CHAtlasPage* page, DWORD width, DWORD height);
+    // Top left of the image, CH_ATLAS_PADDING texels inside its reserved rectangle
+    CH_CORE_DLL_API BOOL PackRect(CHAtlasPage* page, DWORD width, DWORD height, DWORD* x, DWORD* y);
+    void FillPadding(ID3D11Texture2D* page, const CHAtlasEntry* entry, ID3D11Texture2D* image);
+    BOOL PackEntry(CHAtlasPage* page, CHAtlasEntry* entry);
+    BOOL RepackPage(CHAtlasPage* page);
+    void RemoveEntry(CHAtlasEntry* entry);
+    BOOL EvictUnused();
+    void RemapSprites(CHAtlasEntry* entry, DWORD oldX, DWORD oldY);
+
+    void Cleanup();
+}
+
+// Compatibility types
+typedef CHAtlasEntry C3AtlasEntry;
+typedef CHAtlasPage C3AtlasPage;
+
+#endif // _CH_atlas_h_
@@ -0,0 +1,155 @@
+#include "CH_backend.h"
+#include "CH_main.h"
+
+namespace CHBackendInternal {
+    BOOL g_bHeadless = FALSE;
+    BOOL g_bRecording = FALSE;
+    CHBackendStats g_Stats = {};
+    CHBackendStats g_LastStats = {};
+    std::vector<CHBackendCommand> g_Commands;
+
+    static void Record(DWORD type, DWORD value)
+    {
+        if (g_bRecording && g_Commands.size() < CH_BACKEND_MAX_RECORD)
+            g_Commands.push_back({ type, value });
+    }
+}
+
+CH_CORE_DLL_API
+BOOL Backend_IsHeadless()
+{
+    return CHBackendInternal::g_bHeadless;
+}
+
+CH_CORE_DLL_API
+void Backend_GetStats(CHBackendStats* lpStats)
+{
+    if (lpStats)
+        *lpStats = CHBackendInternal::g_LastStats;
+}
+
+CH_CORE_DLL_API
+void Backend_Record(BOOL bRecord)
+{
+    if (bRecord)
+        CHBackendInternal::g_Commands.clear();
+    CHBackendInternal::g_bRecording = bRecord;
+}
+
+CH_CORE_DLL_API
+DWORD Backend_GetRecord(const CHBackendCommand** lppCommands)
+{
+    if (lppCommands)
+        *lppCommands = CHBackendInternal::g_Commands.empty() ? nullptr : CHBackendInternal::g_Commands.data();
+    return static_cast<DWORD>(CHBackendInternal::g_Commands.size());
+}
+
+namespace CHBackendInternal {
+
+    HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer)
+    {
+        g_Stats.dwBufferCreates++;
+        g_Stats.dwBufferBytes += desc->ByteWidth;
+        Record(CH_CMD_CREATE_BUFFER, desc->ByteWidth);
+
+        return g_D3DDevice->CreateBuffer(desc, data, buffer);
+    }
+
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, D3D11_MAPPED_SUBRESOURCE* mapped)
+    {
+        g_Stats.dwMaps++;
+        Record(CH_CMD_MAP, 0);
+
+        return g_D3DContext->Map(resource, subresource, type, 0, mapped);
+    }
+
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture)
+    {
+        g_Stats.dwTextureCreates++;
+        Record(CH_CMD_CREATE_TEXTURE, desc->Width * desc->Height);
+
+        return g_D3DDevice->CreateTexture2D(desc, data, texture);
+    }
+
+    void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box,
+        const void* data, UINT rowPitch, UINT depthPitch)
+    {
+        // Buffers are updated by byte range, textures by rows of rowPitch bytes
+        DWORD bytes = 0;
+        if (box)
+        {
+            bytes = rowPitch ? rowPitch * (box->bottom - box->top) : box->right - box->left;
+        }
+        else
+        {
+            D3D11_RESOURCE_DIMENSION dimension;
+            resource->GetType(&dimension);
+            if (dimension == D3D11_RESOURCE_DIMENSION_BUFFER)
+            {
+                D3D11_BUFFER_DESC desc;
+                static_cast<ID3D11Buffer*>(resource)->GetDesc(&desc);
+                bytes = desc.ByteWidth;
+            }
+            else if (dimension == D3D11_RESOURCE_DIMENSION_TEXTURE2D)
+            {
+                D3D11_TEXTURE2D_DESC desc;
+                static_cast<ID3D11Texture2D*>(resource)->GetDesc(&desc);
+                bytes = rowPitch * (desc.Height >> (subresource % desc.MipLevels));
+            }
+        }
+
+        g_Stats.dwUpdates++;
+        g_Stats.dwUpdateBytes += bytes;
+        Record(CH_CMD_UPDATE, bytes);
+
+        g_D3DContext->UpdateSubresource(resource, subresource, box, data, rowPitch, depthPitch);
+    }
+
+    void Draw(UINT vertexCount, UINT startVertex)
+    {
+        g_Stats.dwDraws++;
+        g_Stats.dwDrawVertices += vertexCount;
+        Record(CH_CMD_DRAW, vertexCount);
+
+        g_D3DContext->Draw(vertexCount, startVertex);
+    }
+
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex)
+    {
+        g_Stats.dwDraws++;
+        g_Stats.dwDrawVertices += indexCount;
+        Record(CH_CMD_DRAW_INDEXED, indexCount);
+
+        g_D3DContext->DrawIndexed(indexCount, startIndex, baseVertex);
+    }
+
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance)
+    {
+        g_Stats.dwDraws++;
+        g_Stats.dwDrawVertices += indexCount * instanceCount;
+        Record(CH_CMD_DRAW_INDEXED_INSTANCED, instanceCount);
+
+        g_D3DContext->DrawIndexedInstanced(indexCount, instanceCount, startIndex, baseVertex, startInstance);
+    }
+
+    void CountStateChange()
+    {
+        g_Stats.dwStateChanges++;
+        Record(CH_CMD_STATE, 0);
+    }
+
+    void BeginFrame()
+    {
+        g_LastStats = g_Stats;
+        ZeroMemory(&g_Stats, sizeof(g_Stats));
+    }
+
+    void Cleanup()
+    {
+        g_bHeadless = FALSE;
+        g_bRecording = FALSE;
+        g_Commands.clear();
+        ZeroMemory(&g_Stats, sizeof(g_Stats));
+        ZeroMemory(&g_LastStats, sizeof(g_LastStats));
+    }
+}
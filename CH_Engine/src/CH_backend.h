@@ -0,0 +1,102 @@
+#ifndef _CH_backend_h_
+#define _CH_backend_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include <vector>
+
+// Headless device types (Init3DHeadless)
+#define CH_BACKEND_NULL     0   // D3D11 null driver: API is validated, nothing is rasterized
+#define CH_BACKEND_WARP     1   // Software rasterizer, no GPU needed
+
+// Commands kept by one recording; later commands are counted but not logged
+#define CH_BACKEND_MAX_RECORD   262144
+
+// Recorded backend command types
+enum CHBackendCommandType {
+    CH_CMD_CREATE_BUFFER = 0,           // dwValue = byte width
+    CH_CMD_MAP = 1,                     // dwValue = 0
+    CH_CMD_STATE = 2,                   // dwValue = 0
+    CH_CMD_DRAW = 3,                    // dwValue = vertex count
+    CH_CMD_DRAW_INDEXED = 4,            // dwValue = index count
+    CH_CMD_DRAW_INDEXED_INSTANCED = 5,  // dwValue = instance count
+    CH_CMD_UPDATE = 6,                  // dwValue = bytes uploaded
+    CH_CMD_CREATE_TEXTURE = 7,          // dwValue = width * height of the top level
+};
+
+struct CHBackendCommand {
+    DWORD dwType;                       // CHBackendCommandType
+    DWORD dwValue;
+};
+
+// Backend traffic of one frame (Begin3D to Begin3D)
+struct CHBackendStats {
+    DWORD dwBufferCreates;
+    DWORD dwBufferBytes;
+    DWORD dwMaps;
+    DWORD dwStateChanges;               // State objects bound
+    DWORD dwDraws;
+    DWORD dwDrawVertices;               // Vertices and indices submitted (times instances)
+    DWORD dwUpdates;                    // UpdateSubresource uploads
+    DWORD dwUpdateBytes;
+    DWORD dwTextureCreates;
+};
+
+/*
+    Headless initialization
+    -----------------------
+    Same as Init3DEx but without a window or swap chain: the frame renders
+    into an offscreen target and Flip only ends the frame. Meant for CPU
+    frame cost benchmarks and regression runs on machines with no GPU.
+    Returns 1 on success, -1 if the device can't be created.
+*/
+CH_CORE_DLL_API
+int Init3DHeadless(DWORD dwWidth, DWORD dwHeight, DWORD dwBackend);
+
+CH_CORE_DLL_API
+BOOL Backend_IsHeadless();
+
+// Counters of the last completed frame
+CH_CORE_DLL_API
+void Backend_GetStats(CHBackendStats* lpStats);
+
+// Start (clears the log) or stop recording backend commands; a recording
+// keeps at most CH_BACKEND_MAX_RECORD commands, stop it when done
+CH_CORE_DLL_API
+void Backend_Record(BOOL bRecord);
+
+// Commands recorded so far; the pointer is valid until the next recorded command
+CH_CORE_DLL_API
+DWORD Backend_GetRecord(const CHBackendCommand** lppCommands);
+
+// Internal backend entry points (counted and recorded)
+namespace CHBackendInternal {
+    extern BOOL g_bHeadless;
+    extern BOOL g_bRecording;
+    extern CHBackendStats g_Stats;
+    extern CHBackendStats g_LastStats;
+    extern std::vector<CHBackendCommand> g_Commands;
+
+    HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Buffer** buffer);
+    HRESULT Map(ID3D11Resource* resource, UINT subresource, D3D11_MAP type, D3D11_MAPPED_SUBRESOURCE* mapped);
+    HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC* desc, const D3D11_SUBRESOURCE_DATA* data, ID3D11Texture2D** texture);
+    void UpdateSubresource(ID3D11Resource* resource, UINT subresource, const D3D11_BOX* box,
+        const void* data, UINT rowPitch, UINT depthPitch);
+    void Draw(UINT vertexCount, UINT startVertex);
+    void DrawIndexed(UINT indexCount, UINT startIndex, INT baseVertex);
+    void DrawIndexedInstanced(UINT indexCount, UINT instanceCount, UINT startIndex, INT baseVertex, UINT startInstance);
+    void CountStateChange();
+
+    void BeginFrame();
+    void Cleanup();
+}
+
+// Compatibility types
+typedef CHBackendStats C3BackendStats;
+
+#endif // _CH_backend_h_
@@ -0,0 +1,345 @@
+#include "CH_batch.h"
+#include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_backend.h"
+
+namespace CHBatchInternal {
+    static DWORD g_dwFrameVisible = 0;
+    static DWORD g_dwFrameCulled = 0;
+    static DWORD g_dwFrameDraws = 0;
+}
+
+CH_CORE_DLL_API
+BOOL StaticScene_Build(CHStaticScene** lppStatic,
+                      CHScene** lppScenes,
+                      const XMMATRIX* lpWorlds,
+                      DWORD dwCount)
+{
+    if (!lppStatic || !lppScenes)
+        return FALSE;
+
+    *lppStatic = nullptr;
+
+    // Scenes of every texture/lightmap pair, pairs in first seen order
+    struct BatchSource {
+        int nTex;
+        int nlTex;
+        std::vector<DWORD> Scenes;
+    };
+    std::vector<BatchSource> sources;
+    std::unordered_map<UINT64, size_t> index;
+
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHScene* scene = lppScenes[i];
+        if (!scene || !scene->lpVB || !scene->lpIB || scene->dwTriCount == 0 ||
+            scene->nTex < 0 || scene->nTex >= TEX_MAX || !g_lpTex[scene->nTex])
+            continue;
+
+        // Blended scenes have to be sorted by depth every frame
+        if (CHSceneInternal::ShouldUseAlphaBlending(g_lpTex[scene->nTex]))
+            continue;
+
+        int lightmap = (scene->nlTex > -1 && scene->nlTex < TEX_MAX && g_lpTex[scene->nlTex]) ? scene->nlTex : -1;
+        UINT64 key = (static_cast<UINT64>(static_cast<UINT32>(scene->nTex)) << 32) | static_cast<UINT32>(lightmap);
+
+        auto it = index.find(key);
+        if (it == index.end())
+        {
+            it = index.emplace(key, sources.size()).first;
+            sources.push_back({ scene->nTex, lightmap, {} });
+        }
+        sources[it->second].Scenes.push_back(i);
+    }
+
+    if (sources.empty())
+        return FALSE;
+
+    CHStaticScene* lpStatic = new CHStaticScene;
+    lpStatic->dwBatchCount = static_cast<DWORD>(sources.size());
+    lpStatic->lpBatch = new CHStaticBatch[lpStatic->dwBatchCount]();   // Zeroed: unload is safe after a partial build
+
+    std::vector<CHSceneVertex> vertices;
+    std::vector<DWORD> indices;
+
+    for (DWORD b = 0; b < lpStatic->dwBatchCount; b++)
+    {
+        const BatchSource& source = sources[b];
+        CHStaticBatch* batch = &lpStatic->lpBatch[b];
+        batch->nTex = source.nTex;
+        batch->nlTex = source.nlTex;
+        batch->dwSubmeshCount = static_cast<DWORD>(source.Scenes.size());
+        batch->lpSubmesh = new CHStaticSubmesh[batch->dwSubmeshCount];
+
+        vertices.clear();
+        indices.clear();
+
+        XMVECTOR batchMin = XMVectorReplicate(FLT_MAX);
+        XMVECTOR batchMax = XMVectorReplicate(-FLT_MAX);
+
+        for (DWORD s = 0; s < batch->dwSubmeshCount; s++)
+        {
+            DWORD sceneIndex = source.Scenes[s];
+            CHScene* scene = lppScenes[sceneIndex];
+
+            // Same world as Scene_Draw would use
+            XMMATRIX world;
+            if (lpWorlds)
+            {
+                world = lpWorlds[sceneIndex];
+            }
+            else
+            {
+                world = XMMatrixIdentity();
+                if (scene->dwFrameCount > 0 && scene->lpFrame)
+                    world = scene->lpFrame[scene->nFrame % scene->dwFrameCount];
+                world = XMMatrixMultiply(world, scene->matrix);
+            }
+
+            // Normals keep their angle to the surface under non-uniform scale
+            XMMATRIX normalWorld = XMMatrixTranspose(XMMatrixInverse(nullptr, world));
+
+            DWORD baseVertex = static_cast<DWORD>(vertices.size());
+            XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+            XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+
+            for (DWORD v = 0; v < scene->dwVecCount; v++)
+            {
+                CHSceneVertex vertex = scene->lpVB[v];
+
+                XMVECTOR pos = XMVector3TransformCoord(XMVectorSet(vertex.x, vertex.y, vertex.z, 1.0f), world);
+                XMVECTOR normal = XMVector3Normalize(XMVector3TransformNormal(XMVectorSet(vertex.nx, vertex.ny, vertex.nz, 0.0f), normalWorld));
+                XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&vertex.x), pos);
+                XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&vertex.nx), normal);
+
+                minPos = XMVectorMin(minPos, pos);
+                maxPos = XMVectorMax(maxPos, pos);
+                vertices.push_back(vertex);
+            }
+
+            CHStaticSubmesh* submesh = &batch->lpSubmesh[s];
+            submesh->dwStartIndex = static_cast<DWORD>(indices.size());
+            submesh->dwIndexCount = scene->dwTriCount * 3;
+            XMStoreFloat3(&submesh->vMin, minPos);
+            XMStoreFloat3(&submesh->vMax, maxPos);
+
+            for (DWORD n = 0; n < submesh->dwIndexCount; n++)
+                indices.push_back(baseVertex + scene->lpIB[n]);
+
+            batchMin = XMVectorMin(batchMin, minPos);
+            batchMax = XMVectorMax(batchMax, maxPos);
+        }
+
+        batch->dwVecCount = static_cast<DWORD>(vertices.size());
+        batch->dwIndexCount = static_cast<DWORD>(indices.size());
+        batch->b32BitIndex = batch->dwVecCount > 0x10000;
+        XMStoreFloat3(&batch->vMin, batchMin);
+        XMStoreFloat3(&batch->vMax, batchMax);
+
+        if (FAILED(CHBatchInternal::CreateBuffers(batch, vertices.data(), indices.data())))
+        {
+            StaticScene_Unload(&lpStatic);
+            return FALSE;
+        }
+    }
+
+    *lppStatic = lpStatic;
+    return TRUE;
+}
+
+CH_CORE_DLL_API
+BOOL StaticScene_Draw(CHStaticScene* lpStatic)
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
+    using namespace CHBatchInternal;
+
+    if (!lpStatic || !g_D3DContext)
+        return FALSE;
+
+    XMFLOAT4 planes[6];
+    ExtractFrustum(XMMatrixMultiply(g_ViewMatrix, g_ProjectMatrix), planes);
+
+    // Same states as Scene_Prepare; vertices are already in world space
+    CHSceneInternal::SetupSceneRenderStates();
+    SetRenderState(CH_RS_ALPHABLENDENABLE, FALSE);
+    CHInternal::g_CompatibilityShaderManager.SetDefaultShaders();
+    CHInternal::g_ConstantBuffers.SetObject(XMMatrixIdentity());
+    CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+    for (DWORD b = 0; b < lpStatic->dwBatchCount; b++)
+        DrawBatch(&lpStatic->lpBatch[b], planes);
+
+    return TRUE;
+}
+
+CH_CORE_DLL_API
+void StaticScene_Unload(CHStaticScene** lppStatic)
+{
+    if (!lppStatic || !*lppStatic)
+        return;
+
+    CHStaticScene* lpStatic = *lppStatic;
+    for (DWORD b = 0; b < lpStatic->dwBatchCount; b++)
+    {
+        lpStatic->lpBatch[b].vertexBuffer.Reset();
+        lpStatic->lpBatch[b].indexBuffer.Reset();
+        delete[] lpStatic->lpBatch[b].lpSubmesh;
+    }
+    delete[] lpStatic->lpBatch;
+    delete lpStatic;
+
+    *lppStatic = nullptr;
+}
+
+CH_CORE_DLL_API
+void StaticScene_GetStats(DWORD* lpVisible, DWORD* lpCulled, DWORD* lpDraws)
+{
+    if (lpVisible)
+        *lpVisible = CHBatchInternal::g_dwFrameVisible;
+    if (lpCulled)
+        *lpCulled = CHBatchInternal::g_dwFrameCulled;
+    if (lpDraws)
+        *lpDraws = CHBatchInternal::g_dwFrameDraws;
+}
+
+namespace CHBatchInternal {
+
+    void ExtractFrustum(const XMMATRIX& viewProj, XMFLOAT4 planes[6])
+    {
+        // Rows of the transpose are the columns of the row-vector matrix
+        XMMATRIX m = XMMatrixTranspose(viewProj);
+        XMVECTOR frustum[6] = {
+            XMVectorAdd(m.r[3], m.r[0]),        // Left
+            XMVectorSubtract(m.r[3], m.r[0]),   // Right
+            XMVectorAdd(m.r[3], m.r[1]),        // Bottom
+            XMVectorSubtract(m.r[3], m.r[1]),   // Top
+            m.r[2],                             // Near (z >= 0)
+            XMVectorSubtract(m.r[3], m.r[2]),   // Far
+        };
+
+        for (int p = 0; p < 6; p++)
+            XMStoreFloat4(&planes[p], XMPlaneNormalize(frustum[p]));
+    }
+
+    BOOL BoxVisible(const XMFLOAT4 planes[6], const XMFLOAT3& vMin, const XMFLOAT3& vMax)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            // Corner farthest along the plane normal
+            const XMFLOAT4& plane = planes[p];
+            float x = plane.x >= 0.0f ? vMax.x : vMin.x;
+            float y = plane.y >= 0.0f ? vMax.y : vMin.y;
+            float z = plane.z >= 0.0f ? vMax.z : vMin.z;
+            if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f)
+                return FALSE;
+        }
+        return TRUE;
+    }
+
+    HRESULT CreateBuffers(CHStaticBatch* batch, const CHSceneVertex* vertices, const DWORD* indices)
+    {
+        if (batch->dwVecCount == 0 || batch->dwIndexCount == 0)
+            return E_INVALIDARG;
+
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+        bufferDesc.ByteWidth = sizeof(CHSceneVertex) * batch->dwVecCount;
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+
+        D3D11_SUBRESOURCE_DATA initData = {};
+        initData.pSysMem = vertices;
+
+        HRESULT hr = CHBackendInternal::CreateBuffer(&bufferDesc, &initData, batch->vertexBuffer.GetAddressOf());
+        if (FAILED(hr))
+            return hr;
+
+        // 16-bit indices whenever every vertex is reachable with them
+        std::vector<WORD> shortIndices;
+        if (batch->b32BitIndex)
+        {
+            bufferDesc.ByteWidth = sizeof(DWORD) * batch->dwIndexCount;
+            initData.pSysMem = indices;
+        }
+        else
+        {
+            shortIndices.assign(indices, indices + batch->dwIndexCount);
+            bufferDesc.ByteWidth = sizeof(WORD) * batch->dwIndexCount;
+            initData.pSysMem = shortIndices.data();
+        }
+        bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+        return CHBackendInternal::CreateBuffer(&bufferDesc, &initData, batch->indexBuffer.GetAddressOf());
+    }
+
+    void DrawBatch(CHStaticBatch* batch, const XMFLOAT4 planes[6])
+    {
+        if (!batch->vertexBuffer || !batch->indexBuffer || !g_lpTex[batch->nTex])
+            return;
+
+        if (!BoxVisible(planes, batch->vMin, batch->vMax))
+        {
+            g_dwFrameCulled += batch->dwSubmeshCount;
+            return;
+        }
+
+        SetTexture(0, g_lpTex[batch->nTex]->lpSRV.Get());
+        if (batch->nlTex > -1 && g_lpTex[batch->nlTex])
+        {
+            SetTexture(1, g_lpTex[batch->nlTex]->lpSRV.Get());
+            CHSceneInternal::SetupLightmapRenderStates();
+        }
+        else
+        {
+            SetTexture(1, nullptr);
+            CHSceneInternal::DisableLightmapRenderStates();
+        }
+
+        UINT stride = sizeof(CHSceneVertex);
+        UINT offset = 0;
+        ID3D11Buffer* vb = batch->vertexBuffer.Get();
+        g_D3DContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
+        g_D3DContext->IASetIndexBuffer(batch->indexBuffer.Get(),
+            batch->b32BitIndex ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT, 0);
+
+        // Visible submeshes next to each other in the index buffer share a draw
+        DWORD runStart = 0;
+        DWORD runCount = 0;
+        for (DWORD s = 0; s <= batch->dwSubmeshCount; s++)
+        {
+            BOOL visible = FALSE;
+            if (s < batch->dwSubmeshCount)
+            {
+                const CHStaticSubmesh& submesh = batch->lpSubmesh[s];
+                visible = BoxVisible(planes, submesh.vMin, submesh.vMax);
+                if (visible)
+                {
+                    if (runCount == 0)
+                        runStart = submesh.dwStartIndex;
+                    runCount += submesh.dwIndexCount;
+                    g_dwFrameVisible++;
+                }
+                else
+                {
+                    g_dwFrameCulled++;
+                }
+            }
+
+            if (!visible && runCount > 0)
+            {
+                CHInternal::g_RenderStateManager.CommitStates();
+                CHBackendInternal::DrawIndexed(runCount, runStart, 0);
+                g_dwFrameDraws++;
+                runCount = 0;
+            }
+        }
+    }
+
+    void BeginFrame()
+    {
+        g_dwFrameVisible = 0;
+        g_dwFrameCulled = 0;
+        g_dwFrameDraws = 0;
+    }
+}
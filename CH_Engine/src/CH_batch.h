@@ -0,0 +1,91 @@
+#ifndef _CH_batch_h_
+#define _CH_batch_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include "CH_scene.h"
+
+// One source scene inside a batch
+struct CHStaticSubmesh {
+    XMFLOAT3 vMin;                      // World space bounds
+    XMFLOAT3 vMax;
+    DWORD dwStartIndex;
+    DWORD dwIndexCount;
+};
+
+// Scenes sharing a texture and lightmap, merged into one buffer pair
+struct CHStaticBatch {
+    int nTex;
+    int nlTex;                          // -1: no lightmap
+
+    DWORD dwVecCount;
+    DWORD dwIndexCount;
+    BOOL b32BitIndex;                   // More than 65536 vertices
+
+    DWORD dwSubmeshCount;
+    CHStaticSubmesh* lpSubmesh;         // In index buffer order
+    XMFLOAT3 vMin;                      // Bounds of all submeshes
+    XMFLOAT3 vMax;
+
+    CHComPtr<ID3D11Buffer> vertexBuffer;
+    CHComPtr<ID3D11Buffer> indexBuffer;
+};
+
+// Static opaque world geometry
+struct CHStaticScene {
+    DWORD dwBatchCount;
+    CHStaticBatch* lpBatch;
+};
+
+/*
+    Static batching
+    ---------------
+    StaticScene_Build merges scenes that never move into one vertex and
+    index buffer per texture/lightmap pair, with vertices transformed to
+    world space at build time. StaticScene_Draw culls every submesh
+    against the view frustum and draws each run of visible submeshes
+    with a single DrawIndexed. Scenes can be unloaded after the build.
+    Alpha blended scenes are left out: they still need Scene_Draw, after
+    the static scene, in back to front order.
+*/
+
+// World of each scene: lpWorlds[i], or its frame and matrix (as Scene_Draw) when lpWorlds is nullptr
+CH_CORE_DLL_API
+BOOL StaticScene_Build(CHStaticScene** lppStatic,
+                      CHScene** lppScenes,
+                      const XMMATRIX* lpWorlds,
+                      DWORD dwCount);
+
+CH_CORE_DLL_API
+BOOL StaticScene_Draw(CHStaticScene* lpStatic);
+
+CH_CORE_DLL_API
+void StaticScene_Unload(CHStaticScene** lppStatic);
+
+// This frame so far: submeshes drawn, submeshes culled and draw calls
+CH_CORE_DLL_API
+void StaticScene_GetStats(DWORD* lpVisible, DWORD* lpCulled, DWORD* lpDraws);
+
+// Internal static batching helpers
+namespace CHBatchInternal {
+    // Planes (ax + by + cz + d >= 0 inside) of the view-projection frustum
+    CH_CORE_DLL_API void ExtractFrustum(const XMMATRIX& viewProj, XMFLOAT4 planes[6]);
+    CH_CORE_DLL_API BOOL BoxVisible(const XMFLOAT4 planes[6], const XMFLOAT3& vMin, const XMFLOAT3& vMax);
+
+    HRESULT CreateBuffers(CHStaticBatch* batch, const CHSceneVertex* vertices, const DWORD* indices);
+    void DrawBatch(CHStaticBatch* batch, const XMFLOAT4 planes[6]);
+
+    void BeginFrame();
+}
+
+// Compatibility types
+typedef CHStaticSubmesh C3StaticSubmesh;
+typedef CHStaticBatch C3StaticBatch;
+typedef CHStaticScene C3StaticScene;
+
+#endif // _CH_batch_h_
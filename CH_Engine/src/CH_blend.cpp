@@ -0,0 +1,244 @@
+#include "CH_blend.h"
+#include "CH_phy.h"
+
+namespace CHBlendInternal {
+    thread_local BlendBatch t_BlendBatch;
+}
+
+BOOL MotionBlend_Create(CHMotionBlend** lpBlend, DWORD dwBoneCount)
+{
+    if (!lpBlend)
+        return FALSE;
+
+    *lpBlend = new CHMotionBlend;
+    ZeroMemory(*lpBlend, sizeof(CHMotionBlend));
+
+    (*lpBlend)->Base.fSpeed = 1.0f;
+    (*lpBlend)->Fade.fSpeed = 1.0f;
+    (*lpBlend)->Layer.fSpeed = 1.0f;
+    (*lpBlend)->dwBoneCount = dwBoneCount;
+
+    if (dwBoneCount > 0)
+    {
+        // Layer affects no bone until a mask is set
+        (*lpBlend)->lpBoneMask = new float[dwBoneCount];
+        for (DWORD i = 0; i < dwBoneCount; i++)
+        {
+            (*lpBlend)->lpBoneMask[i] = 0.0f;
+        }
+    }
+
+    return TRUE;
+}
+
+void MotionBlend_Release(CHMotionBlend** lpBlend)
+{
+    if (!lpBlend || !*lpBlend)
+        return;
+
+    delete[] (*lpBlend)->lpBoneMask;
+    delete *lpBlend;
+    *lpBlend = nullptr;
+}
+
+void MotionBlend_Play(CHMotionBlend* lpBlend, CHMotion* lpMotion, DWORD dwFadeFrames, float fSpeed)
+{
+    if (!lpBlend)
+        return;
+
+    // Fade out whatever is playing now (a fade in progress is cut short)
+    if (dwFadeFrames > 0 && lpBlend->Base.lpMotion)
+    {
+        lpBlend->Fade = lpBlend->Base;
+        lpBlend->dwFadeFrames = dwFadeFrames;
+        lpBlend->dwFadeElapsed = 0;
+    }
+    else
+    {
+        lpBlend->Fade.lpMotion = nullptr;
+        lpBlend->dwFadeFrames = 0;
+        lpBlend->dwFadeElapsed = 0;
+    }
+
+    lpBlend->Base.lpMotion = lpMotion;
+    lpBlend->Base.fFrame = 0.0f;
+    lpBlend->Base.fSpeed = fSpeed;
+}
+
+void MotionBlend_SetLayer(CHMotionBlend* lpBlend, CHMotion* lpMotion, float fWeight, float fSpeed)
+{
+    if (!lpBlend)
+        return;
+
+    if (lpBlend->Layer.lpMotion != lpMotion)
+    {
+        lpBlend->Layer.lpMotion = lpMotion;
+        lpBlend->Layer.fFrame = 0.0f;
+    }
+    lpBlend->Layer.fSpeed = fSpeed;
+    lpBlend->fLayerWeight = fWeight;
+}
+
+void MotionBlend_SetBoneMask(CHMotionBlend* lpBlend, DWORD dwBone, float fWeight)
+{
+    if (!lpBlend || dwBone >= lpBlend->dwBoneCount)
+        return;
+
+    lpBlend->lpBoneMask[dwBone] = std::clamp(fWeight, 0.0f, 1.0f);
+}
+
+void MotionBlend_NextFrame(CHMotionBlend* lpBlend, int nStep)
+{
+    if (!lpBlend)
+        return;
+
+    CHBlendInternal::AdvancePlayer(&lpBlend->Base, nStep);
+    CHBlendInternal::AdvancePlayer(&lpBlend->Layer, nStep);
+
+    if (lpBlend->Fade.lpMotion)
+    {
+        CHBlendInternal::AdvancePlayer(&lpBlend->Fade, nStep);
+
+        lpBlend->dwFadeElapsed += static_cast<DWORD>(std::max(nStep, 0));
+        if (lpBlend->dwFadeElapsed >= lpBlend->dwFadeFrames)
+        {
+            lpBlend->Fade.lpMotion = nullptr;
+            lpBlend->dwFadeFrames = 0;
+            lpBlend->dwFadeElapsed = 0;
+        }
+    }
+}
+
+void MotionBlend_EvaluateBatch(CHMotionBlend** lpBlends,
+                               XMMATRIX** lpAccum,
+                               CHAffine** lpPalettes,
+                               DWORD* lpBoneCounts,
+                               DWORD dwCount)
+{
+    if (!lpBlends || !lpPalettes || !lpBoneCounts || dwCount == 0)
+        return;
+
+    using namespace CHBlendInternal;
+    BlendBatch& batch = t_BlendBatch;
+    batch.Resize(dwCount);
+    batch.slots.clear();
+
+    // Pass 1: sample the clips of every distinct blend once
+    DWORD slotCount = 0;
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHMotionBlend* blend = lpBlends[i];
+
+        auto found = batch.slots.find(blend);
+        if (found != batch.slots.end())
+        {
+            batch.slotOf[i] = found->second;
+            continue;
+        }
+
+        DWORD slot = slotCount++;
+        batch.slots.emplace(blend, slot);
+        batch.slotOf[i] = slot;
+
+        CHAffine baseKey = Affine_Identity();
+
+        if (blend)
+        {
+            SamplePlayer(&blend->Base, &baseKey);
+
+            CHAffine fadeKey;
+            if (blend->Fade.lpMotion && SamplePlayer(&blend->Fade, &fadeKey))
+            {
+                baseKey = Affine_Blend(fadeKey, baseKey, GetFadeWeight(blend));
+            }
+        }
+        batch.baseKeys[slot] = baseKey;
+
+        batch.hasLayer[slot] = FALSE;
+        if (blend && blend->Layer.lpMotion && blend->fLayerWeight > 0.0f && blend->lpBoneMask &&
+            SamplePlayer(&blend->Layer, &batch.layerKeys[slot]))
+        {
+            batch.hasLayer[slot] = TRUE;
+            batch.layerWeights[slot] = blend->fLayerWeight;
+        }
+    }
+
+    // Pass 2: per-bone mask blend and accumulator compose
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHAffine* palette = lpPalettes[i];
+        if (!palette)
+            continue;
+
+        DWORD slot = batch.slotOf[i];
+        const CHAffine& baseKey = batch.baseKeys[slot];
+        const XMMATRIX* accum = lpAccum ? lpAccum[i] : nullptr;
+        CHMotionBlend* blend = lpBlends[i];
+        DWORD boneCount = lpBoneCounts[i];
+
+        if (batch.hasLayer[slot])
+        {
+            const CHAffine& layerKey = batch.layerKeys[slot];
+            float layerWeight = batch.layerWeights[slot];
+            DWORD maskCount = std::min(boneCount, blend->dwBoneCount);
+
+            for (DWORD b = 0; b < boneCount; b++)
+            {
+                float weight = b < maskCount ? blend->lpBoneMask[b] * layerWeight : 0.0f;
+                CHAffine key = weight > 0.0f ? Affine_Blend(baseKey, layerKey, weight) : baseKey;
+                palette[b] = accum ? Affine_Multiply(Affine_FromMatrix(accum[b]), key) : key;
+            }
+        }
+        else
+        {
+            for (DWORD b = 0; b < boneCount; b++)
+            {
+                palette[b] = accum ? Affine_Multiply(Affine_FromMatrix(accum[b]), baseKey) : baseKey;
+            }
+        }
+    }
+}
+
+// Internal implementation
+namespace CHBlendInternal {
+
+    BOOL SamplePlayer(const CHMotionPlayer* player, CHAffine* key)
+    {
+        if (!player || !player->lpMotion)
+            return FALSE;
+
+        return CHPhyInternal::EvaluateMotionKeyframe(player->lpMotion, player->fFrame, key);
+    }
+
+    void AdvancePlayer(CHMotionPlayer* player, int nStep)
+    {
+        if (!player || !player->lpMotion || player->lpMotion->dwFrames == 0)
+            return;
+
+        float frames = static_cast<float>(player->lpMotion->dwFrames);
+        player->fFrame = fmodf(player->fFrame + nStep * player->fSpeed, frames);
+        if (player->fFrame < 0.0f)
+            player->fFrame += frames;
+    }
+
+    float GetFadeWeight(const CHMotionBlend* blend)
+    {
+        if (!blend || blend->dwFadeFrames == 0)
+            return 1.0f;
+
+        return std::min(1.0f, static_cast<float>(blend->dwFadeElapsed) / blend->dwFadeFrames);
+    }
+
+    void BlendBatch::Resize(DWORD count)
+    {
+        if (baseKeys.size() >= count)
+            return;
+
+        baseKeys.resize(count);
+        layerKeys.resize(count);
+        layerWeights.resize(count);
+        hasLayer.resize(count);
+        slotOf.resize(count);
+    }
+
+} // namespace CHBlendInternal
@@ -0,0 +1,96 @@
+#ifndef _CH_blend_h_
+#define _CH_blend_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include "CH_affine.h"
+
+struct CHMotion;
+
+// Clip player (own frame cursor, the clip itself can be shared)
+struct CHMotionPlayer {
+    CHMotion* lpMotion;         // Clip (nullptr = inactive)
+    float fFrame;               // Current frame (fractional)
+    float fSpeed;               // Frames advanced per step
+};
+
+// Crossfade plus one masked layer on top of a base clip
+struct CHMotionBlend {
+    CHMotionPlayer Base;        // Clip being faded in / playing
+    CHMotionPlayer Fade;        // Clip being faded out
+    DWORD dwFadeFrames;         // Crossfade length
+    DWORD dwFadeElapsed;        // Crossfade progress
+
+    CHMotionPlayer Layer;       // Layered clip (e.g. upper body)
+    float fLayerWeight;         // Overall layer weight
+
+    DWORD dwBoneCount;          // Bones covered by the mask
+    float* lpBoneMask;          // Per-bone layer weight (0..1)
+};
+
+// Blend functions
+CH_CORE_DLL_API
+BOOL MotionBlend_Create(CHMotionBlend** lpBlend, DWORD dwBoneCount);
+
+CH_CORE_DLL_API
+void MotionBlend_Release(CHMotionBlend** lpBlend);
+
+// Switch the base clip, crossfading from the current one over dwFadeFrames
+CH_CORE_DLL_API
+void MotionBlend_Play(CHMotionBlend* lpBlend, CHMotion* lpMotion, DWORD dwFadeFrames = 0, float fSpeed = 1.0f);
+
+CH_CORE_DLL_API
+void MotionBlend_SetLayer(CHMotionBlend* lpBlend, CHMotion* lpMotion, float fWeight, float fSpeed = 1.0f);
+
+CH_CORE_DLL_API
+void MotionBlend_SetBoneMask(CHMotionBlend* lpBlend, DWORD dwBone, float fWeight);
+
+CH_CORE_DLL_API
+void MotionBlend_NextFrame(CHMotionBlend* lpBlend, int nStep);
+
+// Evaluate dwCount blends into their bone palettes in one pass.
+// lpAccum[i] supplies the per-bone accumulated matrices (Phy_Muliply), may be nullptr.
+// A blend listed several times (objects sharing it) has its clips sampled once.
+CH_CORE_DLL_API
+void MotionBlend_EvaluateBatch(CHMotionBlend** lpBlends,
+                               XMMATRIX** lpAccum,
+                               CHAffine** lpPalettes,
+                               DWORD* lpBoneCounts,
+                               DWORD dwCount);
+
+// Internal blend implementation
+namespace CHBlendInternal {
+    // Clip sampling
+    BOOL SamplePlayer(const CHMotionPlayer* player, CHAffine* key);
+    void AdvancePlayer(CHMotionPlayer* player, int nStep);
+    float GetFadeWeight(const CHMotionBlend* blend);
+
+    // Batch evaluation scratch, one array per field indexed by distinct blend.
+    // A clip samples to one key for all bones, so keys are not split into lanes:
+    // pass 2 is bound by the per-bone compose, not by reading keys. Per thread,
+    // so batches evaluated on several threads never share it.
+    struct BlendBatch {
+        std::vector<CHAffine> baseKeys;
+        std::vector<CHAffine> layerKeys;
+        std::vector<float> layerWeights;
+        std::vector<BYTE> hasLayer;
+
+        std::unordered_map<const CHMotionBlend*, DWORD> slots;
+        std::vector<DWORD> slotOf;          // Per entry: its blend's slot
+
+        void Resize(DWORD count);
+    };
+
+    extern thread_local BlendBatch t_BlendBatch;
+}
+
+// Compatibility types
+typedef CHMotionBlend C3MotionBlend;
+typedef CHMotionPlayer C3MotionPlayer;
+
+#endif // _CH_blend_h_
@@ -232,8 +232,8 @@ BOOL Camera_BuildView(CHCamera* lpCamera, BOOL bSet)
 
     if (bSet)
     {
-        // Update shader constant buffer with new view matrix
-        CHInternal::g_CompatibilityShaderManager.UpdateConstantBuffer(XMMatrixIdentity(), g_ViewMatrix, g_ProjectMatrix);
+        // Update per-frame shader constants with new view matrix
+        CHInternal::g_ConstantBuffers.UpdateFrame();
     }
     
     return TRUE;
@@ -254,8 +254,8 @@ BOOL Camera_BuildProject(CHCamera* lpCamera, BOOL bSet)
 
     if (bSet)
     {
-        // Update shader constant buffer with new projection matrix
-        CHInternal::g_CompatibilityShaderManager.UpdateConstantBuffer(XMMatrixIdentity(), g_ViewMatrix, g_ProjectMatrix);
+        // Update per-frame shader constants with new projection matrix
+        CHInternal::g_ConstantBuffers.UpdateFrame();
     }
     
     return TRUE;
@@ -278,8 +278,8 @@ BOOL Camera_BuildOrtho(CHCamera* lpCamera,
 
     if (bSet)
     {
-        // Update shader constant buffer with new projection matrix
-        CHInternal::g_CompatibilityShaderManager.UpdateConstantBuffer(XMMatrixIdentity(), g_ViewMatrix, g_ProjectMatrix);
+        // Update per-frame shader constants with new projection matrix
+        CHInternal::g_ConstantBuffers.UpdateFrame();
     }
     
     return TRUE;
@@ -1,5 +1,6 @@
 #include "CH_capscreen.h"
 #include "CH_main.h"
+#include "CH_backend.h"
 #include <string>
 
 void CapScreen(char* lpName)
@@ -83,7 +84,7 @@ BOOL CaptureBackBuffer(unsigned char** buffer, DWORD* width, DWORD* height)
     stagingDesc.MiscFlags = 0;
     
     CHComPtr<ID3D11Texture2D> stagingTexture;
-    hr = g_D3DDevice->CreateTexture2D(&stagingDesc, nullptr, stagingTexture.GetAddressOf());
+    hr = CHBackendInternal::CreateTexture2D(&stagingDesc, nullptr, stagingTexture.GetAddressOf());
     if (FAILED(hr))
         return FALSE;
     
@@ -92,7 +93,7 @@ BOOL CaptureBackBuffer(unsigned char** buffer, DWORD* width, DWORD* height)
     
     // Map staging texture for reading
     D3D11_MAPPED_SUBRESOURCE mappedResource;
-    hr = g_D3DContext->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &mappedResource);
+    hr = CHBackendInternal::Map(stagingTexture.Get(), 0, D3D11_MAP_READ, &mappedResource);
     if (FAILED(hr))
         return FALSE;
     
@@ -31,6 +31,7 @@
 
 // Windows and DirectX 11 includes
 #include <d3d11.h>
+#include <d3d11_1.h>
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <DirectXColors.h>
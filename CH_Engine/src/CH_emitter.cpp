@@ -0,0 +1,569 @@
+#include "CH_emitter.h"
+#include <cfloat>
+
+namespace CHEmitterInternal {
+    WorkerPool g_WorkerPool;
+}
+
+void Emitter_DefaultDesc(CHEmitterDesc* lpDesc)
+{
+    if (!lpDesc)
+        return;
+
+    ZeroMemory(lpDesc, sizeof(CHEmitterDesc));
+    lpDesc->dwMaxParticles = 256;
+    lpDesc->dwSeed = 1;
+    lpDesc->fSpawnRate = 4.0f;
+    lpDesc->fLife = 30.0f;
+
+    // Constant size, age runs across the whole atlas over the lifetime
+    lpDesc->SizeCurve.dwKeys = 1;
+    lpDesc->SizeCurve.fValue[0] = 1.0f;
+    lpDesc->AgeCurve.dwKeys = 2;
+    lpDesc->AgeCurve.fTime[1] = 1.0f;
+    lpDesc->AgeCurve.fValue[1] = 1.0f;
+}
+
+BOOL Emitter_Create(CHPtclEmitter** lpEmitter, const CHEmitterDesc* lpDesc)
+{
+    if (!lpEmitter || !lpDesc)
+        return FALSE;
+
+    *lpEmitter = new CHPtclEmitter();
+    CHPtclEmitter* emitter = *lpEmitter;
+    emitter->Desc = *lpDesc;
+    emitter->Desc.SizeCurve.dwKeys = std::min<DWORD>(emitter->Desc.SizeCurve.dwKeys, CH_EMITTER_CURVE_KEYS);
+    emitter->Desc.AgeCurve.dwKeys = std::min<DWORD>(emitter->Desc.AgeCurve.dwKeys, CH_EMITTER_CURVE_KEYS);
+
+    DWORD capacity = std::max<DWORD>(lpDesc->dwMaxParticles, 1);
+    emitter->dwCapacity = capacity;
+    emitter->lpPosX = new float[capacity];
+    emitter->lpPosY = new float[capacity];
+    emitter->lpPosZ = new float[capacity];
+    emitter->lpVelX = new float[capacity];
+    emitter->lpVelY = new float[capacity];
+    emitter->lpVelZ = new float[capacity];
+    emitter->lpLife = new float[capacity];
+    emitter->lpInvLife = new float[capacity];
+
+    emitter->Frame.lpPos = new XMVECTOR[capacity];
+    emitter->Frame.lpAge = new float[capacity];
+    emitter->Frame.lpSize = new float[capacity];
+    emitter->Frame.matrix = XMMatrixIdentity();
+
+    Emitter_Reset(emitter);
+    return TRUE;
+}
+
+void Emitter_Release(CHPtclEmitter** lpEmitter)
+{
+    if (!lpEmitter || !*lpEmitter)
+        return;
+
+    CHPtclEmitter* emitter = *lpEmitter;
+    delete[] emitter->lpPosX;
+    delete[] emitter->lpPosY;
+    delete[] emitter->lpPosZ;
+    delete[] emitter->lpVelX;
+    delete[] emitter->lpVelY;
+    delete[] emitter->lpVelZ;
+    delete[] emitter->lpLife;
+    delete[] emitter->lpInvLife;
+    delete[] emitter->Frame.lpPos;
+    delete[] emitter->Frame.lpAge;
+    delete[] emitter->Frame.lpSize;
+
+    delete emitter;
+    *lpEmitter = nullptr;
+}
+
+void Emitter_Reset(CHPtclEmitter* lpEmitter)
+{
+    if (!lpEmitter)
+        return;
+
+    lpEmitter->dwCount = 0;
+    lpEmitter->dwFrame = 0;
+    lpEmitter->fSpawnAccum = 0.0f;
+    lpEmitter->dwRandom = lpEmitter->Desc.dwSeed ? lpEmitter->Desc.dwSeed : 1;
+    lpEmitter->Frame.dwCount = 0;
+}
+
+void Emitter_Step(CHPtclEmitter* lpEmitter, int nStep)
+{
+    CHEmitterInternal::StepEmitter(lpEmitter, nStep, TRUE);
+}
+
+void Emitter_StepBatch(CHPtclEmitter** lpEmitters, DWORD dwCount, int nStep)
+{
+    if (!lpEmitters || dwCount == 0 || nStep <= 0)
+        return;
+
+    using namespace CHEmitterInternal;
+
+    // One emitter per job: each owns its random state, so results do not
+    // depend on which thread runs it
+    struct BatchContext {
+        CHPtclEmitter** emitters;
+        int step;
+    } context = { lpEmitters, nStep };
+
+    g_WorkerPool.Run(dwCount, 1, [](void* ctx, DWORD begin, DWORD end)
+    {
+        BatchContext* batch = static_cast<BatchContext*>(ctx);
+        for (DWORD i = begin; i < end; i++)
+        {
+            StepEmitter(batch->emitters[i], batch->step, FALSE);
+        }
+    }, &context);
+}
+
+BOOL Emitter_FitBaked(const CHPtcl* lpPtcl, CHEmitterDesc* lpDesc)
+{
+    if (!lpPtcl || !lpDesc || !lpPtcl->lpPtcl || lpPtcl->dwFrames == 0)
+        return FALSE;
+
+    Emitter_DefaultDesc(lpDesc);
+
+    // Decoded particles, positions in effect space (frames carry their own matrix)
+    std::vector<std::vector<XMFLOAT3>> positions(lpPtcl->dwFrames);
+    std::vector<std::vector<float>> ages(lpPtcl->dwFrames);
+    std::vector<std::vector<float>> sizes(lpPtcl->dwFrames);
+    DWORD maxCount = 0;
+    double totalCount = 0.0;
+    for (DWORD f = 0; f < lpPtcl->dwFrames; f++)
+    {
+        const CHPtclFrame* frame = &lpPtcl->lpPtcl[f];
+        positions[f].resize(frame->dwCount);
+        ages[f].resize(frame->dwCount);
+        sizes[f].resize(frame->dwCount);
+        for (DWORD i = 0; i < frame->dwCount; i++)
+        {
+            XMFLOAT3 pos;
+            CHPtclInternal::DecodeParticle(lpPtcl, frame, i, &pos, &ages[f][i], &sizes[f][i]);
+            XMStoreFloat3(&positions[f][i], XMVector3Transform(XMLoadFloat3(&pos), frame->matrix));
+        }
+        maxCount = std::max(maxCount, frame->dwCount);
+        totalCount += frame->dwCount;
+    }
+
+    if (maxCount == 0)
+        return FALSE;
+
+    // A slot whose age advanced a little between frames holds the same particle
+    const float maxAgeStep = 0.5f;
+    double ageStepSum = 0.0, lifeSum = 0.0, lifeSqSum = 0.0;
+    double velSum[3] = {}, velSqSum[3] = {}, accelSum[3] = {};
+    DWORD pairCount = 0, accelCount = 0;
+
+    for (DWORD f = 0; f + 1 < lpPtcl->dwFrames; f++)
+    {
+        const CHPtclFrame* a = &lpPtcl->lpPtcl[f];
+        const CHPtclFrame* b = &lpPtcl->lpPtcl[f + 1];
+        const CHPtclFrame* c = f + 2 < lpPtcl->dwFrames ? &lpPtcl->lpPtcl[f + 2] : nullptr;
+        DWORD count = std::min(a->dwCount, b->dwCount);
+
+        for (DWORD i = 0; i < count; i++)
+        {
+            float step = ages[f + 1][i] - ages[f][i];
+            if (step <= 0.0f || step >= maxAgeStep)
+                continue;
+
+            const XMFLOAT3& p0 = positions[f][i];
+            const XMFLOAT3& p1 = positions[f + 1][i];
+            float vel[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+            for (int k = 0; k < 3; k++)
+            {
+                velSum[k] += vel[k];
+                velSqSum[k] += vel[k] * vel[k];
+            }
+
+            float life = 1.0f / step;
+            ageStepSum += step;
+            lifeSum += life;
+            lifeSqSum += life * life;
+            pairCount++;
+
+            // Second difference gives the acceleration
+            if (c && i < c->dwCount)
+            {
+                float next = ages[f + 2][i] - ages[f + 1][i];
+                if (next > 0.0f && next < maxAgeStep)
+                {
+                    const XMFLOAT3& p2 = positions[f + 2][i];
+                    accelSum[0] += (p2.x - p1.x) - vel[0];
+                    accelSum[1] += (p2.y - p1.y) - vel[1];
+                    accelSum[2] += (p2.z - p1.z) - vel[2];
+                    accelCount++;
+                }
+            }
+        }
+    }
+
+    float meanStep = pairCount ? static_cast<float>(ageStepSum / pairCount) : 0.0f;
+    lpDesc->fLife = meanStep > 0.0f ? 1.0f / meanStep : static_cast<float>(lpPtcl->dwFrames);
+    if (pairCount)
+    {
+        // Uniform +/- a has a standard deviation of a / sqrt(3)
+        const double spread = 1.7320508;
+        double lifeMean = lifeSum / pairCount;
+        lpDesc->fLifeVariance = static_cast<float>(sqrt(std::max(0.0, lifeSqSum / pairCount - lifeMean * lifeMean)) * spread);
+
+        float mean[3], variance[3];
+        for (int k = 0; k < 3; k++)
+        {
+            double m = velSum[k] / pairCount;
+            mean[k] = static_cast<float>(m);
+            variance[k] = static_cast<float>(sqrt(std::max(0.0, velSqSum[k] / pairCount - m * m)) * spread);
+        }
+        lpDesc->Velocity = XMFLOAT3(mean[0], mean[1], mean[2]);
+        lpDesc->VelocityVariance = XMFLOAT3(variance[0], variance[1], variance[2]);
+    }
+    if (accelCount)
+    {
+        lpDesc->Gravity = XMFLOAT3(static_cast<float>(accelSum[0] / accelCount),
+                                   static_cast<float>(accelSum[1] / accelCount),
+                                   static_cast<float>(accelSum[2] / accelCount));
+    }
+
+    // Steady state: live count = spawn rate * lifetime
+    lpDesc->fSpawnRate = static_cast<float>(totalCount / lpPtcl->dwFrames) / std::max(lpDesc->fLife, 1.0f);
+    lpDesc->dwMaxParticles = maxCount + maxCount / 4 + 1;
+
+    // Spawn box from the youngest particles, size curve from age bins
+    float youngAge = std::max(meanStep * 2.0f, 0.05f);
+    XMFLOAT3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+    XMFLOAT3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    double sizeSum[CH_EMITTER_CURVE_KEYS] = {};
+    DWORD sizeCount[CH_EMITTER_CURVE_KEYS] = {};
+
+    for (DWORD f = 0; f < lpPtcl->dwFrames; f++)
+    {
+        const CHPtclFrame* frame = &lpPtcl->lpPtcl[f];
+        for (DWORD i = 0; i < frame->dwCount; i++)
+        {
+            float age = std::clamp(ages[f][i], 0.0f, 1.0f);
+            int bin = static_cast<int>(age * (CH_EMITTER_CURVE_KEYS - 1) + 0.5f);
+            sizeSum[bin] += sizes[f][i];
+            sizeCount[bin]++;
+
+            if (age <= youngAge)
+            {
+                const XMFLOAT3& p = positions[f][i];
+                boxMin = XMFLOAT3(std::min(boxMin.x, p.x), std::min(boxMin.y, p.y), std::min(boxMin.z, p.z));
+                boxMax = XMFLOAT3(std::max(boxMax.x, p.x), std::max(boxMax.y, p.y), std::max(boxMax.z, p.z));
+            }
+        }
+    }
+
+    if (boxMin.x <= boxMax.x)
+    {
+        lpDesc->SpawnCenter = XMFLOAT3((boxMin.x + boxMax.x) * 0.5f, (boxMin.y + boxMax.y) * 0.5f, (boxMin.z + boxMax.z) * 0.5f);
+        lpDesc->SpawnExtent = XMFLOAT3((boxMax.x - boxMin.x) * 0.5f, (boxMax.y - boxMin.y) * 0.5f, (boxMax.z - boxMin.z) * 0.5f);
+    }
+
+    // Empty bins take the previous key (or the first filled one)
+    float lastSize = 1.0f;
+    for (int k = 0; k < CH_EMITTER_CURVE_KEYS; k++)
+    {
+        if (sizeCount[k])
+        {
+            lastSize = static_cast<float>(sizeSum[k] / sizeCount[k]);
+            break;
+        }
+    }
+    lpDesc->SizeCurve.dwKeys = CH_EMITTER_CURVE_KEYS;
+    for (int k = 0; k < CH_EMITTER_CURVE_KEYS; k++)
+    {
+        if (sizeCount[k])
+            lastSize = static_cast<float>(sizeSum[k] / sizeCount[k]);
+        lpDesc->SizeCurve.fTime[k] = static_cast<float>(k) / (CH_EMITTER_CURVE_KEYS - 1);
+        lpDesc->SizeCurve.fValue[k] = lastSize;
+    }
+
+    return TRUE;
+}
+
+// Internal implementation
+namespace CHEmitterInternal {
+
+    float Random(DWORD* state)
+    {
+        // xorshift32, mapped to [-1, 1)
+        DWORD x = *state;
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        *state = x;
+        return static_cast<float>(x >> 8) * (2.0f / 16777216.0f) - 1.0f;
+    }
+
+    float EvaluateCurve(const CHEmitterCurve* curve, float t)
+    {
+        if (!curve || curve->dwKeys == 0)
+            return 1.0f;
+
+        if (t <= curve->fTime[0])
+            return curve->fValue[0];
+
+        for (DWORD k = 1; k < curve->dwKeys; k++)
+        {
+            if (t < curve->fTime[k])
+            {
+                float span = curve->fTime[k] - curve->fTime[k - 1];
+                float blend = span > 0.0f ? (t - curve->fTime[k - 1]) / span : 1.0f;
+                return curve->fValue[k - 1] + (curve->fValue[k] - curve->fValue[k - 1]) * blend;
+            }
+        }
+
+        return curve->fValue[curve->dwKeys - 1];
+    }
+
+    void KillExpired(CHPtclEmitter* emitter)
+    {
+        // Swap-remove keeps the pass serial and its result deterministic
+        DWORD i = 0;
+        while (i < emitter->dwCount)
+        {
+            if (emitter->lpLife[i] * emitter->lpInvLife[i] < 1.0f)
+            {
+                i++;
+                continue;
+            }
+
+            DWORD last = --emitter->dwCount;
+            emitter->lpPosX[i] = emitter->lpPosX[last];
+            emitter->lpPosY[i] = emitter->lpPosY[last];
+            emitter->lpPosZ[i] = emitter->lpPosZ[last];
+            emitter->lpVelX[i] = emitter->lpVelX[last];
+            emitter->lpVelY[i] = emitter->lpVelY[last];
+            emitter->lpVelZ[i] = emitter->lpVelZ[last];
+            emitter->lpLife[i] = emitter->lpLife[last];
+            emitter->lpInvLife[i] = emitter->lpInvLife[last];
+        }
+    }
+
+    void SpawnParticles(CHPtclEmitter* emitter)
+    {
+        const CHEmitterDesc& desc = emitter->Desc;
+        if (desc.dwEmitFrames > 0 && emitter->dwFrame >= desc.dwEmitFrames)
+            return;
+
+        emitter->fSpawnAccum += desc.fSpawnRate;
+        DWORD spawn = static_cast<DWORD>(emitter->fSpawnAccum);
+        emitter->fSpawnAccum -= static_cast<float>(spawn);
+        spawn = std::min(spawn, emitter->dwCapacity - emitter->dwCount);
+
+        DWORD* rng = &emitter->dwRandom;
+        for (DWORD n = 0; n < spawn; n++)
+        {
+            DWORD i = emitter->dwCount++;
+            emitter->lpPosX[i] = desc.SpawnCenter.x + desc.SpawnExtent.x * Random(rng);
+            emitter->lpPosY[i] = desc.SpawnCenter.y + desc.SpawnExtent.y * Random(rng);
+            emitter->lpPosZ[i] = desc.SpawnCenter.z + desc.SpawnExtent.z * Random(rng);
+            emitter->lpVelX[i] = desc.Velocity.x + desc.VelocityVariance.x * Random(rng);
+            emitter->lpVelY[i] = desc.Velocity.y + desc.VelocityVariance.y * Random(rng);
+            emitter->lpVelZ[i] = desc.Velocity.z + desc.VelocityVariance.z * Random(rng);
+            emitter->lpLife[i] = 0.0f;
+            emitter->lpInvLife[i] = 1.0f / std::max(desc.fLife + desc.fLifeVariance * Random(rng), 1.0f);
+        }
+    }
+
+    void Integrate(CHPtclEmitter* emitter, DWORD begin, DWORD end)
+    {
+        const CHEmitterDesc& desc = emitter->Desc;
+        float damp = 1.0f - std::clamp(desc.fDrag, 0.0f, 1.0f);
+
+        for (DWORD i = begin; i < end; i++)
+        {
+            float vx = (emitter->lpVelX[i] + desc.Gravity.x) * damp;
+            float vy = (emitter->lpVelY[i] + desc.Gravity.y) * damp;
+            float vz = (emitter->lpVelZ[i] + desc.Gravity.z) * damp;
+            emitter->lpVelX[i] = vx;
+            emitter->lpVelY[i] = vy;
+            emitter->lpVelZ[i] = vz;
+            emitter->lpPosX[i] += vx;
+            emitter->lpPosY[i] += vy;
+            emitter->lpPosZ[i] += vz;
+            emitter->lpLife[i] += 1.0f;
+        }
+    }
+
+    void WriteFrame(CHPtclEmitter* emitter, DWORD begin, DWORD end)
+    {
+        CHPtclFrame* frame = &emitter->Frame;
+        for (DWORD i = begin; i < end; i++)
+        {
+            float t = std::min(emitter->lpLife[i] * emitter->lpInvLife[i], 1.0f);
+            frame->lpPos[i] = XMVectorSet(emitter->lpPosX[i], emitter->lpPosY[i], emitter->lpPosZ[i], 1.0f);
+            frame->lpAge[i] = EvaluateCurve(&emitter->Desc.AgeCurve, t);
+            frame->lpSize[i] = EvaluateCurve(&emitter->Desc.SizeCurve, t);
+        }
+    }
+
+    void StepEmitter(CHPtclEmitter* emitter, int nStep, BOOL bParallel)
+    {
+        if (!emitter || nStep <= 0)
+            return;
+
+        // Spawn/kill stay serial, per-particle passes split across workers
+        auto integrate = [](void* ctx, DWORD begin, DWORD end)
+        {
+            Integrate(static_cast<CHPtclEmitter*>(ctx), begin, end);
+        };
+        auto write = [](void* ctx, DWORD begin, DWORD end)
+        {
+            WriteFrame(static_cast<CHPtclEmitter*>(ctx), begin, end);
+        };
+
+        for (int s = 0; s < nStep; s++)
+        {
+            KillExpired(emitter);
+            SpawnParticles(emitter);
+            if (bParallel)
+                g_WorkerPool.Run(emitter->dwCount, PARTICLE_GRAIN, integrate, emitter);
+            else
+                Integrate(emitter, 0, emitter->dwCount);
+            emitter->dwFrame++;
+        }
+
+        if (bParallel)
+            g_WorkerPool.Run(emitter->dwCount, PARTICLE_GRAIN, write, emitter);
+        else
+            WriteFrame(emitter, 0, emitter->dwCount);
+        emitter->Frame.dwCount = emitter->dwCount;
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        // Joining here would block under the loader lock; Shutdown is the only
+        // place that waits, and any worker still parked is left to the process
+        for (std::thread& thread : m_threads)
+        {
+            if (thread.joinable())
+                thread.detach();
+        }
+    }
+
+    BOOL WorkerPool::Start()
+    {
+        if (!m_threads.empty())
+            return TRUE;
+
+        // The calling thread works too
+        unsigned int workers = std::thread::hardware_concurrency();
+        if (workers <= 1)
+            return FALSE;
+
+        m_quit = FALSE;
+        for (unsigned int i = 0; i + 1 < workers; i++)
+        {
+            m_threads.emplace_back(&WorkerPool::WorkerMain, this);
+        }
+        return TRUE;
+    }
+
+    void WorkerPool::Run(DWORD count, DWORD grain, JobFunc job, void* context)
+    {
+        if (count == 0 || !job)
+            return;
+
+        grain = std::max<DWORD>(grain, 1);
+        DWORD chunks = (count + grain - 1) / grain;
+
+        // One job at a time: a caller that finds the pool busy runs inline
+        if (chunks == 1 || m_busy.exchange(true))
+        {
+            job(context, 0, count);
+            return;
+        }
+        if (!Start())
+        {
+            m_busy.store(false);
+            job(context, 0, count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_job = job;
+            m_context = context;
+            m_count = count;
+            m_grain = grain;
+            m_chunks = chunks;
+            m_next.store(0);
+            m_done.store(0);
+            m_generation++;
+        }
+        m_wake.notify_all();
+
+        RunChunks();
+
+        // Wait for the last chunk and for every worker to leave the job
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_finished.wait(lock, [this] { return m_done.load() == m_chunks && m_active == 0; });
+        m_job = nullptr;
+        m_busy.store(false);
+    }
+
+    void WorkerPool::Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = TRUE;
+        }
+        m_wake.notify_all();
+
+        for (std::thread& thread : m_threads)
+        {
+            if (thread.joinable())
+                thread.join();
+        }
+        m_threads.clear();
+    }
+
+    void WorkerPool::WorkerMain()
+    {
+        DWORD seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [&] { return m_quit || (m_job && m_generation != seen); });
+                if (m_quit)
+                    return;
+                seen = m_generation;
+                m_active++;
+            }
+
+            RunChunks();
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_active--;
+            }
+            m_finished.notify_all();
+        }
+    }
+
+    void WorkerPool::RunChunks()
+    {
+        for (;;)
+        {
+            DWORD chunk = m_next.fetch_add(1);
+            if (chunk >= m_chunks)
+                break;
+
+            DWORD begin = chunk * m_grain;
+            DWORD end = std::min(begin + m_grain, m_count);
+            m_job(m_context, begin, end);
+
+            if (m_done.fetch_add(1) + 1 == m_chunks)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_finished.notify_all();
+            }
+        }
+    }
+
+} // namespace CHEmitterInternal
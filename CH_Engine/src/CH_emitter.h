@@ -0,0 +1,151 @@
+#ifndef _CH_emitter_h_
+#define _CH_emitter_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include "CH_ptcl.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#define CH_EMITTER_CURVE_KEYS 4
+
+// Piecewise linear curve over normalized particle life (0..1)
+struct CHEmitterCurve {
+    DWORD dwKeys;                           // Keys in use (0 = constant 1)
+    float fTime[CH_EMITTER_CURVE_KEYS];     // Ascending, 0..1
+    float fValue[CH_EMITTER_CURVE_KEYS];
+};
+
+// Emitter parameters (all rates are per frame, as baked effects are)
+struct CHEmitterDesc {
+    DWORD dwMaxParticles;       // Live particle limit
+    DWORD dwSeed;               // Random seed (same seed = same effect)
+    DWORD dwEmitFrames;         // Frames spent spawning (0 = forever)
+    float fSpawnRate;           // Particles spawned per frame
+    float fLife;                // Particle lifetime in frames
+    float fLifeVariance;        // +/- lifetime in frames
+
+    XMFLOAT3 SpawnCenter;       // Spawn box centre
+    XMFLOAT3 SpawnExtent;       // Spawn box half size
+    XMFLOAT3 Velocity;          // Initial velocity
+    XMFLOAT3 VelocityVariance;  // +/- initial velocity per axis
+    XMFLOAT3 Gravity;           // Velocity added per frame
+    float fDrag;                // Velocity fraction lost per frame
+
+    CHEmitterCurve SizeCurve;   // Life -> particle size
+    CHEmitterCurve AgeCurve;    // Life -> atlas age (0..1)
+};
+
+// Runtime emitter (SoA particle state)
+struct CHPtclEmitter {
+    CHEmitterDesc Desc;
+    DWORD dwCount;              // Live particles
+    DWORD dwCapacity;           // Particles allocated
+
+    float* lpPosX;
+    float* lpPosY;
+    float* lpPosZ;
+    float* lpVelX;
+    float* lpVelY;
+    float* lpVelZ;
+    float* lpLife;              // Frames lived
+    float* lpInvLife;           // 1 / lifetime
+
+    DWORD dwRandom;             // xorshift state
+    DWORD dwFrame;              // Frames simulated since reset
+    float fSpawnAccum;          // Fractional spawn carry
+
+    CHPtclFrame Frame;          // Output consumed by the particle renderer
+};
+
+// Emitter functions
+CH_CORE_DLL_API
+void Emitter_DefaultDesc(CHEmitterDesc* lpDesc);
+
+CH_CORE_DLL_API
+BOOL Emitter_Create(CHPtclEmitter** lpEmitter, const CHEmitterDesc* lpDesc);
+
+CH_CORE_DLL_API
+void Emitter_Release(CHPtclEmitter** lpEmitter);
+
+// Restart from the seed (replaying n frames always gives the same particles)
+CH_CORE_DLL_API
+void Emitter_Reset(CHPtclEmitter* lpEmitter);
+
+CH_CORE_DLL_API
+void Emitter_Step(CHPtclEmitter* lpEmitter, int nStep);
+
+// Step several emitters, spread across the worker threads
+CH_CORE_DLL_API
+void Emitter_StepBatch(CHPtclEmitter** lpEmitters, DWORD dwCount, int nStep);
+
+// Estimate emitter parameters from a baked effect
+CH_CORE_DLL_API
+BOOL Emitter_FitBaked(const CHPtcl* lpPtcl, CHEmitterDesc* lpDesc);
+
+// Internal emitter implementation
+namespace CHEmitterInternal {
+    // Simulation
+    float Random(DWORD* state);
+    float EvaluateCurve(const CHEmitterCurve* curve, float t);
+    void KillExpired(CHPtclEmitter* emitter);
+    void SpawnParticles(CHPtclEmitter* emitter);
+    void Integrate(CHPtclEmitter* emitter, DWORD begin, DWORD end);
+    void WriteFrame(CHPtclEmitter* emitter, DWORD begin, DWORD end);
+    void StepEmitter(CHPtclEmitter* emitter, int nStep, BOOL bParallel);
+
+    // Persistent worker threads for data-parallel loops
+    class WorkerPool {
+    public:
+        typedef void (*JobFunc)(void* context, DWORD begin, DWORD end);
+
+        ~WorkerPool();
+
+        // Run job over [0, count) in chunks of grain, blocks until done.
+        // Runs inline if another thread is already using the pool
+        void Run(DWORD count, DWORD grain, JobFunc job, void* context);
+
+        // Joins the workers; the destructor never blocks
+        void Shutdown();
+
+    private:
+        BOOL Start();
+        void WorkerMain();
+        void RunChunks();
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_finished;
+        BOOL m_quit = FALSE;
+        DWORD m_generation = 0;
+        DWORD m_active = 0;
+
+        JobFunc m_job = nullptr;
+        void* m_context = nullptr;
+        DWORD m_count = 0;
+        DWORD m_grain = 1;
+        DWORD m_chunks = 0;
+        std::atomic<DWORD> m_next{ 0 };
+        std::atomic<DWORD> m_done{ 0 };
+        std::atomic<bool> m_busy{ false };  // A job owns the pool
+    };
+
+    extern WorkerPool g_WorkerPool;
+
+    // Particles per worker chunk
+    constexpr DWORD PARTICLE_GRAIN = 2048;
+}
+
+// Compatibility types
+typedef CHPtclEmitter C3PtclEmitter;
+typedef CHEmitterDesc C3EmitterDesc;
+
+#endif // _CH_emitter_h_
@@ -1,5 +1,13 @@
 #include "CH_font.h"
 #include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_instance.h"
+#include "CH_backend.h"
+#include "CH_datafile.h"
+#include <algorithm>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "vendor/stb/stb_truetype.h"
 
 // Font size adjustment function (from original) - moved to namespace
 
@@ -7,149 +15,112 @@ void Char_Clear(CHChar* lpChar)
 {
     if (!lpChar)
         return;
-        
+
     lpChar->Char[0] = '\0';
     lpChar->Char[1] = '\0';
     lpChar->lpTex = nullptr;
     lpChar->dwTime = 0;
+
+    lpChar->dwCode = 0;
+    lpChar->nGlyph = 0;
+    lpChar->lpPage = nullptr;
+    lpChar->wX = lpChar->wY = 0;
+    lpChar->wWidth = lpChar->wHeight = 0;
+    lpChar->fOffsetX = lpChar->fOffsetY = 0.0f;
+    lpChar->fAdvance = 0.0f;
+    lpChar->bNoRoom = FALSE;
 }
 
 void Font_Clear(CHFont* lpFont)
 {
     if (!lpFont)
         return;
-        
+
     // Clear font bitmap buffer
     if (lpFont->lpBuffer)
     {
         delete[] lpFont->lpBuffer;
         lpFont->lpBuffer = nullptr;
     }
-    
+
     // Release Windows font objects
     if (lpFont->bitmap)
     {
         DeleteObject(lpFont->bitmap);
         lpFont->bitmap = nullptr;
     }
-    
+
     if (lpFont->font)
     {
         DeleteObject(lpFont->font);
         lpFont->font = nullptr;
     }
-    
+
     if (lpFont->hDC)
     {
         DeleteDC(lpFont->hDC);
         lpFont->hDC = nullptr;
     }
-    
-    // Clear character cache
-    for (int i = 0; i < 256; i++)
+
+    // Clear character cache (bitmaps belong to the glyph pages)
+    for (auto& glyph : lpFont->Glyphs)
+        delete glyph.second;
+    lpFont->Glyphs.clear();
+
+    // Release glyph pages
+    for (CHAtlasPage* page : lpFont->Pages)
+        CHAtlasInternal::ReleasePage(page);
+    lpFont->Pages.clear();
+
+    if (lpFont->lpFontData)
     {
-        for (int j = 0; j < 256; j++)
-        {
-            if (lpFont->lpChar[i][j])
-            {
-                if (lpFont->lpChar[i][j]->lpTex)
-                {
-                    Texture_Unload(&lpFont->lpChar[i][j]->lpTex);
-                }
-                delete lpFont->lpChar[i][j];
-                lpFont->lpChar[i][j] = nullptr;
-            }
-        }
+        delete[] lpFont->lpFontData;
+        lpFont->lpFontData = nullptr;
     }
-    
+    lpFont->dwFontDataSize = 0;
+    ZeroMemory(&lpFont->Info, sizeof(lpFont->Info));
+    lpFont->fScale = 0.0f;
+    lpFont->fAscent = 0.0f;
+    lpFont->fLineHeight = 0.0f;
+
     ZeroMemory(lpFont->szName, sizeof(lpFont->szName));
     lpFont->nSize = 0;
     lpFont->nRealSize = 0;
     lpFont->dwChars = 0;
+    lpFont->dwCacheBudget = CH_FONT_CACHE_BUDGET;
+    lpFont->dwEvictions = 0;
+
+    // Retained text built with the old glyphs lays out again
+    lpFont->dwGeneration++;
 }
 
 BOOL Font_Create(CHFont** lpFont, const char* lpFontName, int nSize)
 {
     if (!lpFont || !lpFontName)
         return FALSE;
-    
-    *lpFont = new CHFont;
-    
-    // Initialize the font structure to zero before clearing
-    ZeroMemory(*lpFont, sizeof(CHFont));
-    
-    // Now it's safe to call Font_Clear
+
+    *lpFont = new CHFont();
     Font_Clear(*lpFont);
-    
+
     // Store font information
     strncpy_s((*lpFont)->szName, sizeof((*lpFont)->szName), lpFontName, _TRUNCATE);
     (*lpFont)->nSize = nSize;
     (*lpFont)->nRealSize = CHFontInternal::GetFontRealSize(nSize);
-    
-    // Create Windows font
-    (*lpFont)->font = CreateFontA(
-        (*lpFont)->nRealSize,   // Height
-        0,                      // Width (0 = default)
-        0,                      // Escapement
-        0,                      // Orientation
-        FW_NORMAL,              // Weight
-        FALSE,                  // Italic
-        FALSE,                  // Underline
-        FALSE,                  // Strikeout
-        ANSI_CHARSET,           // Charset
-        OUT_DEFAULT_PRECIS,     // Output precision
-        CLIP_DEFAULT_PRECIS,    // Clipping precision
-        ANTIALIASED_QUALITY,    // Quality
-        DEFAULT_PITCH | FF_DONTCARE, // Pitch and family
-        lpFontName              // Font name
-    );
-    
-    if (!(*lpFont)->font)
-    {
-        Font_Release(lpFont);
-        return FALSE;
-    }
-    
-    // Create device context for font rendering
-    HDC screenDC = GetDC(nullptr);
-    (*lpFont)->hDC = CreateCompatibleDC(screenDC);
-    ReleaseDC(nullptr, screenDC);
-    
-    if (!(*lpFont)->hDC)
-    {
-        Font_Release(lpFont);
-        return FALSE;
-    }
-    
-    // Select font into DC
-    SelectObject((*lpFont)->hDC, (*lpFont)->font);
-    SetTextColor((*lpFont)->hDC, RGB(255, 255, 255));
-    SetBkColor((*lpFont)->hDC, RGB(0, 0, 0));
-    SetBkMode((*lpFont)->hDC, OPAQUE);
-    
-    // Create bitmap for character rendering
-    int bitmapSize = (*lpFont)->nRealSize * (*lpFont)->nRealSize * 4; // RGBA
-    (*lpFont)->lpBuffer = new DWORD[bitmapSize / 4];
-    
-    BITMAPINFO bmi = {};
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = (*lpFont)->nRealSize;
-    bmi.bmiHeader.biHeight = -(*lpFont)->nRealSize; // Top-down
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-    
-    void* bitmapBits;
-    (*lpFont)->bitmap = CreateDIBSection((*lpFont)->hDC, &bmi, DIB_RGB_COLORS, &bitmapBits, nullptr, 0);
-    
-    if (!(*lpFont)->bitmap)
+
+    // Load the TrueType data glyphs are rasterized from
+    if (!CHFontInternal::LoadFontData(*lpFont, lpFontName))
     {
         Font_Release(lpFont);
         return FALSE;
     }
-    
-    SelectObject((*lpFont)->hDC, (*lpFont)->bitmap);
-    
+
+    // Pixel metrics for the real size
+    int ascent, descent, lineGap;
+    stbtt_GetFontVMetrics(&(*lpFont)->Info, &ascent, &descent, &lineGap);
+    (*lpFont)->fScale = stbtt_ScaleForPixelHeight(&(*lpFont)->Info, static_cast<float>((*lpFont)->nRealSize));
+    (*lpFont)->fAscent = ascent * (*lpFont)->fScale;
+    (*lpFont)->fLineHeight = (ascent - descent + lineGap) * (*lpFont)->fScale;
+
     return TRUE;
 }
 
@@ -157,7 +128,7 @@ void Font_Release(CHFont** lpFont)
 {
     if (!lpFont || !*lpFont)
         return;
-        
+
     Font_Clear(*lpFont);
     delete *lpFont;
     *lpFont = nullptr;
@@ -165,6 +136,9 @@ void Font_Release(CHFont** lpFont)
 
 void Font_Prepare()
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    CHInstanceInternal::FlushPending();
+
     CHFontInternal::SetupFontRenderStates();
 }
 
@@ -172,168 +146,736 @@ BOOL Font_Draw(CHFont* lpFont, float fX, float fY, DWORD color, char* lpChar)
 {
     if (!lpFont || !lpChar)
         return FALSE;
-    
-    int len = static_cast<int>(strlen(lpChar));
-    float currentX = fX;
-    
-    for (int i = 0; i < len; i++)
+
+    // Text is drawn over the sprites queued before it
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
+    // Scratch kept between calls, text is drawn every frame
+    static thread_local std::vector<CHFontVertex> vertices;
+    static thread_local std::vector<CHTextRun> runs;
+
+    CHFontInternal::LayoutText(lpFont, lpChar, color, 0.0f, vertices, runs, nullptr, nullptr);
+    if (runs.empty())
+        return TRUE;
+
+    return CHFontInternal::DrawTextQuads(vertices.data(), runs.data(), static_cast<DWORD>(runs.size()), fX, fY);
+}
+
+void Font_SetCacheBudget(CHFont* lpFont, DWORD dwBytes)
+{
+    if (lpFont)
+        lpFont->dwCacheBudget = dwBytes;
+}
+
+void Font_GetCacheStats(CHFont* lpFont, DWORD* lpGlyphs, DWORD* lpBytes, DWORD* lpEvictions)
+{
+    if (!lpFont)
+        return;
+
+    if (lpGlyphs)
+        *lpGlyphs = lpFont->dwChars;
+    if (lpBytes)
+        *lpBytes = CHFontInternal::GetCacheBytes(lpFont);
+    if (lpEvictions)
+        *lpEvictions = lpFont->dwEvictions;
+}
+
+void Font_GetTextExtent(CHFont* lpFont, const char* lpChar, int* lpWidth, int* lpHeight)
+{
+    int width = 0;
+    int height = 0;
+    CHFontInternal::MeasureText(lpFont, lpChar, &width, &height);
+
+    if (lpWidth)
+        *lpWidth = width;
+    if (lpHeight)
+        *lpHeight = height;
+}
+
+BOOL Text_Create(CHText** lpText, CHFont* lpFont, const char* lpString, DWORD color, float fWrapWidth)
+{
+    if (!lpText || !lpFont)
+        return FALSE;
+
+    *lpText = new CHText();
+    (*lpText)->lpFont = lpFont;
+    (*lpText)->dwColor = color;
+    (*lpText)->fWrapWidth = fWrapWidth;
+    (*lpText)->bDirty = TRUE;
+    Text_SetString(*lpText, lpString ? lpString : "");
+    return TRUE;
+}
+
+void Text_Release(CHText** lpText)
+{
+    if (!lpText || !*lpText)
+        return;
+
+    delete[] (*lpText)->lpString;
+    delete *lpText;
+    *lpText = nullptr;
+}
+
+void Text_SetString(CHText* lpText, const char* lpString)
+{
+    if (!lpText || !lpString)
+        return;
+
+    if (lpText->lpString && strcmp(lpText->lpString, lpString) == 0)
+        return;
+
+    delete[] lpText->lpString;
+    size_t length = strlen(lpString) + 1;
+    lpText->lpString = new char[length];
+    memcpy(lpText->lpString, lpString, length);
+    lpText->bDirty = TRUE;
+}
+
+void Text_SetFont(CHText* lpText, CHFont* lpFont)
+{
+    if (!lpText || !lpFont || lpText->lpFont == lpFont)
+        return;
+
+    lpText->lpFont = lpFont;
+    lpText->bDirty = TRUE;
+}
+
+void Text_SetWrapWidth(CHText* lpText, float fWrapWidth)
+{
+    if (!lpText || lpText->fWrapWidth == fWrapWidth)
+        return;
+
+    lpText->fWrapWidth = fWrapWidth;
+    lpText->bDirty = TRUE;
+}
+
+void Text_SetColor(CHText* lpText, DWORD color)
+{
+    if (!lpText || lpText->dwColor == color)
+        return;
+
+    lpText->dwColor = color;
+    for (CHFontVertex& vertex : lpText->Vertices)
+        vertex.color = color;
+}
+
+void Text_GetExtent(CHText* lpText, float* lpWidth, float* lpHeight)
+{
+    if (!lpText)
+        return;
+
+    CHFontInternal::UpdateText(lpText);
+    if (lpWidth)
+        *lpWidth = lpText->fWidth;
+    if (lpHeight)
+        *lpHeight = lpText->fHeight;
+}
+
+BOOL Text_Draw(CHText* lpText, float fX, float fY)
+{
+    if (!lpText)
+        return FALSE;
+
+    float position[2] = { fX, fY };
+    return Text_DrawBatch(&lpText, position, 1);
+}
+
+BOOL Text_DrawBatch(CHText** lpTexts, const float* lpPositions, DWORD dwCount)
+{
+    if (!lpTexts || !lpPositions)
+        return FALSE;
+
+    // Text is drawn over the sprites queued before it
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
+    // Laying out one text may evict a glyph page; the pages every text of
+    // the batch already uses are marked first so none of them is picked
+    DWORD now = static_cast<DWORD>(GetTickCount64());
+    for (DWORD t = 0; t < dwCount; t++)
     {
-        unsigned char ch = static_cast<unsigned char>(lpChar[i]);
-        
-        // Get or create cached character
-        CHChar* cachedChar = CHFontInternal::GetCachedCharacter(lpFont, ch);
-        if (!cachedChar)
+        if (!lpTexts[t])
+            continue;
+        for (const CHTextRun& run : lpTexts[t]->Runs)
+            run.lpPage->dwLastUse = now;
+    }
+
+    // A text laid out before an eviction lays out again
+    for (DWORD pass = 0; pass < 2; pass++)
+    {
+        for (DWORD t = 0; t < dwCount; t++)
         {
-            CHFontInternal::CacheCharacter(lpFont, ch);
-            cachedChar = CHFontInternal::GetCachedCharacter(lpFont, ch);
+            if (lpTexts[t])
+                CHFontInternal::UpdateText(lpTexts[t]);
         }
-        
-        if (cachedChar && cachedChar->lpTex)
+    }
+
+    static thread_local std::vector<CHTexture*> textures;
+    static thread_local std::vector<CHTextRun> draws;
+
+    BOOL result = TRUE;
+    DWORD first = 0;
+    while (first < dwCount)
+    {
+        // Take texts until the chunk is full (a single huge text still goes alone)
+        DWORD last = first;
+        DWORD quads = 0;
+        while (last < dwCount)
         {
-            // Create quad vertices for character
-            CHFontVertex vertices[4];
-            float charWidth = static_cast<float>(lpFont->nRealSize);
-            float charHeight = static_cast<float>(lpFont->nRealSize);
-            
-            // Top-left
-            vertices[0].x = currentX;
-            vertices[0].y = fY;
-            vertices[0].z = 0.0f;
-            vertices[0].rhw = 1.0f;
-            vertices[0].color = color;
-            vertices[0].u = 0.0f;
-            vertices[0].v = 0.0f;
-            
-            // Top-right
-            vertices[1].x = currentX + charWidth;
-            vertices[1].y = fY;
-            vertices[1].z = 0.0f;
-            vertices[1].rhw = 1.0f;
-            vertices[1].color = color;
-            vertices[1].u = 1.0f;
-            vertices[1].v = 0.0f;
-            
-            // Bottom-left
-            vertices[2].x = currentX;
-            vertices[2].y = fY + charHeight;
-            vertices[2].z = 0.0f;
-            vertices[2].rhw = 1.0f;
-            vertices[2].color = color;
-            vertices[2].u = 0.0f;
-            vertices[2].v = 1.0f;
-            
-            // Bottom-right
-            vertices[3].x = currentX + charWidth;
-            vertices[3].y = fY + charHeight;
-            vertices[3].z = 0.0f;
-            vertices[3].rhw = 1.0f;
-            vertices[3].color = color;
-            vertices[3].u = 1.0f;
-            vertices[3].v = 1.0f;
-            
-            // Render character quad
-            CHFontInternal::RenderTextQuad(vertices, cachedChar->lpTex);
-            
-            currentX += charWidth * 0.6f; // Character spacing
+            DWORD textQuads = lpTexts[last] ? static_cast<DWORD>(lpTexts[last]->Vertices.size() / 4) : 0;
+            if (last > first && quads + textQuads > CHFontInternal::TEXT_BATCH_QUADS)
+                break;
+            quads += textQuads;
+            last++;
         }
+
+        if (quads > 0)
+        {
+            UINT baseVertex = 0;
+            CHFontVertex* out = static_cast<CHFontVertex*>(CHInternal::g_DynamicVertexRing.Lock(
+                quads * 4, sizeof(CHFontVertex), &baseVertex, nullptr));
+            if (!out)
+            {
+                result = FALSE;
+                first = last;
+                continue;
+            }
+
+            // Glyph pages in first use order (kept resident while drawn)
+            textures.clear();
+            for (DWORD t = first; t < last; t++)
+            {
+                if (!lpTexts[t])
+                    continue;
+                for (const CHTextRun& run : lpTexts[t]->Runs)
+                {
+                    run.lpPage->dwLastUse = now;
+                    if (std::find(textures.begin(), textures.end(), run.texture) == textures.end())
+                        textures.push_back(run.texture);
+                }
+            }
+
+            // Write every text's quads of one page together, translated
+            draws.clear();
+            DWORD written = 0;
+            for (CHTexture* texture : textures)
+            {
+                CHTextRun draw = { texture, nullptr, written, 0 };
+                for (DWORD t = first; t < last; t++)
+                {
+                    if (!lpTexts[t])
+                        continue;
+
+                    float dx = lpPositions[t * 2];
+                    float dy = lpPositions[t * 2 + 1];
+                    for (const CHTextRun& run : lpTexts[t]->Runs)
+                    {
+                        if (run.texture != texture)
+                            continue;
+
+                        const CHFontVertex* src = &lpTexts[t]->Vertices[run.dwFirstQuad * 4];
+                        CHFontVertex* dst = out + written * 4;
+                        for (DWORD v = 0; v < run.dwQuads * 4; v++)
+                        {
+                            dst[v] = src[v];
+                            dst[v].x += dx;
+                            dst[v].y += dy;
+                        }
+                        written += run.dwQuads;
+                    }
+                }
+                draw.dwQuads = written - draw.dwFirstQuad;
+                draws.push_back(draw);
+            }
+
+            CHInternal::g_DynamicVertexRing.Unlock();
+
+            CHInternal::g_DynamicVertexRing.Bind(sizeof(CHFontVertex));
+            CHInternal::g_QuadIndexBuffer.Bind();
+            CHSpriteInternal::g_SpriteShaderManager.SetSpriteShaders();
+
+            for (const CHTextRun& draw : draws)
+            {
+                SetTexture(0, draw.texture->lpSRV.Get());
+                CHInternal::g_QuadIndexBuffer.DrawQuads(draw.dwQuads, baseVertex + draw.dwFirstQuad * 4);
+            }
+        }
+
+        first = last;
     }
-    
-    return TRUE;
+
+    return result;
 }
 
 // Internal implementation
 namespace CHFontInternal {
 
-BOOL CreateCharacterTexture(CHFont* font, CHChar* character, char ch)
+BOOL LoadFontData(CHFont* font, const char* name)
 {
-    if (!font || !character)
-        return FALSE;
-    
-    // Clear bitmap
-    RECT rect = { 0, 0, font->nRealSize, font->nRealSize };
-    FillRect(font->hDC, &rect, (HBRUSH)GetStockObject(BLACK_BRUSH));
-    
-    // Draw character using Windows GDI
-    char charStr[2] = { ch, '\0' };
-    TextOutA(font->hDC, 0, 0, charStr, 1);
-    
-    // Get bitmap data
-    BITMAPINFO bmi = {};
-    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
-    bmi.bmiHeader.biWidth = font->nRealSize;
-    bmi.bmiHeader.biHeight = -font->nRealSize;
-    bmi.bmiHeader.biPlanes = 1;
-    bmi.bmiHeader.biBitCount = 32;
-    bmi.bmiHeader.biCompression = BI_RGB;
-    
-    GetDIBits(font->hDC, font->bitmap, 0, font->nRealSize, font->lpBuffer, &bmi, DIB_RGB_COLORS);
-    
-    // Create texture from bitmap data
-    CHTexture** charTexture = &character->lpTex;
-    if (Texture_Create(charTexture, font->nRealSize, font->nRealSize, 1, CH_FMT_A8R8G8B8, CH_POOL_MANAGED))
+    const char* ext = strrchr(name, '.');
+    BOOL bFile = ext && (_stricmp(ext, ".ttf") == 0 || _stricmp(ext, ".ttc") == 0 || _stricmp(ext, ".otf") == 0);
+
+    if (bFile)
     {
-        // Convert grayscale to alpha channel
-        DWORD* pixels = font->lpBuffer;
-        for (int i = 0; i < font->nRealSize * font->nRealSize; i++)
+        // Font file from the packed data or a loose file
+        g_objDnFile.BeforeUseDnFile();
+        unsigned long dwSize = 0;
+        void* pBuf = g_objDnFile.GetMPtr(name, dwSize);
+        if (pBuf)
         {
-            DWORD pixel = pixels[i];
-            BYTE intensity = (BYTE)(pixel & 0xFF); // Get blue component as intensity
-            pixels[i] = (intensity << 24) | 0x00FFFFFF; // Set alpha, white color
+            font->lpFontData = new BYTE[dwSize];
+            memcpy(font->lpFontData, pBuf, dwSize);
+            font->dwFontDataSize = dwSize;
+            g_objDnFile.AfterUseDnFile();
         }
-        
-        // Update texture with processed data using DirectX 11
-        D3D11_MAPPED_SUBRESOURCE mappedResource;
-        HRESULT hr = g_D3DContext->Map((*charTexture)->lpTex.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-        if (SUCCEEDED(hr)) {
-            // Copy pixel data
-            DWORD* destPixels = static_cast<DWORD*>(mappedResource.pData);
-            for (UINT y = 0; y < font->nRealSize; y++) {
-                memcpy(destPixels + y * (mappedResource.RowPitch / 4), 
-                       pixels + y * font->nRealSize, 
-                       font->nRealSize * sizeof(DWORD));
+        else
+        {
+            g_objDnFile.AfterUseDnFile();
+
+            FILE* file = fopen(name, "rb");
+            if (!file)
+                return FALSE;
+
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            if (size <= 0)
+            {
+                fclose(file);
+                return FALSE;
             }
-            g_D3DContext->Unmap((*charTexture)->lpTex.Get(), 0);
+
+            font->lpFontData = new BYTE[size];
+            font->dwFontDataSize = static_cast<DWORD>(fread(font->lpFontData, 1, size, file));
+            fclose(file);
         }
-        
+    }
+    else
+    {
+        // Installed face: let GDI resolve the name, then take its file data
+        font->font = CreateFontA(
+            font->nRealSize,        // Height
+            0,                      // Width (0 = default)
+            0,                      // Escapement
+            0,                      // Orientation
+            FW_NORMAL,              // Weight
+            FALSE,                  // Italic
+            FALSE,                  // Underline
+            FALSE,                  // Strikeout
+            DEFAULT_CHARSET,        // Charset
+            OUT_TT_ONLY_PRECIS,     // Output precision (TrueType data needed)
+            CLIP_DEFAULT_PRECIS,    // Clipping precision
+            ANTIALIASED_QUALITY,    // Quality
+            DEFAULT_PITCH | FF_DONTCARE, // Pitch and family
+            name                    // Font name
+        );
+        if (!font->font)
+            return FALSE;
+
+        HDC screenDC = GetDC(nullptr);
+        font->hDC = CreateCompatibleDC(screenDC);
+        ReleaseDC(nullptr, screenDC);
+        if (!font->hDC)
+            return FALSE;
+
+        SelectObject(font->hDC, font->font);
+
+        // Collections have to be read whole through the 'ttcf' table
+        const DWORD ttcfTag = 0x66637474;
+        DWORD table = ttcfTag;
+        DWORD size = GetFontData(font->hDC, table, 0, nullptr, 0);
+        if (size == GDI_ERROR || size == 0)
+        {
+            table = 0;
+            size = GetFontData(font->hDC, table, 0, nullptr, 0);
+        }
+        if (size == GDI_ERROR || size == 0)
+            return FALSE;
+
+        font->lpFontData = new BYTE[size];
+        font->dwFontDataSize = size;
+        if (GetFontData(font->hDC, table, 0, font->lpFontData, size) != size)
+            return FALSE;
+    }
+
+    // Pick the face by name inside collections
+    int offset = stbtt_FindMatchingFont(font->lpFontData, name, STBTT_MACSTYLE_DONTCARE);
+    if (offset < 0)
+        offset = stbtt_GetFontOffsetForIndex(font->lpFontData, 0);
+    if (offset < 0)
+        return FALSE;
+
+    return stbtt_InitFont(&font->Info, font->lpFontData, offset) != 0;
+}
+
+BOOL RasterizeGlyph(CHFont* font, CHChar* character)
+{
+    if (!font || !character)
+        return FALSE;
+
+    character->nGlyph = stbtt_FindGlyphIndex(&font->Info, static_cast<int>(character->dwCode));
+
+    int advance, bearing;
+    stbtt_GetGlyphHMetrics(&font->Info, character->nGlyph, &advance, &bearing);
+    character->fAdvance = advance * font->fScale;
+
+    int x0, y0, x1, y1;
+    stbtt_GetGlyphBitmapBox(&font->Info, character->nGlyph, font->fScale, font->fScale, &x0, &y0, &x1, &y1);
+    int width = x1 - x0;
+    int height = y1 - y0;
+    character->fOffsetX = static_cast<float>(x0);
+    character->fOffsetY = static_cast<float>(y0);
+
+    // Blank glyphs (spaces) only advance the pen
+    if (width <= 0 || height <= 0)
         return TRUE;
+
+    if (width > CH_FONT_PAGE_SIZE - CH_ATLAS_PADDING * 2 || height > CH_FONT_PAGE_SIZE - CH_ATLAS_PADDING * 2)
+        return FALSE;
+
+    // Find room in a glyph page; when all are full, reuse the least
+    // recently used page once the budget is reached, else add one
+    DWORD x = 0, y = 0;
+    CHAtlasPage* target = nullptr;
+    for (CHAtlasPage* page : font->Pages)
+    {
+        if (CHAtlasInternal::PackRect(page, width, height, &x, &y))
+        {
+            target = page;
+            break;
+        }
+    }
+    if (!target)
+    {
+        DWORD pageBytes = CH_FONT_PAGE_SIZE * CH_FONT_PAGE_SIZE * 4;
+        if ((font->Pages.size() + 1) * pageBytes > font->dwCacheBudget)
+            target = EvictGlyphPage(font);
+
+        // Everything is in use right now: go over budget rather than drop glyphs on screen
+        if (!target)
+        {
+            target = CHAtlasInternal::CreatePage(CH_FONT_PAGE_SIZE, CH_FONT_PAGE_SIZE);
+            if (!target)
+                return FALSE;
+            font->Pages.push_back(target);
+        }
+
+        if (!CHAtlasInternal::PackRect(target, width, height, &x, &y))
+            return FALSE;
     }
-    
-    return FALSE;
+
+    // Rasterize coverage, stored as white with alpha like the GDI glyphs were
+    static thread_local std::vector<BYTE> coverage;
+    static thread_local std::vector<DWORD> pixels;
+    coverage.resize(width * height);
+    pixels.resize(width * height);
+    stbtt_MakeGlyphBitmap(&font->Info, coverage.data(), width, height, width,
+        font->fScale, font->fScale, character->nGlyph);
+    for (int i = 0; i < width * height; i++)
+        pixels[i] = (static_cast<DWORD>(coverage[i]) << 24) | 0x00FFFFFF;
+
+    D3D11_BOX box = { x, y, 0, x + width, y + height, 1 };
+    CHBackendInternal::UpdateSubresource(target->lpTex->lpTex.Get(), 0, &box, pixels.data(), width * sizeof(DWORD), 0);
+
+    target->dwLastUse = character->dwTime;
+    character->lpPage = target;
+    character->lpTex = target->lpTex;
+    character->wX = static_cast<WORD>(x);
+    character->wY = static_cast<WORD>(y);
+    character->wWidth = static_cast<WORD>(width);
+    character->wHeight = static_cast<WORD>(height);
+    return TRUE;
 }
 
-void CacheCharacter(CHFont* font, char ch)
+CHChar* CacheCharacter(CHFont* font, DWORD code)
 {
-    if (!font || font->lpChar[ch][0])
-        return; // Already cached
-    
+    if (!font)
+        return nullptr;
+
+    auto found = font->Glyphs.find(code);
+    if (found != font->Glyphs.end())
+        return found->second; // Already cached
+
     CHChar* newChar = new CHChar;
     Char_Clear(newChar);
-    newChar->Char[0] = ch;
+    newChar->Char[0] = static_cast<char>(code >> 8);
+    newChar->Char[1] = static_cast<char>(code & 0xFF);
+    newChar->dwCode = code;
     newChar->dwTime = static_cast<DWORD>(GetTickCount64());
-    
-    if (CreateCharacterTexture(font, newChar, ch))
-    {
-        font->lpChar[ch][0] = newChar;
-        font->dwChars++;
-    }
-    else
+
+    if (!RasterizeGlyph(font, newChar))
     {
-        delete newChar;
+        // Kept as a blank glyph, so it isn't rasterized again on every draw
+        newChar->lpPage = nullptr;
+        newChar->lpTex = nullptr;
+        newChar->bNoRoom = TRUE;
     }
+
+    font->Glyphs[code] = newChar;
+    font->dwChars++;
+    return newChar;
 }
 
-CHChar* GetCachedCharacter(CHFont* font, char ch)
+CHChar* GetCachedCharacter(CHFont* font, DWORD code)
 {
     if (!font)
         return nullptr;
-        
-    CHChar* cachedChar = font->lpChar[ch][0];
-    if (cachedChar)
+
+    auto found = font->Glyphs.find(code);
+    if (found == font->Glyphs.end())
+        return nullptr;
+
+    CHChar* cachedChar = found->second;
+    cachedChar->dwTime = static_cast<DWORD>(GetTickCount64()); // Update access time
+    if (cachedChar->lpPage)
+        cachedChar->lpPage->dwLastUse = cachedChar->dwTime;
+
+    return cachedChar;
+}
+
+CHAtlasPage* EvictGlyphPage(CHFont* font)
+{
+    // Least recently used page, unless it was drawn from just now
+    DWORD now = static_cast<DWORD>(GetTickCount64());
+    CHAtlasPage* oldest = nullptr;
+    for (CHAtlasPage* page : font->Pages)
     {
-        cachedChar->dwTime = static_cast<DWORD>(GetTickCount64()); // Update access time
+        if (now - page->dwLastUse < CH_FONT_GLYPH_HOLD)
+            continue;
+        if (!oldest || static_cast<LONG>(page->dwLastUse - oldest->dwLastUse) < 0)
+            oldest = page;
+    }
+    if (!oldest)
+        return nullptr;
+
+    // Drop its glyphs, and those that found no room before (they get another try)
+    for (auto it = font->Glyphs.begin(); it != font->Glyphs.end();)
+    {
+        if (it->second->lpPage == oldest || it->second->bNoRoom)
+        {
+            if (!it->second->bNoRoom)
+                font->dwEvictions++;
+            delete it->second;
+            it = font->Glyphs.erase(it);
+            font->dwChars--;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    // Start the page over (cleared so no old coverage shows in the padding)
+    static thread_local std::vector<DWORD> blank;
+    DWORD width = oldest->lpTex->Info.Width;
+    DWORD height = oldest->lpTex->Info.Height;
+    blank.assign(width * height, 0);
+    CHBackendInternal::UpdateSubresource(oldest->lpTex->lpTex.Get(), 0, nullptr, blank.data(), width * sizeof(DWORD), 0);
+    stbrp_init_target(&oldest->Context, width, height, oldest->lpNodes, width);
+
+    // Retained text using the page lays out again
+    font->dwGeneration++;
+    return oldest;
+}
+
+DWORD GetCacheBytes(CHFont* font)
+{
+    return static_cast<DWORD>(font->Pages.size() * CH_FONT_PAGE_SIZE * CH_FONT_PAGE_SIZE * 4 +
+        font->Glyphs.size() * sizeof(CHChar));
+}
+
+void DecodeText(const char* text, std::vector<DWORD>& codes)
+{
+    codes.clear();
+
+    // System code page (covers double byte text) to UTF-16
+    static thread_local std::vector<WCHAR> wide;
+    int count = MultiByteToWideChar(CP_ACP, 0, text, -1, nullptr, 0);
+    if (count <= 1)
+        return;
+    wide.resize(count);
+    MultiByteToWideChar(CP_ACP, 0, text, -1, wide.data(), count);
+
+    // UTF-16 to code points
+    for (int i = 0; i < count - 1; i++)
+    {
+        DWORD code = wide[i];
+        if (code >= 0xD800 && code < 0xDC00 && i + 1 < count - 1 &&
+            wide[i + 1] >= 0xDC00 && wide[i + 1] < 0xE000)
+        {
+            code = 0x10000 + ((code - 0xD800) << 10) + (wide[i + 1] - 0xDC00);
+            i++;
+        }
+        codes.push_back(code);
     }
-    
-    return cachedChar;
+}
+
+void LayoutText(CHFont* font, const char* text, DWORD color, float wrapWidth,
+    std::vector<CHFontVertex>& vertices, std::vector<CHTextRun>& runs,
+    float* width, float* height)
+{
+    vertices.clear();
+    runs.clear();
+
+    static thread_local std::vector<DWORD> codes;
+    DecodeText(text, codes);
+
+    // Quads in text order with their glyph page, grouped by page below
+    static thread_local std::vector<CHFontVertex> quads;
+    static thread_local std::vector<DWORD> quadPages;
+    quads.clear();
+    quadPages.clear();
+    const std::vector<CHAtlasPage*>& pages = font->Pages;
+
+    float penX = 0.0f;
+    float baseline = font->fAscent;
+    float maxX = 0.0f;
+    int prevGlyph = -1;
+
+    // Last place the current line may wrap at (after a space)
+    DWORD breakQuad = 0;
+    float breakPenX = -1.0f;
+    float breakWidth = 0.0f;
+
+    for (DWORD code : codes)
+    {
+        if (code == '\n')
+        {
+            maxX = std::max(maxX, penX);
+            penX = 0.0f;
+            baseline += font->fLineHeight;
+            prevGlyph = -1;
+            breakPenX = -1.0f;
+            continue;
+        }
+
+        CHChar* glyph = GetCachedCharacter(font, code);
+        if (!glyph)
+            glyph = CacheCharacter(font, code);
+        if (!glyph)
+            continue;
+
+        if (prevGlyph >= 0)
+            penX += stbtt_GetGlyphKernAdvance(&font->Info, prevGlyph, glyph->nGlyph) * font->fScale;
+        prevGlyph = glyph->nGlyph;
+
+        // Wrap when the glyph would cross the wrap width (spaces may hang)
+        if (wrapWidth > 0.0f && code != ' ' && penX > 0.0f && penX + glyph->fAdvance > wrapWidth)
+        {
+            if (breakPenX > 0.0f)
+            {
+                // Move the word after the last space to the next line
+                maxX = std::max(maxX, breakWidth);
+                float shift = floorf(breakPenX + 0.5f);
+                for (size_t v = breakQuad * 4; v < quads.size(); v++)
+                {
+                    quads[v].x -= shift;
+                    quads[v].y += font->fLineHeight;
+                }
+                penX -= breakPenX;
+            }
+            else
+            {
+                // No space on the line (e.g. CJK): break before this glyph
+                maxX = std::max(maxX, penX);
+                penX = 0.0f;
+            }
+            baseline += font->fLineHeight;
+            breakPenX = -1.0f;
+        }
+
+        if (glyph->lpPage)
+        {
+            // Snap to whole pixels, sprites sample with point filtering
+            float x0 = floorf(penX + glyph->fOffsetX + 0.5f);
+            float y0 = floorf(baseline + glyph->fOffsetY + 0.5f);
+            float x1 = x0 + glyph->wWidth;
+            float y1 = y0 + glyph->wHeight;
+
+            float pageW = static_cast<float>(glyph->lpTex->Info.Width);
+            float pageH = static_cast<float>(glyph->lpTex->Info.Height);
+            float u0 = glyph->wX / pageW;
+            float v0 = glyph->wY / pageH;
+            float u1 = (glyph->wX + glyph->wWidth) / pageW;
+            float v1 = (glyph->wY + glyph->wHeight) / pageH;
+
+            // Top-left, top-right, bottom-left, bottom-right
+            CHFontVertex quad[4] = {
+                { x0, y0, 0.0f, 1.0f, color, u0, v0 },
+                { x1, y0, 0.0f, 1.0f, color, u1, v0 },
+                { x0, y1, 0.0f, 1.0f, color, u0, v1 },
+                { x1, y1, 0.0f, 1.0f, color, u1, v1 },
+            };
+
+            quads.insert(quads.end(), quad, quad + 4);
+            quadPages.push_back(static_cast<DWORD>(
+                std::find(pages.begin(), pages.end(), glyph->lpPage) - pages.begin()));
+        }
+
+        if (code == ' ')
+        {
+            breakQuad = static_cast<DWORD>(quadPages.size());
+            breakWidth = penX;
+            breakPenX = penX + glyph->fAdvance;
+        }
+
+        penX += glyph->fAdvance;
+    }
+    maxX = std::max(maxX, penX);
+
+    // Counting sort of the quads by page, one run per page used
+    static thread_local std::vector<DWORD> pageStart;
+    pageStart.assign(pages.size() + 1, 0);
+    for (DWORD page : quadPages)
+        pageStart[page + 1]++;
+    for (size_t page = 0; page < pages.size(); page++)
+    {
+        if (pageStart[page + 1] > 0)
+        {
+            CHTextRun run;
+            run.texture = pages[page]->lpTex;
+            run.lpPage = pages[page];
+            run.dwFirstQuad = pageStart[page];
+            run.dwQuads = pageStart[page + 1];
+            runs.push_back(run);
+        }
+        pageStart[page + 1] += pageStart[page];
+    }
+
+    vertices.resize(quads.size());
+    for (size_t q = 0; q < quadPages.size(); q++)
+    {
+        DWORD slot = pageStart[quadPages[q]]++;
+        memcpy(&vertices[slot * 4], &quads[q * 4], sizeof(CHFontVertex) * 4);
+    }
+
+    if (width)
+        *width = maxX;
+    if (height)
+        *height = baseline - font->fAscent + font->fLineHeight;
+}
+
+void UpdateText(CHText* text)
+{
+    // Glyphs the quads point at may have moved since the last layout
+    if (text->lpFont && text->dwFontGeneration != text->lpFont->dwGeneration)
+        text->bDirty = TRUE;
+
+    if (!text->bDirty)
+        return;
+
+    if (text->lpFont && text->lpString)
+    {
+        LayoutText(text->lpFont, text->lpString, text->dwColor, text->fWrapWidth,
+            text->Vertices, text->Runs, &text->fWidth, &text->fHeight);
+        text->dwFontGeneration = text->lpFont->dwGeneration;
+    }
+    else
+    {
+        text->Vertices.clear();
+        text->Runs.clear();
+        text->fWidth = text->fHeight = 0.0f;
+    }
+    text->bDirty = FALSE;
 }
 
 void SetupFontRenderStates()
@@ -346,38 +888,41 @@ void SetupFontRenderStates()
     SetRenderState(CH_RS_CULLMODE, CH_CULL_NONE);
 }
 
-BOOL RenderTextQuad(CHFontVertex* vertices, CHTexture* texture)
+BOOL DrawTextQuads(const CHFontVertex* vertices, const CHTextRun* runs, DWORD runCount, float dx, float dy)
 {
-    if (!vertices || !texture)
+    if (!vertices || !runs || runCount == 0)
         return FALSE;
-    
-    // Set texture
-    SetTexture(0, texture->lpSRV.Get());
-    
-    // Create temporary vertex buffer for immediate rendering
-    // In a full implementation, we'd use a persistent dynamic vertex buffer
-    D3D11_BUFFER_DESC bufferDesc = {};
-    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    bufferDesc.ByteWidth = sizeof(CHFontVertex) * 4;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    
-    CHComPtr<ID3D11Buffer> vertexBuffer;
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = vertices;
-    
-    if (FAILED(g_D3DDevice->CreateBuffer(&bufferDesc, &initData, vertexBuffer.GetAddressOf())))
+
+    DWORD quads = runs[runCount - 1].dwFirstQuad + runs[runCount - 1].dwQuads;
+
+    // Copy the quads into the shared dynamic vertex ring at the text position
+    UINT baseVertex = 0;
+    CHFontVertex* out = static_cast<CHFontVertex*>(CHInternal::g_DynamicVertexRing.Lock(
+        quads * 4, sizeof(CHFontVertex), &baseVertex, nullptr));
+    if (!out)
         return FALSE;
-    
-    // Set vertex buffer
-    UINT stride = sizeof(CHFontVertex);
-    UINT offset = 0;
-    g_D3DContext->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-    
-    // Draw quad
-    g_D3DContext->Draw(4, 0);
-    
+
+    for (DWORD v = 0; v < quads * 4; v++)
+    {
+        out[v] = vertices[v];
+        out[v].x += dx;
+        out[v].y += dy;
+    }
+
+    CHInternal::g_DynamicVertexRing.Unlock();
+
+    // Set vertex, shared quad index buffer and the sprite shaders (same vertex layout)
+    CHInternal::g_DynamicVertexRing.Bind(sizeof(CHFontVertex));
+    CHInternal::g_QuadIndexBuffer.Bind();
+    CHSpriteInternal::g_SpriteShaderManager.SetSpriteShaders();
+
+    // One draw per glyph page
+    for (DWORD r = 0; r < runCount; r++)
+    {
+        SetTexture(0, runs[r].texture->lpSRV.Get());
+        CHInternal::g_QuadIndexBuffer.DrawQuads(runs[r].dwQuads, baseVertex + runs[r].dwFirstQuad * 4);
+    }
+
     return TRUE;
 }
 
@@ -395,9 +940,14 @@ void MeasureText(CHFont* font, const char* text, int* width, int* height)
 {
     if (!font || !text || !width || !height)
         return;
-    
-    *width = static_cast<int>(strlen(text)) * font->nRealSize;
-    *height = font->nRealSize;
+
+    static thread_local std::vector<CHFontVertex> vertices;
+    static thread_local std::vector<CHTextRun> runs;
+
+    float w = 0.0f, h = 0.0f;
+    LayoutText(font, text, 0xFFFFFFFF, 0.0f, vertices, runs, &w, &h);
+    *width = static_cast<int>(ceilf(w));
+    *height = static_cast<int>(ceilf(h));
 }
 
-} // namespace CHFontInternal
\ No newline at end of file
+} // namespace CHFontInternal
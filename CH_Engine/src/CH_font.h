@@ -9,6 +9,19 @@
 
 #include "CH_common.h"
 #include "CH_texture.h"
+#include "CH_atlas.h"
+#include "vendor/stb/stb_truetype.h"
+#include <vector>
+#include <unordered_map>
+
+// Glyph atlas page size in texels
+#define CH_FONT_PAGE_SIZE   512
+
+// Default glyph cache budget per font (bytes, four glyph pages)
+#define CH_FONT_CACHE_BUDGET    (4 * CH_FONT_PAGE_SIZE * CH_FONT_PAGE_SIZE * 4)
+
+// Glyph pages used this recently are never evicted (ms)
+#define CH_FONT_GLYPH_HOLD      1000
 
 // Font vertex structure for rendering text
 struct CHFontVertex {
@@ -19,14 +32,24 @@ struct CHFontVertex {
     float u, v;         // Texture coordinates
 };
 
-// Character structure (maintains exact same layout as C3Char)
+// Character structure (C3Char fields first, glyph atlas data after)
 struct CHChar {
     char Char[2];               // Character (supports multibyte)
-    CHTexture* lpTex;           // Character texture
+    CHTexture* lpTex;           // Glyph page texture (nullptr for blank glyphs)
     DWORD dwTime;               // Last access time
+
+    DWORD dwCode;               // Unicode code point
+    int nGlyph;                 // stb_truetype glyph index
+    CHAtlasPage* lpPage;        // Page holding the bitmap
+    WORD wX, wY;                // Bitmap position in the page
+    WORD wWidth, wHeight;       // Bitmap size
+    float fOffsetX;             // Bitmap left edge from the pen position
+    float fOffsetY;             // Bitmap top edge from the baseline
+    float fAdvance;             // Pen advance
+    BOOL bNoRoom;               // Bitmap didn't fit a page: drawn blank until a page is freed
 };
 
-// Font structure (maintains exact same layout as C3Font)
+// Font structure (C3Font fields first, glyph cache and atlas data after)
 struct CHFont {
     DWORD* lpBuffer;            // Font bitmap buffer
     HDC hDC;                    // Device context for font rendering
@@ -37,7 +60,41 @@ struct CHFont {
     int nRealSize;              // Actual rendered size
 
     DWORD dwChars;              // Number of cached characters
-    CHChar* lpChar[256][256];   // Character cache (2D array for multibyte support)
+    std::unordered_map<DWORD, CHChar*> Glyphs;  // Character cache by code point
+    DWORD dwCacheBudget;        // Glyph page bytes kept before evicting
+    DWORD dwEvictions;          // Glyphs evicted so far
+
+    // Glyph atlas backend
+    BYTE* lpFontData;           // TrueType data (kept alive for stb_truetype)
+    DWORD dwFontDataSize;
+    stbtt_fontinfo Info;
+    float fScale;               // Font units to pixels
+    float fAscent;              // Baseline below the top of a line
+    float fLineHeight;
+    std::vector<CHAtlasPage*> Pages;
+    DWORD dwGeneration;         // Bumped whenever laid out text may be stale
+};
+
+// Quads of one glyph page inside a laid out string
+struct CHTextRun {
+    CHTexture* texture;
+    CHAtlasPage* lpPage;
+    DWORD dwFirstQuad;
+    DWORD dwQuads;
+};
+
+// Retained text: laid out once, redrawn anywhere until it changes
+struct CHText {
+    CHFont* lpFont;
+    char* lpString;
+    DWORD dwColor;
+    float fWrapWidth;           // 0 = no wrapping
+    float fWidth, fHeight;      // Laid out size
+
+    std::vector<CHFontVertex> Vertices;   // Quads relative to the text origin
+    std::vector<CHTextRun> Runs;
+    DWORD dwFontGeneration;     // Font generation the quads were built with
+    BOOL bDirty;
 };
 
 // Function declarations (maintaining exact same signatures as original)
@@ -56,6 +113,12 @@ void Font_Release(CHFont** lpFont);
 CH_CORE_DLL_API
 void Font_Prepare();
 
+/*
+    Draw text
+    ---------
+    lpChar is in the system code page (double byte text included);
+    the whole string is drawn with one call per glyph page.
+*/
 CH_CORE_DLL_API
 BOOL Font_Draw(CHFont* lpFont,
               float fX,
@@ -63,17 +126,72 @@ BOOL Font_Draw(CHFont* lpFont,
               DWORD color,
               char* lpChar);
 
+CH_CORE_DLL_API
+void Font_GetTextExtent(CHFont* lpFont, const char* lpChar, int* lpWidth, int* lpHeight);
+
+// Glyph cache budget (bytes of glyph pages, least recently used pages go first)
+CH_CORE_DLL_API
+void Font_SetCacheBudget(CHFont* lpFont, DWORD dwBytes);
+
+CH_CORE_DLL_API
+void Font_GetCacheStats(CHFont* lpFont, DWORD* lpGlyphs, DWORD* lpBytes, DWORD* lpEvictions);
+
+// Retained text functions (layout is redone only when string, font or wrap width change)
+CH_CORE_DLL_API
+BOOL Text_Create(CHText** lpText, CHFont* lpFont, const char* lpString, DWORD color, float fWrapWidth = 0.0f);
+
+CH_CORE_DLL_API
+void Text_Release(CHText** lpText);
+
+CH_CORE_DLL_API
+void Text_SetString(CHText* lpText, const char* lpString);
+
+CH_CORE_DLL_API
+void Text_SetFont(CHText* lpText, CHFont* lpFont);
+
+CH_CORE_DLL_API
+void Text_SetWrapWidth(CHText* lpText, float fWrapWidth);
+
+// Recolors the built quads in place
+CH_CORE_DLL_API
+void Text_SetColor(CHText* lpText, DWORD color);
+
+CH_CORE_DLL_API
+void Text_GetExtent(CHText* lpText, float* lpWidth, float* lpHeight);
+
+CH_CORE_DLL_API
+BOOL Text_Draw(CHText* lpText, float fX, float fY);
+
+// Draw many texts (lpPositions holds x, y pairs) with one call per glyph page
+CH_CORE_DLL_API
+BOOL Text_DrawBatch(CHText** lpTexts, const float* lpPositions, DWORD dwCount);
+
 // Internal font management
 namespace CHFontInternal {
-    // Font texture creation
-    BOOL CreateCharacterTexture(CHFont* font, CHChar* character, char ch);
-    void CacheCharacter(CHFont* font, char ch);
-    CHChar* GetCachedCharacter(CHFont* font, char ch);
-    
-    // Font rendering setup
+    // Font data (a .ttf/.ttc/.otf file, or the installed face of that name)
+    BOOL LoadFontData(CHFont* font, const char* name);
+
+    // Glyph cache
+    BOOL RasterizeGlyph(CHFont* font, CHChar* character);
+    CHChar* CacheCharacter(CHFont* font, DWORD code);
+    CHChar* GetCachedCharacter(CHFont* font, DWORD code);
+    CHAtlasPage* EvictGlyphPage(CHFont* font);
+    DWORD GetCacheBytes(CHFont* font);
+
+    // Text layout
+    void DecodeText(const char* text, std::vector<DWORD>& codes);
+    void LayoutText(CHFont* font, const char* text, DWORD color, float wrapWidth,
+        std::vector<CHFontVertex>& vertices, std::vector<CHTextRun>& runs,
+        float* width, float* height);
+    void UpdateText(CHText* text);
+
+    // Font rendering
     void SetupFontRenderStates();
-    BOOL RenderTextQuad(CHFontVertex* vertices, CHTexture* texture);
+    BOOL DrawTextQuads(const CHFontVertex* vertices, const CHTextRun* runs, DWORD runCount, float dx, float dy);
     
+    // Quads written per ring lock by Text_DrawBatch
+    constexpr DWORD TEXT_BATCH_QUADS = 8192;
+
     // Font metrics
     int GetFontRealSize(int requestedSize);
     void MeasureText(CHFont* font, const char* text, int* width, int* height);
@@ -82,6 +200,7 @@ namespace CHFontInternal {
 // Compatibility types
 typedef CHFont C3Font;
 typedef CHChar C3Char;
+typedef CHText C3Text;
 typedef CHFontVertex FontVertex;
 
 #endif // _CH_font_h_
\ No newline at end of file
@@ -0,0 +1,207 @@
+#include "CH_instance.h"
+#include "CH_main.h"
+#include "CH_backend.h"
+
+namespace CHInstanceInternal {
+    BOOL g_bEnabled = FALSE;
+    std::vector<CHInstancePlacement> g_Placements;
+    std::mutex g_PlacementMutex;
+
+    // Placements being drawn, their groups and instance stream (reused every flush)
+    static std::vector<CHInstancePlacement> g_Flushing;
+    static std::vector<CHInstanceGroup> g_Groups;
+    static std::vector<XMFLOAT4X4> g_Stream;
+
+    static DWORD g_dwFramePlacements = 0;
+    static DWORD g_dwFrameDraws = 0;
+
+    struct GroupKey {
+        CHScene* lpScene;
+        int nTex;
+        int nlTex;
+
+        bool operator==(const GroupKey& other) const
+        {
+            return lpScene == other.lpScene && nTex == other.nTex && nlTex == other.nlTex;
+        }
+    };
+
+    struct GroupKeyHash {
+        size_t operator()(const GroupKey& key) const
+        {
+            size_t hash = std::hash<CHScene*>()(key.lpScene);
+            hash ^= std::hash<int>()(key.nTex) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+            hash ^= std::hash<int>()(key.nlTex) + 0x9E3779B9 + (hash << 6) + (hash >> 2);
+            return hash;
+        }
+    };
+}
+
+CH_CORE_DLL_API
+void SceneInstance_Enable(BOOL bEnable)
+{
+    // Placements still recorded are drawn before switching back to Scene_Draw
+    if (!bEnable && CHInstanceInternal::g_bEnabled)
+        SceneInstance_Flush();
+
+    CHInstanceInternal::g_bEnabled = bEnable;
+}
+
+CH_CORE_DLL_API
+BOOL SceneInstance_Flush()
+{
+    using namespace CHInstanceInternal;
+
+    g_Flushing.clear();
+    {
+        std::lock_guard<std::mutex> lock(g_PlacementMutex);
+        g_Flushing.swap(g_Placements);
+    }
+
+    if (g_Flushing.empty())
+        return TRUE;
+
+    BuildGroups(g_Flushing, g_Groups, g_Stream);
+    g_dwFramePlacements += static_cast<DWORD>(g_Flushing.size());
+    g_dwFrameDraws += DrawGroups(g_Groups, g_Stream);
+    return TRUE;
+}
+
+CH_CORE_DLL_API
+void SceneInstance_GetStats(DWORD* lpPlacements, DWORD* lpDraws)
+{
+    if (lpPlacements)
+        *lpPlacements = CHInstanceInternal::g_dwFramePlacements;
+    if (lpDraws)
+        *lpDraws = CHInstanceInternal::g_dwFrameDraws;
+}
+
+namespace CHInstanceInternal {
+
+    void Record(CHScene* scene, const XMMATRIX& world)
+    {
+        CHInstancePlacement placement;
+        placement.lpScene = scene;
+        placement.nTex = scene->nTex;
+        placement.nlTex = (scene->nlTex > -1 && scene->nlTex < TEX_MAX && g_lpTex[scene->nlTex]) ? scene->nlTex : -1;
+        XMStoreFloat4x4(&placement.matWorld, world);
+
+        std::lock_guard<std::mutex> lock(g_PlacementMutex);
+        g_Placements.push_back(placement);
+    }
+
+    void FlushPending()
+    {
+        if (g_bEnabled)
+            SceneInstance_Flush();
+    }
+
+    void BuildGroups(const std::vector<CHInstancePlacement>& placements,
+        std::vector<CHInstanceGroup>& groups, std::vector<XMFLOAT4X4>& stream)
+    {
+        groups.clear();
+        stream.resize(placements.size());
+
+        // Group of every placement, groups numbered in first seen order
+        std::unordered_map<GroupKey, DWORD, GroupKeyHash> index;
+        std::vector<DWORD> groupOf(placements.size());
+        for (size_t i = 0; i < placements.size(); i++)
+        {
+            const CHInstancePlacement& placement = placements[i];
+            GroupKey key = { placement.lpScene, placement.nTex, placement.nlTex };
+
+            auto it = index.find(key);
+            if (it == index.end())
+            {
+                it = index.emplace(key, static_cast<DWORD>(groups.size())).first;
+                groups.push_back({ placement.lpScene, placement.nTex, placement.nlTex, 0, 0 });
+            }
+
+            groupOf[i] = it->second;
+            groups[it->second].dwInstanceCount++;
+        }
+
+        // Each group's instances are contiguous in the stream
+        std::vector<DWORD> next(groups.size());
+        DWORD first = 0;
+        for (size_t g = 0; g < groups.size(); g++)
+        {
+            groups[g].dwFirstInstance = first;
+            next[g] = first;
+            first += groups[g].dwInstanceCount;
+        }
+
+        for (size_t i = 0; i < placements.size(); i++)
+            stream[next[groupOf[i]]++] = placements[i].matWorld;
+    }
+
+    DWORD DrawGroups(const std::vector<CHInstanceGroup>& groups, const std::vector<XMFLOAT4X4>& stream)
+    {
+        if (!g_D3DContext || groups.empty())
+            return 0;
+
+        // Same states as Scene_Prepare, instanced scenes are opaque
+        CHSceneInternal::SetupSceneRenderStates();
+        SetRenderState(CH_RS_ALPHABLENDENABLE, FALSE);
+
+        CHInternal::g_CompatibilityShaderManager.SetInstancedShaders();
+        CHInternal::g_ConstantBuffers.UpdateFrame();
+        CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+        g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+        // World matrices are read from the shared ring as the second stream
+        CHInternal::g_DynamicVertexRing.Bind(sizeof(XMFLOAT4X4), 1);
+
+        DWORD draws = 0;
+        for (const CHInstanceGroup& group : groups)
+        {
+            CHScene* scene = group.lpScene;
+            if (!scene->vertexBuffer || !scene->indexBuffer || group.nTex < 0 || group.nTex >= TEX_MAX || !g_lpTex[group.nTex])
+                continue;
+
+            UINT firstInstance = 0;
+            if (!CHInternal::g_DynamicVertexRing.Write(&stream[group.dwFirstInstance], group.dwInstanceCount,
+                sizeof(XMFLOAT4X4), &firstInstance, nullptr))
+                continue;
+
+            ID3D11Buffer* vb = scene->vertexBuffer.Get();
+            g_D3DContext->IASetVertexBuffers(0, 1, &vb, &scene->vertexStride, &scene->vertexOffset);
+            g_D3DContext->IASetIndexBuffer(scene->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+
+            SetTexture(0, g_lpTex[group.nTex]->lpSRV.Get());
+            if (group.nlTex > -1 && group.nlTex < TEX_MAX && g_lpTex[group.nlTex])
+            {
+                SetTexture(1, g_lpTex[group.nlTex]->lpSRV.Get());
+                CHSceneInternal::SetupLightmapRenderStates();
+            }
+            else
+            {
+                SetTexture(1, nullptr);
+                CHSceneInternal::DisableLightmapRenderStates();
+            }
+
+            CHInternal::g_RenderStateManager.CommitStates();
+            CHBackendInternal::DrawIndexedInstanced(scene->dwTriCount * 3, group.dwInstanceCount, 0, 0, firstInstance);
+            draws++;
+        }
+
+        return draws;
+    }
+
+    void BeginFrame()
+    {
+        g_dwFramePlacements = 0;
+        g_dwFrameDraws = 0;
+    }
+
+    void Cleanup()
+    {
+        std::lock_guard<std::mutex> lock(g_PlacementMutex);
+
+        g_Placements.clear();
+        g_Flushing.clear();
+        g_Groups.clear();
+        g_Stream.clear();
+        g_bEnabled = FALSE;
+    }
+}
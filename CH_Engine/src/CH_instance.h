@@ -0,0 +1,83 @@
+#ifndef _CH_instance_h_
+#define _CH_instance_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include "CH_scene.h"
+#include <vector>
+#include <mutex>
+
+// One Scene_Draw of an opaque scene while instancing is enabled
+struct CHInstancePlacement {
+    CHScene* lpScene;                   // Mesh (its buffers must live until the flush)
+    int nTex;
+    int nlTex;                          // -1: no lightmap
+    XMFLOAT4X4 matWorld;
+};
+
+// Placements drawn by one DrawIndexedInstanced
+struct CHInstanceGroup {
+    CHScene* lpScene;
+    int nTex;
+    int nlTex;
+    DWORD dwFirstInstance;              // Into the instance stream
+    DWORD dwInstanceCount;
+};
+
+/*
+    Scene instancing
+    ----------------
+    While enabled, Scene_Draw records opaque scenes as placements instead
+    of drawing them. SceneInstance_Flush (also run by End3D, before the
+    render queue) groups the placements sharing a mesh, texture and
+    lightmap and draws each group with one DrawIndexedInstanced; the
+    world matrices are streamed per instance. Alpha blended scenes are
+    still drawn by Scene_Draw, in order. Pending placements are flushed
+    before an alpha scene or mesh is drawn, and by Ptcl_Prepare,
+    Shape_Prepare, Font_Prepare and Sprite_Prepare before they set their
+    states, so whatever those draw blends over the instanced scenes.
+*/
+CH_CORE_DLL_API
+void SceneInstance_Enable(BOOL bEnable);
+
+CH_CORE_DLL_API
+BOOL SceneInstance_Flush();
+
+// This frame so far: placements recorded and instanced draws issued for them
+CH_CORE_DLL_API
+void SceneInstance_GetStats(DWORD* lpPlacements, DWORD* lpDraws);
+
+// Internal instancing management
+namespace CHInstanceInternal {
+    extern BOOL g_bEnabled;
+    extern std::vector<CHInstancePlacement> g_Placements;
+    extern std::mutex g_PlacementMutex; // Scene_Draw may record from several threads
+
+    void Record(CHScene* scene, const XMMATRIX& world);
+
+    // Draws the pending placements ahead of a blended draw; leaves the
+    // scene states of Scene_Prepare set
+    void FlushPending();
+
+    // CPU only: groups placements (first seen order) and builds the stream of
+    // world matrices, each group's instances contiguous in recording order
+    CH_CORE_DLL_API void BuildGroups(const std::vector<CHInstancePlacement>& placements,
+        std::vector<CHInstanceGroup>& groups, std::vector<XMFLOAT4X4>& stream);
+
+    // Returns the instanced draws issued
+    DWORD DrawGroups(const std::vector<CHInstanceGroup>& groups, const std::vector<XMFLOAT4X4>& stream);
+
+    void BeginFrame();
+    void Cleanup();
+}
+
+// Compatibility types
+typedef CHInstancePlacement C3InstancePlacement;
+typedef CHInstanceGroup C3InstanceGroup;
+
+#endif // _CH_instance_h_
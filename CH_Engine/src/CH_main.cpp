@@ -2,7 +2,14 @@
 #include "CH_texture.h"
 #include "CH_datafile.h"
 #include "CH_sprite.h"
+#include "CH_atlas.h"
 #include "CH_phy.h"
+#include "CH_emitter.h"
+#include "CH_queue.h"
+#include "CH_instance.h"
+#include "CH_batch.h"
+#include "CH_backend.h"
+#include "CH_shader.h"
 #include <windows.h>
 #include <winuser.h>
 #include <winres.h>
@@ -39,8 +46,12 @@ CH_CORE_DLL_API CRITICAL_SECTION g_CriticalSection;
 
 // Internal render state management
 namespace CHInternal {
+    StateObjectCache g_StateObjectCache;
     RenderStateManager g_RenderStateManager;
     CompatibilityShaderManager g_CompatibilityShaderManager;
+    DynamicVertexRing g_DynamicVertexRing;
+    QuadIndexBuffer g_QuadIndexBuffer;
+    ConstantBufferManager g_ConstantBuffers;
 }
 
 // Physics internal management
@@ -130,6 +141,174 @@ int Init3D(HINSTANCE hInst,
     return Init3DEx(hWnd, dwWidth, dwHeight, bWindowed, dwBackCount);
 }
 
+// Render target, depth buffer, viewport and the shared engine objects
+// (common to Init3DEx and Init3DHeadless)
+static int InitDeviceObjects(ID3D11Texture2D* renderTarget,
+    HWND hWnd,
+    DWORD dwWidth,
+    DWORD dwHeight,
+    BOOL bWindowed,
+    DWORD dwBackCount)
+{
+    HRESULT hr = g_D3DDevice->CreateRenderTargetView(renderTarget, nullptr, 
+                                           g_RenderTargetView.GetAddressOf());
+    if (FAILED(hr))
+        return -1;
+
+    // Create depth stencil buffer and view
+    D3D11_TEXTURE2D_DESC depthStencilDesc = {};
+    depthStencilDesc.Width = dwWidth;
+    depthStencilDesc.Height = dwHeight;
+    depthStencilDesc.MipLevels = 1;
+    depthStencilDesc.ArraySize = 1;
+    depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
+    depthStencilDesc.SampleDesc.Count = 1;
+    depthStencilDesc.SampleDesc.Quality = 0;
+    depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
+    depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
+
+    hr = CHBackendInternal::CreateTexture2D(&depthStencilDesc, nullptr, 
+                                           g_DepthStencilBuffer.GetAddressOf());
+    if (FAILED(hr))
+        return -1;
+
+    hr = g_D3DDevice->CreateDepthStencilView(g_DepthStencilBuffer.Get(), nullptr, 
+                                           g_DepthStencilView.GetAddressOf());
+    if (FAILED(hr))
+        return -1;
+
+    // Set render targets
+    g_D3DContext->OMSetRenderTargets(1, g_RenderTargetView.GetAddressOf(), 
+                                    g_DepthStencilView.Get());
+
+    // Set viewport
+    g_Viewport.TopLeftX = 0.0f;
+    g_Viewport.TopLeftY = 0.0f;
+    g_Viewport.Width = static_cast<float>(dwWidth);
+    g_Viewport.Height = static_cast<float>(dwHeight);
+    g_Viewport.MinDepth = 0.0f;
+    g_Viewport.MaxDepth = 1.0f;
+
+    D3D11_VIEWPORT viewport;
+    viewport.TopLeftX = g_Viewport.TopLeftX;
+    viewport.TopLeftY = g_Viewport.TopLeftY;
+    viewport.Width = g_Viewport.Width;
+    viewport.Height = g_Viewport.Height;
+    viewport.MinDepth = g_Viewport.MinDepth;
+    viewport.MaxDepth = g_Viewport.MaxDepth;
+    
+    g_D3DContext->RSSetViewports(1, &viewport);
+
+    // Shader constants shared by the scene and skinned mesh shaders
+    if (FAILED(CHInternal::g_ConstantBuffers.Initialize()))
+        return -1;
+
+    // Initialize compatibility shaders
+    if (FAILED(CHInternal::g_CompatibilityShaderManager.Initialize()))
+        return -1;
+    
+    // Initialize sprite shaders
+    if (FAILED(CHSpriteInternal::g_SpriteShaderManager.Initialize()))
+        return -1;
+
+    // Shared dynamic vertex ring (skinned meshes, particles, shapes, sprites, text)
+    if (FAILED(CHInternal::g_DynamicVertexRing.Initialize(CH_DYNAMIC_VB_SIZE)))
+        return -1;
+
+    if (FAILED(CHInternal::g_QuadIndexBuffer.Initialize()))
+        return -1;
+
+    // Set default render states (maintaining exact same defaults as original)
+    SetRenderState(CH_RS_AMBIENT, 0xFFFFFFFF);
+    SetRenderState(CH_RS_LIGHTING, TRUE);
+    SetRenderState(CH_RS_CULLMODE, CH_CULL_CW);
+    SetRenderState(CH_RS_ZFUNC, CH_CMP_LESSEQUAL);
+    SetRenderState(CH_RS_EDGEANTIALIAS, TRUE);
+    SetRenderState(CH_RS_MULTISAMPLEANTIALIAS, TRUE);
+    SetTextureStageState(0, CH_TSS_MINFILTER, CH_TEXF_LINEAR);
+    SetTextureStageState(0, CH_TSS_MAGFILTER, CH_TEXF_LINEAR);
+    SetTextureStageState(0, CH_TSS_MIPFILTER, CH_TEXF_LINEAR);
+
+    // Initialize texture system
+    for (int t = 0; t < TEX_MAX; t++)
+        g_lpTex[t] = nullptr;
+
+    // Initialize critical section for thread safety
+    InitializeCriticalSection(&g_CriticalSection);
+
+    g_hWnd = hWnd;
+
+    // Store present parameters for compatibility
+    g_Present.Windowed = bWindowed;
+    g_Present.BackBufferCount = dwBackCount;
+    g_Present.BackBufferWidth = g_DisplayMode.Width;
+    g_Present.BackBufferHeight = g_DisplayMode.Height;
+    g_Present.hDeviceWindow = g_hWnd;
+    g_Present.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+    g_Present.BackBufferFormat = g_DisplayMode.Format;
+    g_Present.EnableAutoDepthStencil = TRUE;
+    g_Present.AutoDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
+
+    return 1; // Success
+}
+
+CH_CORE_DLL_API
+int Init3DHeadless(DWORD dwWidth, DWORD dwHeight, DWORD dwBackend)
+{
+    g_DisplayMode.Width = dwWidth;
+    g_DisplayMode.Height = dwHeight;
+    g_DisplayMode.RefreshRate = 60;
+    g_DisplayMode.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+
+    D3D_FEATURE_LEVEL featureLevels[] = {
+        D3D_FEATURE_LEVEL_11_1,
+        D3D_FEATURE_LEVEL_11_0,
+        D3D_FEATURE_LEVEL_10_1,
+        D3D_FEATURE_LEVEL_10_0
+    };
+
+    // The null driver ships with the SDK layers; WARP is always there
+    D3D_DRIVER_TYPE driverTypes[] = { D3D_DRIVER_TYPE_NULL, D3D_DRIVER_TYPE_WARP };
+    UINT first = dwBackend == CH_BACKEND_WARP ? 1 : 0;
+
+    HRESULT hr = E_FAIL;
+    for (UINT i = first; i < 2 && FAILED(hr); i++)
+    {
+        hr = D3D11CreateDevice(
+            nullptr,
+            driverTypes[i],
+            nullptr,
+            0,
+            featureLevels,
+            4,
+            D3D11_SDK_VERSION,
+            g_D3DDevice.GetAddressOf(),
+            &g_FeatureLevel,
+            g_D3DContext.GetAddressOf()
+        );
+    }
+    if (FAILED(hr))
+        return -1;
+
+    // Offscreen color target in place of the swap chain back buffer
+    D3D11_TEXTURE2D_DESC targetDesc = {};
+    targetDesc.Width = dwWidth;
+    targetDesc.Height = dwHeight;
+    targetDesc.MipLevels = 1;
+    targetDesc.ArraySize = 1;
+    targetDesc.Format = g_DisplayMode.Format;
+    targetDesc.SampleDesc.Count = 1;
+    targetDesc.Usage = D3D11_USAGE_DEFAULT;
+    targetDesc.BindFlags = D3D11_BIND_RENDER_TARGET;
+
+    CHComPtr<ID3D11Texture2D> target;
+    if (FAILED(CHBackendInternal::CreateTexture2D(&targetDesc, nullptr, target.GetAddressOf())))
+        return -1;
+
+    CHBackendInternal::g_bHeadless = TRUE;
+    return InitDeviceObjects(target.Get(), nullptr, dwWidth, dwHeight, TRUE, 1);
+}
+
 int Init3DEx(HWND hWnd,
             DWORD dwWidth,
             DWORD dwHeight,
@@ -245,103 +424,18 @@ int Init3DEx(HWND hWnd,
     if (FAILED(hr))
         return -1;
 
-    hr = g_D3DDevice->CreateRenderTargetView(backBuffer.Get(), nullptr, 
-                                           g_RenderTargetView.GetAddressOf());
-    if (FAILED(hr))
-        return -1;
-
-    // Create depth stencil buffer and view
-    D3D11_TEXTURE2D_DESC depthStencilDesc = {};
-    depthStencilDesc.Width = dwWidth;
-    depthStencilDesc.Height = dwHeight;
-    depthStencilDesc.MipLevels = 1;
-    depthStencilDesc.ArraySize = 1;
-    depthStencilDesc.Format = DXGI_FORMAT_D24_UNORM_S8_UINT;
-    depthStencilDesc.SampleDesc.Count = 1;
-    depthStencilDesc.SampleDesc.Quality = 0;
-    depthStencilDesc.Usage = D3D11_USAGE_DEFAULT;
-    depthStencilDesc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-
-    hr = g_D3DDevice->CreateTexture2D(&depthStencilDesc, nullptr, 
-                                     g_DepthStencilBuffer.GetAddressOf());
-    if (FAILED(hr))
-        return -1;
-
-    hr = g_D3DDevice->CreateDepthStencilView(g_DepthStencilBuffer.Get(), nullptr, 
-                                           g_DepthStencilView.GetAddressOf());
-    if (FAILED(hr))
-        return -1;
-
-    // Set render targets
-    g_D3DContext->OMSetRenderTargets(1, g_RenderTargetView.GetAddressOf(), 
-                                    g_DepthStencilView.Get());
-
-    // Set viewport
-    g_Viewport.TopLeftX = 0.0f;
-    g_Viewport.TopLeftY = 0.0f;
-    g_Viewport.Width = static_cast<float>(dwWidth);
-    g_Viewport.Height = static_cast<float>(dwHeight);
-    g_Viewport.MinDepth = 0.0f;
-    g_Viewport.MaxDepth = 1.0f;
-
-    D3D11_VIEWPORT viewport;
-    viewport.TopLeftX = g_Viewport.TopLeftX;
-    viewport.TopLeftY = g_Viewport.TopLeftY;
-    viewport.Width = g_Viewport.Width;
-    viewport.Height = g_Viewport.Height;
-    viewport.MinDepth = g_Viewport.MinDepth;
-    viewport.MaxDepth = g_Viewport.MaxDepth;
-    
-    g_D3DContext->RSSetViewports(1, &viewport);
-
     ShowWindow(hWnd, SW_SHOW);
     UpdateWindow(hWnd);
 
-    // Initialize compatibility shaders
-    if (FAILED(CHInternal::g_CompatibilityShaderManager.Initialize()))
-        return -1;
-    
-    // Initialize sprite shaders
-    if (FAILED(CHSpriteInternal::g_SpriteShaderManager.Initialize()))
-        return -1;
-
-    // Set default render states (maintaining exact same defaults as original)
-    SetRenderState(CH_RS_AMBIENT, 0xFFFFFFFF);
-    SetRenderState(CH_RS_LIGHTING, TRUE);
-    SetRenderState(CH_RS_CULLMODE, CH_CULL_CW);
-    SetRenderState(CH_RS_ZFUNC, CH_CMP_LESSEQUAL);
-    SetRenderState(CH_RS_EDGEANTIALIAS, TRUE);
-    SetRenderState(CH_RS_MULTISAMPLEANTIALIAS, TRUE);
-    SetTextureStageState(0, CH_TSS_MINFILTER, CH_TEXF_LINEAR);
-    SetTextureStageState(0, CH_TSS_MAGFILTER, CH_TEXF_LINEAR);
-    SetTextureStageState(0, CH_TSS_MIPFILTER, CH_TEXF_LINEAR);
-
-    // Initialize texture system
-    for (int t = 0; t < TEX_MAX; t++)
-        g_lpTex[t] = nullptr;
-
-    // Initialize critical section for thread safety
-    InitializeCriticalSection(&g_CriticalSection);
-
-    g_hWnd = hWnd;
-
-    // Store present parameters for compatibility
-    g_Present.Windowed = bWindowed;
-    g_Present.BackBufferCount = dwBackCount;
-    g_Present.BackBufferWidth = g_DisplayMode.Width;
-    g_Present.BackBufferHeight = g_DisplayMode.Height;
-    g_Present.hDeviceWindow = g_hWnd;
-    g_Present.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
-    g_Present.BackBufferFormat = g_DisplayMode.Format;
-    g_Present.EnableAutoDepthStencil = TRUE;
-    g_Present.AutoDepthStencilFormat = DXGI_FORMAT_D24_UNORM_S8_UINT;
-
-    return 1; // Success
+    return InitDeviceObjects(backBuffer.Get(), hWnd, dwWidth, dwHeight, bWindowed, dwBackCount);
 }
 
 CH_CORE_DLL_API
 void Quit3D()
 {
+    // Atlas pages hold (manifest) textures of the global array
+    CHAtlasInternal::Cleanup();
+
     // Cleanup all textures in global array first
     for (int t = 0; t < TEX_MAX; t++)
     {
@@ -355,9 +449,19 @@ void Quit3D()
         }
     }
     
+    CHQueueInternal::Cleanup();
+    CHInstanceInternal::Cleanup();
     CHInternal::g_CompatibilityShaderManager.Cleanup();
+    CHInternal::g_ConstantBuffers.Cleanup();
+    CHSpriteInternal::g_SpriteBatch.Clear();
     CHSpriteInternal::g_SpriteShaderManager.Cleanup();
+    CHInternal::g_DynamicVertexRing.Cleanup();
+    CHInternal::g_QuadIndexBuffer.Cleanup();
+    CHEmitterInternal::g_WorkerPool.Shutdown();
     CHInternal::g_RenderStateManager.Reset();
+    CHInternal::g_StateObjectCache.Cleanup();
+    CHBackendInternal::Cleanup();
+    CHShaderInternal::Cleanup();
     
     g_DepthStencilView.Reset();
     g_DepthStencilBuffer.Reset();
@@ -375,6 +479,12 @@ BOOL Begin3D()
 {
     // DirectX 11 doesn't require explicit BeginScene/EndScene
     // but we maintain the API for compatibility
+    CHInternal::g_DynamicVertexRing.BeginFrame();
+    CHInternal::g_RenderStateManager.BeginFrame();
+    CHInternal::g_ConstantBuffers.BeginFrame();
+    CHBackendInternal::BeginFrame();
+    CHInstanceInternal::BeginFrame();
+    CHBatchInternal::BeginFrame();
     return TRUE;
 }
 
@@ -382,7 +492,11 @@ CH_CORE_DLL_API
 BOOL End3D()
 {
     // DirectX 11 doesn't require explicit BeginScene/EndScene
-    // but we maintain the API for compatibility
+    // but we maintain the API for compatibility; instanced scenes, queued
+    // scene packets and then sprites still pending for this frame are drawn here
+    SceneInstance_Flush();
+    RenderQueue_Flush();
+    CHSpriteInternal::g_SpriteBatch.Flush();
     return TRUE;
 }
 
@@ -431,8 +545,9 @@ BOOL ClearBuffer(BOOL bZBuffer, BOOL bTarget, DWORD color)
 CH_CORE_DLL_API
 BOOL Flip()
 {
+    // Headless frames end here (nothing to present)
     if (!g_SwapChain)
-        return FALSE;
+        return CHBackendInternal::g_bHeadless;
 
     HRESULT hr = g_SwapChain->Present(0, 0);
     return SUCCEEDED(hr);
@@ -441,21 +556,38 @@ BOOL Flip()
 CH_CORE_DLL_API
 void SetRenderState(CHRenderStateType state, DWORD dwValue)
 {
+    // Queued sprites are drawn with the state they were queued under
+    CHSpriteInternal::g_SpriteBatch.Flush();
     CHInternal::g_RenderStateManager.SetRenderState(state, dwValue);
 }
 
 CH_CORE_DLL_API
 void SetTextureStageState(DWORD dwStage, CHTextureStageStateType type, DWORD dwValue)
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
     CHInternal::g_RenderStateManager.SetTextureStageState(dwStage, type, dwValue);
 }
 
+CH_CORE_DLL_API
+void GetRenderStateStats(DWORD* lpRequested, DWORD* lpApplied, DWORD* lpObjects)
+{
+    CHInternal::g_RenderStateManager.GetStats(lpRequested, lpApplied);
+    CHInternal::g_StateObjectCache.GetStats(lpObjects, nullptr);
+}
+
+CH_CORE_DLL_API
+void GetConstantBufferStats(DWORD* lpFrame, DWORD* lpObject, DWORD* lpMaterial)
+{
+    CHInternal::g_ConstantBuffers.GetStats(lpFrame, lpObject, lpMaterial);
+}
+
 CH_CORE_DLL_API
 BOOL SetTexture(DWORD dwStage, ID3D11ShaderResourceView* lpTex)
 {
     if (dwStage >= 8)
         return FALSE;
 
+    CHSpriteInternal::g_SpriteBatch.Flush();
     g_D3DContext->PSSetShaderResources(dwStage, 1, &lpTex);
     return TRUE;
 }
@@ -502,13 +634,17 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
     {
         // Create vertex shader for scene rendering
         const char* vertexShaderSource = R"(
-        cbuffer ConstantBuffer : register(b0)
+        cbuffer PerFrame : register(b0)
         {
-            matrix World;
             matrix View;
             matrix Projection;
         };
         
+        cbuffer PerObject : register(b1)
+        {
+            matrix World;
+        };
+        
         struct VS_INPUT
         {
             float3 Pos : POSITION;
@@ -556,6 +692,11 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
         Texture2D lightmapTexture : register(t1);
         SamplerState sampleType : register(s0);
         
+        cbuffer PerMaterial : register(b2)
+        {
+            float4 MaterialColor;
+        };
+        
         struct PS_INPUT
         {
             float4 Pos : SV_POSITION;
@@ -576,7 +717,7 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
             // Combine diffuse and lightmap (modulate)
             float4 finalColor = diffuseColor * lightmapColor;
             
-            return finalColor;
+            return finalColor * MaterialColor;
         }
     )";
 
@@ -585,6 +726,11 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
         Texture2D diffuseTexture : register(t0);
         SamplerState sampleType : register(s0);
         
+        cbuffer PerMaterial : register(b2)
+        {
+            float4 MaterialColor;
+        };
+        
         struct PS_INPUT
         {
             float4 Pos : SV_POSITION;
@@ -606,7 +752,7 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
             // Apply basic lighting
             diffuseColor.rgb *= (0.3f + 0.7f * ndotl); // Ambient + diffuse
             
-            return diffuseColor;
+            return diffuseColor * MaterialColor;
         }
     )";
 
@@ -614,8 +760,8 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
         CHComPtr<ID3DBlob> vertexShaderBlob;
         CHComPtr<ID3DBlob> errorBlob;
 
-        HRESULT hr = D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr,
-            "main", "vs_4_0", 0, 0, vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        HRESULT hr = CHShaderInternal::CompileShader(vertexShaderSource, nullptr,
+            "main", "vs_4_0", vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
 
         if (FAILED(hr))
         {
@@ -635,8 +781,8 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
 
         // Compile lightmap pixel shader
         CHComPtr<ID3DBlob> pixelShaderBlob;
-        hr = D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr,
-            "main", "ps_4_0", 0, 0, pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        hr = CHShaderInternal::CompileShader(pixelShaderSource, nullptr,
+            "main", "ps_4_0", pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
 
         if (FAILED(hr))
         {
@@ -656,8 +802,8 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
 
         // Compile simple pixel shader
         CHComPtr<ID3DBlob> simplePixelShaderBlob;
-        hr = D3DCompile(simplePixelShaderSource, strlen(simplePixelShaderSource), nullptr, nullptr, nullptr,
-            "main", "ps_4_0", 0, 0, simplePixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        hr = CHShaderInternal::CompileShader(simplePixelShaderSource, nullptr,
+            "main", "ps_4_0", simplePixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
 
         if (FAILED(hr))
             return hr;
@@ -683,14 +829,83 @@ HRESULT CHInternal::CompatibilityShaderManager::Initialize()
         if (FAILED(hr))
             return hr;
 
-        // Create constant buffer
-        D3D11_BUFFER_DESC constantBufferDesc = {};
-        constantBufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        constantBufferDesc.ByteWidth = sizeof(XMMATRIX) * 3; // World, View, Projection
-        constantBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-        constantBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        // Instanced scene vertex shader: the world matrix is streamed per instance
+        const char* instancedVertexShaderSource = R"(
+        cbuffer PerFrame : register(b0)
+        {
+            matrix View;
+            matrix Projection;
+        };
+        
+        struct VS_INPUT
+        {
+            float3 Pos : POSITION;
+            float3 Normal : NORMAL;
+            float2 Tex : TEXCOORD0;
+            float2 LightTex : TEXCOORD1;
+            float4 World0 : WORLD0;
+            float4 World1 : WORLD1;
+            float4 World2 : WORLD2;
+            float4 World3 : WORLD3;
+        };
+        
+        struct PS_INPUT
+        {
+            float4 Pos : SV_POSITION;
+            float3 Normal : NORMAL;
+            float2 Tex : TEXCOORD0;
+            float2 LightTex : TEXCOORD1;
+            float3 WorldPos : TEXCOORD2;
+        };
+        
+        PS_INPUT main(VS_INPUT input)
+        {
+            PS_INPUT output = (PS_INPUT)0;
+            
+            // Rows of the instance's world matrix
+            float4x4 World = float4x4(input.World0, input.World1, input.World2, input.World3);
+            
+            float4 worldPos = mul(float4(input.Pos, 1.0f), World);
+            float4 viewPos = mul(worldPos, View);
+            output.Pos = mul(viewPos, Projection);
+            
+            output.Normal = normalize(mul(input.Normal, (float3x3)World));
+            output.Tex = input.Tex;
+            output.LightTex = input.LightTex;
+            output.WorldPos = worldPos.xyz;
+            
+            return output;
+        }
+    )";
+
+        CHComPtr<ID3DBlob> instancedShaderBlob;
+        hr = CHShaderInternal::CompileShader(instancedVertexShaderSource, nullptr,
+            "main", "vs_4_0", instancedShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        if (FAILED(hr))
+            return hr;
+
+        hr = g_D3DDevice->CreateVertexShader(instancedShaderBlob->GetBufferPointer(),
+            instancedShaderBlob->GetBufferSize(),
+            nullptr, m_instancedVertexShader.GetAddressOf());
+        if (FAILED(hr))
+            return hr;
+
+        // Scene vertices in slot 0, one world matrix per instance in slot 1
+        D3D11_INPUT_ELEMENT_DESC instancedLayout[] = {
+            { "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "TEXCOORD", 1, DXGI_FORMAT_R32G32_FLOAT, 0, 32, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+            { "WORLD", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLD", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLD", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 32, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+            { "WORLD", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 48, D3D11_INPUT_PER_INSTANCE_DATA, 1 }
+        };
 
-        hr = g_D3DDevice->CreateBuffer(&constantBufferDesc, nullptr, m_constantBuffer.GetAddressOf());
+        hr = g_D3DDevice->CreateInputLayout(instancedLayout, ARRAYSIZE(instancedLayout),
+            instancedShaderBlob->GetBufferPointer(),
+            instancedShaderBlob->GetBufferSize(),
+            m_instancedInputLayout.GetAddressOf());
         if (FAILED(hr))
             return hr;
 
@@ -719,10 +934,11 @@ void CHInternal::CompatibilityShaderManager::SetDefaultShaders()
         g_D3DContext->VSSetShader(m_defaultVertexShader.Get(), nullptr, 0);
         g_D3DContext->PSSetShader(m_simplePixelShader.Get(), nullptr, 0); // Use simple by default
         g_D3DContext->IASetInputLayout(m_defaultInputLayout.Get());
-        g_D3DContext->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+        g_ConstantBuffers.Bind();
 
         // Set default sampler
         g_D3DContext->PSSetSamplers(0, 1, m_defaultSampler.GetAddressOf());
+        g_RenderStateManager.SetBoundSampler(0, m_defaultSampler.Get());
     }
 
 void CHInternal::CompatibilityShaderManager::SetLightmapShaders()
@@ -730,37 +946,129 @@ void CHInternal::CompatibilityShaderManager::SetLightmapShaders()
         g_D3DContext->VSSetShader(m_defaultVertexShader.Get(), nullptr, 0);
         g_D3DContext->PSSetShader(m_defaultPixelShader.Get(), nullptr, 0); // Use lightmap shader
         g_D3DContext->IASetInputLayout(m_defaultInputLayout.Get());
-        g_D3DContext->VSSetConstantBuffers(0, 1, m_constantBuffer.GetAddressOf());
+        g_ConstantBuffers.Bind();
+
+        // Set default sampler for both texture stages
+        g_D3DContext->PSSetSamplers(0, 1, m_defaultSampler.GetAddressOf());
+        g_RenderStateManager.SetBoundSampler(0, m_defaultSampler.Get());
+    }
+
+void CHInternal::CompatibilityShaderManager::SetInstancedShaders()
+    {
+        g_D3DContext->VSSetShader(m_instancedVertexShader.Get(), nullptr, 0);
+        g_D3DContext->PSSetShader(m_simplePixelShader.Get(), nullptr, 0);
+        g_D3DContext->IASetInputLayout(m_instancedInputLayout.Get());
+        g_ConstantBuffers.Bind();
+
+        g_D3DContext->PSSetSamplers(0, 1, m_defaultSampler.GetAddressOf());
+        g_RenderStateManager.SetBoundSampler(0, m_defaultSampler.Get());
+    }
+
+void CHInternal::CompatibilityShaderManager::Cleanup()
+    {
+        m_defaultSampler.Reset();
+        m_instancedInputLayout.Reset();
+        m_instancedVertexShader.Reset();
+        m_defaultInputLayout.Reset();
+        m_simplePixelShader.Reset();
+        m_defaultPixelShader.Reset();
+        m_defaultVertexShader.Reset();
+    }
+
+
+}
+
+// State object cache (FNV-1a over the descriptor bytes)
+template <typename Desc>
+size_t CHInternal::StateObjectCache::DescHash<Desc>::operator()(const DescKey<Desc>& key) const
+{
+    const BYTE* bytes = reinterpret_cast<const BYTE*>(&key.desc);
+    UINT64 hash = 14695981039346656037ull;
+    for (size_t i = 0; i < sizeof(Desc); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return static_cast<size_t>(hash);
+}
+
+ID3D11RasterizerState* CHInternal::StateObjectCache::GetRasterizerState(const D3D11_RASTERIZER_DESC& desc)
+{
+    DescKey<D3D11_RASTERIZER_DESC> key = { desc };
+    auto it = m_rasterizerStates.find(key);
+    if (it != m_rasterizerStates.end())
+        return it->second.Get();
+
+    CHComPtr<ID3D11RasterizerState> state;
+    if (!g_D3DDevice || FAILED(g_D3DDevice->CreateRasterizerState(&desc, state.GetAddressOf())))
+        return nullptr;
+
+    m_creations++;
+    return (m_rasterizerStates[key] = state).Get();
+}
+
+ID3D11DepthStencilState* CHInternal::StateObjectCache::GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc)
+{
+    DescKey<D3D11_DEPTH_STENCIL_DESC> key = { desc };
+    auto it = m_depthStencilStates.find(key);
+    if (it != m_depthStencilStates.end())
+        return it->second.Get();
+
+    CHComPtr<ID3D11DepthStencilState> state;
+    if (!g_D3DDevice || FAILED(g_D3DDevice->CreateDepthStencilState(&desc, state.GetAddressOf())))
+        return nullptr;
+
+    m_creations++;
+    return (m_depthStencilStates[key] = state).Get();
+}
+
+ID3D11BlendState* CHInternal::StateObjectCache::GetBlendState(const D3D11_BLEND_DESC& desc)
+{
+    DescKey<D3D11_BLEND_DESC> key = { desc };
+    auto it = m_blendStates.find(key);
+    if (it != m_blendStates.end())
+        return it->second.Get();
 
-        // Set default sampler for both texture stages
-        g_D3DContext->PSSetSamplers(0, 1, m_defaultSampler.GetAddressOf());
-    }
+    CHComPtr<ID3D11BlendState> state;
+    if (!g_D3DDevice || FAILED(g_D3DDevice->CreateBlendState(&desc, state.GetAddressOf())))
+        return nullptr;
 
-void CHInternal::CompatibilityShaderManager::UpdateConstantBuffer(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& proj)
-    {
-        D3D11_MAPPED_SUBRESOURCE mappedResource;
-        HRESULT hr = g_D3DContext->Map(m_constantBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-        if (SUCCEEDED(hr))
-        {
-            XMMATRIX* matrices = reinterpret_cast<XMMATRIX*>(mappedResource.pData);
-            matrices[0] = XMMatrixTranspose(world);
-            matrices[1] = XMMatrixTranspose(view);
-            matrices[2] = XMMatrixTranspose(proj);
-            g_D3DContext->Unmap(m_constantBuffer.Get(), 0);
-        }
-    }
+    m_creations++;
+    return (m_blendStates[key] = state).Get();
+}
 
-void CHInternal::CompatibilityShaderManager::Cleanup()
-    {
-        m_defaultSampler.Reset();
-        m_constantBuffer.Reset();
-        m_defaultInputLayout.Reset();
-        m_simplePixelShader.Reset();
-        m_defaultPixelShader.Reset();
-        m_defaultVertexShader.Reset();
-    }
+ID3D11SamplerState* CHInternal::StateObjectCache::GetSamplerState(const D3D11_SAMPLER_DESC& desc)
+{
+    DescKey<D3D11_SAMPLER_DESC> key = { desc };
+    auto it = m_samplerStates.find(key);
+    if (it != m_samplerStates.end())
+        return it->second.Get();
+
+    CHComPtr<ID3D11SamplerState> state;
+    if (!g_D3DDevice || FAILED(g_D3DDevice->CreateSamplerState(&desc, state.GetAddressOf())))
+        return nullptr;
+
+    m_creations++;
+    return (m_samplerStates[key] = state).Get();
+}
 
+void CHInternal::StateObjectCache::GetStats(DWORD* objects, DWORD* creations) const
+{
+    if (objects)
+        *objects = static_cast<DWORD>(m_rasterizerStates.size() + m_depthStencilStates.size() +
+                                      m_blendStates.size() + m_samplerStates.size());
+    if (creations)
+        *creations = m_creations;
+}
 
+void CHInternal::StateObjectCache::Cleanup()
+{
+    // Objects belong to the device; drop them before it goes away
+    m_rasterizerStates.clear();
+    m_depthStencilStates.clear();
+    m_blendStates.clear();
+    m_samplerStates.clear();
+    m_creations = 0;
 }
 
 // CHInternal namespace method implementations
@@ -770,29 +1078,42 @@ void CHInternal::RenderStateManager::SetRenderState(CHRenderStateType state, DWO
     if (static_cast<int>(state) >= 512)
         return;
 
+    m_dwRequested++;
+
     // Cache state changes and apply them efficiently
     if (m_currentState.currentStates[static_cast<int>(state)] == value)
         return;
 
     m_currentState.currentStates[static_cast<int>(state)] = value;
 
-    // Apply immediately for critical states
+    // Mark the state block for the next draw (CommitStates)
     switch (state)
     {
     case CH_RS_CULLMODE:
+    case CH_RS_MULTISAMPLEANTIALIAS:
+    case CH_RS_ANTIALIASEDLINEENABLE:
+        m_dwDirty |= DIRTY_RASTERIZER;
+        break;
     case CH_RS_ZFUNC:
     case CH_RS_ZENABLE:
     case CH_RS_ZWRITEENABLE:
+    case CH_RS_STENCILENABLE:
+    case CH_RS_STENCILFAIL:
+    case CH_RS_STENCILZFAIL:
+    case CH_RS_STENCILPASS:
+    case CH_RS_STENCILFUNC:
+    case CH_RS_STENCILREF:
+    case CH_RS_STENCILMASK:
+    case CH_RS_STENCILWRITEMASK:
+        m_dwDirty |= DIRTY_DEPTHSTENCIL;
+        break;
     case CH_RS_ALPHABLENDENABLE:
     case CH_RS_SRCBLEND:
     case CH_RS_DESTBLEND:
-    case CH_RS_ALPHATESTENABLE:
-    case CH_RS_ALPHAREF:
-    case CH_RS_ALPHAFUNC:
-        ApplyStates();
+        m_dwDirty |= DIRTY_BLEND;
         break;
     default:
-        // Other states can be batched
+        // No D3D11 state object depends on it
         break;
     }
 }
@@ -802,150 +1123,221 @@ void CHInternal::RenderStateManager::SetTextureStageState(DWORD stage, CHTexture
     if (stage >= 8 || static_cast<int>(type) >= 64)
         return;
 
+    m_dwRequested++;
+
     if (m_currentState.currentTextureStates[stage][static_cast<int>(type)] == value)
         return;
 
     m_currentState.currentTextureStates[stage][static_cast<int>(type)] = value;
 
-    // Apply sampler state changes for filtering
-    if (type == CH_TSS_MINFILTER || type == CH_TSS_MAGFILTER || type == CH_TSS_MIPFILTER)
+    // Sampler state changes are bound by the next draw
+    switch (type)
     {
-        ApplySamplerState(stage);
+    case CH_TSS_MINFILTER:
+    case CH_TSS_MAGFILTER:
+    case CH_TSS_MIPFILTER:
+    case CH_TSS_ADDRESSU:
+    case CH_TSS_ADDRESSV:
+    case CH_TSS_ADDRESSW:
+    case CH_TSS_BORDERCOLOR:
+    case CH_TSS_MAXANISOTROPY:
+        m_dwDirtySamplers |= 1 << stage;
+        break;
+    default:
+        break;
     }
 }
 
+void CHInternal::RenderStateManager::SetBoundSampler(DWORD stage, ID3D11SamplerState* sampler)
+{
+    if (stage >= 8)
+        return;
+
+    // Pending changes to the stage are superseded, as when they were applied immediately
+    m_boundSamplers[stage] = sampler;
+    m_dwDirtySamplers &= ~(1 << stage);
+}
+
+void CHInternal::RenderStateManager::BeginFrame()
+{
+    m_dwLastRequested = m_dwRequested;
+    m_dwLastApplied = m_dwApplied;
+    m_dwRequested = 0;
+    m_dwApplied = 0;
+}
+
+void CHInternal::RenderStateManager::GetStats(DWORD* requested, DWORD* applied) const
+{
+    if (requested)
+        *requested = m_dwLastRequested;
+    if (applied)
+        *applied = m_dwLastApplied;
+}
+
 void CHInternal::RenderStateManager::ApplyStates()
         {
-            // Apply rasterizer state
-            D3D11_RASTERIZER_DESC rasterizerDesc = {};
-            rasterizerDesc.FillMode = D3D11_FILL_SOLID;
-            rasterizerDesc.CullMode = D3D11_CULL_BACK;
+            if (!g_D3DContext)
+                return;
 
-            DWORD cullMode = m_currentState.currentStates[CH_RS_CULLMODE];
-            switch (cullMode)
+            if (m_dwDirty & DIRTY_RASTERIZER)
             {
-            case CH_CULL_NONE:
-                rasterizerDesc.CullMode = D3D11_CULL_NONE;
-                break;
-            case CH_CULL_CW:
+                // Apply rasterizer state (descriptors are cache keys: zero the padding too)
+                D3D11_RASTERIZER_DESC rasterizerDesc;
+                ZeroMemory(&rasterizerDesc, sizeof(rasterizerDesc));
+                rasterizerDesc.FillMode = D3D11_FILL_SOLID;
                 rasterizerDesc.CullMode = D3D11_CULL_BACK;
-                rasterizerDesc.FrontCounterClockwise = FALSE;
-                break;
-            case CH_CULL_CCW:
-                rasterizerDesc.CullMode = D3D11_CULL_BACK;
-                rasterizerDesc.FrontCounterClockwise = TRUE;
-                break;
-            }
 
-            rasterizerDesc.DepthBias = 0;
-            rasterizerDesc.DepthBiasClamp = 0.0f;
-            rasterizerDesc.SlopeScaledDepthBias = 0.0f;
-            rasterizerDesc.DepthClipEnable = TRUE;
-            rasterizerDesc.ScissorEnable = FALSE;
-            rasterizerDesc.MultisampleEnable = m_currentState.currentStates[CH_RS_MULTISAMPLEANTIALIAS] ? TRUE : FALSE;
-            rasterizerDesc.AntialiasedLineEnable = m_currentState.currentStates[CH_RS_ANTIALIASEDLINEENABLE] ? TRUE : FALSE;
-
-            // Create and set rasterizer state
-            CHComPtr<ID3D11RasterizerState> rasterizerState;
-            if (SUCCEEDED(g_D3DDevice->CreateRasterizerState(&rasterizerDesc, rasterizerState.GetAddressOf())))
-            {
-                g_D3DContext->RSSetState(rasterizerState.Get());
-            }
-
-            // Apply depth stencil state
-            D3D11_DEPTH_STENCIL_DESC depthStencilDesc = {};
-            depthStencilDesc.DepthEnable = m_currentState.currentStates[CH_RS_ZENABLE] ? TRUE : FALSE;
-            depthStencilDesc.DepthWriteMask = m_currentState.currentStates[CH_RS_ZWRITEENABLE] ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+                DWORD cullMode = m_currentState.currentStates[CH_RS_CULLMODE];
+                switch (cullMode)
+                {
+                case CH_CULL_NONE:
+                    rasterizerDesc.CullMode = D3D11_CULL_NONE;
+                    break;
+                case CH_CULL_CW:
+                    rasterizerDesc.CullMode = D3D11_CULL_BACK;
+                    rasterizerDesc.FrontCounterClockwise = FALSE;
+                    break;
+                case CH_CULL_CCW:
+                    rasterizerDesc.CullMode = D3D11_CULL_BACK;
+                    rasterizerDesc.FrontCounterClockwise = TRUE;
+                    break;
+                }
 
-            DWORD zFunc = m_currentState.currentStates[CH_RS_ZFUNC];
-            switch (zFunc)
-            {
-            case CH_CMP_NEVER:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_NEVER;
-                break;
-            case CH_CMP_LESS:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS;
-                break;
-            case CH_CMP_EQUAL:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
-                break;
-            case CH_CMP_LESSEQUAL:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-                break;
-            case CH_CMP_GREATER:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER;
-                break;
-            case CH_CMP_NOTEQUAL:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_NOT_EQUAL;
-                break;
-            case CH_CMP_GREATEREQUAL:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL;
-                break;
-            case CH_CMP_ALWAYS:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
-                break;
-            default:
-                depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
-                break;
+                rasterizerDesc.DepthBias = 0;
+                rasterizerDesc.DepthBiasClamp = 0.0f;
+                rasterizerDesc.SlopeScaledDepthBias = 0.0f;
+                rasterizerDesc.DepthClipEnable = TRUE;
+                rasterizerDesc.ScissorEnable = FALSE;
+                rasterizerDesc.MultisampleEnable = m_currentState.currentStates[CH_RS_MULTISAMPLEANTIALIAS] ? TRUE : FALSE;
+                rasterizerDesc.AntialiasedLineEnable = m_currentState.currentStates[CH_RS_ANTIALIASEDLINEENABLE] ? TRUE : FALSE;
+
+                // Look up and set rasterizer state (only when it changed)
+                ID3D11RasterizerState* rasterizerState = g_StateObjectCache.GetRasterizerState(rasterizerDesc);
+                if (rasterizerState && rasterizerState != m_boundRasterizer)
+                {
+                    g_D3DContext->RSSetState(rasterizerState);
+                    m_boundRasterizer = rasterizerState;
+                    m_dwApplied++;
+                    CHBackendInternal::CountStateChange();
+                }
             }
 
-            // Handle stencil operations if enabled
-            depthStencilDesc.StencilEnable = m_currentState.currentStates[CH_RS_STENCILENABLE] ? TRUE : FALSE;
-            if (depthStencilDesc.StencilEnable)
+            if (m_dwDirty & DIRTY_DEPTHSTENCIL)
             {
-                depthStencilDesc.StencilReadMask = static_cast<UINT8>(m_currentState.currentStates[CH_RS_STENCILMASK]);
-                depthStencilDesc.StencilWriteMask = static_cast<UINT8>(m_currentState.currentStates[CH_RS_STENCILWRITEMASK]);
+                // Apply depth stencil state
+                D3D11_DEPTH_STENCIL_DESC depthStencilDesc;
+                ZeroMemory(&depthStencilDesc, sizeof(depthStencilDesc));
+                depthStencilDesc.DepthEnable = m_currentState.currentStates[CH_RS_ZENABLE] ? TRUE : FALSE;
+                depthStencilDesc.DepthWriteMask = m_currentState.currentStates[CH_RS_ZWRITEENABLE] ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
+
+                DWORD zFunc = m_currentState.currentStates[CH_RS_ZFUNC];
+                switch (zFunc)
+                {
+                case CH_CMP_NEVER:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_NEVER;
+                    break;
+                case CH_CMP_LESS:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS;
+                    break;
+                case CH_CMP_EQUAL:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_EQUAL;
+                    break;
+                case CH_CMP_LESSEQUAL:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+                    break;
+                case CH_CMP_GREATER:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER;
+                    break;
+                case CH_CMP_NOTEQUAL:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_NOT_EQUAL;
+                    break;
+                case CH_CMP_GREATEREQUAL:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_GREATER_EQUAL;
+                    break;
+                case CH_CMP_ALWAYS:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+                    break;
+                default:
+                    depthStencilDesc.DepthFunc = D3D11_COMPARISON_LESS_EQUAL;
+                    break;
+                }
+
+                // Handle stencil operations if enabled
+                depthStencilDesc.StencilEnable = m_currentState.currentStates[CH_RS_STENCILENABLE] ? TRUE : FALSE;
+                if (depthStencilDesc.StencilEnable)
+                {
+                    depthStencilDesc.StencilReadMask = static_cast<UINT8>(m_currentState.currentStates[CH_RS_STENCILMASK]);
+                    depthStencilDesc.StencilWriteMask = static_cast<UINT8>(m_currentState.currentStates[CH_RS_STENCILWRITEMASK]);
 
-                // Front face stencil operations
-                depthStencilDesc.FrontFace.StencilFailOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILFAIL]);
-                depthStencilDesc.FrontFace.StencilDepthFailOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILZFAIL]);
-                depthStencilDesc.FrontFace.StencilPassOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILPASS]);
-                depthStencilDesc.FrontFace.StencilFunc = ConvertStencilFunc(m_currentState.currentStates[CH_RS_STENCILFUNC]);
+                    // Front face stencil operations
+                    depthStencilDesc.FrontFace.StencilFailOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILFAIL]);
+                    depthStencilDesc.FrontFace.StencilDepthFailOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILZFAIL]);
+                    depthStencilDesc.FrontFace.StencilPassOp = ConvertStencilOp(m_currentState.currentStates[CH_RS_STENCILPASS]);
+                    depthStencilDesc.FrontFace.StencilFunc = ConvertStencilFunc(m_currentState.currentStates[CH_RS_STENCILFUNC]);
 
-                // Back face stencil operations (same as front for now)
-                depthStencilDesc.BackFace = depthStencilDesc.FrontFace;
-            }
+                    // Back face stencil operations (same as front for now)
+                    depthStencilDesc.BackFace = depthStencilDesc.FrontFace;
+                }
 
-            // Create and set depth stencil state
-            CHComPtr<ID3D11DepthStencilState> depthStencilState;
-            if (SUCCEEDED(g_D3DDevice->CreateDepthStencilState(&depthStencilDesc, depthStencilState.GetAddressOf())))
-            {
+                // Look up and set depth stencil state
+                ID3D11DepthStencilState* depthStencilState = g_StateObjectCache.GetDepthStencilState(depthStencilDesc);
                 UINT stencilRef = m_currentState.currentStates[CH_RS_STENCILREF];
-                g_D3DContext->OMSetDepthStencilState(depthStencilState.Get(), stencilRef);
+                if (depthStencilState && (depthStencilState != m_boundDepthStencil || stencilRef != m_boundStencilRef))
+                {
+                    g_D3DContext->OMSetDepthStencilState(depthStencilState, stencilRef);
+                    m_boundDepthStencil = depthStencilState;
+                    m_boundStencilRef = stencilRef;
+                    m_dwApplied++;
+                    CHBackendInternal::CountStateChange();
+                }
             }
 
-            // Apply blend state
-            if (m_currentState.currentStates[CH_RS_ALPHABLENDENABLE])
+            if (m_dwDirty & DIRTY_BLEND)
             {
-                D3D11_BLEND_DESC blendDesc = {};
-                blendDesc.AlphaToCoverageEnable = FALSE;
-                blendDesc.IndependentBlendEnable = FALSE;
-                blendDesc.RenderTarget[0].BlendEnable = TRUE;
-
-                // Convert CH blend modes to D3D11
-                DWORD srcBlend = m_currentState.currentStates[CH_RS_SRCBLEND];
-                DWORD destBlend = m_currentState.currentStates[CH_RS_DESTBLEND];
-
-                blendDesc.RenderTarget[0].SrcBlend = ConvertBlendMode(srcBlend);
-                blendDesc.RenderTarget[0].DestBlend = ConvertBlendMode(destBlend);
-                blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
-                blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
-                blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
-                blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
-                blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
-
-                CHComPtr<ID3D11BlendState> blendState;
-                if (SUCCEEDED(g_D3DDevice->CreateBlendState(&blendDesc, blendState.GetAddressOf())))
+                // Apply blend state (nullptr = blending disabled)
+                ID3D11BlendState* blendState = nullptr;
+                if (m_currentState.currentStates[CH_RS_ALPHABLENDENABLE])
+                {
+                    D3D11_BLEND_DESC blendDesc;
+                    ZeroMemory(&blendDesc, sizeof(blendDesc));
+                    blendDesc.AlphaToCoverageEnable = FALSE;
+                    blendDesc.IndependentBlendEnable = FALSE;
+                    blendDesc.RenderTarget[0].BlendEnable = TRUE;
+
+                    // Convert CH blend modes to D3D11
+                    DWORD srcBlend = m_currentState.currentStates[CH_RS_SRCBLEND];
+                    DWORD destBlend = m_currentState.currentStates[CH_RS_DESTBLEND];
+
+                    blendDesc.RenderTarget[0].SrcBlend = ConvertBlendMode(srcBlend);
+                    blendDesc.RenderTarget[0].DestBlend = ConvertBlendMode(destBlend);
+                    blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+                    blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+                    blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+                    blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+                    blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+
+                    blendState = g_StateObjectCache.GetBlendState(blendDesc);
+                }
+
+                if (blendState != m_boundBlend)
                 {
                     float blendFactor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
-                    g_D3DContext->OMSetBlendState(blendState.Get(), blendFactor, 0xffffffff);
+                    g_D3DContext->OMSetBlendState(blendState, blendFactor, 0xffffffff);
+                    m_boundBlend = blendState;
+                    m_dwApplied++;
+                    CHBackendInternal::CountStateChange();
                 }
             }
-            else
+
+            // Samplers are only bound for stages whose sampler states changed
+            for (DWORD stage = 0; m_dwDirtySamplers != 0 && stage < 8; stage++)
             {
-                // Disable blending
-                g_D3DContext->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+                if (m_dwDirtySamplers & (1 << stage))
+                    ApplySamplerState(stage);
             }
+
+            m_dwDirty = 0;
+            m_dwDirtySamplers = 0;
         }
 
 D3D11_BLEND CHInternal::RenderStateManager::ConvertBlendMode(DWORD chBlend)
@@ -1034,7 +1426,8 @@ void CHInternal::RenderStateManager::ApplySamplerState(DWORD stage)
             if (stage >= 8)
                 return;
 
-            D3D11_SAMPLER_DESC samplerDesc = {};
+            D3D11_SAMPLER_DESC samplerDesc;
+            ZeroMemory(&samplerDesc, sizeof(samplerDesc));
 
             // Get filter settings
             DWORD minFilter = m_currentState.currentTextureStates[stage][CH_TSS_MINFILTER];
@@ -1095,10 +1488,14 @@ void CHInternal::RenderStateManager::ApplySamplerState(DWORD stage)
             samplerDesc.MinLOD = 0;
             samplerDesc.MaxLOD = D3D11_FLOAT32_MAX;
 
-            CHComPtr<ID3D11SamplerState> samplerState;
-            if (SUCCEEDED(g_D3DDevice->CreateSamplerState(&samplerDesc, samplerState.GetAddressOf())))
+            // Shader managers report their own slot binds through SetBoundSampler
+            ID3D11SamplerState* samplerState = g_StateObjectCache.GetSamplerState(samplerDesc);
+            if (samplerState && samplerState != m_boundSamplers[stage])
             {
-                g_D3DContext->PSSetSamplers(stage, 1, samplerState.GetAddressOf());
+                g_D3DContext->PSSetSamplers(stage, 1, &samplerState);
+                m_boundSamplers[stage] = samplerState;
+                m_dwApplied++;
+                CHBackendInternal::CountStateChange();
             }
         }
 
@@ -1128,14 +1525,18 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
     {
         // Create vertex shader for skeletal animation
         const char* vertexShaderSource = R"(
-        cbuffer ConstantBuffer : register(b0)
+        cbuffer PerFrame : register(b0)
         {
-            matrix World;
             matrix View;
             matrix Projection;
         };
         
-        cbuffer BoneMatrices : register(b1)
+        cbuffer PerObject : register(b1)
+        {
+            matrix World;
+        };
+        
+        cbuffer BoneMatrices : register(b3)
         {
             matrix BoneMatrices[64]; // Support up to 64 bones
         };
@@ -1201,6 +1602,11 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
         Texture2D diffuseTexture : register(t0);
         SamplerState sampleType : register(s0);
         
+        cbuffer PerMaterial : register(b2)
+        {
+            float4 MaterialColor;
+        };
+        
         struct PS_INPUT
         {
             float4 Pos : SV_POSITION;
@@ -1220,7 +1626,7 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
             // Apply basic lighting
             diffuseColor.rgb *= (0.3f + 0.7f * ndotl); // Ambient + diffuse
             
-            return diffuseColor;
+            return diffuseColor * MaterialColor;
         }
     )";
 
@@ -1228,8 +1634,8 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
         CHComPtr<ID3DBlob> vertexShaderBlob;
         CHComPtr<ID3DBlob> errorBlob;
 
-        HRESULT hr = D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr,
-            "main", "vs_4_0", 0, 0, vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        HRESULT hr = CHShaderInternal::CompileShader(vertexShaderSource, nullptr,
+            "main", "vs_4_0", vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
 
         if (FAILED(hr))
         {
@@ -1244,8 +1650,8 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
 
         // Compile pixel shader
         CHComPtr<ID3DBlob> pixelShaderBlob;
-        hr = D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr,
-            "main", "ps_4_0", 0, 0, pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        hr = CHShaderInternal::CompileShader(pixelShaderSource, nullptr,
+            "main", "ps_4_0", pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
 
         if (FAILED(hr))
             return FALSE;
@@ -1279,7 +1685,7 @@ BOOL CHPhyInternal::PhyShaderManager::Initialize()
         boneBufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         boneBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-        hr = g_D3DDevice->CreateBuffer(&boneBufferDesc, nullptr, m_boneMatrixBuffer.GetAddressOf());
+        hr = CHBackendInternal::CreateBuffer(&boneBufferDesc, nullptr, m_boneMatrixBuffer.GetAddressOf());
         if (FAILED(hr))
             return FALSE;
 
@@ -1291,7 +1697,8 @@ void CHPhyInternal::PhyShaderManager::SetSkeletalShaders()
         g_D3DContext->VSSetShader(m_skeletalVertexShader.Get(), nullptr, 0);
         g_D3DContext->PSSetShader(m_skeletalPixelShader.Get(), nullptr, 0);
         g_D3DContext->IASetInputLayout(m_skeletalInputLayout.Get());
-        g_D3DContext->VSSetConstantBuffers(1, 1, m_boneMatrixBuffer.GetAddressOf()); // Bone matrices at slot 1
+        CHInternal::g_ConstantBuffers.Bind();
+        g_D3DContext->VSSetConstantBuffers(3, 1, m_boneMatrixBuffer.GetAddressOf()); // Bone matrices at slot 3
     }
 
 void CHPhyInternal::PhyShaderManager::SetNormalShaders()
@@ -1311,7 +1718,7 @@ void CHPhyInternal::PhyShaderManager::UpdateBoneMatrices(const XMMATRIX* boneMat
         if (boneCount > 64) boneCount = 64; // Limit to 64 bones
 
         D3D11_MAPPED_SUBRESOURCE mappedResource;
-        HRESULT hr = g_D3DContext->Map(m_boneMatrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
+        HRESULT hr = CHBackendInternal::Map(m_boneMatrixBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, &mappedResource);
         if (SUCCEEDED(hr))
         {
             XMMATRIX* matrices = reinterpret_cast<XMMATRIX*>(mappedResource.pData);
@@ -1337,6 +1744,16 @@ void CHInternal::RenderStateManager::Reset()
     {
         ZeroMemory(&m_currentState, sizeof(m_currentState));
 
+        m_boundRasterizer = nullptr;
+        m_boundDepthStencil = nullptr;
+        m_boundStencilRef = 0;
+        m_boundBlend = nullptr;
+        ZeroMemory(m_boundSamplers, sizeof(m_boundSamplers));
+        m_dwDirty = 0;
+        m_dwDirtySamplers = 0;
+        m_dwRequested = m_dwApplied = 0;
+        m_dwLastRequested = m_dwLastApplied = 0;
+
         // Set default states (matching DirectX 8 defaults)
         m_currentState.currentStates[CH_RS_ZENABLE] = TRUE;
         m_currentState.currentStates[CH_RS_ZWRITEENABLE] = TRUE;
@@ -1382,3 +1799,433 @@ void CHInternal::RenderStateManager::Reset()
         }
     }
 
+
+// Shared dynamic vertex ring
+HRESULT CHInternal::DynamicVertexRing::Initialize(UINT capacity)
+{
+    Cleanup();
+
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.ByteWidth = capacity;
+    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    HRESULT hr = CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, m_buffer.GetAddressOf());
+    if (FAILED(hr))
+        return hr;
+
+    m_capacity = capacity;
+    m_offset = 0;
+    m_discardPending = TRUE;
+    return S_OK;
+}
+
+void CHInternal::DynamicVertexRing::BeginFrame()
+{
+    // Everything written last frame is dropped by the next lock's discard
+    m_offset = 0;
+    m_discardPending = TRUE;
+    m_locks = 0;
+    m_discards = 0;
+}
+
+void* CHInternal::DynamicVertexRing::Lock(UINT vertexCount, UINT stride, UINT* baseVertex, DWORD* generation)
+{
+    if (!m_buffer || m_locked || vertexCount == 0 || stride == 0)
+        return nullptr;
+
+    UINT bytes = vertexCount * stride;
+    if (bytes > m_capacity)
+        return nullptr;
+
+    // Start on a multiple of stride so the offset is expressible as a base vertex
+    UINT start = (m_offset + stride - 1) / stride * stride;
+    if (m_discardPending || start + bytes > m_capacity)
+    {
+        // New frame, or this frame overflowed: rename the buffer
+        start = 0;
+        m_discardPending = TRUE;
+    }
+
+    D3D11_MAP mapType = m_discardPending ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    if (FAILED(CHBackendInternal::Map(m_buffer.Get(), 0, mapType, &mappedResource)))
+        return nullptr;
+
+    if (m_discardPending)
+    {
+        m_generation++;
+        if (m_generation == 0)
+            m_generation = 1;
+        m_discardPending = FALSE;
+        m_discards++;
+    }
+
+    m_offset = start + bytes;
+    m_locked = TRUE;
+    m_locks++;
+
+    if (baseVertex)
+        *baseVertex = start / stride;
+    if (generation)
+        *generation = m_generation;
+
+    return static_cast<BYTE*>(mappedResource.pData) + start;
+}
+
+void CHInternal::DynamicVertexRing::Unlock()
+{
+    if (!m_locked)
+        return;
+
+    g_D3DContext->Unmap(m_buffer.Get(), 0);
+    m_locked = FALSE;
+}
+
+BOOL CHInternal::DynamicVertexRing::Write(const void* vertices, UINT vertexCount, UINT stride, UINT* baseVertex, DWORD* generation)
+{
+    if (!vertices)
+        return FALSE;
+
+    void* dest = Lock(vertexCount, stride, baseVertex, generation);
+    if (!dest)
+        return FALSE;
+
+    memcpy(dest, vertices, vertexCount * stride);
+    Unlock();
+    return TRUE;
+}
+
+void CHInternal::DynamicVertexRing::Bind(UINT stride, UINT slot)
+{
+    UINT offset = 0;
+    g_D3DContext->IASetVertexBuffers(slot, 1, m_buffer.GetAddressOf(), &stride, &offset);
+}
+
+void CHInternal::DynamicVertexRing::GetStats(DWORD* locks, DWORD* discards) const
+{
+    if (locks)
+        *locks = m_locks;
+    if (discards)
+        *discards = m_discards;
+}
+
+void CHInternal::DynamicVertexRing::Cleanup()
+{
+    if (m_locked)
+        Unlock();
+
+    m_buffer.Reset();
+    m_capacity = 0;
+    m_offset = 0;
+    m_discardPending = TRUE;
+}
+
+// Shared quad index buffer
+HRESULT CHInternal::QuadIndexBuffer::Initialize()
+{
+    Cleanup();
+
+    DWORD indexCount = CH_QUAD_INDEX_MAX * 6;
+    WORD* indices = new WORD[indexCount];
+    for (DWORD i = 0; i < CH_QUAD_INDEX_MAX; i++)
+    {
+        WORD vertex = static_cast<WORD>(i * 4);
+        WORD* quad = indices + i * 6;
+
+        // Same two triangles as a 4-vertex strip
+        quad[0] = vertex;
+        quad[1] = vertex + 1;
+        quad[2] = vertex + 2;
+        quad[3] = vertex + 1;
+        quad[4] = vertex + 3;
+        quad[5] = vertex + 2;
+    }
+
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
+    bufferDesc.ByteWidth = sizeof(WORD) * indexCount;
+    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+
+    D3D11_SUBRESOURCE_DATA initData = {};
+    initData.pSysMem = indices;
+
+    HRESULT hr = CHBackendInternal::CreateBuffer(&bufferDesc, &initData, m_buffer.GetAddressOf());
+    delete[] indices;
+    return hr;
+}
+
+void CHInternal::QuadIndexBuffer::Bind()
+{
+    g_D3DContext->IASetIndexBuffer(m_buffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+}
+
+void CHInternal::QuadIndexBuffer::DrawQuads(UINT quadCount, UINT baseVertex)
+{
+    g_RenderStateManager.CommitStates();
+
+    // Indices are relative, so each chunk just moves the base vertex on
+    while (quadCount > 0)
+    {
+        UINT chunk = std::min<UINT>(quadCount, CH_QUAD_INDEX_MAX);
+        CHBackendInternal::DrawIndexed(chunk * 6, 0, baseVertex);
+        quadCount -= chunk;
+        baseVertex += chunk * 4;
+    }
+}
+
+void CHInternal::QuadIndexBuffer::Cleanup()
+{
+    m_buffer.Reset();
+}
+
+// Shader constants by update frequency
+
+// An object slot is 16 constants, the offset granularity of VSSetConstantBuffers1
+#define CH_OBJECT_SLOT_CONSTANTS    16
+#define CH_OBJECT_SLOT_BYTES        (CH_OBJECT_SLOT_CONSTANTS * 16)
+
+HRESULT CHInternal::ConstantBufferManager::Initialize()
+{
+    Cleanup();
+
+    D3D11_BUFFER_DESC bufferDesc = {};
+    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    bufferDesc.ByteWidth = sizeof(XMFLOAT4X4) * 2; // View, Projection
+    HRESULT hr = CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, m_frameBuffer.GetAddressOf());
+    if (FAILED(hr))
+        return hr;
+
+    bufferDesc.ByteWidth = sizeof(XMFLOAT4); // MaterialColor
+    hr = CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, m_materialBuffer.GetAddressOf());
+    if (FAILED(hr))
+        return hr;
+
+    // The object ring needs offset binding and NO_OVERWRITE maps of constant buffers (D3D11.1)
+    D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+    if (SUCCEEDED(g_D3DDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+        options.ConstantBufferOffsetting && options.MapNoOverwriteOnDynamicConstantBuffer)
+    {
+        g_D3DContext->QueryInterface(__uuidof(ID3D11DeviceContext1), reinterpret_cast<void**>(m_context1.GetAddressOf()));
+    }
+
+    m_slots = m_context1 ? CH_OBJECT_CB_SLOTS : 1;
+    bufferDesc.ByteWidth = m_slots * CH_OBJECT_SLOT_BYTES;
+    hr = CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, m_objectBuffer.GetAddressOf());
+    if (FAILED(hr))
+        return hr;
+
+    // Nothing is tinted until a material says so
+    if (!WriteMaterial(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f)))
+        return E_FAIL;
+
+    Bind();
+    return S_OK;
+}
+
+void CHInternal::ConstantBufferManager::Bind()
+{
+    if (!m_frameBuffer)
+        return;
+
+    g_D3DContext->VSSetConstantBuffers(0, 1, m_frameBuffer.GetAddressOf());
+    if (m_context1)
+    {
+        UINT firstConstant = m_boundSlot * CH_OBJECT_SLOT_CONSTANTS;
+        UINT numConstants = CH_OBJECT_SLOT_CONSTANTS;
+        m_context1->VSSetConstantBuffers1(1, 1, m_objectBuffer.GetAddressOf(), &firstConstant, &numConstants);
+    }
+    else
+    {
+        g_D3DContext->VSSetConstantBuffers(1, 1, m_objectBuffer.GetAddressOf());
+    }
+    g_D3DContext->PSSetConstantBuffers(2, 1, m_materialBuffer.GetAddressOf());
+}
+
+void CHInternal::ConstantBufferManager::BeginFrame()
+{
+    // Object slots written last frame are dropped by the next allocation's discard
+    m_nextSlot = 0;
+    m_discardPending = TRUE;
+
+    m_lastFrameUploads = m_frameUploads;
+    m_lastObjectUploads = m_objectUploads;
+    m_lastMaterialUploads = m_materialUploads;
+    m_frameUploads = 0;
+    m_objectUploads = 0;
+    m_materialUploads = 0;
+}
+
+void CHInternal::ConstantBufferManager::UpdateFrame()
+{
+    if (!m_frameBuffer)
+        return;
+
+    XMFLOAT4X4 view, proj;
+    XMStoreFloat4x4(&view, g_ViewMatrix);
+    XMStoreFloat4x4(&proj, g_ProjectMatrix);
+
+    // The camera usually changes once per frame, not once per draw
+    if (m_frameValid && memcmp(&view, &m_view, sizeof(view)) == 0 && memcmp(&proj, &m_proj, sizeof(proj)) == 0)
+        return;
+
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    if (FAILED(CHBackendInternal::Map(m_frameBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, &mappedResource)))
+        return;
+
+    XMMATRIX* matrices = reinterpret_cast<XMMATRIX*>(mappedResource.pData);
+    matrices[0] = XMMatrixTranspose(g_ViewMatrix);
+    matrices[1] = XMMatrixTranspose(g_ProjectMatrix);
+    g_D3DContext->Unmap(m_frameBuffer.Get(), 0);
+
+    m_view = view;
+    m_proj = proj;
+    m_frameValid = TRUE;
+    m_frameUploads++;
+}
+
+void CHInternal::ConstantBufferManager::SetObject(const XMMATRIX& world)
+{
+    UpdateFrame();
+
+    XMFLOAT4X4 value;
+    XMStoreFloat4x4(&value, world);
+    if (m_worldValid && memcmp(&value, &m_world, sizeof(value)) == 0)
+        return;
+
+    if (m_context1)
+    {
+        UINT slot = 0;
+        if (!WriteObjects(&value, 1, &slot))
+            return;
+        BindObject(slot);
+    }
+    else
+    {
+        D3D11_MAPPED_SUBRESOURCE mappedResource;
+        if (FAILED(CHBackendInternal::Map(m_objectBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, &mappedResource)))
+            return;
+
+        *reinterpret_cast<XMMATRIX*>(mappedResource.pData) = XMMatrixTranspose(world);
+        g_D3DContext->Unmap(m_objectBuffer.Get(), 0);
+        m_objectUploads++;
+    }
+
+    m_world = value;
+    m_worldValid = TRUE;
+}
+
+BOOL CHInternal::ConstantBufferManager::WriteObjects(const XMFLOAT4X4* worlds, UINT count, UINT* firstSlot)
+{
+    if (!m_context1 || !worlds || count == 0 || count > m_slots)
+        return FALSE;
+
+    UINT start = m_nextSlot;
+    if (m_discardPending || start + count > m_slots)
+    {
+        // New frame, or this frame overflowed: rename the buffer
+        start = 0;
+        m_discardPending = TRUE;
+    }
+
+    D3D11_MAP mapType = m_discardPending ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE;
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    if (FAILED(CHBackendInternal::Map(m_objectBuffer.Get(), 0, mapType, &mappedResource)))
+        return FALSE;
+
+    BYTE* dest = static_cast<BYTE*>(mappedResource.pData) + start * CH_OBJECT_SLOT_BYTES;
+    for (UINT i = 0; i < count; i++)
+    {
+        XMMATRIX world = XMLoadFloat4x4(&worlds[i]);
+        *reinterpret_cast<XMMATRIX*>(dest + i * CH_OBJECT_SLOT_BYTES) = XMMatrixTranspose(world);
+    }
+    g_D3DContext->Unmap(m_objectBuffer.Get(), 0);
+
+    if (m_discardPending)
+    {
+        // The bound slot's contents went with the old buffer
+        m_discardPending = FALSE;
+        m_worldValid = FALSE;
+    }
+
+    m_nextSlot = start + count;
+    m_objectUploads += count;
+    *firstSlot = start;
+    return TRUE;
+}
+
+void CHInternal::ConstantBufferManager::BindObject(UINT slot)
+{
+    if (!m_context1 || slot >= m_slots)
+        return;
+
+    UpdateFrame();
+
+    UINT firstConstant = slot * CH_OBJECT_SLOT_CONSTANTS;
+    UINT numConstants = CH_OBJECT_SLOT_CONSTANTS;
+    m_context1->VSSetConstantBuffers1(1, 1, m_objectBuffer.GetAddressOf(), &firstConstant, &numConstants);
+
+    // SetObject can't compare against a slot it didn't write
+    m_boundSlot = slot;
+    m_worldValid = FALSE;
+}
+
+void CHInternal::ConstantBufferManager::SetMaterial(const XMFLOAT4& color)
+{
+    if (m_materialValid && memcmp(&color, &m_material, sizeof(color)) == 0)
+        return;
+
+    WriteMaterial(color);
+}
+
+BOOL CHInternal::ConstantBufferManager::WriteMaterial(const XMFLOAT4& color)
+{
+    D3D11_MAPPED_SUBRESOURCE mappedResource;
+    if (!m_materialBuffer ||
+        FAILED(CHBackendInternal::Map(m_materialBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, &mappedResource)))
+        return FALSE;
+
+    *reinterpret_cast<XMFLOAT4*>(mappedResource.pData) = color;
+    g_D3DContext->Unmap(m_materialBuffer.Get(), 0);
+
+    m_material = color;
+    m_materialValid = TRUE;
+    m_materialUploads++;
+    return TRUE;
+}
+
+void CHInternal::ConstantBufferManager::GetStats(DWORD* frameUploads, DWORD* objectUploads, DWORD* materialUploads) const
+{
+    if (frameUploads)
+        *frameUploads = m_lastFrameUploads;
+    if (objectUploads)
+        *objectUploads = m_lastObjectUploads;
+    if (materialUploads)
+        *materialUploads = m_lastMaterialUploads;
+}
+
+void CHInternal::ConstantBufferManager::Cleanup()
+{
+    m_frameBuffer.Reset();
+    m_objectBuffer.Reset();
+    m_materialBuffer.Reset();
+    m_context1.Reset();
+    m_slots = 0;
+    m_nextSlot = 0;
+    m_boundSlot = 0;
+    m_discardPending = TRUE;
+    m_frameValid = FALSE;
+    m_worldValid = FALSE;
+    m_materialValid = FALSE;
+    m_frameUploads = 0;
+    m_objectUploads = 0;
+    m_materialUploads = 0;
+    m_lastFrameUploads = 0;
+    m_lastObjectUploads = 0;
+    m_lastMaterialUploads = 0;
+}
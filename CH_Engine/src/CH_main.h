@@ -14,6 +14,7 @@
 #include <d3dcompiler.h>
 #include <DirectXMath.h>
 #include <algorithm>
+#include <unordered_map>
 #include <ole2.h>  // For HRESULT definition
 #include "CH_common.h"
 
@@ -131,6 +132,15 @@ void SetTextureStageState(DWORD dwStage,
 CH_CORE_DLL_API
 BOOL SetTexture(DWORD dwStage, ID3D11ShaderResourceView* lpTex);
 
+// Render state traffic of the last frame: SetRenderState/SetTextureStageState
+// calls, state objects actually bound, and unique state objects created
+CH_CORE_DLL_API
+void GetRenderStateStats(DWORD* lpRequested, DWORD* lpApplied, DWORD* lpObjects);
+
+// Shader constant uploads of the last frame, per update frequency
+CH_CORE_DLL_API
+void GetConstantBufferStats(DWORD* lpFrame, DWORD* lpObject, DWORD* lpMaterial);
+
 // Frame rate calculation functions (maintaining exact same interface)
 CH_CORE_DLL_API
 DWORD CalcRate();
@@ -138,8 +148,50 @@ DWORD CalcRate();
 CH_CORE_DLL_API
 BOOL LimitRate(DWORD dwRate);
 
+// Size of the shared dynamic vertex ring (bytes)
+#define CH_DYNAMIC_VB_SIZE  (4 * 1024 * 1024)
+
+// Quads covered by the shared quad index buffer (16-bit indices)
+#define CH_QUAD_INDEX_MAX   16384
+
+// Per-object constant slots in the object ring (256 bytes each)
+#define CH_OBJECT_CB_SLOTS  4096
+
 // Internal DirectX 11 specific functionality
 namespace CHInternal {
+    // Immutable D3D11 state objects, created once per unique descriptor.
+    // Descriptors must be fully zeroed before filling (keys compare bytes).
+    class StateObjectCache {
+    private:
+        template <typename Desc>
+        struct DescKey {
+            Desc desc;
+            bool operator==(const DescKey& other) const { return memcmp(&desc, &other.desc, sizeof(Desc)) == 0; }
+        };
+
+        template <typename Desc>
+        struct DescHash {
+            size_t operator()(const DescKey<Desc>& key) const;
+        };
+
+        template <typename Desc, typename State>
+        using StateMap = std::unordered_map<DescKey<Desc>, CHComPtr<State>, DescHash<Desc>>;
+
+        StateMap<D3D11_RASTERIZER_DESC, ID3D11RasterizerState> m_rasterizerStates;
+        StateMap<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState> m_depthStencilStates;
+        StateMap<D3D11_BLEND_DESC, ID3D11BlendState> m_blendStates;
+        StateMap<D3D11_SAMPLER_DESC, ID3D11SamplerState> m_samplerStates;
+        DWORD m_creations = 0;
+
+    public:
+        ID3D11RasterizerState* GetRasterizerState(const D3D11_RASTERIZER_DESC& desc);
+        ID3D11DepthStencilState* GetDepthStencilState(const D3D11_DEPTH_STENCIL_DESC& desc);
+        ID3D11BlendState* GetBlendState(const D3D11_BLEND_DESC& desc);
+        ID3D11SamplerState* GetSamplerState(const D3D11_SAMPLER_DESC& desc);
+        void GetStats(DWORD* objects, DWORD* creations) const;
+        void Cleanup();
+    };
+
     // Render state management
     class RenderStateManager {
     private:
@@ -150,6 +202,27 @@ namespace CHInternal {
 
         RenderState m_currentState;
 
+        // State blocks changed since the last CommitStates
+        enum : DWORD {
+            DIRTY_RASTERIZER   = 0x01,
+            DIRTY_DEPTHSTENCIL = 0x02,
+            DIRTY_BLEND        = 0x04,
+        };
+        DWORD m_dwDirty;
+        DWORD m_dwDirtySamplers;            // One bit per texture stage
+
+        // State objects last bound (rebinding is skipped when unchanged);
+        // nullptr matches the defaults of a freshly created context
+        ID3D11RasterizerState* m_boundRasterizer;
+        ID3D11DepthStencilState* m_boundDepthStencil;
+        UINT m_boundStencilRef;
+        ID3D11BlendState* m_boundBlend;
+        ID3D11SamplerState* m_boundSamplers[8];
+
+        // Counters (current frame, last frame)
+        DWORD m_dwRequested, m_dwApplied;
+        DWORD m_dwLastRequested, m_dwLastApplied;
+
         // State conversion helpers
         D3D11_BLEND ConvertBlendMode(DWORD chBlend);
         D3D11_STENCIL_OP ConvertStencilOp(DWORD chStencilOp);
@@ -162,6 +235,15 @@ namespace CHInternal {
         void SetTextureStageState(DWORD stage, CHTextureStageStateType type, DWORD value);
         void ApplyStates();
         void Reset();
+
+        // Pre-draw hook: binds the dirty state blocks; every draw path calls it
+        void CommitStates() { if (m_dwDirty || m_dwDirtySamplers) ApplyStates(); }
+
+        // A shader manager bound its own sampler to the stage
+        void SetBoundSampler(DWORD stage, ID3D11SamplerState* sampler);
+
+        void BeginFrame();
+        void GetStats(DWORD* requested, DWORD* applied) const;
     };
 
     extern RenderStateManager g_RenderStateManager;
@@ -173,14 +255,113 @@ namespace CHInternal {
         CHComPtr<ID3D11PixelShader> m_defaultPixelShader;
         CHComPtr<ID3D11PixelShader> m_simplePixelShader;
         CHComPtr<ID3D11InputLayout> m_defaultInputLayout;
-        CHComPtr<ID3D11Buffer> m_constantBuffer;
+        CHComPtr<ID3D11VertexShader> m_instancedVertexShader;
+        CHComPtr<ID3D11InputLayout> m_instancedInputLayout;
         CHComPtr<ID3D11SamplerState> m_defaultSampler;
 
     public:
         HRESULT Initialize();
         void SetDefaultShaders();
         void SetLightmapShaders();
-        void UpdateConstantBuffer(const XMMATRIX& world, const XMMATRIX& view, const XMMATRIX& proj);
+        void SetInstancedShaders();
+        void Cleanup();
+    };
+
+    // Shared dynamic vertex ring: producers sub-allocate with NO_OVERWRITE
+    // and draw with a base vertex; the buffer is discarded once per frame
+    // (or when a frame overflows it). Allocations stay valid while the
+    // generation they were made in is current.
+    class DynamicVertexRing {
+    private:
+        CHComPtr<ID3D11Buffer> m_buffer;
+        UINT m_capacity;            // Bytes
+        UINT m_offset;              // Next free byte
+        DWORD m_generation;         // Bumped on every discard
+        BOOL m_discardPending;      // Next lock starts a new frame
+        BOOL m_locked;
+
+        // Statistics (reset by BeginFrame)
+        DWORD m_locks;
+        DWORD m_discards;
+
+    public:
+        HRESULT Initialize(UINT capacity);
+        void BeginFrame();
+        void* Lock(UINT vertexCount, UINT stride, UINT* baseVertex, DWORD* generation);
+        void Unlock();
+        BOOL Write(const void* vertices, UINT vertexCount, UINT stride, UINT* baseVertex, DWORD* generation);
+        BOOL IsValid(DWORD generation) const { return generation != 0 && generation == m_generation; }
+        void Bind(UINT stride, UINT slot = 0);
+        void GetStats(DWORD* locks, DWORD* discards) const;
+        void Cleanup();
+    };
+
+    // Shared immutable index buffer for quads (0,1,2 / 1,3,2 per 4 vertices).
+    // Particles, sprites and text draw with it at a ring base vertex;
+    // larger batches are split into CH_QUAD_INDEX_MAX chunks.
+    class QuadIndexBuffer {
+    private:
+        CHComPtr<ID3D11Buffer> m_buffer;
+
+    public:
+        HRESULT Initialize();
+        void Bind();
+        void DrawQuads(UINT quadCount, UINT baseVertex);
+        void Cleanup();
+    };
+
+    // Shader constants split by update frequency:
+    //   b0 per-frame    View, Projection    uploaded when the camera changed
+    //   b1 per-object   World               one 256-byte slot per object
+    //   b2 per-material MaterialColor (PS)  uploaded when the value changed
+    // With D3D11.1 constant buffer offsets, object slots are sub-allocated
+    // from one ring with NO_OVERWRITE and bound by offset (discarded once
+    // per frame). Otherwise a single slot is rewritten with DISCARD and an
+    // unchanged world is not uploaded again.
+    class ConstantBufferManager {
+    private:
+        CHComPtr<ID3D11Buffer> m_frameBuffer;
+        CHComPtr<ID3D11Buffer> m_objectBuffer;
+        CHComPtr<ID3D11Buffer> m_materialBuffer;
+        CHComPtr<ID3D11DeviceContext1> m_context1;  // Null when offsets aren't supported
+        UINT m_slots;               // Object slots in m_objectBuffer
+        UINT m_nextSlot;
+        UINT m_boundSlot;           // Slot bound at b1
+        BOOL m_discardPending;      // Next allocation starts a new frame
+
+        // Last uploaded values (valid flags cleared by Cleanup)
+        XMFLOAT4X4 m_view;
+        XMFLOAT4X4 m_proj;
+        XMFLOAT4X4 m_world;
+        XMFLOAT4 m_material;
+        BOOL m_frameValid;
+        BOOL m_worldValid;
+        BOOL m_materialValid;
+
+        // Statistics (reset by BeginFrame)
+        DWORD m_frameUploads;
+        DWORD m_objectUploads;
+        DWORD m_materialUploads;
+        DWORD m_lastFrameUploads;
+        DWORD m_lastObjectUploads;
+        DWORD m_lastMaterialUploads;
+
+        BOOL WriteMaterial(const XMFLOAT4& color);
+
+    public:
+        HRESULT Initialize();
+        void Bind();
+        void BeginFrame();
+        void UpdateFrame();
+        void SetObject(const XMMATRIX& world);
+        void SetMaterial(const XMFLOAT4& color);
+
+        // Ring only: upload count worlds to consecutive slots, then bind them one by one
+        BOOL IsRing() const { return m_context1 ? TRUE : FALSE; }
+        BOOL WriteObjects(const XMFLOAT4X4* worlds, UINT count, UINT* firstSlot);
+        void BindObject(UINT slot);
+
+        void GetStats(DWORD* frameUploads, DWORD* objectUploads, DWORD* materialUploads) const;
         void Cleanup();
     };
 
@@ -254,8 +435,12 @@ namespace CHInternal {
     typedef CH_D3DCAPS8 D3DCAPS8;
 
     // Global variables for internal use
+    extern StateObjectCache g_StateObjectCache;
     extern RenderStateManager g_RenderStateManager;
     extern CompatibilityShaderManager g_CompatibilityShaderManager;
+    extern DynamicVertexRing g_DynamicVertexRing;
+    extern QuadIndexBuffer g_QuadIndexBuffer;
+    extern ConstantBufferManager g_ConstantBuffers;
 }
 
 // Physics internal namespace
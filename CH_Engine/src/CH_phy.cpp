@@ -3,6 +3,9 @@
 using namespace DirectX;
 #include "CH_phy.h"
 #include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_instance.h"
+#include "CH_backend.h"
 #include "CH_texture.h"
 #include <algorithm>
 #include <algorithm> // for std::min
@@ -17,13 +20,23 @@ void Motion_Clear(CHMotion* lpMotion)
     if (!lpMotion)
         return;
 
-    delete[] lpMotion->lpKeyFrame;
+    // Keyframes still borrowed by instances must not be freed: refuse until
+    // the last instance is unloaded
+    if (!lpMotion->lpSource && lpMotion->dwRefCount > 1)
+        return;
+
+    // Instances borrow their keyframes from the source motion and hold a reference on it
+    if (lpMotion->lpSource)
+        CHPhyInternal::ReleaseMotion(lpMotion->lpSource);
+    else
+        delete[] lpMotion->lpKeyFrame;
     delete[] lpMotion->matrix;
     delete[] lpMotion->lpMorph;
 
     lpMotion->lpKeyFrame = nullptr;
     lpMotion->matrix = nullptr;
     lpMotion->lpMorph = nullptr;
+    lpMotion->lpSource = nullptr;
     lpMotion->dwBoneCount = 0;
     lpMotion->dwFrames = 0;
     lpMotion->dwKeyFrames = 0;
@@ -36,7 +49,7 @@ BOOL Motion_Load(CHMotion** lpMotion, FILE* file)
     if (!lpMotion || !file)
         return FALSE;
 
-    *lpMotion = new CHMotion;
+    *lpMotion = new CHMotion();
     Motion_Clear(*lpMotion);
 
     // Read motion header
@@ -81,6 +94,7 @@ BOOL Motion_Load(CHMotion** lpMotion, FILE* file)
     }
 
     fread(&(*lpMotion)->nFrame, sizeof(int), 1, file);
+    (*lpMotion)->dwRefCount = 1;
 
     return TRUE;
 }
@@ -90,7 +104,7 @@ BOOL Motion_LoadPack(CHMotion** lpMotion, HANDLE f)
     if (!lpMotion || f == INVALID_HANDLE_VALUE)
         return FALSE;
 
-    *lpMotion = new CHMotion;
+    *lpMotion = new CHMotion();
     Motion_Clear(*lpMotion);
 
     DWORD bytesRead;
@@ -136,6 +150,45 @@ BOOL Motion_LoadPack(CHMotion** lpMotion, HANDLE f)
     }
 
     ReadFile(f, &(*lpMotion)->nFrame, sizeof(int), &bytesRead, nullptr);
+    (*lpMotion)->dwRefCount = 1;
+
+    return TRUE;
+}
+
+BOOL Motion_CreateInstance(CHMotion** lpMotion, CHMotion* lpSource)
+{
+    if (!lpMotion || !lpSource)
+        return FALSE;
+
+    *lpMotion = new CHMotion();
+    Motion_Clear(*lpMotion);
+
+    // Keyframes are shared with the source motion, kept alive by the reference
+    (*lpMotion)->lpSource = lpSource;
+    (*lpMotion)->dwRefCount = 1;
+    lpSource->dwRefCount++;
+    (*lpMotion)->dwBoneCount = lpSource->dwBoneCount;
+    (*lpMotion)->dwFrames = lpSource->dwFrames;
+    (*lpMotion)->dwKeyFrames = lpSource->dwKeyFrames;
+    (*lpMotion)->lpKeyFrame = lpSource->lpKeyFrame;
+    (*lpMotion)->nFrame = 0;
+
+    // Bone matrices are per-instance overrides (Phy_Muliply), start from the source's pose
+    if ((*lpMotion)->dwBoneCount > 0)
+    {
+        (*lpMotion)->matrix = new XMMATRIX[(*lpMotion)->dwBoneCount];
+        for (DWORD i = 0; i < (*lpMotion)->dwBoneCount; i++)
+        {
+            (*lpMotion)->matrix[i] = lpSource->matrix ? lpSource->matrix[i] : XMMatrixIdentity();
+        }
+    }
+
+    (*lpMotion)->dwMorphCount = lpSource->dwMorphCount;
+    if (lpSource->dwMorphCount > 0 && lpSource->lpMorph)
+    {
+        (*lpMotion)->lpMorph = new float[lpSource->dwMorphCount];
+        memcpy((*lpMotion)->lpMorph, lpSource->lpMorph, sizeof(float) * lpSource->dwMorphCount);
+    }
 
     return TRUE;
 }
@@ -145,16 +198,31 @@ void Phy_Clear(CHPhy* lpPhy)
     if (!lpPhy)
         return;
 
-    delete[] lpPhy->lpName;
-    delete[] lpPhy->lpVB;
-    delete[] lpPhy->lpIB;
+    // Instances alias the template's mesh arrays, only drop the reference
+    if (lpPhy->lpTemplate)
+    {
+        CHPhyInternal::ReleaseTemplate(lpPhy->lpTemplate);
+        lpPhy->lpTemplate = nullptr;
+    }
+    else
+    {
+        delete[] lpPhy->lpName;
+        delete[] lpPhy->lpCompactVB;
+        delete[] lpPhy->lpMorphDelta;
+        delete[] lpPhy->lpIB;
+        delete[] lpPhy->lpTexName;
+    }
     delete[] lpPhy->lpOutVB;
-    delete[] lpPhy->lpTexName;
+    delete[] lpPhy->lpBonePalette;
 
     lpPhy->lpName = nullptr;
-    lpPhy->lpVB = nullptr;
+    lpPhy->lpCompactVB = nullptr;
+    lpPhy->lpMorphDelta = nullptr;
     lpPhy->lpIB = nullptr;
     lpPhy->lpOutVB = nullptr;
+    lpPhy->lpBonePalette = nullptr;
+    lpPhy->dwPaletteSize = 0;
+    lpPhy->lpBlend = nullptr;
     lpPhy->lpTexName = nullptr;
 
     if (lpPhy->lpMotion)
@@ -170,6 +238,7 @@ void Phy_Clear(CHPhy* lpPhy)
     lpPhy->dwAVecCount = 0;
     lpPhy->dwNTriCount = 0;
     lpPhy->dwATriCount = 0;
+    memset(lpPhy->dwMorphDeltaStart, 0, sizeof(lpPhy->dwMorphDeltaStart));
     lpPhy->nTex = -1;
     lpPhy->nTex2 = -1;
     lpPhy->bDraw = TRUE;
@@ -184,7 +253,9 @@ void Phy_Clear(CHPhy* lpPhy)
     lpPhy->bboxMax = XMVectorZero();
     lpPhy->normalVertexStride = sizeof(CHPhyOutVertex);
     lpPhy->alphaVertexStride = sizeof(CHPhyOutVertex);
-    lpPhy->vertexOffset = 0;
+    lpPhy->normalBaseVertex = 0;
+    lpPhy->alphaBaseVertex = 0;
+    lpPhy->dwRingGeneration = 0;
 }
 
 BOOL Phy_Load(CHPhy** lpPhy, FILE* file, BOOL bTex)
@@ -192,7 +263,7 @@ BOOL Phy_Load(CHPhy** lpPhy, FILE* file, BOOL bTex)
     if (!lpPhy || !file)
         return FALSE;
 
-    *lpPhy = new CHPhy;
+    *lpPhy = new CHPhy();
     Phy_Clear(*lpPhy);
 
     // Read version
@@ -234,8 +305,16 @@ BOOL Phy_Load(CHPhy** lpPhy, FILE* file, BOOL bTex)
             DWORD totalVerts = (*lpPhy)->dwNVecCount + (*lpPhy)->dwAVecCount;
             if (totalVerts > 0)
             {
-                (*lpPhy)->lpVB = new CHPhyVertex[totalVerts];
-                fread((*lpPhy)->lpVB, sizeof(CHPhyVertex), totalVerts, file);
+                CHPhyVertex* srcVerts = new CHPhyVertex[totalVerts];
+                fread(srcVerts, sizeof(CHPhyVertex), totalVerts, file);
+                BOOL built = CHPhyInternal::BuildCompactVertices(*lpPhy, srcVerts, totalVerts);
+                delete[] srcVerts;
+
+                if (!built)
+                {
+                    Phy_Unload(lpPhy);
+                    return FALSE;
+                }
             }
 
             // Read indices
@@ -275,7 +354,6 @@ BOOL Phy_Load(CHPhy** lpPhy, FILE* file, BOOL bTex)
             (*lpPhy)->lpOutVB = new CHPhyOutVertex[totalVerts];
 
             // Create DirectX 11 buffers
-            CHPhyInternal::CreateVertexBuffers(*lpPhy);
             CHPhyInternal::CreateIndexBuffers(*lpPhy);
             CHPhyInternal::CreateBoneMatrixBuffer(*lpPhy);
 
@@ -295,33 +373,84 @@ BOOL Phy_Calculate(CHPhy* lpPhy)
     if (!lpPhy || !lpPhy->lpMotion)
         return FALSE;
 
-    // Process animation keys
-    float alpha;
-    if (Key_ProcessAlpha(&lpPhy->Key, lpPhy->lpMotion->nFrame,
-        lpPhy->lpMotion->dwFrames, &alpha))
-        lpPhy->fA = alpha;
-
-    BOOL draw;
-    if (Key_ProcessDraw(&lpPhy->Key, lpPhy->lpMotion->nFrame, &draw))
-        lpPhy->bDraw = draw;
-
-    int tex = -1;
-    Key_ProcessChangeTex(&lpPhy->Key, lpPhy->lpMotion->nFrame, &tex);
-
-    if (!lpPhy->bDraw)
+    if (!CHPhyInternal::ProcessPhyKeys(lpPhy))
         return TRUE;
 
     // Process skeletal animation
-    CHPhyInternal::ProcessMotionKeyframes(lpPhy->lpMotion);
+    CHPhyInternal::BuildBonePalette(lpPhy);
     CHPhyInternal::ProcessVertexBlending(lpPhy);
-    CHPhyInternal::UpdateVertexBuffer(lpPhy, false); // Normal vertices
-    CHPhyInternal::UpdateVertexBuffer(lpPhy, true);  // Alpha vertices
+    CHPhyInternal::UpdateVertexBuffer(lpPhy);
 
     return TRUE;
 }
 
+BOOL Phy_CalculateBatch(CHPhy** lpPhy, DWORD dwCount)
+{
+    if (!lpPhy || dwCount == 0)
+        return FALSE;
+
+    // Gather lists are kept between calls to avoid per-frame allocation
+    // (per thread, so batches can be calculated on several threads)
+    static thread_local std::vector<CHMotionBlend*> blends;
+    static thread_local std::vector<XMMATRIX*> accums;
+    static thread_local std::vector<CHAffine*> palettes;
+    static thread_local std::vector<DWORD> boneCounts;
+    blends.clear();
+    accums.clear();
+    palettes.clear();
+    boneCounts.clear();
+
+    // Keys first, then every blended object's palette in one pass
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHPhy* phy = lpPhy[i];
+        if (!phy || !phy->lpMotion || !CHPhyInternal::ProcessPhyKeys(phy))
+            continue;
+
+        if (phy->lpBlend && CHPhyInternal::EnsureBonePalette(phy))
+        {
+            blends.push_back(phy->lpBlend);
+            accums.push_back(phy->lpMotion->matrix);
+            palettes.push_back(phy->lpBonePalette);
+            boneCounts.push_back(phy->dwPaletteSize);
+        }
+        else
+        {
+            CHPhyInternal::BuildBonePalette(phy);
+        }
+    }
+
+    if (!blends.empty())
+    {
+        MotionBlend_EvaluateBatch(blends.data(), accums.data(), palettes.data(),
+            boneCounts.data(), static_cast<DWORD>(blends.size()));
+    }
+
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHPhy* phy = lpPhy[i];
+        if (!phy || !phy->lpMotion || !phy->bDraw)
+            continue;
+
+        CHPhyInternal::ProcessVertexBlending(phy);
+        CHPhyInternal::UpdateVertexBuffer(phy);
+    }
+
+    return TRUE;
+}
+
+void Phy_SetMotionBlend(CHPhy* lpPhy, CHMotionBlend* lpBlend)
+{
+    if (!lpPhy)
+        return;
+
+    lpPhy->lpBlend = lpBlend;
+}
+
 BOOL Phy_DrawNormal(CHPhy* lpPhy)
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     if (!lpPhy || !lpPhy->bDraw || lpPhy->dwNTriCount == 0)
         return FALSE;
 
@@ -330,6 +459,9 @@ BOOL Phy_DrawNormal(CHPhy* lpPhy)
 
 BOOL Phy_DrawAlpha(CHPhy* lpPhy, BOOL bZ, int nAsb, int nAdb)
 {
+    CHInstanceInternal::FlushPending();
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     if (!lpPhy || !lpPhy->bDraw || lpPhy->dwATriCount == 0)
         return FALSE;
 
@@ -345,6 +477,11 @@ void Phy_NextFrame(CHPhy* lpPhy, int nStep)
     {
         lpPhy->lpMotion->nFrame = (lpPhy->lpMotion->nFrame + nStep) % lpPhy->lpMotion->dwFrames;
     }
+
+    if (lpPhy->lpBlend)
+    {
+        MotionBlend_NextFrame(lpPhy->lpBlend, nStep);
+    }
 }
 
 void Phy_SetFrame(CHPhy* lpPhy, DWORD dwFrame)
@@ -363,29 +500,24 @@ namespace CHPhyInternal {
 
     void ProcessVertexBlending(CHPhy* phy)
     {
-        if (!phy || !phy->lpVB || !phy->lpOutVB || !phy->lpMotion)
+        if (!phy || !phy->lpCompactVB || !phy->lpOutVB || !phy->lpMotion || !phy->lpBonePalette)
             return;
 
         DWORD totalVerts = phy->dwNVecCount + phy->dwAVecCount;
 
+        // Base positions go into the output buffer first, morphs and
+        // skinning then work in place so no scratch array is needed
+        ApplyMorphTargets(phy);
+
+        DWORD boneCount = phy->dwPaletteSize;
+        const float weightScale = 1.0f / CH_PHY_WEIGHT_SCALE;
+
         for (DWORD i = 0; i < totalVerts; i++)
         {
-            CHPhyVertex* srcVert = &phy->lpVB[i];
+            const CHPhyCompactVertex* srcVert = &phy->lpCompactVB[i];
             CHPhyOutVertex* outVert = &phy->lpOutVB[i];
 
-            // Initialize with first morph target
-            XMVECTOR blendedPos = srcVert->pos[0];
-
-            // Apply morph targets if available
-            if (phy->lpMotion->dwMorphCount > 0 && phy->lpMotion->lpMorph)
-            {
-                blendedPos = XMVectorZero();
-                for (DWORD m = 0; m < CH_MORPH_MAX && m < phy->lpMotion->dwMorphCount; m++)
-                {
-                    float weight = (m < phy->lpMotion->dwMorphCount) ? phy->lpMotion->lpMorph[m] : 0.0f;
-                    blendedPos = XMVectorAdd(blendedPos, XMVectorScale(srcVert->pos[m], weight));
-                }
-            }
+            XMVECTOR blendedPos = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(&outVert->x));
 
             // Apply bone transformations
             XMVECTOR finalPos = XMVectorZero();
@@ -393,12 +525,13 @@ namespace CHPhyInternal {
 
             for (DWORD b = 0; b < CH_BONE_MAX; b++)
             {
-                if (srcVert->weight[b] > 0.0f && srcVert->index[b] < phy->lpMotion->dwBoneCount)
+                if (srcVert->weight[b] > 0 && srcVert->index[b] < boneCount)
                 {
-                    XMMATRIX boneMatrix = phy->lpMotion->matrix[srcVert->index[b]];
-                    XMVECTOR transformedPos = XMVector3TransformCoord(blendedPos, boneMatrix);
-                    finalPos = XMVectorAdd(finalPos, XMVectorScale(transformedPos, srcVert->weight[b]));
-                    totalWeight += srcVert->weight[b];
+                    float weight = srcVert->weight[b] * weightScale;
+                    const CHAffine& bone = phy->lpBonePalette[srcVert->index[b]];
+                    XMVECTOR transformedPos = Affine_TransformPoint(bone, blendedPos);
+                    finalPos = XMVectorAdd(finalPos, XMVectorScale(transformedPos, weight));
+                    totalWeight += weight;
                 }
             }
 
@@ -431,105 +564,302 @@ namespace CHPhyInternal {
             b = static_cast<DWORD>(b * phy->fB);
             a = static_cast<DWORD>(a * phy->fA);
 
-                         r = std::min(255UL, r);
-             g = std::min(255UL, g);
-             b = std::min(255UL, b);
-             a = std::min(255UL, a);
+            r = std::min(255UL, r);
+            g = std::min(255UL, g);
+            b = std::min(255UL, b);
+            a = std::min(255UL, a);
 
             outVert->color = (a << 24) | (r << 16) | (g << 8) | b;
         }
     }
 
-    void ProcessMotionKeyframes(CHMotion* motion)
+    void ApplyMorphTargets(CHPhy* phy)
     {
-        if (!motion || !motion->lpKeyFrame || motion->dwKeyFrames == 0)
+        if (!phy || !phy->lpCompactVB || !phy->lpOutVB || !phy->lpMotion)
             return;
 
-        // Find keyframes around current frame
-        int currentFrame = motion->nFrame % motion->dwFrames;
-        CHKeyFrame* prevKeyframe = nullptr;
-        CHKeyFrame* nextKeyframe = nullptr;
+        DWORD totalVerts = phy->dwNVecCount + phy->dwAVecCount;
+        CHMotion* motion = phy->lpMotion;
 
-        for (DWORD i = 0; i < motion->dwKeyFrames; i++)
+        // Without morph weights the base position is used as is
+        if (motion->dwMorphCount == 0 || !motion->lpMorph)
         {
-            if (motion->lpKeyFrame[i].pos <= currentFrame)
+            for (DWORD i = 0; i < totalVerts; i++)
             {
-                prevKeyframe = &motion->lpKeyFrame[i];
+                phy->lpOutVB[i].x = phy->lpCompactVB[i].pos.x;
+                phy->lpOutVB[i].y = phy->lpCompactVB[i].pos.y;
+                phy->lpOutVB[i].z = phy->lpCompactVB[i].pos.z;
+            }
+            return;
+        }
+
+        // sum(w[m] * pos[m]) == base * sum(w[m]) + sum(w[m] * delta[m])
+        DWORD morphCount = std::min(static_cast<DWORD>(CH_MORPH_MAX), motion->dwMorphCount);
+        float weightSum = 0.0f;
+        for (DWORD m = 0; m < morphCount; m++)
+        {
+            weightSum += motion->lpMorph[m];
+        }
+
+        for (DWORD i = 0; i < totalVerts; i++)
+        {
+            phy->lpOutVB[i].x = phy->lpCompactVB[i].pos.x * weightSum;
+            phy->lpOutVB[i].y = phy->lpCompactVB[i].pos.y * weightSum;
+            phy->lpOutVB[i].z = phy->lpCompactVB[i].pos.z * weightSum;
+        }
+
+        if (!phy->lpMorphDelta)
+            return;
+
+        // Target 0 is the base and never has deltas
+        for (DWORD m = 1; m < morphCount; m++)
+        {
+            float weight = motion->lpMorph[m];
+            if (weight == 0.0f)
+                continue;
+
+            for (DWORD d = phy->dwMorphDeltaStart[m]; d < phy->dwMorphDeltaStart[m + 1]; d++)
+            {
+                const CHPhyMorphDelta& delta = phy->lpMorphDelta[d];
+                CHPhyOutVertex& outVert = phy->lpOutVB[delta.dwVertex];
+                outVert.x += delta.delta.x * weight;
+                outVert.y += delta.delta.y * weight;
+                outVert.z += delta.delta.z * weight;
             }
-            if (motion->lpKeyFrame[i].pos > currentFrame && !nextKeyframe)
+        }
+    }
+
+    BOOL BuildCompactVertices(CHPhy* phy, const CHPhyVertex* src, DWORD count)
+    {
+        if (!phy || !src || count == 0)
+            return FALSE;
+
+        // Bone indices are packed into bytes: meshes using more than 256 bones are rejected
+        for (DWORD i = 0; i < count; i++)
+        {
+            for (DWORD b = 0; b < CH_BONE_MAX; b++)
             {
-                nextKeyframe = &motion->lpKeyFrame[i];
-                break;
+                if (src[i].index[b] > 0xFF && src[i].weight[b] > 0.0f)
+                    return FALSE;
             }
         }
 
-        // Apply keyframe transformation to bone matrices
-        if (prevKeyframe && prevKeyframe->matrix)
+        delete[] phy->lpCompactVB;
+        delete[] phy->lpMorphDelta;
+        phy->lpCompactVB = new CHPhyCompactVertex[count];
+        phy->lpMorphDelta = nullptr;
+
+        // Count the non-zero deltas of each target first
+        DWORD deltaCount = 0;
+        phy->dwMorphDeltaStart[0] = 0;
+        phy->dwMorphDeltaStart[1] = 0;
+        for (DWORD m = 1; m < CH_MORPH_MAX; m++)
         {
-            for (DWORD i = 0; i < motion->dwBoneCount; i++)
+            for (DWORD i = 0; i < count; i++)
             {
-                if (nextKeyframe && nextKeyframe->matrix)
+                XMVECTOR delta = XMVectorSubtract(src[i].pos[m], src[i].pos[0]);
+                if (!XMVector3NearEqual(delta, XMVectorZero(), XMVectorReplicate(CH_PHY_MORPH_EPSILON)))
+                    deltaCount++;
+            }
+            phy->dwMorphDeltaStart[m + 1] = deltaCount;
+        }
+
+        if (deltaCount > 0)
+            phy->lpMorphDelta = new CHPhyMorphDelta[deltaCount];
+
+        DWORD d = 0;
+        for (DWORD m = 1; m < CH_MORPH_MAX; m++)
+        {
+            for (DWORD i = 0; i < count; i++)
+            {
+                XMVECTOR delta = XMVectorSubtract(src[i].pos[m], src[i].pos[0]);
+                if (!XMVector3NearEqual(delta, XMVectorZero(), XMVectorReplicate(CH_PHY_MORPH_EPSILON)))
                 {
-                    // Interpolate between keyframes
-                    float t = static_cast<float>(currentFrame - prevKeyframe->pos) /
-                        static_cast<float>(nextKeyframe->pos - prevKeyframe->pos);
-
-                    // Simple linear interpolation (could be improved with quaternion slerp)
-                    XMMATRIX prevMatrix = XMMatrixMultiply(*prevKeyframe->matrix,
-                        XMMatrixScaling(1.0f - t, 1.0f - t, 1.0f - t));
-                    XMMATRIX nextMatrix = XMMatrixMultiply(*nextKeyframe->matrix, 
-                        XMMatrixScaling(t, t, t));
-                    
-                    // Combine matrices (DirectX Math doesn't have XMMatrixAdd)
-                    motion->matrix[i] = XMMatrixMultiply(motion->matrix[i], 
-                        XMMatrixMultiply(prevMatrix, nextMatrix));
+                    phy->lpMorphDelta[d].dwVertex = i;
+                    XMStoreFloat3(&phy->lpMorphDelta[d].delta, delta);
+                    d++;
                 }
-                else
+            }
+        }
+
+        for (DWORD i = 0; i < count; i++)
+        {
+            const CHPhyVertex& srcVert = src[i];
+            CHPhyCompactVertex& dstVert = phy->lpCompactVB[i];
+
+            XMStoreFloat3(&dstVert.pos, srcVert.pos[0]);
+            dstVert.u = srcVert.u;
+            dstVert.v = srcVert.v;
+            dstVert.color = srcVert.color;
+
+            for (DWORD b = 0; b < CH_BONE_MAX; b++)
+            {
+                if (srcVert.weight[b] <= 0.0f)
                 {
-                    // Use single keyframe
-                    motion->matrix[i] = XMMatrixMultiply(motion->matrix[i], *prevKeyframe->matrix);
+                    dstVert.index[b] = 0;
+                    dstVert.weight[b] = 0;
+                    continue;
                 }
+
+                float weight = std::min(1.0f, srcVert.weight[b]);
+                dstVert.index[b] = static_cast<BYTE>(srcVert.index[b]);
+                dstVert.weight[b] = static_cast<WORD>(weight * CH_PHY_WEIGHT_SCALE + 0.5f);
             }
         }
+
+        return TRUE;
     }
 
-    BOOL CreateVertexBuffers(CHPhy* phy)
+    void ExpandCompactVertices(const CHPhy* phy, CHPhyVertex* dst)
     {
-        if (!phy)
-            return FALSE;
+        if (!phy || !phy->lpCompactVB || !dst)
+            return;
 
-        DWORD normalVertCount = phy->dwNVecCount;
-        DWORD alphaVertCount = phy->dwAVecCount;
+        DWORD totalVerts = phy->dwNVecCount + phy->dwAVecCount;
 
-        // Create normal vertex buffer
-        if (normalVertCount > 0)
+        for (DWORD i = 0; i < totalVerts; i++)
         {
-            D3D11_BUFFER_DESC bufferDesc = {};
-            bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-            bufferDesc.ByteWidth = sizeof(CHPhyOutVertex) * normalVertCount;
-            bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-            bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            const CHPhyCompactVertex& srcVert = phy->lpCompactVB[i];
+            CHPhyVertex& dstVert = dst[i];
 
-            if (FAILED(g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, phy->normalVertexBuffer.GetAddressOf())))
-                return FALSE;
+            XMVECTOR basePos = XMLoadFloat3(&srcVert.pos);
+            for (DWORD m = 0; m < CH_MORPH_MAX; m++)
+            {
+                dstVert.pos[m] = basePos;
+            }
+
+            dstVert.u = srcVert.u;
+            dstVert.v = srcVert.v;
+            dstVert.color = srcVert.color;
+
+            for (DWORD b = 0; b < CH_BONE_MAX; b++)
+            {
+                dstVert.index[b] = srcVert.index[b];
+                dstVert.weight[b] = srcVert.weight[b] / CH_PHY_WEIGHT_SCALE;
+            }
         }
 
-        // Create alpha vertex buffer
-        if (alphaVertCount > 0)
+        if (!phy->lpMorphDelta)
+            return;
+
+        for (DWORD m = 1; m < CH_MORPH_MAX; m++)
         {
-            D3D11_BUFFER_DESC bufferDesc = {};
-            bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-            bufferDesc.ByteWidth = sizeof(CHPhyOutVertex) * alphaVertCount;
-            bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-            bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            for (DWORD d = phy->dwMorphDeltaStart[m]; d < phy->dwMorphDeltaStart[m + 1]; d++)
+            {
+                const CHPhyMorphDelta& delta = phy->lpMorphDelta[d];
+                dst[delta.dwVertex].pos[m] = XMVectorAdd(dst[delta.dwVertex].pos[m],
+                    XMLoadFloat3(&delta.delta));
+            }
+        }
+    }
 
-            if (FAILED(g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, phy->alphaVertexBuffer.GetAddressOf())))
-                return FALSE;
+    BOOL ProcessPhyKeys(CHPhy* phy)
+    {
+        // Process animation keys
+        float alpha;
+        if (Key_ProcessAlpha(&phy->Key, phy->lpMotion->nFrame,
+            phy->lpMotion->dwFrames, &alpha))
+            phy->fA = alpha;
+
+        BOOL draw;
+        if (Key_ProcessDraw(&phy->Key, phy->lpMotion->nFrame, &draw))
+            phy->bDraw = draw;
+
+        int tex = -1;
+        Key_ProcessChangeTex(&phy->Key, phy->lpMotion->nFrame, &tex);
+
+        return phy->bDraw;
+    }
+
+    BOOL EvaluateMotionKeyframe(CHMotion* motion, float fFrame, CHAffine* key)
+    {
+        if (!motion || !key || !motion->lpKeyFrame || motion->dwKeyFrames == 0 || motion->dwFrames == 0)
+            return FALSE;
+
+        // Find keyframes around current frame
+        float currentFrame = fmodf(fFrame, static_cast<float>(motion->dwFrames));
+        if (currentFrame < 0.0f)
+            currentFrame += motion->dwFrames;
+
+        CHKeyFrame* prevKeyframe = nullptr;
+        CHKeyFrame* nextKeyframe = nullptr;
+
+        for (DWORD i = 0; i < motion->dwKeyFrames; i++)
+        {
+            if (motion->lpKeyFrame[i].pos <= currentFrame)
+            {
+                prevKeyframe = &motion->lpKeyFrame[i];
+            }
+            else
+            {
+                nextKeyframe = &motion->lpKeyFrame[i];
+                break;
+            }
+        }
+
+        if (!prevKeyframe || !prevKeyframe->matrix)
+            return FALSE;
+
+        *key = Affine_FromMatrix(*prevKeyframe->matrix);
+
+        // Interpolate between keyframes
+        if (nextKeyframe && nextKeyframe->matrix)
+        {
+            float t = (currentFrame - prevKeyframe->pos) /
+                static_cast<float>(nextKeyframe->pos - prevKeyframe->pos);
+            *key = Affine_Blend(*key, Affine_FromMatrix(*nextKeyframe->matrix), t);
         }
 
         return TRUE;
     }
 
+    BOOL EnsureBonePalette(CHPhy* phy)
+    {
+        if (!phy || !phy->lpMotion)
+            return FALSE;
+
+        CHMotion* motion = phy->lpMotion;
+        if (phy->dwPaletteSize != motion->dwBoneCount)
+        {
+            delete[] phy->lpBonePalette;
+            phy->lpBonePalette = motion->dwBoneCount > 0 ? new CHAffine[motion->dwBoneCount] : nullptr;
+            phy->dwPaletteSize = motion->dwBoneCount;
+        }
+
+        return phy->lpBonePalette != nullptr;
+    }
+
+    void BuildBonePalette(CHPhy* phy)
+    {
+        if (!EnsureBonePalette(phy))
+            return;
+
+        CHMotion* motion = phy->lpMotion;
+
+        // Blended objects take the same path as Phy_CalculateBatch
+        if (phy->lpBlend)
+        {
+            XMMATRIX* accum = motion->matrix;
+            MotionBlend_EvaluateBatch(&phy->lpBlend, &accum, &phy->lpBonePalette,
+                &phy->dwPaletteSize, 1);
+            return;
+        }
+
+        if (!motion->matrix)
+            return;
+
+        // The accumulated bone matrices (Phy_Muliply) are left untouched,
+        // the keyframe is composed into the palette only
+        CHAffine key;
+        BOOL hasKey = EvaluateMotionKeyframe(motion, static_cast<float>(motion->nFrame), &key);
+
+        for (DWORD i = 0; i < motion->dwBoneCount; i++)
+        {
+            CHAffine bone = Affine_FromMatrix(motion->matrix[i]);
+            phy->lpBonePalette[i] = hasKey ? Affine_Multiply(bone, key) : bone;
+        }
+    }
+
     BOOL CreateIndexBuffers(CHPhy* phy)
     {
         if (!phy)
@@ -549,7 +879,7 @@ namespace CHPhyInternal {
             D3D11_SUBRESOURCE_DATA initData = {};
             initData.pSysMem = phy->lpIB;
 
-            if (FAILED(g_D3DDevice->CreateBuffer(&bufferDesc, &initData, phy->normalIndexBuffer.GetAddressOf())))
+            if (FAILED(CHBackendInternal::CreateBuffer(&bufferDesc, &initData, phy->normalIndexBuffer.GetAddressOf())))
                 return FALSE;
         }
 
@@ -564,7 +894,7 @@ namespace CHPhyInternal {
             D3D11_SUBRESOURCE_DATA initData = {};
             initData.pSysMem = phy->lpIB + normalIndexCount;
 
-            if (FAILED(g_D3DDevice->CreateBuffer(&bufferDesc, &initData, phy->alphaIndexBuffer.GetAddressOf())))
+            if (FAILED(CHBackendInternal::CreateBuffer(&bufferDesc, &initData, phy->alphaIndexBuffer.GetAddressOf())))
                 return FALSE;
         }
 
@@ -582,27 +912,27 @@ namespace CHPhyInternal {
         bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
         bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 
-        return SUCCEEDED(g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, phy->boneMatrixBuffer.GetAddressOf()));
+        return SUCCEEDED(CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, phy->boneMatrixBuffer.GetAddressOf()));
     }
 
-    void UpdateVertexBuffer(CHPhy* phy, bool isAlpha)
+    BOOL UpdateVertexBuffer(CHPhy* phy)
     {
         if (!phy || !phy->lpOutVB)
-            return;
-
-        CHComPtr<ID3D11Buffer> buffer = isAlpha ? phy->alphaVertexBuffer : phy->normalVertexBuffer;
-        if (!buffer)
-            return;
-
-        DWORD vertCount = isAlpha ? phy->dwAVecCount : phy->dwNVecCount;
-        DWORD vertOffset = isAlpha ? phy->dwNVecCount : 0;
+            return FALSE;
 
-        D3D11_MAPPED_SUBRESOURCE mappedResource;
-        if (SUCCEEDED(g_D3DContext->Map(buffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+        // Normal and alpha vertices are contiguous in lpOutVB, upload them as one block
+        DWORD totalVerts = phy->dwNVecCount + phy->dwAVecCount;
+        UINT baseVertex = 0;
+        if (!CHInternal::g_DynamicVertexRing.Write(phy->lpOutVB, totalVerts, sizeof(CHPhyOutVertex),
+            &baseVertex, &phy->dwRingGeneration))
         {
-            memcpy(mappedResource.pData, phy->lpOutVB + vertOffset, sizeof(CHPhyOutVertex) * vertCount);
-            g_D3DContext->Unmap(buffer.Get(), 0);
+            phy->dwRingGeneration = 0;
+            return FALSE;
         }
+
+        phy->normalBaseVertex = baseVertex;
+        phy->alphaBaseVertex = baseVertex + phy->dwNVecCount;
+        return TRUE;
     }
 
     void ReleaseBuffers(CHPhy* phy)
@@ -610,8 +940,6 @@ namespace CHPhyInternal {
         if (!phy)
             return;
 
-        phy->normalVertexBuffer.Reset();
-        phy->alphaVertexBuffer.Reset();
         phy->normalIndexBuffer.Reset();
         phy->alphaIndexBuffer.Reset();
         phy->boneMatrixBuffer.Reset();
@@ -619,7 +947,11 @@ namespace CHPhyInternal {
 
     BOOL RenderNormalMesh(CHPhy* phy)
     {
-        if (!phy || !phy->normalVertexBuffer || !phy->normalIndexBuffer)
+        if (!phy || !phy->lpOutVB || !phy->normalIndexBuffer)
+            return FALSE;
+
+        // Last upload was discarded with an earlier frame, resubmit it
+        if (!CHInternal::g_DynamicVertexRing.IsValid(phy->dwRingGeneration) && !UpdateVertexBuffer(phy))
             return FALSE;
 
         // Set texture
@@ -634,23 +966,28 @@ namespace CHPhyInternal {
         SetRenderState(CH_RS_ZWRITEENABLE, TRUE);
 
         // Set vertex and index buffers
-        g_D3DContext->IASetVertexBuffers(0, 1, phy->normalVertexBuffer.GetAddressOf(),
-            &phy->normalVertexStride, &phy->vertexOffset);
+        CHInternal::g_DynamicVertexRing.Bind(phy->normalVertexStride);
         g_D3DContext->IASetIndexBuffer(phy->normalIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
         g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        // Set shaders
+        // Set shaders; skinned vertices are already in world space, the color is per material
         g_PhyShaderManager.SetSkeletalShaders();
+        CHInternal::g_ConstantBuffers.SetObject(XMMatrixIdentity());
+        CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(phy->fR, phy->fG, phy->fB, phy->fA));
 
         // Draw
-        g_D3DContext->DrawIndexed(phy->dwNTriCount * 3, 0, 0);
+        CHInternal::g_RenderStateManager.CommitStates();
+        CHBackendInternal::DrawIndexed(phy->dwNTriCount * 3, 0, phy->normalBaseVertex);
 
         return TRUE;
     }
 
     BOOL RenderAlphaMesh(CHPhy* phy, bool enableZ, int srcBlend, int destBlend)
     {
-        if (!phy || !phy->alphaVertexBuffer || !phy->alphaIndexBuffer)
+        if (!phy || !phy->lpOutVB || !phy->alphaIndexBuffer)
+            return FALSE;
+
+        if (!CHInternal::g_DynamicVertexRing.IsValid(phy->dwRingGeneration) && !UpdateVertexBuffer(phy))
             return FALSE;
 
         // Set texture
@@ -666,20 +1003,94 @@ namespace CHPhyInternal {
         SetRenderState(CH_RS_ZWRITEENABLE, enableZ ? TRUE : FALSE);
 
         // Set vertex and index buffers
-        g_D3DContext->IASetVertexBuffers(0, 1, phy->alphaVertexBuffer.GetAddressOf(),
-            &phy->alphaVertexStride, &phy->vertexOffset);
+        CHInternal::g_DynamicVertexRing.Bind(phy->alphaVertexStride);
         g_D3DContext->IASetIndexBuffer(phy->alphaIndexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
         g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
-        // Set shaders
+        // Set shaders; skinned vertices are already in world space, the color is per material
         g_PhyShaderManager.SetSkeletalShaders();
+        CHInternal::g_ConstantBuffers.SetObject(XMMatrixIdentity());
+        CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(phy->fR, phy->fG, phy->fB, phy->fA));
 
         // Draw
-        g_D3DContext->DrawIndexed(phy->dwATriCount * 3, 0, 0);
+        CHInternal::g_RenderStateManager.CommitStates();
+        CHBackendInternal::DrawIndexed(phy->dwATriCount * 3, 0, phy->alphaBaseVertex);
 
         return TRUE;
     }
 
+    BOOL CreateTemplateFromPhy(CHPhyTemplate** tmpl, CHPhy* phy)
+    {
+        if (!tmpl || !phy)
+            return FALSE;
+
+        *tmpl = new CHPhyTemplate();
+        CHPhyTemplate* t = *tmpl;
+
+        // Take ownership of the mesh arrays, phy is unloaded by the caller
+        t->lpName = phy->lpName;
+        t->dwBlendCount = phy->dwBlendCount;
+        t->dwNVecCount = phy->dwNVecCount;
+        t->dwAVecCount = phy->dwAVecCount;
+        t->lpCompactVB = phy->lpCompactVB;
+        t->lpMorphDelta = phy->lpMorphDelta;
+        memcpy(t->dwMorphDeltaStart, phy->dwMorphDeltaStart, sizeof(t->dwMorphDeltaStart));
+        t->dwNTriCount = phy->dwNTriCount;
+        t->dwATriCount = phy->dwATriCount;
+        t->lpIB = phy->lpIB;
+        t->lpTexName = phy->lpTexName;
+        t->nTex = phy->nTex;
+        t->nTex2 = phy->nTex2;
+        t->bboxMin = phy->bboxMin;
+        t->bboxMax = phy->bboxMax;
+        t->InitMatrix = phy->InitMatrix;
+        t->normalIndexBuffer = phy->normalIndexBuffer;
+        t->alphaIndexBuffer = phy->alphaIndexBuffer;
+        t->dwRefCount = 1;
+
+        phy->lpName = nullptr;
+        phy->lpCompactVB = nullptr;
+        phy->lpMorphDelta = nullptr;
+        phy->lpIB = nullptr;
+        phy->lpTexName = nullptr;
+
+        return TRUE;
+    }
+
+    void ReleaseTemplate(CHPhyTemplate* tmpl)
+    {
+        if (!tmpl || tmpl->dwRefCount == 0)
+            return;
+
+        if (--tmpl->dwRefCount > 0)
+            return;
+
+        delete[] tmpl->lpName;
+        delete[] tmpl->lpCompactVB;
+        delete[] tmpl->lpMorphDelta;
+        delete[] tmpl->lpIB;
+        delete[] tmpl->lpTexName;
+        tmpl->normalIndexBuffer.Reset();
+        tmpl->alphaIndexBuffer.Reset();
+        delete tmpl;
+    }
+
+    void ReleaseMotion(CHMotion* motion)
+    {
+        if (!motion)
+            return;
+
+        // Sources stay alive while instances borrow their keyframes
+        if (motion->dwRefCount > 1)
+        {
+            motion->dwRefCount--;
+            return;
+        }
+
+        Motion_Clear(motion);
+        delete motion;
+    }
+
     void SetSkeletalShaders()
     {
         // Use the shader manager's method instead of direct access
@@ -697,8 +1108,7 @@ void Motion_Unload(CHMotion** lpMotion)
     if (!lpMotion || !*lpMotion)
         return;
 
-    Motion_Clear(*lpMotion);
-    delete* lpMotion;
+    CHPhyInternal::ReleaseMotion(*lpMotion);
     *lpMotion = nullptr;
 }
 
@@ -765,7 +1175,7 @@ BOOL Phy_LoadPack(CHPhy** lpPhy, HANDLE f, BOOL bTex)
     if (!lpPhy || f == INVALID_HANDLE_VALUE)
         return FALSE;
 
-    *lpPhy = new CHPhy;
+    *lpPhy = new CHPhy();
     Phy_Clear(*lpPhy);
 
     DWORD bytesRead;
@@ -803,8 +1213,16 @@ BOOL Phy_LoadPack(CHPhy** lpPhy, HANDLE f, BOOL bTex)
     DWORD totalVerts = (*lpPhy)->dwNVecCount + (*lpPhy)->dwAVecCount;
     if (totalVerts > 0)
     {
-        (*lpPhy)->lpVB = new CHPhyVertex[totalVerts];
-        ReadFile(f, (*lpPhy)->lpVB, sizeof(CHPhyVertex) * totalVerts, &bytesRead, nullptr);
+        CHPhyVertex* srcVerts = new CHPhyVertex[totalVerts];
+        ReadFile(f, srcVerts, sizeof(CHPhyVertex) * totalVerts, &bytesRead, nullptr);
+        BOOL built = CHPhyInternal::BuildCompactVertices(*lpPhy, srcVerts, totalVerts);
+        delete[] srcVerts;
+
+        if (!built)
+        {
+            Phy_Unload(lpPhy);
+            return FALSE;
+        }
     }
 
     // Read indices
@@ -844,7 +1262,6 @@ BOOL Phy_LoadPack(CHPhy** lpPhy, HANDLE f, BOOL bTex)
     (*lpPhy)->lpOutVB = new CHPhyOutVertex[totalVerts];
 
     // Create DirectX 11 buffers
-    CHPhyInternal::CreateVertexBuffers(*lpPhy);
     CHPhyInternal::CreateIndexBuffers(*lpPhy);
     CHPhyInternal::CreateBoneMatrixBuffer(*lpPhy);
 
@@ -892,7 +1309,11 @@ BOOL Phy_Save(char* lpName, CHPhy* lpPhy, BOOL bNew)
     DWORD totalVerts = lpPhy->dwNVecCount + lpPhy->dwAVecCount;
     if (totalVerts > 0)
     {
-        fwrite(lpPhy->lpVB, sizeof(CHPhyVertex), totalVerts, file);
+        // Expand the compact layout back to the file layout
+        CHPhyVertex* srcVerts = new CHPhyVertex[totalVerts];
+        CHPhyInternal::ExpandCompactVertices(lpPhy, srcVerts);
+        fwrite(srcVerts, sizeof(CHPhyVertex), totalVerts, file);
+        delete[] srcVerts;
     }
 
     // Write indices
@@ -937,9 +1358,104 @@ void Phy_Unload(CHPhy** lpPhy)
     *lpPhy = nullptr;
 }
 
+CH_CORE_DLL_API
+BOOL Phy_LoadTemplate(CHPhyTemplate** lpTemplate, FILE* file, BOOL bTex)
+{
+    if (!lpTemplate || !file)
+        return FALSE;
+
+    *lpTemplate = nullptr;
+
+    CHPhy* phy = nullptr;
+    if (!Phy_Load(&phy, file, bTex))
+        return FALSE;
+
+    BOOL result = CHPhyInternal::CreateTemplateFromPhy(lpTemplate, phy);
+    Phy_Unload(&phy);
+    return result;
+}
+
+CH_CORE_DLL_API
+BOOL Phy_LoadTemplatePack(CHPhyTemplate** lpTemplate, HANDLE f, BOOL bTex)
+{
+    if (!lpTemplate || f == INVALID_HANDLE_VALUE)
+        return FALSE;
+
+    *lpTemplate = nullptr;
+
+    CHPhy* phy = nullptr;
+    if (!Phy_LoadPack(&phy, f, bTex))
+        return FALSE;
+
+    BOOL result = CHPhyInternal::CreateTemplateFromPhy(lpTemplate, phy);
+    Phy_Unload(&phy);
+    return result;
+}
+
+CH_CORE_DLL_API
+void Phy_UnloadTemplate(CHPhyTemplate** lpTemplate)
+{
+    if (!lpTemplate || !*lpTemplate)
+        return;
+
+    CHPhyInternal::ReleaseTemplate(*lpTemplate);
+    *lpTemplate = nullptr;
+}
+
+CH_CORE_DLL_API
+BOOL Phy_CreateInstance(CHPhy** lpPhy, CHPhyTemplate* lpTemplate, CHMotion* lpMotion)
+{
+    if (!lpPhy || !lpTemplate)
+        return FALSE;
+
+    *lpPhy = new CHPhy();
+    Phy_Clear(*lpPhy);
+
+    CHPhy* phy = *lpPhy;
+    phy->lpTemplate = lpTemplate;
+    lpTemplate->dwRefCount++;
+
+    // Mesh data is read-only and shared
+    phy->lpName = lpTemplate->lpName;
+    phy->dwBlendCount = lpTemplate->dwBlendCount;
+    phy->dwNVecCount = lpTemplate->dwNVecCount;
+    phy->dwAVecCount = lpTemplate->dwAVecCount;
+    phy->lpCompactVB = lpTemplate->lpCompactVB;
+    phy->lpMorphDelta = lpTemplate->lpMorphDelta;
+    memcpy(phy->dwMorphDeltaStart, lpTemplate->dwMorphDeltaStart, sizeof(phy->dwMorphDeltaStart));
+    phy->dwNTriCount = lpTemplate->dwNTriCount;
+    phy->dwATriCount = lpTemplate->dwATriCount;
+    phy->lpIB = lpTemplate->lpIB;
+    phy->lpTexName = lpTemplate->lpTexName;
+    phy->nTex = lpTemplate->nTex;
+    phy->nTex2 = lpTemplate->nTex2;
+    phy->bboxMin = lpTemplate->bboxMin;
+    phy->bboxMax = lpTemplate->bboxMax;
+    phy->InitMatrix = lpTemplate->InitMatrix;
+    phy->normalIndexBuffer = lpTemplate->normalIndexBuffer;
+    phy->alphaIndexBuffer = lpTemplate->alphaIndexBuffer;
+
+    // Skinned output is per instance
+    DWORD totalVerts = phy->dwNVecCount + phy->dwAVecCount;
+    if (totalVerts > 0)
+    {
+        phy->lpOutVB = new CHPhyOutVertex[totalVerts];
+    }
+
+    if (lpMotion && !Motion_CreateInstance(&phy->lpMotion, lpMotion))
+    {
+        Phy_Unload(lpPhy);
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 CH_CORE_DLL_API
 void Phy_Prepare()
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     // Initialize shaders if not already done
     CHPhyInternal::g_PhyShaderManager.Initialize();
 }
@@ -11,6 +11,8 @@
 #include "CH_texture.h"
 #include "CH_key.h"
 #include "CH_main.h"
+#include "CH_affine.h"
+#include "CH_blend.h"
 
 // Physics/Skeletal animation output vertex (for rendering)
 struct CHPhyOutVertex {
@@ -32,6 +34,24 @@ struct CHPhyVertex {
     float weight[CH_BONE_MAX];      // Bone weights
 };
 
+// Compact runtime vertex (converted from CHPhyVertex at load time)
+struct CHPhyCompactVertex {
+    XMFLOAT3 pos;                   // Base position (morph target 0)
+    float u, v;                     // Texture coordinates
+    DWORD color;                    // Vertex color
+    BYTE index[CH_BONE_MAX];        // Bone indices
+    WORD weight[CH_BONE_MAX];       // Bone weights (0..65535 maps to 0..1)
+};
+
+// Sparse morph delta (only stored where a target differs from the base)
+struct CHPhyMorphDelta {
+    DWORD dwVertex;                 // Vertex index
+    XMFLOAT3 delta;                 // Target position minus base position
+};
+
+#define CH_PHY_WEIGHT_SCALE     65535.0f
+#define CH_PHY_MORPH_EPSILON    1.0e-6f
+
 // Motion keyframe
 struct CHKeyFrame {
     DWORD pos;                      // Frame position
@@ -51,9 +71,14 @@ struct CHMotion {
     DWORD dwMorphCount;             // Number of morph targets
     float* lpMorph;                 // Morph weights
     int nFrame;                     // Current frame
+
+    CHMotion* lpSource;             // Keyframes borrowed from this motion (instances only)
+    DWORD dwRefCount;               // Owner plus live instances
 };
 
 // Motion function declarations
+
+// Does nothing to a source motion whose keyframes instances still borrow
 CH_CORE_DLL_API
 void Motion_Clear(CHMotion* lpMotion);
 
@@ -72,6 +97,39 @@ void Motion_Unload(CHMotion** lpMotion);
 CH_CORE_DLL_API
 void Motion_GetMatrix(CHMotion* lpMotion, DWORD dwBone, XMMATRIX* lpMatrix);
 
+// Motion sharing lpSource's keyframes, with its own bone matrices, morph weights and frame.
+// The instance holds a reference on lpSource: Motion_Unload of the source only frees
+// the keyframes once every instance is unloaded too.
+CH_CORE_DLL_API
+BOOL Motion_CreateInstance(CHMotion** lpMotion, CHMotion* lpSource);
+
+// Shared, immutable mesh data of a physics object (one per mesh file)
+struct CHPhyTemplate {
+    char* lpName;                   // Object name
+
+    DWORD dwBlendCount;             // Number of bones affecting each vertex
+    DWORD dwNVecCount;              // Normal vertex count
+    DWORD dwAVecCount;              // Alpha vertex count
+    CHPhyCompactVertex* lpCompactVB;    // Compact source vertices
+    CHPhyMorphDelta* lpMorphDelta;  // Sparse morph deltas
+    DWORD dwMorphDeltaStart[CH_MORPH_MAX + 1];
+
+    DWORD dwNTriCount;              // Normal triangle count
+    DWORD dwATriCount;              // Alpha triangle count
+    WORD* lpIB;                     // Index buffer (CPU side)
+
+    char* lpTexName;                // Texture name
+    int nTex;                       // Primary texture ID
+    int nTex2;                      // Secondary texture ID
+    XMVECTOR bboxMin, bboxMax;      // Bounding box
+    XMMATRIX InitMatrix;            // Initial transformation matrix
+
+    CHComPtr<ID3D11Buffer> normalIndexBuffer = nullptr;
+    CHComPtr<ID3D11Buffer> alphaIndexBuffer = nullptr;
+
+    DWORD dwRefCount;               // Owner plus live instances
+};
+
 // Physics object structure (skeletal animated mesh)
 struct CHPhy {
     char* lpName;                   // Object name
@@ -80,7 +138,10 @@ struct CHPhy {
 
     DWORD dwNVecCount;              // Normal vertex count
     DWORD dwAVecCount;              // Alpha vertex count
-    CHPhyVertex* lpVB;              // Vertex buffer (CPU side)
+    CHPhyCompactVertex* lpCompactVB;    // Compact runtime vertices
+
+    CHPhyMorphDelta* lpMorphDelta;  // Sparse morph deltas, grouped by target
+    DWORD dwMorphDeltaStart[CH_MORPH_MAX + 1];  // Delta range of each target
     
     DWORD dwNTriCount;              // Normal triangle count
     DWORD dwATriCount;              // Alpha triangle count
@@ -104,9 +165,13 @@ struct CHPhy {
 
     XMFLOAT2 uvstep;               // UV animation step
 
+    CHAffine* lpBonePalette;        // Evaluated bone transforms (per frame)
+    DWORD dwPaletteSize;            // Bones allocated in lpBonePalette
+    CHMotionBlend* lpBlend;         // Optional crossfade/layer blend (not owned)
+
+    CHPhyTemplate* lpTemplate;      // Shared mesh (instances only, mesh arrays alias it)
+
     // DirectX 11 specific data (internal use)
-    CHComPtr<ID3D11Buffer> normalVertexBuffer = nullptr;
-    CHComPtr<ID3D11Buffer> alphaVertexBuffer = nullptr;
     CHComPtr<ID3D11Buffer> normalIndexBuffer = nullptr;
     CHComPtr<ID3D11Buffer> alphaIndexBuffer = nullptr;
     CHComPtr<ID3D11Buffer> boneMatrixBuffer = nullptr;
@@ -114,7 +179,9 @@ struct CHPhy {
     CHPhyOutVertex* lpOutVB;        // Processed output vertices
     UINT normalVertexStride;
     UINT alphaVertexStride;
-    UINT vertexOffset;
+    UINT normalBaseVertex;          // Skinned vertices in the dynamic vertex ring
+    UINT alphaBaseVertex;
+    DWORD dwRingGeneration;         // Ring generation of that upload
 };
 
 // Physics function declarations (maintaining exact same signatures as original)
@@ -136,9 +203,32 @@ void Phy_Unload(CHPhy** lpPhy);
 CH_CORE_DLL_API
 void Phy_Prepare();
 
+// Templates: load a mesh once, then spawn instances without touching the file
+CH_CORE_DLL_API
+BOOL Phy_LoadTemplate(CHPhyTemplate** lpTemplate, FILE* file, BOOL bTex = FALSE);
+
+CH_CORE_DLL_API
+BOOL Phy_LoadTemplatePack(CHPhyTemplate** lpTemplate, HANDLE f, BOOL bTex = FALSE);
+
+// Drops the owner reference; the mesh is freed once the last instance is unloaded
+CH_CORE_DLL_API
+void Phy_UnloadTemplate(CHPhyTemplate** lpTemplate);
+
+// lpMotion (optional) becomes a Motion_CreateInstance of that clip
+CH_CORE_DLL_API
+BOOL Phy_CreateInstance(CHPhy** lpPhy, CHPhyTemplate* lpTemplate, CHMotion* lpMotion = nullptr);
+
 CH_CORE_DLL_API
 BOOL Phy_Calculate(CHPhy* lpPhy);
 
+// Calculate many objects at once; motion blends are evaluated as one batch
+CH_CORE_DLL_API
+BOOL Phy_CalculateBatch(CHPhy** lpPhy, DWORD dwCount);
+
+// Attach a blend (nullptr detaches); lpMotion still supplies bone count and Phy_Muliply matrices
+CH_CORE_DLL_API
+void Phy_SetMotionBlend(CHPhy* lpPhy, CHMotionBlend* lpBlend);
+
 CH_CORE_DLL_API
 BOOL Phy_DrawNormal(CHPhy* lpPhy);
 
@@ -177,12 +267,15 @@ namespace CHPhyInternal {
     void InterpolateKeyframes(CHMotion* motion, float frame, XMMATRIX* outMatrices);
     void ApplyBoneTransforms(CHPhy* phy);
     void ApplyMorphTargets(CHPhy* phy);
+
+    // Compact vertex conversion
+    BOOL BuildCompactVertices(CHPhy* phy, const CHPhyVertex* src, DWORD count);
+    void ExpandCompactVertices(const CHPhy* phy, CHPhyVertex* dst);
     
     // Buffer management
-    BOOL CreateVertexBuffers(CHPhy* phy);
     BOOL CreateIndexBuffers(CHPhy* phy);
     BOOL CreateBoneMatrixBuffer(CHPhy* phy);
-    void UpdateVertexBuffer(CHPhy* phy, bool isAlpha);
+    BOOL UpdateVertexBuffer(CHPhy* phy);
     void UpdateBoneMatrices(CHPhy* phy);
     void ReleaseBuffers(CHPhy* phy);
     
@@ -194,12 +287,20 @@ namespace CHPhyInternal {
     // Motion processing
     BOOL LoadMotionFromFile(FILE* file, CHMotion** motion);
     BOOL LoadMotionFromPack(HANDLE handle, CHMotion** motion);
-    void ProcessMotionKeyframes(CHMotion* motion);
+    BOOL EvaluateMotionKeyframe(CHMotion* motion, float fFrame, CHAffine* key);
+    BOOL EnsureBonePalette(CHPhy* phy);
+    void BuildBonePalette(CHPhy* phy);
+    BOOL ProcessPhyKeys(CHPhy* phy);
     
     // File I/O utilities
     BOOL LoadPhyFromFile(FILE* file, CHPhy** phy, bool loadTextures);
     BOOL LoadPhyFromPack(HANDLE handle, CHPhy** phy, bool loadTextures);
     BOOL SavePhyToFile(const char* filename, CHPhy* phy, bool newFile);
+
+    // Template management
+    BOOL CreateTemplateFromPhy(CHPhyTemplate** tmpl, CHPhy* phy);
+    void ReleaseTemplate(CHPhyTemplate* tmpl);
+    void ReleaseMotion(CHMotion* motion);
     
     // Shader management for skeletal animation
     class PhyShaderManager {
@@ -227,6 +328,7 @@ namespace CHPhyInternal {
 typedef CHPhy C3Phy;
 typedef CHMotion C3Motion;
 typedef CHKeyFrame C3KeyFrame;
+typedef CHPhyTemplate C3PhyTemplate;
 typedef CHPhyVertex PhyVertex;
 typedef CHPhyOutVertex PhyOutVertex;
 
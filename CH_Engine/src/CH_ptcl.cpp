@@ -3,30 +3,58 @@
 using namespace DirectX;
 #include "CH_ptcl.h"
 #include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_instance.h"
 #include "CH_texture.h"
+#include "CH_emitter.h"
 #include <algorithm>
+#include <cfloat>
 
 extern const char CH_VERSION[64];
 
 // Global particle shader manager
 CHPtclInternal::ParticleShaderManager CHPtclInternal::g_ParticleShaderManager;
+thread_local CHPtclInternal::SortScratch CHPtclInternal::t_SortScratch;
+BOOL CHPtclInternal::g_bPackFrames = TRUE;
 
 void Ptcl_Clear(CHPtcl* lpPtcl)
 {
     if (!lpPtcl)
         return;
     
+    if (lpPtcl->lpTemplate)
+    {
+        // Name, UV table and frames belong to the template (a table the
+        // instance built for another dwRow is its own and freed below)
+        if (lpPtcl->lpUVTable == lpPtcl->lpTemplate->lpUVTable)
+            lpPtcl->lpUVTable = nullptr;
+        
+        std::vector<CHPtcl*>& instances = lpPtcl->lpTemplate->Instances;
+        instances.erase(std::remove(instances.begin(), instances.end(), lpPtcl), instances.end());
+        CHPtclInternal::ReleaseTemplate(lpPtcl->lpTemplate);
+        lpPtcl->lpTemplate = nullptr;
+        lpPtcl->lpName = nullptr;
+        lpPtcl->lpTexName = nullptr;
+        lpPtcl->lpPtcl = nullptr;
+        lpPtcl->lpPackedData = nullptr;
+    }
+    
     // Clear name
     delete[] lpPtcl->lpName;
     lpPtcl->lpName = nullptr;
     
-    // Clear vertex buffer
-    delete[] lpPtcl->lpVB;
-    lpPtcl->lpVB = nullptr;
+    // Clear atlas UV table
+    delete[] lpPtcl->lpUVTable;
+    lpPtcl->lpUVTable = nullptr;
+    lpPtcl->dwUVTableRow = 0;
     
-    // Clear index buffer
-    delete[] lpPtcl->lpIB;
-    lpPtcl->lpIB = nullptr;
+    // Clear depth order
+    delete[] lpPtcl->lpOrder;
+    lpPtcl->lpOrder = nullptr;
+    lpPtcl->dwOrderCapacity = 0;
+    lpPtcl->dwOrderCount = 0;
+    lpPtcl->bSort = TRUE;
+    lpPtcl->fViewDepth = 0.0f;
     
     // Clear texture name
     delete[] lpPtcl->lpTexName;
@@ -48,16 +76,42 @@ void Ptcl_Clear(CHPtcl* lpPtcl)
         delete[] lpPtcl->lpPtcl;
         lpPtcl->lpPtcl = nullptr;
     }
+    delete[] lpPtcl->lpPackedData;
+    lpPtcl->lpPackedData = nullptr;
+    lpPtcl->dwPackedSize = 0;
+    lpPtcl->bPackedAge16 = FALSE;
     
     lpPtcl->nFrame = 0;
     lpPtcl->dwFrames = 0;
+    Emitter_Release(&lpPtcl->lpEmitter);
     lpPtcl->matrix = XMMatrixIdentity();
     
     // Release DirectX 11 buffers
     CHPtclInternal::ReleaseBuffers(lpPtcl);
     
     lpPtcl->vertexStride = sizeof(CHPtclVertex);
-    lpPtcl->vertexOffset = 0;
+    lpPtcl->baseVertex = 0;
+    lpPtcl->dwRingGeneration = 0;
+}
+
+BOOL Ptcl_Create(CHPtcl** lpPtcl, const CHEmitterDesc* lpDesc, int nTex, DWORD dwRow)
+{
+    if (!lpPtcl || !lpDesc)
+        return FALSE;
+    
+    *lpPtcl = new CHPtcl();
+    Ptcl_Clear(*lpPtcl);
+    
+    if (!Emitter_Create(&(*lpPtcl)->lpEmitter, lpDesc))
+    {
+        Ptcl_Unload(lpPtcl);
+        return FALSE;
+    }
+    
+    (*lpPtcl)->nTex = nTex;
+    (*lpPtcl)->dwRow = std::max<DWORD>(dwRow, 1);
+    (*lpPtcl)->dwCount = (*lpPtcl)->lpEmitter->dwCapacity;
+    return TRUE;
 }
 
 BOOL Ptcl_Load(CHPtcl** lpPtcl, FILE* file, BOOL bTex)
@@ -131,18 +185,21 @@ BOOL Ptcl_Save(char* lpName, CHPtcl* lpPtcl, BOOL bNew)
         
         if (frame->dwCount > 0)
         {
-            // Particle positions (convert XMVECTOR to XMFLOAT3)
+            // Particles are decoded back to floats (frames may be packed)
+            std::vector<XMFLOAT3> pos(frame->dwCount);
+            std::vector<float> age(frame->dwCount);
+            std::vector<float> size(frame->dwCount);
             for (DWORD j = 0; j < frame->dwCount; j++)
             {
-                XMFLOAT3 pos;
-                XMStoreFloat3(&pos, frame->lpPos[j]);
-                fwrite(&pos, sizeof(XMFLOAT3), 1, file);
+                CHPtclInternal::DecodeParticle(lpPtcl, frame, j, &pos[j], &age[j], &size[j]);
             }
+            
+            fwrite(pos.data(), sizeof(XMFLOAT3), frame->dwCount, file);
             chunk.dwChunkSize += sizeof(XMFLOAT3) * frame->dwCount;
             
             // Particle ages and sizes
-            fwrite(frame->lpAge, sizeof(float), frame->dwCount, file);
-            fwrite(frame->lpSize, sizeof(float), frame->dwCount, file);
+            fwrite(age.data(), sizeof(float), frame->dwCount, file);
+            fwrite(size.data(), sizeof(float), frame->dwCount, file);
             chunk.dwChunkSize += sizeof(float) * frame->dwCount * 2;
             
             // Frame matrix (convert XMMATRIX to XMFLOAT4X4)
@@ -167,82 +224,284 @@ void Ptcl_Unload(CHPtcl** lpPtcl)
     if (!lpPtcl || !*lpPtcl)
         return;
     
-    // Clean up frame data
-    if ((*lpPtcl)->lpPtcl)
+    // Frees owned data, or releases the template of an instance
+    Ptcl_Clear(*lpPtcl);
+    
+    delete *lpPtcl;
+    *lpPtcl = nullptr;
+}
+
+BOOL Ptcl_LoadTemplate(CHPtclTemplate** lpTemplate, FILE* file, BOOL bTex)
+{
+    if (!lpTemplate || !file)
+        return FALSE;
+    
+    *lpTemplate = nullptr;
+    
+    CHPtcl* ptcl = nullptr;
+    if (!Ptcl_Load(&ptcl, file, bTex))
     {
-        for (DWORD i = 0; i < (*lpPtcl)->dwFrames; i++)
-        {
-            delete[] (*lpPtcl)->lpPtcl[i].lpPos;
-            delete[] (*lpPtcl)->lpPtcl[i].lpAge;
-            delete[] (*lpPtcl)->lpPtcl[i].lpSize;
-        }
-        delete[] (*lpPtcl)->lpPtcl;
+        Ptcl_Unload(&ptcl);
+        return FALSE;
     }
     
-    // Clean up other data
-    delete[] (*lpPtcl)->lpName;
-    delete[] (*lpPtcl)->lpVB;
-    delete[] (*lpPtcl)->lpIB;
-    delete[] (*lpPtcl)->lpTexName;
+    BOOL result = CHPtclInternal::CreateTemplateFromPtcl(lpTemplate, ptcl);
+    Ptcl_Unload(&ptcl);
+    return result;
+}
+
+BOOL Ptcl_LoadTemplatePack(CHPtclTemplate** lpTemplate, HANDLE f, BOOL bTex)
+{
+    if (!lpTemplate || f == INVALID_HANDLE_VALUE)
+        return FALSE;
     
-    // Release DirectX buffers
-    CHPtclInternal::ReleaseBuffers(*lpPtcl);
+    *lpTemplate = nullptr;
     
-    delete *lpPtcl;
-    *lpPtcl = nullptr;
+    CHPtcl* ptcl = nullptr;
+    if (!Ptcl_LoadPack(&ptcl, f, bTex))
+    {
+        Ptcl_Unload(&ptcl);
+        return FALSE;
+    }
+    
+    BOOL result = CHPtclInternal::CreateTemplateFromPtcl(lpTemplate, ptcl);
+    Ptcl_Unload(&ptcl);
+    return result;
+}
+
+void Ptcl_UnloadTemplate(CHPtclTemplate** lpTemplate)
+{
+    if (!lpTemplate || !*lpTemplate)
+        return;
+    
+    CHPtclInternal::ReleaseTemplate(*lpTemplate);
+    *lpTemplate = nullptr;
+}
+
+BOOL Ptcl_CreateInstance(CHPtcl** lpPtcl, CHPtclTemplate* lpTemplate)
+{
+    if (!lpPtcl || !lpTemplate)
+        return FALSE;
+    
+    *lpPtcl = new CHPtcl();
+    Ptcl_Clear(*lpPtcl);
+    
+    CHPtcl* ptcl = *lpPtcl;
+    ptcl->lpTemplate = lpTemplate;
+    lpTemplate->dwRefCount++;
+    lpTemplate->Instances.push_back(ptcl);
+    
+    // Effect data is read-only and shared; nTex is the instance's override
+    ptcl->lpName = lpTemplate->lpName;
+    ptcl->lpTexName = lpTemplate->lpTexName;
+    ptcl->nTex = lpTemplate->nTex;
+    ptcl->dwCount = lpTemplate->dwCount;
+    ptcl->dwRow = lpTemplate->dwRow;
+    ptcl->lpUVTable = lpTemplate->lpUVTable;
+    ptcl->dwUVTableRow = lpTemplate->dwRow;
+    ptcl->lpPtcl = lpTemplate->lpPtcl;
+    ptcl->dwFrames = lpTemplate->dwFrames;
+    ptcl->lpPackedData = lpTemplate->lpPackedData;
+    ptcl->dwPackedSize = lpTemplate->dwPackedSize;
+    ptcl->bPackedAge16 = lpTemplate->bPackedAge16;
+    
+    return TRUE;
+}
+
+void Ptcl_SetFrameCompression(BOOL bPack)
+{
+    CHPtclInternal::g_bPackFrames = bPack;
 }
 
 void Ptcl_Prepare()
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    CHInstanceInternal::FlushPending();
+    
     CHPtclInternal::SetupParticleRenderStates();
 }
 
 BOOL Ptcl_Draw(CHPtcl* lpPtcl, int nAsb, int nAdb)
 {
-    if (!lpPtcl || lpPtcl->nFrame >= static_cast<int>(lpPtcl->dwFrames))
-        return FALSE;
+    CHSpriteInternal::g_SpriteBatch.Flush();
     
-    CHPtclFrame* frame = &lpPtcl->lpPtcl[lpPtcl->nFrame];
+    CHPtclFrame* frame = CHPtclInternal::GetCurrentFrame(lpPtcl);
+    if (!frame)
+        return FALSE;
     
     if (frame->dwCount == 0)
         return TRUE;
     
-    // Generate particle quads
-    CHPtclInternal::GenerateParticleQuads(lpPtcl, frame);
+    // Back-to-front order only matters when blending is not additive
+    CHPtclInternal::SortParticlesByDepth(lpPtcl, CHPtclInternal::NeedsDepthSort(lpPtcl, nAdb));
     
-    // Set render states
-    SetRenderState(CH_RS_ALPHABLENDENABLE, TRUE);
-    SetRenderState(CH_RS_SRCBLEND, nAsb);
-    SetRenderState(CH_RS_DESTBLEND, nAdb);
-    SetRenderState(CH_RS_ALPHATESTENABLE, TRUE);
-    SetRenderState(CH_RS_ALPHAREF, 0x08);
-    SetRenderState(CH_RS_ALPHAFUNC, CH_CMP_GREATEREQUAL);
+    return CHPtclInternal::DrawCurrentFrame(lpPtcl, nAsb, nAdb);
+}
+
+BOOL Ptcl_DrawSorted(CHPtcl** lpPtcl, DWORD dwCount, int nAsb, int nAdb)
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
     
-    // Set texture
-    if (lpPtcl->nTex >= 0 && lpPtcl->nTex < TEX_MAX && g_lpTex[lpPtcl->nTex])
+    if (!lpPtcl || dwCount == 0)
+        return FALSE;
+    
+    using namespace CHPtclInternal;
+    
+    // Gather list is kept between calls to avoid per-frame allocation
+    static thread_local std::vector<CHPtcl*> systems;
+    systems.clear();
+    
+    for (DWORD i = 0; i < dwCount; i++)
     {
-        SetTexture(0, g_lpTex[lpPtcl->nTex]->lpSRV.Get());
+        CHPtcl* ptcl = lpPtcl[i];
+        CHPtclFrame* frame = GetCurrentFrame(ptcl);
+        if (!frame || frame->dwCount == 0)
+            continue;
+        
+        if (!SortParticlesByDepth(ptcl, NeedsDepthSort(ptcl, nAdb)))
+            continue;
+        
+        systems.push_back(ptcl);
     }
     
-    // Set vertex and index buffers
-    if (!lpPtcl->vertexBuffer && !CHPtclInternal::CreateVertexBuffer(lpPtcl))
-        return FALSE;
+    OrderByViewDepth(systems);
     
-    if (!lpPtcl->indexBuffer && !CHPtclInternal::CreateIndexBuffer(lpPtcl))
+    BOOL result = TRUE;
+    for (CHPtcl* ptcl : systems)
+    {
+        if (!DrawCurrentFrame(ptcl, nAsb, nAdb))
+            result = FALSE;
+    }
+    
+    return result;
+}
+
+BOOL Ptcl_DrawInstances(CHPtcl** lpPtcl, DWORD dwCount, int nAsb, int nAdb)
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    
+    if (!lpPtcl || dwCount == 0)
         return FALSE;
     
-    g_D3DContext->IASetVertexBuffers(0, 1, lpPtcl->vertexBuffer.GetAddressOf(), 
-        &lpPtcl->vertexStride, &lpPtcl->vertexOffset);
-    g_D3DContext->IASetIndexBuffer(lpPtcl->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    using namespace CHPtclInternal;
     
-    // Set shaders
-    CHPtclInternal::g_ParticleShaderManager.SetParticleShaders();
+    // Gather list is kept between calls to avoid per-frame allocation
+    static thread_local std::vector<CHPtcl*> systems;
+    systems.clear();
     
-    // Draw particles
-    g_D3DContext->DrawIndexed(frame->dwCount * 6, 0, 0);
+    DWORD totalQuads = 0;
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHPtcl* ptcl = lpPtcl[i];
+        CHPtclFrame* frame = GetCurrentFrame(ptcl);
+        if (!frame || frame->dwCount == 0)
+            continue;
+        
+        if (!SortParticlesByDepth(ptcl, NeedsDepthSort(ptcl, nAdb)))
+            continue;
+        
+        systems.push_back(ptcl);
+        totalQuads += frame->dwCount;
+    }
     
-    return TRUE;
+    if (systems.empty())
+        return TRUE;
+    
+    // Additive systems draw in input order (neighbours sharing a texture still merge)
+    if (nAdb != CH_BLEND_ONE)
+        OrderByViewDepth(systems);
+    
+    // One ring allocation for every system; each keeps its slot for redraws
+    UINT baseVertex = 0;
+    DWORD generation = 0;
+    float* out = static_cast<float*>(CHInternal::g_DynamicVertexRing.Lock(totalQuads * 4, sizeof(CHPtclVertex),
+        &baseVertex, &generation));
+    if (!out)
+    {
+        // Larger than the ring: fall back to one allocation per system
+        BOOL result = TRUE;
+        for (CHPtcl* ptcl : systems)
+        {
+            if (!DrawCurrentFrame(ptcl, nAsb, nAdb))
+                result = FALSE;
+        }
+        return result;
+    }
+    
+    BOOL result = TRUE;
+    UINT vertex = baseVertex;
+    for (CHPtcl* ptcl : systems)
+    {
+        CHPtclFrame* frame = GetCurrentFrame(ptcl);
+        const DWORD* order = ptcl->dwOrderCount == frame->dwCount ? ptcl->lpOrder : nullptr;
+        
+        ptcl->baseVertex = vertex;
+        ptcl->dwRingGeneration = generation;
+        if (!WriteParticleQuads(ptcl, frame, order, out))
+        {
+            // Leave the (unwritten) quads out of the draw
+            ptcl->dwRingGeneration = 0;
+            result = FALSE;
+        }
+        
+        out += frame->dwCount * 4 * (sizeof(CHPtclVertex) / sizeof(float));
+        vertex += frame->dwCount * 4;
+    }
+    CHInternal::g_DynamicVertexRing.Unlock();
+    
+    ApplyParticleStates(nAsb, nAdb);
+    CHInternal::g_DynamicVertexRing.Bind(sizeof(CHPtclVertex));
+    CHInternal::g_QuadIndexBuffer.Bind();
+    g_ParticleShaderManager.SetParticleShaders();
+    
+    // Consecutive systems with the same texture are one draw
+    size_t i = 0;
+    while (i < systems.size())
+    {
+        CHPtcl* first = systems[i];
+        if (!CHInternal::g_DynamicVertexRing.IsValid(first->dwRingGeneration))
+        {
+            i++;
+            continue;
+        }
+        
+        DWORD quads = 0;
+        size_t end = i;
+        while (end < systems.size() && systems[end]->nTex == first->nTex &&
+               CHInternal::g_DynamicVertexRing.IsValid(systems[end]->dwRingGeneration))
+        {
+            quads += GetCurrentFrame(systems[end])->dwCount;
+            end++;
+        }
+        
+        if (first->nTex >= 0 && first->nTex < TEX_MAX && g_lpTex[first->nTex])
+        {
+            SetTexture(0, g_lpTex[first->nTex]->lpSRV.Get());
+        }
+        CHInternal::g_QuadIndexBuffer.DrawQuads(quads, first->baseVertex);
+        i = end;
+    }
+    
+    return result;
+}
+
+BOOL Ptcl_DrawTemplate(CHPtclTemplate* lpTemplate, int nAsb, int nAdb)
+{
+    if (!lpTemplate)
+        return FALSE;
+    
+    if (lpTemplate->Instances.empty())
+        return TRUE;
+    
+    return Ptcl_DrawInstances(lpTemplate->Instances.data(), static_cast<DWORD>(lpTemplate->Instances.size()), nAsb, nAdb);
+}
+
+void Ptcl_SetSort(CHPtcl* lpPtcl, BOOL bSort)
+{
+    if (!lpPtcl)
+        return;
+    
+    lpPtcl->bSort = bSort;
 }
 
 void Ptcl_NextFrame(CHPtcl* lpPtcl, int nStep)
@@ -250,7 +509,12 @@ void Ptcl_NextFrame(CHPtcl* lpPtcl, int nStep)
     if (!lpPtcl)
         return;
     
-    if (lpPtcl->dwFrames > 0)
+    if (lpPtcl->lpEmitter)
+    {
+        Emitter_Step(lpPtcl->lpEmitter, nStep);
+        lpPtcl->nFrame += nStep;
+    }
+    else if (lpPtcl->dwFrames > 0)
     {
         lpPtcl->nFrame = (lpPtcl->nFrame + nStep) % lpPtcl->dwFrames;
     }
@@ -261,10 +525,46 @@ void Ptcl_SetFrame(CHPtcl* lpPtcl, DWORD dwFrame)
     if (!lpPtcl)
         return;
     
-    if (dwFrame < lpPtcl->dwFrames)
+    if (lpPtcl->lpEmitter)
     {
+        // Seeded simulation: replaying from the start lands on the same particles
+        Emitter_Reset(lpPtcl->lpEmitter);
+        Emitter_Step(lpPtcl->lpEmitter, static_cast<int>(dwFrame));
         lpPtcl->nFrame = static_cast<int>(dwFrame);
     }
+    else if (dwFrame < lpPtcl->dwFrames)
+    {
+        lpPtcl->nFrame = static_cast<int>(dwFrame);
+    }
+}
+
+void Ptcl_NextFrameBatch(CHPtcl** lpPtcl, DWORD dwCount, int nStep)
+{
+    if (!lpPtcl || dwCount == 0)
+        return;
+    
+    // Gather list is kept between calls to avoid per-frame allocation
+    static thread_local std::vector<CHPtclEmitter*> emitters;
+    emitters.clear();
+    
+    for (DWORD i = 0; i < dwCount; i++)
+    {
+        CHPtcl* ptcl = lpPtcl[i];
+        if (!ptcl)
+            continue;
+        
+        if (ptcl->lpEmitter)
+        {
+            emitters.push_back(ptcl->lpEmitter);
+            ptcl->nFrame += nStep;
+        }
+        else
+        {
+            Ptcl_NextFrame(ptcl, nStep);
+        }
+    }
+    
+    Emitter_StepBatch(emitters.data(), static_cast<DWORD>(emitters.size()), nStep);
 }
 
 void Ptcl_Muliply(CHPtcl* lpPtcl, XMMATRIX* matrix)
@@ -294,166 +594,406 @@ void Ptcl_ChangeTexture(CHPtcl* lpPtcl, int nTexID)
 // Internal implementation
 namespace CHPtclInternal {
 
-void GenerateParticleQuads(CHPtcl* ptcl, CHPtclFrame* frame)
+BOOL BuildUVTable(CHPtcl* ptcl)
 {
-    if (!ptcl || !frame || frame->dwCount == 0)
+    if (!ptcl || ptcl->dwRow == 0)
+        return FALSE;
+    
+    // The template's table is shared and never rebuilt: an instance gets its own
+    if (!ptcl->lpTemplate || ptcl->lpUVTable != ptcl->lpTemplate->lpUVTable)
+        delete[] ptcl->lpUVTable;
+    
+    // Top-left corner of every atlas cell, indexed by animation cell
+    DWORD segcount = ptcl->dwRow * ptcl->dwRow;
+    float segsize = 1.0f / ptcl->dwRow;
+    ptcl->lpUVTable = new XMFLOAT2[segcount];
+    for (DWORD i = 0; i < segcount; i++)
+    {
+        ptcl->lpUVTable[i].x = (i % ptcl->dwRow) * segsize;
+        ptcl->lpUVTable[i].y = (i / ptcl->dwRow) * segsize;
+    }
+    ptcl->dwUVTableRow = ptcl->dwRow;
+    return TRUE;
+}
+
+// 16-byte store into the (write-combined) ring, non-temporal when aligned
+static inline void StoreQuadVector(float* dest, FXMVECTOR v, bool aligned)
+{
+#if defined(_XM_SSE_INTRINSICS_)
+    if (aligned)
+    {
+        _mm_stream_ps(dest, v);
         return;
+    }
+#endif
+    XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(dest), v);
+}
+
+BOOL GenerateParticleQuads(CHPtcl* ptcl, CHPtclFrame* frame, const DWORD* lpOrder)
+{
+    if (!ptcl || !frame || frame->dwCount == 0)
+        return FALSE;
+    
+    // Quads are written straight into the dynamic vertex ring
+    float* out = static_cast<float*>(CHInternal::g_DynamicVertexRing.Lock(frame->dwCount * 4, sizeof(CHPtclVertex),
+        &ptcl->baseVertex, &ptcl->dwRingGeneration));
+    if (!out)
+    {
+        ptcl->dwRingGeneration = 0;
+        return FALSE;
+    }
+    
+    BOOL result = WriteParticleQuads(ptcl, frame, lpOrder, out);
+    CHInternal::g_DynamicVertexRing.Unlock();
+    
+    if (!result)
+        ptcl->dwRingGeneration = 0;
+    return result;
+}
+
+BOOL WriteParticleQuads(CHPtcl* ptcl, const CHPtclFrame* frame, const DWORD* lpOrder, float* out)
+{
+    if (!ptcl || !frame || frame->dwCount == 0 || !out)
+        return FALSE;
+    
+    PackedFrame packed = {};
+    BOOL isPacked = GetPackedFrame(ptcl, frame, &packed);
+    if (!isPacked && (!frame->lpPos || !frame->lpAge || !frame->lpSize))
+        return FALSE;
     
+    if (ptcl->dwUVTableRow != ptcl->dwRow && !BuildUVTable(ptcl))
+        return FALSE;
+    
+    DWORD count = frame->dwCount;
     DWORD segcount = ptcl->dwRow * ptcl->dwRow;
     float segsize = 1.0f / ptcl->dwRow;
     
-    // Calculate combined transformation matrix
-    XMMATRIX combinedMatrix = XMMatrixMultiply(frame->matrix, ptcl->matrix);
-    combinedMatrix = XMMatrixMultiply(combinedMatrix, g_ViewMatrix);
+    CHAffine combined = GetViewTransform(ptcl, frame);
+    
+    // A quad is 96 bytes, so if the first one is aligned they all are
+    const bool aligned = (reinterpret_cast<uintptr_t>(out) & 15) == 0;
+    
+    float white;
+    const DWORD whiteBits = 0xFFFFFFFF;
+    memcpy(&white, &whiteBits, sizeof(white));
+    
+    // Dequantization constants for packed frames
+    const XMVECTOR posMinX = XMVectorReplicate(frame->PackedMin.x);
+    const XMVECTOR posMinY = XMVectorReplicate(frame->PackedMin.y);
+    const XMVECTOR posMinZ = XMVectorReplicate(frame->PackedMin.z);
+    const XMVECTOR posScaleX = XMVectorReplicate(frame->PackedScale.x);
+    const XMVECTOR posScaleY = XMVectorReplicate(frame->PackedScale.y);
+    const XMVECTOR posScaleZ = XMVectorReplicate(frame->PackedScale.z);
+    const float ageStep = packed.lpAge16 ? 1.0f / 65536.0f : 1.0f / 256.0f;
+    
+    const XMVECTOR cellScale = XMVectorReplicate(static_cast<float>(segcount));
+    const XMVECTOR cellMax = XMVectorReplicate(static_cast<float>(segcount - 1));
     
-    // Generate quads for each particle
-    for (DWORD n = 0; n < frame->dwCount; n++)
+    XMFLOAT4A left, right, bottom, top, depth;
+    XMINT4 cells;
+    
+    // Four particles per iteration: SoA transform, then six 16-byte stores per quad
+    for (DWORD n = 0; n < count; n += 4)
     {
-        DWORD index = static_cast<DWORD>(frame->lpAge[n] * segcount);
-        
-        float u = (index % ptcl->dwRow) * segsize;
-        float v = (index / ptcl->dwRow) * segsize;
-        
-        // Transform particle position
-        XMVECTOR worldPos = XMVector3TransformCoord(frame->lpPos[n], combinedMatrix);
-        XMFLOAT3 pos;
-        XMStoreFloat3(&pos, worldPos);
-        
-        float size = frame->lpSize[n];
+        DWORD lanes = std::min<DWORD>(4, count - n);
         
-        // Generate quad vertices
-        DWORD baseIndex = n * 4;
+        // The tail group repeats its last particle in the unused lanes;
+        // lpOrder (back-to-front permutation) is gathered through here
+        DWORD index[4];
+        float size[4];
+        float age[4];
+        for (DWORD k = 0; k < 4; k++)
+        {
+            DWORD slot = n + std::min<DWORD>(k, lanes - 1);
+            index[k] = lpOrder ? lpOrder[slot] : slot;
+            if (isPacked)
+            {
+                DWORD q = packed.lpAge16 ? packed.lpAge16[index[k]] : packed.lpAge8[index[k]];
+                size[k] = frame->fSizeMin + packed.lpSize[index[k]] * frame->fSizeScale;
+                age[k] = (q + 0.5f) * ageStep;
+            }
+            else
+            {
+                size[k] = frame->lpSize[index[k]];
+                age[k] = frame->lpAge[index[k]];
+            }
+        }
         
-        // Vertex 0 (top-left)
-        ptcl->lpVB[baseIndex].x = pos.x - size;
-        ptcl->lpVB[baseIndex].y = pos.y - size;
-        ptcl->lpVB[baseIndex].z = pos.z;
-        ptcl->lpVB[baseIndex].u = u;
-        ptcl->lpVB[baseIndex].v = v + segsize;
-        ptcl->lpVB[baseIndex].color = 0xFFFFFFFF;
+        XMMATRIX lanesPos;
+        if (isPacked)
+        {
+            // Dequantize straight into SoA lanes
+            const WORD* p0 = packed.lpPos + index[0] * 3;
+            const WORD* p1 = packed.lpPos + index[1] * 3;
+            const WORD* p2 = packed.lpPos + index[2] * 3;
+            const WORD* p3 = packed.lpPos + index[3] * 3;
+            lanesPos.r[0] = XMVectorMultiplyAdd(XMVectorSet(p0[0], p1[0], p2[0], p3[0]), posScaleX, posMinX);
+            lanesPos.r[1] = XMVectorMultiplyAdd(XMVectorSet(p0[1], p1[1], p2[1], p3[1]), posScaleY, posMinY);
+            lanesPos.r[2] = XMVectorMultiplyAdd(XMVectorSet(p0[2], p1[2], p2[2], p3[2]), posScaleZ, posMinZ);
+        }
+        else
+        {
+            lanesPos = XMMatrixTranspose(XMMATRIX(frame->lpPos[index[0]], frame->lpPos[index[1]],
+                frame->lpPos[index[2]], frame->lpPos[index[3]]));
+        }
+        Affine_TransformSoA(combined, lanesPos.r[0], lanesPos.r[1], lanesPos.r[2]);
         
-        // Vertex 1 (top-right)
-        ptcl->lpVB[baseIndex + 1].x = pos.x + size;
-        ptcl->lpVB[baseIndex + 1].y = pos.y - size;
-        ptcl->lpVB[baseIndex + 1].z = pos.z;
-        ptcl->lpVB[baseIndex + 1].u = u + segsize;
-        ptcl->lpVB[baseIndex + 1].v = v + segsize;
-        ptcl->lpVB[baseIndex + 1].color = 0xFFFFFFFF;
+        XMVECTOR sizes = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(size));
+        XMStoreFloat4A(&left, XMVectorSubtract(lanesPos.r[0], sizes));
+        XMStoreFloat4A(&right, XMVectorAdd(lanesPos.r[0], sizes));
+        XMStoreFloat4A(&bottom, XMVectorSubtract(lanesPos.r[1], sizes));
+        XMStoreFloat4A(&top, XMVectorAdd(lanesPos.r[1], sizes));
+        XMStoreFloat4A(&depth, lanesPos.r[2]);
         
-        // Vertex 2 (bottom-left)
-        ptcl->lpVB[baseIndex + 2].x = pos.x - size;
-        ptcl->lpVB[baseIndex + 2].y = pos.y + size;
-        ptcl->lpVB[baseIndex + 2].z = pos.z;
-        ptcl->lpVB[baseIndex + 2].u = u;
-        ptcl->lpVB[baseIndex + 2].v = v;
-        ptcl->lpVB[baseIndex + 2].color = 0xFFFFFFFF;
+        // Atlas cell from age, clamped so age == 1 stays on the last cell
+        XMVECTOR cell = XMVectorFloor(XMVectorMultiply(XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(age)), cellScale));
+        cell = XMVectorClamp(cell, XMVectorZero(), cellMax);
+        XMStoreSInt4(&cells, XMConvertVectorFloatToInt(cell, 0));
         
-        // Vertex 3 (bottom-right)
-        ptcl->lpVB[baseIndex + 3].x = pos.x + size;
-        ptcl->lpVB[baseIndex + 3].y = pos.y + size;
-        ptcl->lpVB[baseIndex + 3].z = pos.z;
-        ptcl->lpVB[baseIndex + 3].u = u + segsize;
-        ptcl->lpVB[baseIndex + 3].v = v;
-        ptcl->lpVB[baseIndex + 3].color = 0xFFFFFFFF;
+        const float* l = &left.x;
+        const float* r = &right.x;
+        const float* b = &bottom.x;
+        const float* t = &top.x;
+        const float* z = &depth.x;
+        const int32_t* c = &cells.x;
         
-        // Generate indices for quad
-        ptcl->lpIB[n * 6] = static_cast<WORD>(baseIndex);
-        ptcl->lpIB[n * 6 + 1] = static_cast<WORD>(baseIndex + 1);
-        ptcl->lpIB[n * 6 + 2] = static_cast<WORD>(baseIndex + 2);
-        ptcl->lpIB[n * 6 + 3] = static_cast<WORD>(baseIndex + 2);
-        ptcl->lpIB[n * 6 + 4] = static_cast<WORD>(baseIndex + 1);
-        ptcl->lpIB[n * 6 + 5] = static_cast<WORD>(baseIndex + 3);
+        for (DWORD k = 0; k < lanes; k++)
+        {
+            const XMFLOAT2& uv = ptcl->lpUVTable[c[k]];
+            float u1 = uv.x + segsize;
+            float v1 = uv.y + segsize;
+            
+            // Vertex layout is x y z color u v; vertices 0..3 are
+            // (l,b,u0,v1) (r,b,u1,v1) (l,t,u0,v0) (r,t,u1,v0)
+            StoreQuadVector(out + 0, XMVectorSet(l[k], b[k], z[k], white), aligned);
+            StoreQuadVector(out + 4, XMVectorSet(uv.x, v1, r[k], b[k]), aligned);
+            StoreQuadVector(out + 8, XMVectorSet(z[k], white, u1, v1), aligned);
+            StoreQuadVector(out + 12, XMVectorSet(l[k], t[k], z[k], white), aligned);
+            StoreQuadVector(out + 16, XMVectorSet(uv.x, uv.y, r[k], t[k]), aligned);
+            StoreQuadVector(out + 20, XMVectorSet(z[k], white, u1, uv.y), aligned);
+            out += 24;
+        }
     }
     
-    // Update GPU buffers
-    UpdateVertexBuffer(ptcl);
+#if defined(_XM_SSE_INTRINSICS_)
+    if (aligned)
+    {
+        _mm_sfence();
+    }
+#endif
+    
+    return TRUE;
 }
 
-BOOL CreateVertexBuffer(CHPtcl* ptcl)
+void ReleaseBuffers(CHPtcl* ptcl)
 {
     if (!ptcl)
-        return FALSE;
-    
-    if (ptcl->vertexBuffer)
-        return TRUE; // Already created
-    
-    CHPtclFrame* currentFrame = &ptcl->lpPtcl[ptcl->nFrame];
-    
-    D3D11_BUFFER_DESC bufferDesc = {};
-    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    bufferDesc.ByteWidth = sizeof(CHPtclVertex) * currentFrame->dwCount * 4;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        return;
     
-    return SUCCEEDED(g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, ptcl->vertexBuffer.GetAddressOf()));
+    // Quads live in the shared ring, just forget the allocation
+    ptcl->dwRingGeneration = 0;
 }
 
-BOOL CreateIndexBuffer(CHPtcl* ptcl)
+BOOL GetPackedFrame(const CHPtcl* ptcl, const CHPtclFrame* frame, PackedFrame* packed)
 {
-    if (!ptcl)
+    if (!ptcl || !frame || !ptcl->lpPackedData || frame->lpPos || frame->dwCount == 0)
         return FALSE;
     
-    if (ptcl->indexBuffer)
-        return TRUE; // Already created
+    DWORD count = frame->dwCount;
+    const BYTE* data = ptcl->lpPackedData + frame->dwPackedOffset;
+    packed->lpPos = reinterpret_cast<const WORD*>(data);
+    packed->lpSize = packed->lpPos + count * 3;
+    packed->lpAge8 = ptcl->bPackedAge16 ? nullptr : reinterpret_cast<const BYTE*>(packed->lpSize + count);
+    packed->lpAge16 = ptcl->bPackedAge16 ? packed->lpSize + count : nullptr;
+    return TRUE;
+}
+
+void DecodeParticle(const CHPtcl* ptcl, const CHPtclFrame* frame, DWORD index, XMFLOAT3* pos, float* age, float* size)
+{
+    PackedFrame packed = {};
+    if (!GetPackedFrame(ptcl, frame, &packed))
+    {
+        XMStoreFloat3(pos, frame->lpPos[index]);
+        *age = frame->lpAge[index];
+        *size = frame->lpSize[index];
+        return;
+    }
     
-    CHPtclFrame* currentFrame = &ptcl->lpPtcl[ptcl->nFrame];
+    const WORD* q = packed.lpPos + index * 3;
+    pos->x = frame->PackedMin.x + q[0] * frame->PackedScale.x;
+    pos->y = frame->PackedMin.y + q[1] * frame->PackedScale.y;
+    pos->z = frame->PackedMin.z + q[2] * frame->PackedScale.z;
+    *size = frame->fSizeMin + packed.lpSize[index] * frame->fSizeScale;
+    *age = packed.lpAge16 ? (packed.lpAge16[index] + 0.5f) / 65536.0f : (packed.lpAge8[index] + 0.5f) / 256.0f;
+}
+
+DWORD QuantizeAge(float age, DWORD levels, DWORD cells)
+{
+    // Decoded age is (q + 0.5) / levels; nudge q until it lands in the same
+    // atlas cell as the original, using the float maths of quad generation
+    age = std::clamp(age, 0.0f, 1.0f);
+    float step = 1.0f / levels;
+    auto cellOf = [cells](float value)
+    {
+        return std::min(static_cast<DWORD>(floorf(value * static_cast<float>(cells))), cells - 1);
+    };
     
-    // Generate indices for quads (two triangles per particle)
-    DWORD indexCount = currentFrame->dwCount * 6; // 6 indices per quad
-    WORD* indices = new WORD[indexCount];
+    DWORD cell = cellOf(age);
+    DWORD q = std::min(static_cast<DWORD>(age * levels), levels - 1);
+    while (q + 1 < levels && cellOf((q + 0.5f) * step) < cell)
+        q++;
+    while (q > 0 && cellOf((q + 0.5f) * step) > cell)
+        q--;
+    return q;
+}
+
+void StoreFrame(CHPtcl* ptcl, CHPtclFrame* frame, const XMFLOAT3* pos, const float* age, const float* size,
+                std::vector<BYTE>* block)
+{
+    DWORD count = frame->dwCount;
     
-    for (DWORD i = 0; i < currentFrame->dwCount; i++)
+    if (!block)
     {
-        DWORD baseVertex = i * 4;
-        DWORD baseIndex = i * 6;
-        
-        // First triangle (0, 1, 2)
-        indices[baseIndex] = static_cast<WORD>(baseVertex);
-        indices[baseIndex + 1] = static_cast<WORD>(baseVertex + 1);
-        indices[baseIndex + 2] = static_cast<WORD>(baseVertex + 2);
-        
-        // Second triangle (1, 3, 2)
-        indices[baseIndex + 3] = static_cast<WORD>(baseVertex + 1);
-        indices[baseIndex + 4] = static_cast<WORD>(baseVertex + 3);
-        indices[baseIndex + 5] = static_cast<WORD>(baseVertex + 2);
+        // Uncompressed: the original float arrays
+        frame->lpPos = new XMVECTOR[count];
+        frame->lpAge = new float[count];
+        frame->lpSize = new float[count];
+        for (DWORD i = 0; i < count; i++)
+        {
+            frame->lpPos[i] = XMLoadFloat3(&pos[i]);
+        }
+        memcpy(frame->lpAge, age, sizeof(float) * count);
+        memcpy(frame->lpSize, size, sizeof(float) * count);
+        return;
     }
     
-    D3D11_BUFFER_DESC bufferDesc = {};
-    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = sizeof(WORD) * indexCount;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+    // Frame ranges for 16-bit positions and sizes
+    XMFLOAT3 posMin = pos[0];
+    XMFLOAT3 posMax = pos[0];
+    float sizeMin = size[0];
+    float sizeMax = size[0];
+    for (DWORD i = 1; i < count; i++)
+    {
+        posMin = XMFLOAT3(std::min(posMin.x, pos[i].x), std::min(posMin.y, pos[i].y), std::min(posMin.z, pos[i].z));
+        posMax = XMFLOAT3(std::max(posMax.x, pos[i].x), std::max(posMax.y, pos[i].y), std::max(posMax.z, pos[i].z));
+        sizeMin = std::min(sizeMin, size[i]);
+        sizeMax = std::max(sizeMax, size[i]);
+    }
+    
+    const float levels = 65535.0f;
+    frame->PackedMin = posMin;
+    frame->PackedScale = XMFLOAT3((posMax.x - posMin.x) / levels, (posMax.y - posMin.y) / levels, (posMax.z - posMin.z) / levels);
+    frame->fSizeMin = sizeMin;
+    frame->fSizeScale = (sizeMax - sizeMin) / levels;
     
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = indices;
+    auto quantize = [levels](float value, float minValue, float scale)
+    {
+        return scale > 0.0f ? static_cast<WORD>(std::clamp((value - minValue) / scale + 0.5f, 0.0f, levels)) : WORD(0);
+    };
     
-    BOOL result = SUCCEEDED(g_D3DDevice->CreateBuffer(&bufferDesc, &initData, ptcl->indexBuffer.GetAddressOf()));
+    // Frames start 4-byte aligned so the WORD arrays stay aligned
+    DWORD ageBytes = ptcl->bPackedAge16 ? sizeof(WORD) : sizeof(BYTE);
+    DWORD frameBytes = (count * (sizeof(WORD) * 4 + ageBytes) + 3) & ~3u;
+    frame->dwPackedOffset = static_cast<DWORD>(block->size());
+    block->resize(block->size() + frameBytes);
     
-    delete[] indices;
-    return result;
+    BYTE* data = block->data() + frame->dwPackedOffset;
+    WORD* outPos = reinterpret_cast<WORD*>(data);
+    WORD* outSize = outPos + count * 3;
+    for (DWORD i = 0; i < count; i++)
+    {
+        outPos[i * 3 + 0] = quantize(pos[i].x, posMin.x, frame->PackedScale.x);
+        outPos[i * 3 + 1] = quantize(pos[i].y, posMin.y, frame->PackedScale.y);
+        outPos[i * 3 + 2] = quantize(pos[i].z, posMin.z, frame->PackedScale.z);
+        outSize[i] = quantize(size[i], sizeMin, frame->fSizeScale);
+    }
+    
+    DWORD cells = std::max<DWORD>(ptcl->dwRow * ptcl->dwRow, 1);
+    if (ptcl->bPackedAge16)
+    {
+        WORD* outAge = outSize + count;
+        for (DWORD i = 0; i < count; i++)
+            outAge[i] = static_cast<WORD>(QuantizeAge(age[i], 65536, cells));
+    }
+    else
+    {
+        BYTE* outAge = reinterpret_cast<BYTE*>(outSize + count);
+        for (DWORD i = 0; i < count; i++)
+            outAge[i] = static_cast<BYTE>(QuantizeAge(age[i], 256, cells));
+    }
 }
 
-void UpdateVertexBuffer(CHPtcl* ptcl)
+void FinishPacking(CHPtcl* ptcl, const std::vector<BYTE>& block)
 {
-    if (!ptcl || !ptcl->vertexBuffer || !ptcl->lpVB)
+    if (block.empty())
         return;
     
-    CHPtclFrame* currentFrame = &ptcl->lpPtcl[ptcl->nFrame];
+    ptcl->lpPackedData = new BYTE[block.size()];
+    ptcl->dwPackedSize = static_cast<DWORD>(block.size());
+    memcpy(ptcl->lpPackedData, block.data(), block.size());
+}
+
+BOOL CreateTemplateFromPtcl(CHPtclTemplate** tmpl, CHPtcl* ptcl)
+{
+    if (!tmpl || !ptcl || ptcl->lpTemplate || ptcl->lpEmitter)
+        return FALSE;
     
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    if (SUCCEEDED(g_D3DContext->Map(ptcl->vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
-    {
-        memcpy(mappedResource.pData, ptcl->lpVB, sizeof(CHPtclVertex) * currentFrame->dwCount * 4);
-        g_D3DContext->Unmap(ptcl->vertexBuffer.Get(), 0);
-    }
+    // Built once here and shared read-only by every instance
+    if (ptcl->dwUVTableRow != ptcl->dwRow && !BuildUVTable(ptcl))
+        return FALSE;
+    
+    *tmpl = new CHPtclTemplate();
+    CHPtclTemplate* t = *tmpl;
+    
+    // Take ownership of the effect data, ptcl is unloaded by the caller
+    t->lpName = ptcl->lpName;
+    t->lpTexName = ptcl->lpTexName;
+    t->nTex = ptcl->nTex;
+    t->dwCount = ptcl->dwCount;
+    t->dwRow = ptcl->dwRow;
+    t->lpUVTable = ptcl->lpUVTable;
+    t->lpPtcl = ptcl->lpPtcl;
+    t->dwFrames = ptcl->dwFrames;
+    t->lpPackedData = ptcl->lpPackedData;
+    t->dwPackedSize = ptcl->dwPackedSize;
+    t->bPackedAge16 = ptcl->bPackedAge16;
+    t->dwRefCount = 1;
+    
+    ptcl->lpName = nullptr;
+    ptcl->lpTexName = nullptr;
+    ptcl->lpUVTable = nullptr;
+    ptcl->dwUVTableRow = 0;
+    ptcl->lpPtcl = nullptr;
+    ptcl->dwFrames = 0;
+    ptcl->lpPackedData = nullptr;
+    ptcl->dwPackedSize = 0;
+    
+    return TRUE;
 }
 
-void ReleaseBuffers(CHPtcl* ptcl)
+void ReleaseTemplate(CHPtclTemplate* tmpl)
 {
-    if (!ptcl)
+    if (!tmpl || tmpl->dwRefCount == 0)
         return;
     
-    ptcl->vertexBuffer.Reset();
-    ptcl->indexBuffer.Reset();
+    if (--tmpl->dwRefCount > 0)
+        return;
+    
+    delete[] tmpl->lpName;
+    delete[] tmpl->lpTexName;
+    delete[] tmpl->lpUVTable;
+    if (tmpl->lpPtcl)
+    {
+        for (DWORD i = 0; i < tmpl->dwFrames; i++)
+        {
+            delete[] tmpl->lpPtcl[i].lpPos;
+            delete[] tmpl->lpPtcl[i].lpAge;
+            delete[] tmpl->lpPtcl[i].lpSize;
+        }
+        delete[] tmpl->lpPtcl;
+    }
+    delete[] tmpl->lpPackedData;
+    delete tmpl;
 }
 
 void SetupParticleRenderStates()
@@ -471,7 +1011,7 @@ BOOL LoadPtclFromFile(FILE* file, CHPtcl** ptcl, bool loadTextures)
     if (!file || !ptcl)
         return FALSE;
     
-    *ptcl = new CHPtcl;
+    *ptcl = new CHPtcl();
     Ptcl_Clear(*ptcl);
     
     DWORD temp;
@@ -502,12 +1042,15 @@ BOOL LoadPtclFromFile(FILE* file, CHPtcl** ptcl, bool loadTextures)
     fread(&(*ptcl)->dwCount, sizeof(DWORD), 1, file);
     fread(&(*ptcl)->dwFrames, sizeof(DWORD), 1, file);
     
-    // Allocate vertex and index buffers
-    (*ptcl)->lpVB = new CHPtclVertex[(*ptcl)->dwCount * 4];
-    (*ptcl)->lpIB = new WORD[(*ptcl)->dwCount * 6];
-    
     // Allocate frame data
-    (*ptcl)->lpPtcl = new CHPtclFrame[(*ptcl)->dwFrames];
+    (*ptcl)->lpPtcl = new CHPtclFrame[(*ptcl)->dwFrames]();
+    (*ptcl)->bPackedAge16 = (*ptcl)->dwRow * (*ptcl)->dwRow > 256;
+    
+    // Frames are read through scratch arrays, then packed into one block
+    std::vector<XMFLOAT3> pos;
+    std::vector<float> age;
+    std::vector<float> size;
+    std::vector<BYTE> block;
     
     // Read frame data
     for (DWORD n = 0; n < (*ptcl)->dwFrames; n++)
@@ -518,36 +1061,24 @@ BOOL LoadPtclFromFile(FILE* file, CHPtcl** ptcl, bool loadTextures)
         
         if (frame->dwCount > 0)
         {
-            // Allocate and read positions
-            frame->lpPos = new XMVECTOR[frame->dwCount];
-            for (DWORD i = 0; i < frame->dwCount; i++)
-            {
-                XMFLOAT3 pos;
-                fread(&pos, sizeof(XMFLOAT3), 1, file);
-                frame->lpPos[i] = XMLoadFloat3(&pos);
-            }
-            
-            // Allocate and read ages
-            frame->lpAge = new float[frame->dwCount];
-            fread(frame->lpAge, sizeof(float), frame->dwCount, file);
-            
-            // Allocate and read sizes
-            frame->lpSize = new float[frame->dwCount];
-            fread(frame->lpSize, sizeof(float), frame->dwCount, file);
+            // Read positions, ages and sizes
+            pos.resize(frame->dwCount);
+            age.resize(frame->dwCount);
+            size.resize(frame->dwCount);
+            fread(pos.data(), sizeof(XMFLOAT3), frame->dwCount, file);
+            fread(age.data(), sizeof(float), frame->dwCount, file);
+            fread(size.data(), sizeof(float), frame->dwCount, file);
             
             // Read matrix
             XMFLOAT4X4 matrixData;
             fread(&matrixData, sizeof(XMFLOAT4X4), 1, file);
             frame->matrix = XMLoadFloat4x4(&matrixData);
-        }
-        else
-        {
-            frame->lpPos = nullptr;
-            frame->lpAge = nullptr;
-            frame->lpSize = nullptr;
+            
+            StoreFrame(*ptcl, frame, pos.data(), age.data(), size.data(), g_bPackFrames ? &block : nullptr);
         }
     }
     
+    FinishPacking(*ptcl, block);
     return TRUE;
 }
 
@@ -556,7 +1087,7 @@ BOOL LoadPtclFromPack(HANDLE handle, CHPtcl** ptcl, bool loadTextures)
     if (!handle || handle == INVALID_HANDLE_VALUE || !ptcl)
         return FALSE;
     
-    *ptcl = new CHPtcl;
+    *ptcl = new CHPtcl();
     Ptcl_Clear(*ptcl);
     
     DWORD bytesRead;
@@ -588,12 +1119,15 @@ BOOL LoadPtclFromPack(HANDLE handle, CHPtcl** ptcl, bool loadTextures)
     ReadFile(handle, &(*ptcl)->dwCount, sizeof(DWORD), &bytesRead, nullptr);
     ReadFile(handle, &(*ptcl)->dwFrames, sizeof(DWORD), &bytesRead, nullptr);
     
-    // Allocate vertex and index buffers
-    (*ptcl)->lpVB = new CHPtclVertex[(*ptcl)->dwCount * 4];
-    (*ptcl)->lpIB = new WORD[(*ptcl)->dwCount * 6];
-    
     // Allocate frame data
-    (*ptcl)->lpPtcl = new CHPtclFrame[(*ptcl)->dwFrames];
+    (*ptcl)->lpPtcl = new CHPtclFrame[(*ptcl)->dwFrames]();
+    (*ptcl)->bPackedAge16 = (*ptcl)->dwRow * (*ptcl)->dwRow > 256;
+    
+    // Frames are read through scratch arrays, then packed into one block
+    std::vector<XMFLOAT3> pos;
+    std::vector<float> age;
+    std::vector<float> size;
+    std::vector<BYTE> block;
     
     // Read frame data
     for (DWORD n = 0; n < (*ptcl)->dwFrames; n++)
@@ -604,36 +1138,24 @@ BOOL LoadPtclFromPack(HANDLE handle, CHPtcl** ptcl, bool loadTextures)
         
         if (frame->dwCount > 0)
         {
-            // Allocate and read positions
-            frame->lpPos = new XMVECTOR[frame->dwCount];
-            for (DWORD i = 0; i < frame->dwCount; i++)
-            {
-                XMFLOAT3 pos;
-                ReadFile(handle, &pos, sizeof(XMFLOAT3), &bytesRead, nullptr);
-                frame->lpPos[i] = XMLoadFloat3(&pos);
-            }
-            
-            // Allocate and read ages
-            frame->lpAge = new float[frame->dwCount];
-            ReadFile(handle, frame->lpAge, sizeof(float) * frame->dwCount, &bytesRead, nullptr);
-            
-            // Allocate and read sizes
-            frame->lpSize = new float[frame->dwCount];
-            ReadFile(handle, frame->lpSize, sizeof(float) * frame->dwCount, &bytesRead, nullptr);
+            // Read positions, ages and sizes
+            pos.resize(frame->dwCount);
+            age.resize(frame->dwCount);
+            size.resize(frame->dwCount);
+            ReadFile(handle, pos.data(), sizeof(XMFLOAT3) * frame->dwCount, &bytesRead, nullptr);
+            ReadFile(handle, age.data(), sizeof(float) * frame->dwCount, &bytesRead, nullptr);
+            ReadFile(handle, size.data(), sizeof(float) * frame->dwCount, &bytesRead, nullptr);
             
             // Read matrix
             XMFLOAT4X4 matrixData;
             ReadFile(handle, &matrixData, sizeof(XMFLOAT4X4), &bytesRead, nullptr);
             frame->matrix = XMLoadFloat4x4(&matrixData);
-        }
-        else
-        {
-            frame->lpPos = nullptr;
-            frame->lpAge = nullptr;
-            frame->lpSize = nullptr;
+            
+            StoreFrame(*ptcl, frame, pos.data(), age.data(), size.data(), g_bPackFrames ? &block : nullptr);
         }
     }
     
+    FinishPacking(*ptcl, block);
     return TRUE;
 }
 
@@ -679,22 +1201,35 @@ void ParticleShaderManager::Cleanup()
     m_inputLayout.Reset();
 }
 
+CHPtclFrame* GetCurrentFrame(CHPtcl* ptcl)
+{
+    if (!ptcl)
+        return nullptr;
+    
+    if (ptcl->lpEmitter)
+        return &ptcl->lpEmitter->Frame;
+    
+    if (ptcl->nFrame >= static_cast<int>(ptcl->dwFrames))
+        return nullptr;
+    
+    return &ptcl->lpPtcl[ptcl->nFrame];
+}
+
 void GenerateQuads(CHPtcl* ptcl)
 {
-    if (!ptcl || ptcl->nFrame >= static_cast<int>(ptcl->dwFrames))
+    CHPtclFrame* frame = GetCurrentFrame(ptcl);
+    if (!frame)
         return;
     
-    CHPtclFrame* frame = &ptcl->lpPtcl[ptcl->nFrame];
-    GenerateParticleQuads(ptcl, frame);
+    GenerateParticleQuads(ptcl, frame, nullptr);
 }
 
 void UpdateParticles(CHPtcl* ptcl)
 {
-    if (!ptcl || ptcl->nFrame >= static_cast<int>(ptcl->dwFrames))
+    CHPtclFrame* currentFrame = GetCurrentFrame(ptcl);
+    if (!currentFrame || !currentFrame->lpAge)
         return;
     
-    CHPtclFrame* currentFrame = &ptcl->lpPtcl[ptcl->nFrame];
-    
     // Update particle ages and sizes based on frame data
     for (DWORD i = 0; i < currentFrame->dwCount; i++)
     {
@@ -706,29 +1241,242 @@ void UpdateParticles(CHPtcl* ptcl)
     }
 }
 
-void SortParticlesByDepth(CHPtcl* ptcl)
+CHAffine GetViewTransform(const CHPtcl* ptcl, const CHPtclFrame* frame)
+{
+    // Frame, system and view matrices are all affine
+    CHAffine combined = Affine_Multiply(Affine_FromMatrix(frame->matrix), Affine_FromMatrix(ptcl->matrix));
+    return Affine_Multiply(combined, Affine_FromMatrix(g_ViewMatrix));
+}
+
+BOOL NeedsDepthSort(const CHPtcl* ptcl, int destBlend)
+{
+    // Additive blending is order independent
+    return ptcl && ptcl->bSort && destBlend != CH_BLEND_ONE;
+}
+
+WORD QuantizeDepth(float depth, float farZ, float invRange)
+{
+    // Farthest maps to 0 so an ascending sort draws back to front
+    float t = (farZ - depth) * invRange;
+    t = std::clamp(t, 0.0f, 1.0f);
+    return static_cast<WORD>(t * 65535.0f + 0.5f);
+}
+
+void RadixSortKeys(const WORD* keys, DWORD count, DWORD* order, DWORD* scratch)
+{
+    if (count == 0)
+        return;
+    
+    DWORD histLo[256] = {};
+    DWORD histHi[256] = {};
+    for (DWORD i = 0; i < count; i++)
+    {
+        histLo[keys[i] & 0xFF]++;
+        histHi[keys[i] >> 8]++;
+    }
+    
+    // A pass whose byte is the same for every key would not move anything
+    bool skipLo = histLo[keys[0] & 0xFF] == count;
+    bool skipHi = histHi[keys[0] >> 8] == count;
+    
+    DWORD sumLo = 0;
+    DWORD sumHi = 0;
+    for (DWORD b = 0; b < 256; b++)
+    {
+        DWORD lo = histLo[b];
+        DWORD hi = histHi[b];
+        histLo[b] = sumLo;
+        histHi[b] = sumHi;
+        sumLo += lo;
+        sumHi += hi;
+    }
+    
+    // LSD, two stable 8-bit passes: identity -> scratch -> order
+    for (DWORD i = 0; i < count; i++)
+    {
+        scratch[skipLo ? i : histLo[keys[i] & 0xFF]++] = i;
+    }
+    
+    if (skipHi)
+    {
+        memcpy(order, scratch, sizeof(DWORD) * count);
+        return;
+    }
+    
+    for (DWORD i = 0; i < count; i++)
+    {
+        DWORD index = scratch[i];
+        order[histHi[keys[index] >> 8]++] = index;
+    }
+}
+
+BOOL SortParticlesByDepth(CHPtcl* ptcl, BOOL bBuildOrder)
 {
-    // For proper alpha blending, particles should be sorted back-to-front
-    // This is a simplified implementation - in practice, you'd use the view matrix
-    if (!ptcl || ptcl->nFrame >= static_cast<int>(ptcl->dwFrames))
+    CHPtclFrame* frame = GetCurrentFrame(ptcl);
+    if (!frame)
+        return FALSE;
+    
+    DWORD count = frame->dwCount;
+    ptcl->dwOrderCount = 0;
+    PackedFrame packed = {};
+    BOOL isPacked = GetPackedFrame(ptcl, frame, &packed);
+    if (count == 0 || (!frame->lpPos && !isPacked))
+        return FALSE;
+    
+    // Only view-space z is needed: third row of the combined transform
+    CHAffine combined = GetViewTransform(ptcl, frame);
+    XMFLOAT4 row;
+    XMStoreFloat4(&row, combined.r[2]);
+    
+    t_SortScratch.Resize(count);
+    float* depths = t_SortScratch.depths.data();
+    
+    float nearZ = FLT_MAX;
+    float farZ = -FLT_MAX;
+    for (DWORD i = 0; i < count; i++)
+    {
+        XMFLOAT3 pos;
+        if (isPacked)
+        {
+            const WORD* q = packed.lpPos + i * 3;
+            pos = XMFLOAT3(frame->PackedMin.x + q[0] * frame->PackedScale.x,
+                           frame->PackedMin.y + q[1] * frame->PackedScale.y,
+                           frame->PackedMin.z + q[2] * frame->PackedScale.z);
+        }
+        else
+        {
+            XMStoreFloat3(&pos, frame->lpPos[i]);
+        }
+        float z = row.x * pos.x + row.y * pos.y + row.z * pos.z + row.w;
+        depths[i] = z;
+        nearZ = std::min(nearZ, z);
+        farZ = std::max(farZ, z);
+    }
+    ptcl->fViewDepth = (nearZ + farZ) * 0.5f;
+    
+    if (!bBuildOrder)
+        return TRUE;
+    
+    if (ptcl->dwOrderCapacity < count)
+    {
+        delete[] ptcl->lpOrder;
+        ptcl->lpOrder = new DWORD[count];
+        ptcl->dwOrderCapacity = count;
+    }
+    
+    // 16-bit keys over this frame's depth range
+    float invRange = farZ > nearZ ? 1.0f / (farZ - nearZ) : 0.0f;
+    WORD* keys = t_SortScratch.keys.data();
+    for (DWORD i = 0; i < count; i++)
+    {
+        keys[i] = QuantizeDepth(depths[i], farZ, invRange);
+    }
+    
+    RadixSortKeys(keys, count, ptcl->lpOrder, t_SortScratch.scratch.data());
+    ptcl->dwOrderCount = count;
+    return TRUE;
+}
+
+void OrderByViewDepth(std::vector<CHPtcl*>& systems)
+{
+    DWORD count = static_cast<DWORD>(systems.size());
+    if (count < 2)
         return;
     
-    // TODO: Implement depth sorting based on camera position
-    // For now, we assume particles are already in correct order
+    float nearZ = FLT_MAX;
+    float farZ = -FLT_MAX;
+    for (CHPtcl* ptcl : systems)
+    {
+        nearZ = std::min(nearZ, ptcl->fViewDepth);
+        farZ = std::max(farZ, ptcl->fViewDepth);
+    }
+    
+    // Systems are ordered by their view-depth centre with the same radix sort
+    t_SortScratch.Resize(count);
+    float invRange = farZ > nearZ ? 1.0f / (farZ - nearZ) : 0.0f;
+    for (DWORD i = 0; i < count; i++)
+    {
+        t_SortScratch.keys[i] = QuantizeDepth(systems[i]->fViewDepth, farZ, invRange);
+    }
+    
+    static thread_local std::vector<DWORD> order;
+    static thread_local std::vector<CHPtcl*> sorted;
+    order.resize(count);
+    RadixSortKeys(t_SortScratch.keys.data(), count, order.data(), t_SortScratch.scratch.data());
+    
+    sorted.resize(count);
+    for (DWORD i = 0; i < count; i++)
+    {
+        sorted[i] = systems[order[i]];
+    }
+    systems.swap(sorted);
 }
 
-BOOL RenderParticleSystem(CHPtcl* ptcl, int srcBlend, int destBlend)
+void SortScratch::Resize(DWORD count)
+{
+    if (depths.size() >= count)
+        return;
+    
+    depths.resize(count);
+    keys.resize(count);
+    scratch.resize(count);
+}
+
+void ApplyParticleStates(int srcBlend, int destBlend)
+{
+    SetRenderState(CH_RS_ALPHABLENDENABLE, TRUE);
+    SetRenderState(CH_RS_SRCBLEND, srcBlend);
+    SetRenderState(CH_RS_DESTBLEND, destBlend);
+    SetRenderState(CH_RS_ALPHATESTENABLE, TRUE);
+    SetRenderState(CH_RS_ALPHAREF, 0x08);
+    SetRenderState(CH_RS_ALPHAFUNC, CH_CMP_GREATEREQUAL);
+}
+
+BOOL DrawCurrentFrame(CHPtcl* ptcl, int srcBlend, int destBlend)
 {
-    if (!ptcl || ptcl->nFrame >= static_cast<int>(ptcl->dwFrames))
+    CHPtclFrame* frame = GetCurrentFrame(ptcl);
+    if (!frame)
         return FALSE;
     
-    CHPtclFrame* currentFrame = &ptcl->lpPtcl[ptcl->nFrame];
+    if (frame->dwCount == 0)
+        return TRUE;
     
-    // Create buffers if needed
-    if (!ptcl->vertexBuffer && !CreateVertexBuffer(ptcl))
+    // Generate particle quads (in depth order when it was sorted)
+    const DWORD* order = ptcl->dwOrderCount == frame->dwCount ? ptcl->lpOrder : nullptr;
+    if (!GenerateParticleQuads(ptcl, frame, order))
+        return FALSE;
+    
+    // Set render states
+    ApplyParticleStates(srcBlend, destBlend);
+    
+    // Set texture
+    if (ptcl->nTex >= 0 && ptcl->nTex < TEX_MAX && g_lpTex[ptcl->nTex])
+    {
+        SetTexture(0, g_lpTex[ptcl->nTex]->lpSRV.Get());
+    }
+    
+    // Set vertex and index buffers
+    CHInternal::g_DynamicVertexRing.Bind(ptcl->vertexStride);
+    CHInternal::g_QuadIndexBuffer.Bind();
+    
+    // Set shaders
+    g_ParticleShaderManager.SetParticleShaders();
+    
+    // Draw particles
+    CHInternal::g_QuadIndexBuffer.DrawQuads(frame->dwCount, ptcl->baseVertex);
+    
+    return TRUE;
+}
+
+BOOL RenderParticleSystem(CHPtcl* ptcl, int srcBlend, int destBlend)
+{
+    CHPtclFrame* currentFrame = GetCurrentFrame(ptcl);
+    if (!currentFrame)
         return FALSE;
     
-    if (!ptcl->indexBuffer && !CreateIndexBuffer(ptcl))
+    // Resubmit the quads if their ring allocation was discarded
+    const DWORD* order = ptcl->dwOrderCount == currentFrame->dwCount ? ptcl->lpOrder : nullptr;
+    if (!CHInternal::g_DynamicVertexRing.IsValid(ptcl->dwRingGeneration) && !GenerateParticleQuads(ptcl, currentFrame, order))
         return FALSE;
     
     // Set texture if available
@@ -742,12 +1490,11 @@ BOOL RenderParticleSystem(CHPtcl* ptcl, int srcBlend, int destBlend)
     SetRenderState(CH_RS_DESTBLEND, destBlend);
     
     // Set vertex and index buffers
-    g_D3DContext->IASetVertexBuffers(0, 1, ptcl->vertexBuffer.GetAddressOf(), &ptcl->vertexStride, &ptcl->vertexOffset);
-    g_D3DContext->IASetIndexBuffer(ptcl->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
-    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+    CHInternal::g_DynamicVertexRing.Bind(ptcl->vertexStride);
+    CHInternal::g_QuadIndexBuffer.Bind();
     
     // Draw particles
-    g_D3DContext->DrawIndexed(currentFrame->dwCount * 6, 0, 0);
+    CHInternal::g_QuadIndexBuffer.DrawQuads(currentFrame->dwCount, ptcl->baseVertex);
     
     return TRUE;
 }
@@ -9,6 +9,7 @@
 
 #include "CH_common.h"
 #include "CH_texture.h"
+#include "CH_affine.h"
 
 // Particle vertex structure for rendering
 struct CHPtclVertex {
@@ -24,35 +25,82 @@ struct CHPtclFrame {
     float* lpAge;               // Particle ages
     float* lpSize;              // Particle sizes
     XMMATRIX matrix;           // Frame transformation matrix
+
+    // Compressed particles (lpPos/lpAge/lpSize are nullptr when packed)
+    DWORD dwPackedOffset;       // Byte offset into CHPtcl::lpPackedData
+    XMFLOAT3 PackedMin;         // Position bounds minimum
+    XMFLOAT3 PackedScale;       // Position step per 16-bit unit
+    float fSizeMin;             // Size range minimum
+    float fSizeScale;           // Size step per 16-bit unit
+};
+
+struct CHPtclEmitter;
+struct CHEmitterDesc;
+struct CHPtcl;
+
+// Shared, immutable data of a baked effect (one per .ptcl file)
+struct CHPtclTemplate {
+    char* lpName;               // Particle system name
+    char* lpTexName;            // Texture name
+    int nTex;                   // Texture ID
+    DWORD dwCount;              // Maximum particle count
+    DWORD dwRow;                // Texture rows (for animation)
+    XMFLOAT2* lpUVTable;        // Atlas cell UVs (dwRow * dwRow entries)
+
+    CHPtclFrame* lpPtcl;        // Frame data array
+    DWORD dwFrames;             // Total frames
+    BYTE* lpPackedData;         // Compressed frames (see CHPtcl)
+    DWORD dwPackedSize;
+    BOOL bPackedAge16;
+
+    std::vector<CHPtcl*> Instances; // Live instances (for Ptcl_DrawTemplate)
+    DWORD dwRefCount;           // Owner plus live instances
 };
 
-// Particle system structure (maintains exact same layout as C3Ptcl)
+// Particle system structure (C3Ptcl's fields plus UV table, emitter, packing and sort state)
 struct CHPtcl {
     char* lpName;               // Particle system name
-    CHPtclVertex* lpVB;         // Vertex buffer (CPU side)
-    WORD* lpIB;                 // Index buffer (CPU side)
     int nTex;                   // Texture ID
     char* lpTexName;            // Texture name (for plugin use)
     DWORD dwCount;              // Maximum particle count
     DWORD dwRow;                // Texture rows (for animation)
+    XMFLOAT2* lpUVTable;        // Atlas cell UVs (dwRow * dwRow entries, instances share the template's)
+    DWORD dwUVTableRow;         // dwRow the table was built for
 
     CHPtclFrame* lpPtcl;        // Frame data array
     int nFrame;                 // Current frame
     DWORD dwFrames;             // Total frames
+    CHPtclEmitter* lpEmitter;   // Runtime emitter (nullptr = baked frames)
+    CHPtclTemplate* lpTemplate; // Shared effect (instances only, frame data aliases it)
+
+    // All baked frames in one block, lpPtcl is the offset table
+    BYTE* lpPackedData;         // Per frame: WORD xyz[n], WORD size[n], age[n]
+    DWORD dwPackedSize;         // Bytes in lpPackedData
+    BOOL bPackedAge16;          // 16-bit ages (atlas over 256 cells), else 8-bit
 
     XMMATRIX matrix;           // Transformation matrix
 
+    // Back-to-front order of the current frame
+    BOOL bSort;                 // Depth sort when blending is not additive
+    DWORD* lpOrder;             // Particle permutation (far to near)
+    DWORD dwOrderCapacity;      // Entries allocated in lpOrder
+    DWORD dwOrderCount;         // Entries valid in lpOrder (0 = file order)
+    float fViewDepth;           // View-space depth centre (for ordering systems)
+
     // DirectX 11 specific data (internal use)
-    CHComPtr<ID3D11Buffer> vertexBuffer = nullptr;
-    CHComPtr<ID3D11Buffer> indexBuffer = nullptr;
     UINT vertexStride;
-    UINT vertexOffset;
+    UINT baseVertex;            // Quads in the dynamic vertex ring
+    DWORD dwRingGeneration;     // Ring generation of that upload
 };
 
 // Function declarations (maintaining exact same signatures as original)
 CH_CORE_DLL_API
 void Ptcl_Clear(CHPtcl* lpPtcl);
 
+// Create a system simulated from an emitter description instead of baked frames
+CH_CORE_DLL_API
+BOOL Ptcl_Create(CHPtcl** lpPtcl, const CHEmitterDesc* lpDesc, int nTex = -1, DWORD dwRow = 1);
+
 CH_CORE_DLL_API
 BOOL Ptcl_Load(CHPtcl** lpPtcl, FILE* file, BOOL bTex = FALSE);
 
@@ -65,18 +113,57 @@ BOOL Ptcl_Save(char* lpName, CHPtcl* lpPtcl, BOOL bNew);
 CH_CORE_DLL_API
 void Ptcl_Unload(CHPtcl** lpPtcl);
 
+// Templates: load an effect once, then spawn instances that only carry
+// their frame, matrix, texture override and ring slot
+CH_CORE_DLL_API
+BOOL Ptcl_LoadTemplate(CHPtclTemplate** lpTemplate, FILE* file, BOOL bTex = FALSE);
+
+CH_CORE_DLL_API
+BOOL Ptcl_LoadTemplatePack(CHPtclTemplate** lpTemplate, HANDLE f, BOOL bTex = FALSE);
+
+// Drops the owner reference; the effect is freed once the last instance is unloaded
+CH_CORE_DLL_API
+void Ptcl_UnloadTemplate(CHPtclTemplate** lpTemplate);
+
+CH_CORE_DLL_API
+BOOL Ptcl_CreateInstance(CHPtcl** lpPtcl, CHPtclTemplate* lpTemplate);
+
+// Keep baked frames of subsequently loaded systems compressed (default on)
+CH_CORE_DLL_API
+void Ptcl_SetFrameCompression(BOOL bPack);
+
 CH_CORE_DLL_API
 void Ptcl_Prepare();
 
 CH_CORE_DLL_API
 BOOL Ptcl_Draw(CHPtcl* lpPtcl, int nAsb = 5, int nAdb = 6);
 
+// Draw several systems back to front (by view-depth centre), each depth sorted
+CH_CORE_DLL_API
+BOOL Ptcl_DrawSorted(CHPtcl** lpPtcl, DWORD dwCount, int nAsb = 5, int nAdb = 6);
+
+// Draw several systems from one vertex ring allocation (runs split by texture)
+CH_CORE_DLL_API
+BOOL Ptcl_DrawInstances(CHPtcl** lpPtcl, DWORD dwCount, int nAsb = 5, int nAdb = 6);
+
+// Draw every live instance of a template
+CH_CORE_DLL_API
+BOOL Ptcl_DrawTemplate(CHPtclTemplate* lpTemplate, int nAsb = 5, int nAdb = 6);
+
+// Enable/disable per-particle depth sorting (additive systems never sort)
+CH_CORE_DLL_API
+void Ptcl_SetSort(CHPtcl* lpPtcl, BOOL bSort);
+
 CH_CORE_DLL_API
 void Ptcl_NextFrame(CHPtcl* lpPtcl, int nStep);
 
 CH_CORE_DLL_API
 void Ptcl_SetFrame(CHPtcl* lpPtcl, DWORD dwFrame);
 
+// Advance several systems; emitter-driven ones simulate on the worker threads
+CH_CORE_DLL_API
+void Ptcl_NextFrameBatch(CHPtcl** lpPtcl, DWORD dwCount, int nStep);
+
 CH_CORE_DLL_API
 void Ptcl_Muliply(CHPtcl* lpPtcl, XMMATRIX* matrix);
 
@@ -89,19 +176,61 @@ void Ptcl_ChangeTexture(CHPtcl* lpPtcl, int nTexID);
 // Internal particle system implementation
 namespace CHPtclInternal {
     // Particle simulation
+    CHPtclFrame* GetCurrentFrame(CHPtcl* ptcl);
     void UpdateParticles(CHPtcl* ptcl);
     void GenerateQuads(CHPtcl* ptcl);
-    void GenerateParticleQuads(CHPtcl* ptcl, CHPtclFrame* frame);
-    void SortParticlesByDepth(CHPtcl* ptcl);
+    BOOL GenerateParticleQuads(CHPtcl* ptcl, CHPtclFrame* frame, const DWORD* lpOrder);
+    BOOL WriteParticleQuads(CHPtcl* ptcl, const CHPtclFrame* frame, const DWORD* lpOrder, float* out);
+    BOOL BuildUVTable(CHPtcl* ptcl);
+    CHAffine GetViewTransform(const CHPtcl* ptcl, const CHPtclFrame* frame);
+
+    // Depth sorting (16-bit quantized view depth, LSD radix sort)
+    BOOL NeedsDepthSort(const CHPtcl* ptcl, int destBlend);
+    BOOL SortParticlesByDepth(CHPtcl* ptcl, BOOL bBuildOrder);
+    CH_CORE_DLL_API WORD QuantizeDepth(float depth, float farZ, float invRange);
+    CH_CORE_DLL_API void RadixSortKeys(const WORD* keys, DWORD count, DWORD* order, DWORD* scratch);
+    void OrderByViewDepth(std::vector<CHPtcl*>& systems);
+
+    // Scratch for depth sorting (reused across frames, one per thread)
+    struct SortScratch {
+        std::vector<float> depths;
+        std::vector<WORD> keys;
+        std::vector<DWORD> scratch;
+
+        void Resize(DWORD count);
+    };
+
+    extern thread_local SortScratch t_SortScratch;
+    
+    // Compressed frames (16-bit positions and sizes over the frame range,
+    // 8 or 16-bit ages that keep the atlas cell exact)
+    struct PackedFrame {
+        const WORD* lpPos;      // x y z per particle
+        const WORD* lpSize;
+        const BYTE* lpAge8;     // Set when ages are 8-bit
+        const WORD* lpAge16;    // Set when ages are 16-bit
+    };
+    
+    extern BOOL g_bPackFrames;
+    
+    BOOL GetPackedFrame(const CHPtcl* ptcl, const CHPtclFrame* frame, PackedFrame* packed);
+    CH_CORE_DLL_API void DecodeParticle(const CHPtcl* ptcl, const CHPtclFrame* frame, DWORD index, XMFLOAT3* pos, float* age, float* size);
+    CH_CORE_DLL_API void StoreFrame(CHPtcl* ptcl, CHPtclFrame* frame, const XMFLOAT3* pos, const float* age, const float* size,
+                    std::vector<BYTE>* block);
+    CH_CORE_DLL_API void FinishPacking(CHPtcl* ptcl, const std::vector<BYTE>& block);
+    CH_CORE_DLL_API DWORD QuantizeAge(float age, DWORD levels, DWORD cells);
     
     // Buffer management
-    BOOL CreateVertexBuffer(CHPtcl* ptcl);
-    BOOL CreateIndexBuffer(CHPtcl* ptcl);
-    void UpdateVertexBuffer(CHPtcl* ptcl);
     void ReleaseBuffers(CHPtcl* ptcl);
     
+    // Template management
+    BOOL CreateTemplateFromPtcl(CHPtclTemplate** tmpl, CHPtcl* ptcl);
+    void ReleaseTemplate(CHPtclTemplate* tmpl);
+    
     // Rendering
     void SetupParticleRenderStates();
+    void ApplyParticleStates(int srcBlend, int destBlend);
+    BOOL DrawCurrentFrame(CHPtcl* ptcl, int srcBlend, int destBlend);
     BOOL RenderParticleSystem(CHPtcl* ptcl, int srcBlend, int destBlend);
     
     // File I/O
@@ -125,6 +254,7 @@ namespace CHPtclInternal {
 
 // Compatibility types
 typedef CHPtcl C3Ptcl;
+typedef CHPtclTemplate C3PtclTemplate;
 typedef CHPtclVertex PtclVertex;
 typedef CHPtclFrame PtclFrame;
 
@@ -0,0 +1,258 @@
+#include "CH_queue.h"
+#include "CH_main.h"
+#include "CH_backend.h"
+
+namespace CHQueueInternal {
+    BOOL g_bEnabled = FALSE;
+    std::vector<RenderQueue*> g_Queues;
+    std::mutex g_QueueMutex;
+
+    // Gathered packets and their sorted order (reused every flush)
+    static std::vector<CHRenderPacket> g_Packets;
+    static std::vector<SortItem> g_Order;
+    static std::vector<XMFLOAT4X4> g_Worlds;
+
+    // Queue of the calling thread, valid while its generation matches
+    static thread_local RenderQueue* t_lpQueue = nullptr;
+    static thread_local DWORD t_dwGeneration = 0;
+    static std::atomic<DWORD> g_dwGeneration{ 1 };   // Read without the lock on the fast path
+
+    static DWORD g_dwLastPackets = 0;
+    static DWORD g_dwLastBinds = 0;
+}
+
+CH_CORE_DLL_API
+void RenderQueue_Enable(BOOL bEnable)
+{
+    // Packets still queued are drawn before switching back to immediate mode
+    if (!bEnable && CHQueueInternal::g_bEnabled)
+        RenderQueue_Flush();
+
+    CHQueueInternal::g_bEnabled = bEnable;
+}
+
+CH_CORE_DLL_API
+void RenderQueue_SetLayer(DWORD dwLayer)
+{
+    CHQueueInternal::RenderQueue* queue = CHQueueInternal::GetThreadQueue();
+    if (queue)
+        queue->dwLayer = std::min<DWORD>(dwLayer, 0xFF);
+}
+
+CH_CORE_DLL_API
+BOOL RenderQueue_Flush()
+{
+    using namespace CHQueueInternal;
+
+    g_Packets.clear();
+    g_Order.clear();
+
+    {
+        std::lock_guard<std::mutex> lock(g_QueueMutex);
+        for (RenderQueue* queue : g_Queues)
+        {
+            std::lock_guard<std::mutex> queueLock(queue->Mutex);
+            g_Packets.insert(g_Packets.end(), queue->Packets.begin(), queue->Packets.end());
+            queue->Packets.clear();
+        }
+    }
+
+    if (g_Packets.empty())
+    {
+        g_dwLastPackets = 0;
+        g_dwLastBinds = 0;
+        return TRUE;
+    }
+
+    // Sort small (key, index) pairs instead of whole packets
+    g_Order.resize(g_Packets.size());
+    for (DWORD i = 0; i < g_Order.size(); i++)
+    {
+        g_Order[i].qwKey = g_Packets[i].qwKey;
+        g_Order[i].dwIndex = i;
+    }
+    std::sort(g_Order.begin(), g_Order.end(), [](const SortItem& a, const SortItem& b)
+    {
+        return a.qwKey != b.qwKey ? a.qwKey < b.qwKey : a.dwIndex < b.dwIndex;
+    });
+
+    Replay(g_Packets, g_Order);
+    return TRUE;
+}
+
+CH_CORE_DLL_API
+void RenderQueue_GetStats(DWORD* lpPackets, DWORD* lpBinds)
+{
+    if (lpPackets)
+        *lpPackets = CHQueueInternal::g_dwLastPackets;
+    if (lpBinds)
+        *lpBinds = CHQueueInternal::g_dwLastBinds;
+}
+
+namespace CHQueueInternal {
+
+    RenderQueue* GetThreadQueue()
+    {
+        if (t_lpQueue && t_dwGeneration == g_dwGeneration)
+            return t_lpQueue;
+
+        std::lock_guard<std::mutex> lock(g_QueueMutex);
+        if (!t_lpQueue || t_dwGeneration != g_dwGeneration)
+        {
+            t_lpQueue = new RenderQueue();
+            t_dwGeneration = g_dwGeneration;
+            g_Queues.push_back(t_lpQueue);
+        }
+        return t_lpQueue;
+    }
+
+    UINT64 MakeKey(DWORD layer, BOOL translucent, DWORD shader, int tex, int lightmap, float viewDepth)
+    {
+        // Positive floats order like their bit patterns; keep the top 24 bits
+        float depth = viewDepth > 0.0f ? viewDepth : 0.0f;
+        UINT32 depthBits;
+        memcpy(&depthBits, &depth, sizeof(depthBits));
+        UINT64 quantDepth = depthBits >> 8;
+
+        UINT64 texBits = static_cast<UINT64>(tex < 0 ? 0x3FFF : tex & 0x3FFF);
+        UINT64 lightBits = static_cast<UINT64>(lightmap < 0 ? 0x3FFF : lightmap & 0x3FFF);
+        UINT64 material = (static_cast<UINT64>(shader & 0x7) << 28) | (texBits << 14) | lightBits;
+
+        UINT64 key = static_cast<UINT64>(layer & 0xFF) << 56;
+        if (translucent)
+        {
+            // Back to front: farther packets get smaller keys
+            key |= 1ull << 55;
+            key |= ((~quantDepth) & 0xFFFFFF) << 31;
+            key |= material;
+        }
+        else
+        {
+            // Grouped by material, front to back within it
+            key |= material << 24;
+            key |= quantDepth;
+        }
+        return key;
+    }
+
+    void Record(CHRenderPacket& packet, BOOL translucent, int tex, int lightmap, float viewDepth)
+    {
+        RenderQueue* queue = GetThreadQueue();
+        packet.qwKey = MakeKey(queue->dwLayer, translucent, packet.dwShader, tex, lightmap, viewDepth);
+
+        // Only the owning thread appends, so the lock is only contended by the flush
+        std::lock_guard<std::mutex> lock(queue->Mutex);
+        queue->Packets.push_back(packet);
+    }
+
+    void Replay(const std::vector<CHRenderPacket>& packets, const std::vector<SortItem>& order)
+    {
+        if (!g_D3DContext)
+            return;
+
+        DWORD binds = 0;
+        const CHRenderPacket* last = nullptr;
+
+        // With a constant ring, every world the sorted packets switch to is uploaded in one map
+        BOOL batched = FALSE;
+        UINT worldSlot = 0;
+        if (CHInternal::g_ConstantBuffers.IsRing())
+        {
+            g_Worlds.clear();
+            for (const SortItem& item : order)
+            {
+                const CHRenderPacket& packet = packets[item.dwIndex];
+                if (!last || memcmp(&packet.matWorld, &last->matWorld, sizeof(XMFLOAT4X4)) != 0)
+                    g_Worlds.push_back(packet.matWorld);
+                last = &packet;
+            }
+            last = nullptr;
+
+            batched = CHInternal::g_ConstantBuffers.WriteObjects(g_Worlds.data(),
+                static_cast<UINT>(g_Worlds.size()), &worldSlot);
+        }
+
+        g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+        CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+        for (const SortItem& item : order)
+        {
+            const CHRenderPacket& packet = packets[item.dwIndex];
+
+            if (!last || packet.dwShader != last->dwShader)
+            {
+                if (packet.dwShader == CH_QUEUE_SHADER_LIGHTMAP)
+                    CHInternal::g_CompatibilityShaderManager.SetLightmapShaders();
+                else
+                    CHInternal::g_CompatibilityShaderManager.SetDefaultShaders();
+                binds++;
+            }
+
+            if (!last || packet.lpVB != last->lpVB || packet.dwStride != last->dwStride || packet.dwOffset != last->dwOffset)
+            {
+                g_D3DContext->IASetVertexBuffers(0, 1, &packet.lpVB, &packet.dwStride, &packet.dwOffset);
+                binds++;
+            }
+
+            if (!last || packet.lpIB != last->lpIB || packet.ibFormat != last->ibFormat)
+            {
+                g_D3DContext->IASetIndexBuffer(packet.lpIB, packet.ibFormat, 0);
+                binds++;
+            }
+
+            for (DWORD stage = 0; stage < 2; stage++)
+            {
+                if (!last || packet.lpTexture[stage] != last->lpTexture[stage])
+                {
+                    SetTexture(stage, packet.lpTexture[stage]);
+                    binds++;
+                }
+            }
+
+            if (!last || memcmp(&packet.matWorld, &last->matWorld, sizeof(XMFLOAT4X4)) != 0)
+            {
+                if (batched)
+                    CHInternal::g_ConstantBuffers.BindObject(worldSlot++);
+                else
+                    CHInternal::g_ConstantBuffers.SetObject(XMLoadFloat4x4(&packet.matWorld));
+                binds++;
+            }
+
+            // The state manager drops unchanged values and binds once at the draw
+            SetRenderState(CH_RS_ZENABLE, packet.bZEnable);
+            SetRenderState(CH_RS_ZWRITEENABLE, packet.bZWrite);
+            SetRenderState(CH_RS_CULLMODE, packet.dwCullMode);
+            SetRenderState(CH_RS_ALPHABLENDENABLE, packet.bAlphaBlend);
+            if (packet.bAlphaBlend)
+            {
+                SetRenderState(CH_RS_SRCBLEND, packet.dwSrcBlend);
+                SetRenderState(CH_RS_DESTBLEND, packet.dwDestBlend);
+            }
+
+            CHInternal::g_RenderStateManager.CommitStates();
+            CHBackendInternal::DrawIndexed(packet.dwIndexCount, packet.dwStartIndex, packet.nBaseVertex);
+
+            last = &packet;
+        }
+
+        g_dwLastPackets = static_cast<DWORD>(order.size());
+        g_dwLastBinds = binds;
+    }
+
+    void Cleanup()
+    {
+        std::lock_guard<std::mutex> lock(g_QueueMutex);
+
+        for (RenderQueue* queue : g_Queues)
+            delete queue;
+        g_Queues.clear();
+
+        // Threads still holding a queue pointer allocate a new one
+        g_dwGeneration++;
+
+        g_Packets.clear();
+        g_Order.clear();
+        g_Worlds.clear();
+        g_bEnabled = FALSE;
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef _CH_queue_h_
+#define _CH_queue_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Layer of packets recorded by a thread that never set one
+#define CH_QUEUE_LAYER_DEFAULT  0x80
+
+// Shader set a packet is drawn with
+enum CHQueueShader {
+    CH_QUEUE_SHADER_DEFAULT = 0,        // CompatibilityShaderManager::SetDefaultShaders
+    CH_QUEUE_SHADER_LIGHTMAP = 1,       // CompatibilityShaderManager::SetLightmapShaders
+};
+
+// Recorded draw (buffers are referenced, not copied: they must live until the flush)
+struct CHRenderPacket {
+    UINT64 qwKey;                       // Sort key (see CHQueueInternal::MakeKey)
+
+    // Buffers
+    ID3D11Buffer* lpVB;
+    UINT dwStride;
+    UINT dwOffset;
+    ID3D11Buffer* lpIB;
+    DXGI_FORMAT ibFormat;
+    UINT dwIndexCount;
+    UINT dwStartIndex;
+    INT nBaseVertex;
+
+    // Constant block
+    XMFLOAT4X4 matWorld;
+
+    // State block
+    DWORD dwShader;                     // CHQueueShader
+    ID3D11ShaderResourceView* lpTexture[2];
+    BOOL bZEnable;
+    BOOL bZWrite;
+    DWORD dwCullMode;
+    BOOL bAlphaBlend;
+    DWORD dwSrcBlend;
+    DWORD dwDestBlend;
+};
+
+/*
+    Render queue
+    ------------
+    While enabled, Scene_Draw records a packet into the calling thread's
+    queue instead of drawing. RenderQueue_Flush (also run by End3D) sorts
+    the packets of every thread by key and replays them: by layer, opaque
+    front to back, then alpha back to front. Recording threads must be
+    done before the flush.
+*/
+CH_CORE_DLL_API
+void RenderQueue_Enable(BOOL bEnable);
+
+// Layer of the packets the calling thread records from now on (0 - 255, drawn in order)
+CH_CORE_DLL_API
+void RenderQueue_SetLayer(DWORD dwLayer);
+
+CH_CORE_DLL_API
+BOOL RenderQueue_Flush();
+
+// Last flush: packets drawn and D3D11 binds issued for them
+CH_CORE_DLL_API
+void RenderQueue_GetStats(DWORD* lpPackets, DWORD* lpBinds);
+
+// Internal render queue management
+namespace CHQueueInternal {
+    // Packets recorded by one thread
+    struct RenderQueue {
+        std::vector<CHRenderPacket> Packets;
+        DWORD dwLayer = CH_QUEUE_LAYER_DEFAULT;
+        std::mutex Mutex;               // Only contended by the flush
+    };
+
+    // Packet order after sorting (index breaks ties in recording order)
+    struct SortItem {
+        UINT64 qwKey;
+        DWORD dwIndex;
+    };
+
+    extern BOOL g_bEnabled;
+    extern std::vector<RenderQueue*> g_Queues;
+    extern std::mutex g_QueueMutex;     // Guards g_Queues
+
+    RenderQueue* GetThreadQueue();
+
+    // Sort key, most significant first:
+    //   layer(8) | translucent(1) | opaque: shader(3) texture(14) lightmap(14) depth(24)
+    //                             | alpha:  ~depth(24) shader(3) texture(14) lightmap(14)
+    CH_CORE_DLL_API UINT64 MakeKey(DWORD layer, BOOL translucent, DWORD shader, int tex, int lightmap, float viewDepth);
+
+    // Keys the packet with the calling thread's layer and queues it
+    void Record(CHRenderPacket& packet, BOOL translucent, int tex, int lightmap, float viewDepth);
+
+    // Single submission path, binding only what differs from the previous packet
+    void Replay(const std::vector<CHRenderPacket>& packets, const std::vector<SortItem>& order);
+
+    void Cleanup();
+}
+
+// Compatibility types
+typedef CHRenderPacket C3RenderPacket;
+
+#endif // _CH_queue_h_
@@ -1,6 +1,10 @@
 #include "CH_scene.h"
 #include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_backend.h"
 #include "CH_camera.h"
+#include "CH_queue.h"
+#include "CH_instance.h"
 
 CH_CORE_DLL_API
 void Scene_Clear(CHScene* lpScene)
@@ -29,6 +33,9 @@ void Scene_Clear(CHScene* lpScene)
     lpScene->indexBuffer.Reset();
     lpScene->vertexStride = sizeof(CHSceneVertex);
     lpScene->vertexOffset = 0;
+
+    lpScene->vCenter = XMFLOAT3(0.0f, 0.0f, 0.0f);
+    lpScene->fRadius = 0.0f;
 }
 
 CH_CORE_DLL_API
@@ -356,18 +363,48 @@ BOOL Scene_Optimize(CHScene* lpScene)
 CH_CORE_DLL_API
 void Scene_Prepare()
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     CHSceneInternal::SetupSceneRenderStates();
 }
 
 CH_CORE_DLL_API
 BOOL Scene_Draw(CHScene* lpScene)
 {
-    if (!lpScene || lpScene->nTex < 0 || !g_lpTex[lpScene->nTex])
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
+    if (!lpScene || lpScene->nTex < 0 || lpScene->nTex >= TEX_MAX || !g_lpTex[lpScene->nTex])
         return FALSE;
 
+    // Set world matrix (frame animation + additional transformation)
+    XMMATRIX worldMatrix = XMMatrixIdentity();
+    if (lpScene->dwFrameCount > 0 && lpScene->lpFrame)
+    {
+        worldMatrix = lpScene->lpFrame[lpScene->nFrame % lpScene->dwFrameCount];
+    }
+    worldMatrix = XMMatrixMultiply(worldMatrix, lpScene->matrix);
+
+    // Instanced: opaque placements are grouped by SceneInstance_Flush
+    if (CHInstanceInternal::g_bEnabled && lpScene->vertexBuffer && lpScene->indexBuffer &&
+        !CHSceneInternal::ShouldUseAlphaBlending(g_lpTex[lpScene->nTex]))
+    {
+        CHInstanceInternal::Record(lpScene, worldMatrix);
+        lpScene->matrix = XMMatrixIdentity();
+        return TRUE;
+    }
+
+    // Queued: drawn sorted by RenderQueue_Flush
+    if (CHQueueInternal::g_bEnabled)
+    {
+        BOOL recorded = CHSceneInternal::RecordScene(lpScene, worldMatrix);
+        lpScene->matrix = XMMatrixIdentity();
+        return recorded;
+    }
+
     // Set alpha blending based on texture format (matching original logic)
     if (CHSceneInternal::ShouldUseAlphaBlending(g_lpTex[lpScene->nTex]))
     {
+        CHInstanceInternal::FlushPending();
         SetRenderState(CH_RS_ALPHABLENDENABLE, TRUE);
         SetRenderState(CH_RS_SRCBLEND, CH_BLEND_SRCALPHA);
         SetRenderState(CH_RS_DESTBLEND, CH_BLEND_INVSRCALPHA);
@@ -382,7 +419,7 @@ BOOL Scene_Draw(CHScene* lpScene)
         return FALSE;
 
     // Set lightmap if available (matching original)
-    if (lpScene->nlTex > -1 && g_lpTex[lpScene->nlTex])
+    if (lpScene->nlTex > -1 && lpScene->nlTex < TEX_MAX && g_lpTex[lpScene->nlTex])
     {
         if (!SetTexture(1, g_lpTex[lpScene->nlTex]->lpSRV.Get()))
             return FALSE;
@@ -394,16 +431,9 @@ BOOL Scene_Draw(CHScene* lpScene)
         CHSceneInternal::DisableLightmapRenderStates();
     }
 
-    // Set world matrix (frame animation + additional transformation)
-    XMMATRIX worldMatrix = XMMatrixIdentity();
-    if (lpScene->dwFrameCount > 0 && lpScene->lpFrame)
-    {
-        worldMatrix = lpScene->lpFrame[lpScene->nFrame % lpScene->dwFrameCount];
-    }
-    worldMatrix = XMMatrixMultiply(worldMatrix, lpScene->matrix);
-
-    // Update constant buffer for shaders
-            CHInternal::g_CompatibilityShaderManager.UpdateConstantBuffer(worldMatrix, g_ViewMatrix, g_ProjectMatrix);
+    // Only the world changes per scene; view and projection are per-frame
+    CHInternal::g_ConstantBuffers.SetObject(worldMatrix);
+    CHInternal::g_ConstantBuffers.SetMaterial(XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
 
     // Render the scene
     HRESULT hr = CHSceneInternal::RenderScene(lpScene);
@@ -488,7 +518,9 @@ namespace CHSceneInternal {
         D3D11_SUBRESOURCE_DATA initData = {};
         initData.pSysMem = scene->lpVB;
 
-        return g_D3DDevice->CreateBuffer(&bufferDesc, &initData, scene->vertexBuffer.GetAddressOf());
+        ComputeBounds(scene);
+
+        return CHBackendInternal::CreateBuffer(&bufferDesc, &initData, scene->vertexBuffer.GetAddressOf());
     }
 
     HRESULT CreateIndexBuffer(CHScene* scene)
@@ -505,7 +537,31 @@ namespace CHSceneInternal {
         D3D11_SUBRESOURCE_DATA initData = {};
         initData.pSysMem = scene->lpIB;
 
-        return g_D3DDevice->CreateBuffer(&bufferDesc, &initData, scene->indexBuffer.GetAddressOf());
+        return CHBackendInternal::CreateBuffer(&bufferDesc, &initData, scene->indexBuffer.GetAddressOf());
+    }
+
+    void ComputeBounds(CHScene* scene)
+    {
+        // Box center and the farthest vertex from it
+        XMVECTOR minPos = XMVectorReplicate(FLT_MAX);
+        XMVECTOR maxPos = XMVectorReplicate(-FLT_MAX);
+        for (DWORD v = 0; v < scene->dwVecCount; v++)
+        {
+            XMVECTOR pos = XMVectorSet(scene->lpVB[v].x, scene->lpVB[v].y, scene->lpVB[v].z, 0.0f);
+            minPos = XMVectorMin(minPos, pos);
+            maxPos = XMVectorMax(maxPos, pos);
+        }
+
+        XMVECTOR center = XMVectorScale(XMVectorAdd(minPos, maxPos), 0.5f);
+        float radiusSq = 0.0f;
+        for (DWORD v = 0; v < scene->dwVecCount; v++)
+        {
+            XMVECTOR pos = XMVectorSet(scene->lpVB[v].x, scene->lpVB[v].y, scene->lpVB[v].z, 0.0f);
+            radiusSq = std::max(radiusSq, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(pos, center))));
+        }
+
+        XMStoreFloat3(&scene->vCenter, center);
+        scene->fRadius = sqrtf(radiusSq);
     }
 
     void ReleaseBuffers(CHScene* scene)
@@ -536,11 +592,45 @@ namespace CHSceneInternal {
         CHInternal::g_CompatibilityShaderManager.SetDefaultShaders();
 
         // Draw (matching original DrawIndexedPrimitive)
-        g_D3DContext->DrawIndexed(scene->dwTriCount * 3, 0, 0);
+        CHInternal::g_RenderStateManager.CommitStates();
+        CHBackendInternal::DrawIndexed(scene->dwTriCount * 3, 0, 0);
 
         return S_OK;
     }
 
+    BOOL RecordScene(CHScene* scene, const XMMATRIX& world)
+    {
+        if (!scene->vertexBuffer || !scene->indexBuffer)
+            return FALSE;
+
+        CHRenderPacket packet = {};
+        packet.lpVB = scene->vertexBuffer.Get();
+        packet.dwStride = scene->vertexStride;
+        packet.dwOffset = scene->vertexOffset;
+        packet.lpIB = scene->indexBuffer.Get();
+        packet.ibFormat = DXGI_FORMAT_R16_UINT;
+        packet.dwIndexCount = scene->dwTriCount * 3;
+        XMStoreFloat4x4(&packet.matWorld, world);
+
+        // Same states as Scene_Prepare + Scene_Draw
+        packet.dwShader = CH_QUEUE_SHADER_DEFAULT;
+        packet.lpTexture[0] = g_lpTex[scene->nTex]->lpSRV.Get();
+        BOOL lightmap = scene->nlTex > -1 && scene->nlTex < TEX_MAX && g_lpTex[scene->nlTex];
+        packet.lpTexture[1] = lightmap ? g_lpTex[scene->nlTex]->lpSRV.Get() : nullptr;
+        packet.bZEnable = TRUE;
+        packet.bZWrite = TRUE;
+        packet.dwCullMode = CH_CULL_CW;
+        packet.bAlphaBlend = ShouldUseAlphaBlending(g_lpTex[scene->nTex]) ? TRUE : FALSE;
+        packet.dwSrcBlend = CH_BLEND_SRCALPHA;
+        packet.dwDestBlend = CH_BLEND_INVSRCALPHA;
+
+        // View space depth of the bounding sphere center
+        XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&scene->vCenter), XMMatrixMultiply(world, g_ViewMatrix));
+
+        CHQueueInternal::Record(packet, packet.bAlphaBlend, scene->nTex, lightmap ? scene->nlTex : -1, XMVectorGetZ(center));
+        return TRUE;
+    }
+
     bool ShouldUseAlphaBlending(CHTexture* texture)
     {
         if (!texture)
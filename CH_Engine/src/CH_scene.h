@@ -49,6 +49,10 @@ struct CHScene {
     CHComPtr<ID3D11Buffer> indexBuffer;
     UINT vertexStride;
     UINT vertexOffset;
+
+    // Local bounding sphere (render queue depth)
+    XMFLOAT3 vCenter;
+    float fRadius;
 };
 
 // Function declarations (maintaining exact same signatures as original)
@@ -96,9 +100,11 @@ namespace CHSceneInternal {
     CH_CORE_DLL_API HRESULT CreateVertexBuffer(CHScene* scene);
     CH_CORE_DLL_API HRESULT CreateIndexBuffer(CHScene* scene);
     void ReleaseBuffers(CHScene* scene);
+    void ComputeBounds(CHScene* scene);
     
     // Rendering utilities
     HRESULT RenderScene(CHScene* scene);
+    BOOL RecordScene(CHScene* scene, const XMMATRIX& world);
     bool ShouldUseAlphaBlending(CHTexture* texture);
 }
 
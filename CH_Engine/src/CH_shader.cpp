@@ -0,0 +1,230 @@
+#include "CH_shader.h"
+#include "CH_main.h"
+
+// Bytecode generated by Shader_ExportEmbedded (TestCHEngine postbuild, see premake5.lua)
+#if __has_include("CH_shader_blobs.h")
+#include "CH_shader_blobs.h"
+#define CH_SHADER_EMBEDDED
+#endif
+
+// Disk cache file header
+struct CHShaderCacheHeader {
+    DWORD dwMagic;                      // 'CHSC'
+    UINT64 qwKey;
+    DWORD dwSize;                       // Bytecode bytes that follow
+};
+
+#define CH_SHADER_CACHE_MAGIC   0x43534843
+
+namespace CHShaderInternal {
+    std::string g_strCacheDir = CH_SHADER_CACHE_DIR;
+    std::unordered_map<UINT64, CHComPtr<ID3DBlob>> g_Loaded;
+
+    static DWORD g_dwEmbedded = 0;
+    static DWORD g_dwDisk = 0;
+    static DWORD g_dwCompiled = 0;
+}
+
+CH_CORE_DLL_API
+void Shader_SetCacheDir(const char* lpDir)
+{
+    CHShaderInternal::g_strCacheDir = lpDir ? lpDir : "";
+}
+
+CH_CORE_DLL_API
+BOOL Shader_ExportEmbedded(const char* lpFile)
+{
+    if (!lpFile)
+        return FALSE;
+
+    FILE* file = fopen(lpFile, "w");
+    if (!file)
+        return FALSE;
+
+    // Sorted by key so the output is stable between runs
+    std::vector<UINT64> keys;
+    for (const auto& loaded : CHShaderInternal::g_Loaded)
+        keys.push_back(loaded.first);
+    std::sort(keys.begin(), keys.end());
+
+    fprintf(file, "// Generated by Shader_ExportEmbedded, do not edit\n");
+    fprintf(file, "#pragma once\n\n");
+
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        ID3DBlob* code = CHShaderInternal::g_Loaded[keys[i]].Get();
+        const BYTE* bytes = static_cast<const BYTE*>(code->GetBufferPointer());
+        SIZE_T size = code->GetBufferSize();
+
+        fprintf(file, "static const BYTE g_ShaderCode%u[] = {", static_cast<unsigned>(i));
+        for (SIZE_T b = 0; b < size; b++)
+            fprintf(file, "%s0x%02x,", (b % 16) == 0 ? "\n    " : " ", bytes[b]);
+        fprintf(file, "\n};\n\n");
+    }
+
+    fprintf(file, "static const CHEmbeddedShader g_EmbeddedShaders[] = {\n");
+    for (size_t i = 0; i < keys.size(); i++)
+    {
+        fprintf(file, "    { 0x%016llxull, g_ShaderCode%u, sizeof(g_ShaderCode%u) },\n",
+            static_cast<unsigned long long>(keys[i]), static_cast<unsigned>(i), static_cast<unsigned>(i));
+    }
+    fprintf(file, "};\n");
+
+    fclose(file);
+    return TRUE;
+}
+
+CH_CORE_DLL_API
+void Shader_GetCacheStats(DWORD* lpEmbedded, DWORD* lpDisk, DWORD* lpCompiled)
+{
+    if (lpEmbedded)
+        *lpEmbedded = CHShaderInternal::g_dwEmbedded;
+    if (lpDisk)
+        *lpDisk = CHShaderInternal::g_dwDisk;
+    if (lpCompiled)
+        *lpCompiled = CHShaderInternal::g_dwCompiled;
+}
+
+namespace CHShaderInternal {
+
+    // FNV-1a, strings hashed with their terminator so "ab"+"c" != "a"+"bc"
+    static void HashString(UINT64& hash, const char* text)
+    {
+        const char* c = text ? text : "";
+        do
+        {
+            hash ^= static_cast<BYTE>(*c);
+            hash *= 1099511628211ull;
+        } while (*c++);
+    }
+
+    UINT64 MakeKey(const char* source, const D3D_SHADER_MACRO* defines, const char* entry, const char* profile)
+    {
+        UINT64 hash = 14695981039346656037ull;
+        HashString(hash, source);
+        for (const D3D_SHADER_MACRO* define = defines; define && define->Name; define++)
+        {
+            HashString(hash, define->Name);
+            HashString(hash, define->Definition);
+        }
+        HashString(hash, entry);
+        HashString(hash, profile);
+#ifdef D3D_COMPILER_VERSION
+        // A new compiler may generate different code
+        hash ^= D3D_COMPILER_VERSION;
+        hash *= 1099511628211ull;
+#endif
+        return hash;
+    }
+
+    HRESULT CompileShader(const char* source, const D3D_SHADER_MACRO* defines,
+        const char* entry, const char* profile, ID3DBlob** code, ID3DBlob** errors)
+    {
+        if (!source || !code)
+            return E_INVALIDARG;
+
+        UINT64 key = MakeKey(source, defines, entry, profile);
+
+        // Already loaded this run (shared by several managers, or a device reset)
+        auto it = g_Loaded.find(key);
+        if (it != g_Loaded.end())
+        {
+            *code = it->second.Get();
+            (*code)->AddRef();
+            return S_OK;
+        }
+
+        CHComPtr<ID3DBlob> blob;
+        const CHEmbeddedShader* embedded = FindEmbedded(key);
+        if (embedded && SUCCEEDED(D3DCreateBlob(embedded->dwSize, blob.GetAddressOf())))
+        {
+            memcpy(blob->GetBufferPointer(), embedded->lpCode, embedded->dwSize);
+            g_dwEmbedded++;
+        }
+        else if (ReadCache(key, blob.GetAddressOf()))
+        {
+            g_dwDisk++;
+        }
+        else
+        {
+            HRESULT hr = D3DCompile(source, strlen(source), nullptr, defines, nullptr,
+                entry, profile, 0, 0, blob.GetAddressOf(), errors);
+            if (FAILED(hr))
+                return hr;
+
+            WriteCache(key, blob.Get());
+            g_dwCompiled++;
+        }
+
+        g_Loaded[key] = blob;
+        *code = blob.Get();
+        (*code)->AddRef();
+        return S_OK;
+    }
+
+    const CHEmbeddedShader* FindEmbedded(UINT64 key)
+    {
+#ifdef CH_SHADER_EMBEDDED
+        for (const CHEmbeddedShader& shader : g_EmbeddedShaders)
+        {
+            if (shader.qwKey == key)
+                return &shader;
+        }
+#endif
+        return nullptr;
+    }
+
+    static std::string CachePath(UINT64 key)
+    {
+        char name[32];
+        sprintf(name, "\\%016llx.cso", static_cast<unsigned long long>(key));
+        return g_strCacheDir + name;
+    }
+
+    BOOL ReadCache(UINT64 key, ID3DBlob** code)
+    {
+        if (g_strCacheDir.empty())
+            return FALSE;
+
+        FILE* file = fopen(CachePath(key).c_str(), "rb");
+        if (!file)
+            return FALSE;
+
+        // Header guards against truncated files and key collisions in the name
+        CHShaderCacheHeader header;
+        BOOL valid = fread(&header, sizeof(header), 1, file) == 1 &&
+                     header.dwMagic == CH_SHADER_CACHE_MAGIC && header.qwKey == key && header.dwSize > 0 &&
+                     SUCCEEDED(D3DCreateBlob(header.dwSize, code)) &&
+                     fread((*code)->GetBufferPointer(), header.dwSize, 1, file) == 1;
+        fclose(file);
+
+        if (!valid && *code)
+        {
+            (*code)->Release();
+            *code = nullptr;
+        }
+        return valid;
+    }
+
+    void WriteCache(UINT64 key, ID3DBlob* code)
+    {
+        if (g_strCacheDir.empty() || !code)
+            return;
+
+        CreateDirectoryA(g_strCacheDir.c_str(), nullptr);
+
+        FILE* file = fopen(CachePath(key).c_str(), "wb");
+        if (!file)
+            return;
+
+        CHShaderCacheHeader header = { CH_SHADER_CACHE_MAGIC, key, static_cast<DWORD>(code->GetBufferSize()) };
+        fwrite(&header, sizeof(header), 1, file);
+        fwrite(code->GetBufferPointer(), code->GetBufferSize(), 1, file);
+        fclose(file);
+    }
+
+    void Cleanup()
+    {
+        g_Loaded.clear();
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef _CH_shader_h_
+#define _CH_shader_h_
+
+#ifdef CH_CORE_DLL_EXPORTS
+#define CH_CORE_DLL_API __declspec(dllexport)
+#else
+#define CH_CORE_DLL_API __declspec(dllimport)
+#endif
+
+#include "CH_common.h"
+#include <unordered_map>
+
+// Default directory of the shader bytecode disk cache
+#define CH_SHADER_CACHE_DIR     "shadercache"
+
+// Precompiled shader bytecode (see Shader_ExportEmbedded)
+struct CHEmbeddedShader {
+    UINT64 qwKey;                       // CHShaderInternal::MakeKey
+    const BYTE* lpCode;
+    DWORD dwSize;
+};
+
+/*
+    Shader bytecode cache
+    ---------------------
+    Engine shaders are looked up, in order:
+        1. bytecode embedded at build time (CH_shader_blobs.h, when present)
+        2. the disk cache, one file per key (hash of source, defines, entry and profile)
+        3. D3DCompile, whose result is written to the disk cache
+    Only shaders whose source changed are recompiled.
+*/
+
+// Directory of the disk cache (nullptr or "" turns it off)
+CH_CORE_DLL_API
+void Shader_SetCacheDir(const char* lpDir);
+
+/*
+    Write every shader loaded so far as a C++ header of bytecode arrays.
+    Saved as CH_Engine/src/CH_shader_blobs.h, the next build starts
+    without compiling or reading any shader. Call before Quit3D.
+*/
+CH_CORE_DLL_API
+BOOL Shader_ExportEmbedded(const char* lpFile);
+
+// Shaders served from the embedded table, the disk cache and D3DCompile
+CH_CORE_DLL_API
+void Shader_GetCacheStats(DWORD* lpEmbedded, DWORD* lpDisk, DWORD* lpCompiled);
+
+// Internal shader cache management
+namespace CHShaderInternal {
+    extern std::string g_strCacheDir;
+    extern std::unordered_map<UINT64, CHComPtr<ID3DBlob>> g_Loaded;
+
+    CH_CORE_DLL_API UINT64 MakeKey(const char* source, const D3D_SHADER_MACRO* defines, const char* entry, const char* profile);
+
+    // Drop-in for D3DCompile on engine shader sources (errors is only set when compiling)
+    HRESULT CompileShader(const char* source, const D3D_SHADER_MACRO* defines,
+        const char* entry, const char* profile, ID3DBlob** code, ID3DBlob** errors);
+
+    const CHEmbeddedShader* FindEmbedded(UINT64 key);
+    BOOL ReadCache(UINT64 key, ID3DBlob** code);
+    void WriteCache(UINT64 key, ID3DBlob* code);
+
+    void Cleanup();
+}
+
+#endif // _CH_shader_h_
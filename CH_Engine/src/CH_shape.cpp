@@ -1,5 +1,8 @@
 #include "CH_shape.h"
 #include "CH_main.h"
+#include "CH_sprite.h"
+#include "CH_instance.h"
+#include "CH_backend.h"
 
 extern const char CH_VERSION[64];
 
@@ -129,16 +132,10 @@ void Shape_Clear(CHShape* lpShape)
     lpShape->vb = nullptr;
     lpShape->dwSegment = 0;
     lpShape->dwSegmentCur = 0;
-    lpShape->last[0] = XMVectorZero();
-    lpShape->last[1] = XMVectorZero();
-    lpShape->bFirst = TRUE;
     
-    // Clear smoothing data
+    // Clear trail
     lpShape->dwSmooth = 1;
-    delete[] lpShape->lpSmooths0;
-    delete[] lpShape->lpSmooths1;
-    lpShape->lpSmooths0 = nullptr;
-    lpShape->lpSmooths1 = nullptr;
+    Trail_Release(&lpShape->lpTrail);
     
     // Clear TearAir data
     lpShape->pTearAirTex.Reset();
@@ -151,7 +148,7 @@ void Shape_Clear(CHShape* lpShape)
     CHShapeInternal::ReleaseBuffers(lpShape);
     
     lpShape->vertexStride = sizeof(CHShapeOutVertex);
-    lpShape->vertexOffset = 0;
+    lpShape->baseVertex = 0;
 }
 
 BOOL Shape_Load(CHShape** lpShape, FILE* file, BOOL bTex)
@@ -196,27 +193,28 @@ void Shape_SetSegment(CHShape* lpShape, DWORD dwSegment, DWORD dwSmooth)
     lpShape->dwSegment = dwSegment;
     lpShape->dwSmooth = dwSmooth;
     
-    // Allocate vertex buffer for segments
-    delete[] lpShape->vb;
-    lpShape->vb = new CHShapeOutVertex[dwSegment * 2]; // Two vertices per segment
-    
-    // Allocate smoothing arrays if needed
-    if (dwSmooth > 1)
+    // Flash shapes draw as a trail of dwSegment edges, all storage allocated here
+    Trail_Release(&lpShape->lpTrail);
+    if (dwSegment > 0)
     {
-        delete[] lpShape->lpSmooths0;
-        delete[] lpShape->lpSmooths1;
-        lpShape->lpSmooths0 = new XMVECTOR[dwSegment];
-        lpShape->lpSmooths1 = new XMVECTOR[dwSegment];
+        Trail_Create(&lpShape->lpTrail, dwSegment, dwSmooth);
     }
 }
 
 BOOL Shape_Draw(CHShape* lpShape, BOOL bLocal, int nAsb, int nAdb)
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    
     if (!lpShape)
         return FALSE;
     
-    // Process shape lines and generate geometry
-    CHShapeInternal::ProcessShapeLines(lpShape);
+    // Flash: the trail is extended by Shape_NextFrame, drawing never changes it
+    if (lpShape->lpTrail)
+    {
+        return Trail_Draw(lpShape->lpTrail, lpShape->nTex, nAsb, nAdb);
+    }
+    
+    // Generate geometry from the (untouched) source lines
     CHShapeInternal::GenerateShapeGeometry(lpShape);
     
     // Render the shape
@@ -225,6 +223,9 @@ BOOL Shape_Draw(CHShape* lpShape, BOOL bLocal, int nAsb, int nAdb)
 
 void Shape_Prepare()
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    CHInstanceInternal::FlushPending();
+    
     CHShapeInternal::SetupShapeRenderStates();
 }
 
@@ -260,14 +261,20 @@ void Shape_Muliply(CHShape* lpShape, XMMATRIX* matrix)
 
 void Shape_NextFrame(CHShape* lpShape, int nStep)
 {
-    if (!lpShape || !lpShape->lpMotion)
+    if (!lpShape)
         return;
     
-    if (lpShape->lpMotion->dwFrames > 0)
+    if (lpShape->lpMotion && lpShape->lpMotion->dwFrames > 0)
     {
         lpShape->lpMotion->nFrame = (lpShape->lpMotion->nFrame + nStep) % lpShape->lpMotion->dwFrames;
         CHShapeInternal::ProcessSMotionFrame(lpShape->lpMotion);
     }
+    
+    // Flash: one edge per update, only the new rows are tessellated
+    if (lpShape->lpTrail)
+    {
+        CHShapeInternal::AppendTrailEdge(lpShape);
+    }
 }
 
 void Shape_SetFrame(CHShape* lpShape, DWORD dwFrame)
@@ -295,43 +302,311 @@ void Shape_ClearMatrix(CHShape* lpShape)
 
 BOOL Shape_DrawAlpha(CHShape* lpShape, BOOL bLocal)
 {
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    
     if (!lpShape)
         return FALSE;
     
-    // Process shape lines and generate geometry
-    CHShapeInternal::ProcessShapeLines(lpShape);
+    if (lpShape->lpTrail)
+    {
+        return Trail_Draw(lpShape->lpTrail, lpShape->nTex, CH_BLEND_SRCALPHA, CH_BLEND_INVSRCALPHA);
+    }
+    
+    // Generate geometry from the (untouched) source lines
     CHShapeInternal::GenerateShapeGeometry(lpShape);
     
     // Render with alpha blending
     return CHShapeInternal::RenderShape(lpShape, false, CH_BLEND_SRCALPHA, CH_BLEND_INVSRCALPHA);
 }
 
+BOOL Trail_Create(CHTrail** lpTrail, DWORD dwMaxPoints, DWORD dwSmooth)
+{
+    if (!lpTrail)
+        return FALSE;
+    
+    *lpTrail = new CHTrail();
+    CHTrail* trail = *lpTrail;
+    
+    // Rewriting a segment looks one edge back and two ahead
+    trail->dwMaxPoints = std::max<DWORD>(dwMaxPoints, 4);
+    trail->dwSmooth = std::max<DWORD>(dwSmooth, 1);
+    trail->lpEdge0 = new XMVECTOR[trail->dwMaxPoints];
+    trail->lpEdge1 = new XMVECTOR[trail->dwMaxPoints];
+    
+    trail->dwRowCapacity = (trail->dwMaxPoints - 1) * trail->dwSmooth + 1;
+    trail->lpStrip = new CHShapeOutVertex[(trail->dwRowCapacity + 1) * 2];
+    trail->dwColor = 0xFFFFFFFF;
+    
+    Trail_Reset(trail);
+    return TRUE;
+}
+
+void Trail_Release(CHTrail** lpTrail)
+{
+    if (!lpTrail || !*lpTrail)
+        return;
+    
+    delete[] (*lpTrail)->lpEdge0;
+    delete[] (*lpTrail)->lpEdge1;
+    delete[] (*lpTrail)->lpStrip;
+    (*lpTrail)->stripBuffer.Reset();
+    
+    delete *lpTrail;
+    *lpTrail = nullptr;
+}
+
+void Trail_Reset(CHTrail* lpTrail)
+{
+    if (!lpTrail)
+        return;
+    
+    lpTrail->dwPointTotal = 0;
+    lpTrail->dwRowTotal = 0;
+    lpTrail->dwDirtyRow = 0;
+}
+
+void Trail_AddEdge(CHTrail* lpTrail, FXMVECTOR vEdge0, FXMVECTOR vEdge1)
+{
+    if (!lpTrail)
+        return;
+    
+    using namespace CHShapeInternal;
+    
+    DWORD point = lpTrail->dwPointTotal++;
+    lpTrail->lpEdge0[point % lpTrail->dwMaxPoints] = vEdge0;
+    lpTrail->lpEdge1[point % lpTrail->dwMaxPoints] = vEdge1;
+    
+    DWORD firstRow;
+    if (point == 0)
+    {
+        firstRow = 0;
+        WriteTrailRow(lpTrail, 0);
+    }
+    else
+    {
+        // The previous segment now knows its far neighbour; the new one is
+        // provisional until the next edge arrives
+        DWORD firstSegment = point >= 2 ? point - 2 : 0;
+        firstRow = firstSegment * lpTrail->dwSmooth + 1;
+        for (DWORD segment = firstSegment; segment < point; segment++)
+        {
+            TessellateTrailSegment(lpTrail, segment);
+        }
+    }
+    
+    lpTrail->dwRowTotal = point * lpTrail->dwSmooth + 1;
+    lpTrail->dwDirtyRow = std::min(lpTrail->dwDirtyRow, firstRow);
+}
+
+BOOL Trail_Draw(CHTrail* lpTrail, int nTex, int nAsb, int nAdb)
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    
+    if (!lpTrail)
+        return FALSE;
+    
+    // A strip needs two rows
+    DWORD visible = std::min(lpTrail->dwRowTotal, lpTrail->dwRowCapacity);
+    if (visible < 2)
+        return TRUE;
+    
+    if (!CHShapeInternal::UploadTrail(lpTrail))
+        return FALSE;
+    
+    // Set texture if available
+    if (nTex >= 0 && nTex < TEX_MAX && g_lpTex[nTex])
+    {
+        SetTexture(0, g_lpTex[nTex]->lpSRV.Get());
+    }
+    
+    SetRenderState(CH_RS_SRCBLEND, nAsb);
+    SetRenderState(CH_RS_DESTBLEND, nAdb);
+    SetRenderState(CH_RS_CULLMODE, CH_CULL_NONE);
+    
+    UINT stride = sizeof(CHShapeOutVertex);
+    UINT offset = 0;
+    ID3D11Buffer* buffer = lpTrail->stripBuffer.Get();
+    g_D3DContext->IASetVertexBuffers(0, 1, &buffer, &stride, &offset);
+    g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    
+    // The ring wraps at most once; the mirror of row 0 stitches the two parts
+    DWORD capacity = lpTrail->dwRowCapacity;
+    DWORD startSlot = (lpTrail->dwRowTotal - visible) % capacity;
+    CHInternal::g_RenderStateManager.CommitStates();
+    if (startSlot + visible <= capacity)
+    {
+        CHBackendInternal::Draw(visible * 2, startSlot * 2);
+    }
+    else
+    {
+        DWORD tailRows = capacity - startSlot + 1;
+        CHBackendInternal::Draw(tailRows * 2, startSlot * 2);
+        CHBackendInternal::Draw((visible - tailRows + 1) * 2, 0);
+    }
+    
+    return TRUE;
+}
+
 // Internal implementation
 namespace CHShapeInternal {
 
-void ProcessShapeLines(CHShape* shape)
+XMMATRIX GetShapeTransform(const CHShape* shape)
 {
-    if (!shape)
+    // Motion is applied on output, the source lines keep their points
+    if (shape && shape->lpMotion && shape->lpMotion->nFrame < static_cast<int>(shape->lpMotion->dwFrames))
+    {
+        return XMMatrixMultiply(shape->lpMotion->lpFrames[shape->lpMotion->nFrame], shape->lpMotion->matrix);
+    }
+    return XMMatrixIdentity();
+}
+
+void AppendTrailEdge(CHShape* shape)
+{
+    if (!shape || !shape->lpTrail || shape->dwLineCount == 0)
         return;
     
-    // Process each line in the shape
-    for (DWORD i = 0; i < shape->dwLineCount; i++)
+    // The first line is the blade: its two ends are the trail edges
+    CHLine* line = &shape->lpLine[0];
+    if (line->dwVecCount < 2)
+        return;
+    
+    XMMATRIX transform = GetShapeTransform(shape);
+    Trail_AddEdge(shape->lpTrail,
+                  XMVector3TransformCoord(line->lpVB[0], transform),
+                  XMVector3TransformCoord(line->lpVB[line->dwVecCount - 1], transform));
+}
+
+void WriteTrailRow(CHTrail* trail, DWORD row)
+{
+    DWORD smooth = trail->dwSmooth;
+    DWORD segment = row / smooth;
+    DWORD step = row % smooth;
+    DWORD newest = trail->dwPointTotal - 1;
+    DWORD ring = trail->dwMaxPoints;
+    
+    XMVECTOR edge0, edge1;
+    if (step == 0)
+    {
+        edge0 = trail->lpEdge0[segment % ring];
+        edge1 = trail->lpEdge1[segment % ring];
+    }
+    else
+    {
+        // Catmull-Rom through the neighbours, clamped at both ends of the trail
+        DWORD i1 = segment;
+        DWORD i2 = segment + 1;
+        DWORD i0 = segment > 0 && newest - (segment - 1) < ring ? segment - 1 : i1;
+        DWORD i3 = segment + 2 <= newest ? segment + 2 : i2;
+        float t = static_cast<float>(step) / static_cast<float>(smooth);
+        
+        edge0 = InterpolateShapePoint(trail->lpEdge0[i0 % ring], trail->lpEdge0[i1 % ring],
+                                      trail->lpEdge0[i2 % ring], trail->lpEdge0[i3 % ring], t);
+        edge1 = InterpolateShapePoint(trail->lpEdge1[i0 % ring], trail->lpEdge1[i1 % ring],
+                                      trail->lpEdge1[i2 % ring], trail->lpEdge1[i3 % ring], t);
+    }
+    
+    // u follows the absolute row, one texture repeat per full trail length, so
+    // a row never changes once written; the sampler wraps it
+    DWORD slot = row % trail->dwRowCapacity;
+    float u = static_cast<float>(row) / static_cast<float>(trail->dwRowCapacity - 1);
+    CHShapeOutVertex* out = &trail->lpStrip[slot * 2];
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&out[0]), edge0);
+    out[0].color = trail->dwColor;
+    out[0].u = u;
+    out[0].v = 0.0f;
+    XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&out[1]), edge1);
+    out[1].color = trail->dwColor;
+    out[1].u = u;
+    out[1].v = 1.0f;
+    
+    // Row 0 is mirrored past the end so a wrapped strip stays continuous
+    if (slot == 0)
+    {
+        trail->lpStrip[trail->dwRowCapacity * 2] = out[0];
+        trail->lpStrip[trail->dwRowCapacity * 2 + 1] = out[1];
+    }
+}
+
+void TessellateTrailSegment(CHTrail* trail, DWORD segment)
+{
+    // Interior rows plus the row on the segment's far edge
+    DWORD first = segment * trail->dwSmooth + 1;
+    DWORD last = (segment + 1) * trail->dwSmooth;
+    for (DWORD row = first; row <= last; row++)
+    {
+        WriteTrailRow(trail, row);
+    }
+}
+
+BOOL UploadTrail(CHTrail* trail)
+{
+    if (!g_D3DDevice || !g_D3DContext)
+        return FALSE;
+    
+    DWORD capacity = trail->dwRowCapacity;
+    if (!trail->stripBuffer)
     {
-        ProcessShapeLine(shape, i);
+        D3D11_BUFFER_DESC bufferDesc = {};
+        bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+        bufferDesc.ByteWidth = (capacity + 1) * 2 * sizeof(CHShapeOutVertex);
+        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+        
+        if (FAILED(CHBackendInternal::CreateBuffer(&bufferDesc, nullptr, trail->stripBuffer.GetAddressOf())))
+            return FALSE;
+        trail->dwDirtyRow = 0;
     }
     
-    // Apply smoothing if enabled
-    if (shape->dwSmooth > 1)
+    DWORD total = trail->dwRowTotal;
+    if (trail->dwDirtyRow >= total)
+        return TRUE;
+    
+    // Only rows from dwDirtyRow on changed; dirty rows older than the window
+    // share their slots with newer rows
+    DWORD from = std::max(trail->dwDirtyRow, total - std::min(total, capacity));
+    BOOL mirror = FALSE;
+    
+    const UINT rowBytes = 2 * sizeof(CHShapeOutVertex);
+    while (from < total)
     {
-        SmoothShapeLines(shape);
+        DWORD slot = from % capacity;
+        DWORD rows = std::min(total - from, capacity - slot);
+        mirror = mirror || slot == 0;
+        
+        D3D11_BOX box = { slot * rowBytes, 0, 0, (slot + rows) * rowBytes, 1, 1 };
+        CHBackendInternal::UpdateSubresource(trail->stripBuffer.Get(), 0, &box, &trail->lpStrip[slot * 2], 0, 0);
+        from += rows;
     }
+    
+    if (mirror)
+    {
+        D3D11_BOX box = { capacity * rowBytes, 0, 0, (capacity + 1) * rowBytes, 1, 1 };
+        CHBackendInternal::UpdateSubresource(trail->stripBuffer.Get(), 0, &box, &trail->lpStrip[capacity * 2], 0, 0);
+    }
+    
+    trail->dwDirtyRow = total;
+    return TRUE;
 }
 
 void GenerateShapeGeometry(CHShape* shape)
 {
-    if (!shape || !shape->vb)
+    if (!shape)
         return;
     
+    // Line list capacity only changes when the lines do
+    DWORD segments = 0;
+    for (DWORD lineIdx = 0; lineIdx < shape->dwLineCount; lineIdx++)
+    {
+        if (shape->lpLine[lineIdx].dwVecCount > 1)
+            segments += shape->lpLine[lineIdx].dwVecCount - 1;
+    }
+    if (!shape->vb || shape->dwSegment < segments)
+    {
+        delete[] shape->vb;
+        shape->vb = new CHShapeOutVertex[segments * 2];
+        shape->dwSegment = segments;
+    }
+    
+    XMMATRIX transform = GetShapeTransform(shape);
     DWORD vertexIndex = 0;
     
     // Generate vertices for all lines
@@ -339,17 +614,17 @@ void GenerateShapeGeometry(CHShape* shape)
     {
         CHLine* line = &shape->lpLine[lineIdx];
         
-        for (DWORD i = 0; i < line->dwVecCount - 1 && vertexIndex < shape->dwSegment * 2; i++)
+        for (DWORD i = 0; i + 1 < line->dwVecCount && vertexIndex < shape->dwSegment * 2; i++)
         {
             // First vertex of line segment
-            XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&shape->vb[vertexIndex]), line->lpVB[i]);
+            XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&shape->vb[vertexIndex]), XMVector3TransformCoord(line->lpVB[i], transform));
             shape->vb[vertexIndex].color = 0xFFFFFFFF;
             shape->vb[vertexIndex].u = static_cast<float>(i) / static_cast<float>(line->dwVecCount - 1);
             shape->vb[vertexIndex].v = 0.0f;
             vertexIndex++;
             
             // Second vertex of line segment
-            XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&shape->vb[vertexIndex]), line->lpVB[i + 1]);
+            XMStoreFloat3(reinterpret_cast<XMFLOAT3*>(&shape->vb[vertexIndex]), XMVector3TransformCoord(line->lpVB[i + 1], transform));
             shape->vb[vertexIndex].color = 0xFFFFFFFF;
             shape->vb[vertexIndex].u = static_cast<float>(i + 1) / static_cast<float>(line->dwVecCount - 1);
             shape->vb[vertexIndex].v = 1.0f;
@@ -363,41 +638,6 @@ void GenerateShapeGeometry(CHShape* shape)
     UpdateVertexBuffer(shape);
 }
 
-void SmoothShapeLines(CHShape* shape)
-{
-    if (!shape || !shape->lpSmooths0 || !shape->lpSmooths1)
-        return;
-    
-    // Apply Catmull-Rom spline smoothing to lines
-    for (DWORD lineIdx = 0; lineIdx < shape->dwLineCount; lineIdx++)
-    {
-        CHLine* line = &shape->lpLine[lineIdx];
-        if (line->dwVecCount < 4)
-            continue; // Need at least 4 points for spline
-        
-        DWORD smoothCount = (line->dwVecCount - 3) * shape->dwSmooth;
-        XMVECTOR* smoothedPoints = new XMVECTOR[smoothCount];
-        
-        DWORD outputIndex = 0;
-        for (DWORD i = 0; i < line->dwVecCount - 3; i++)
-        {
-            for (DWORD s = 0; s < shape->dwSmooth; s++)
-            {
-                float t = static_cast<float>(s) / static_cast<float>(shape->dwSmooth);
-                smoothedPoints[outputIndex] = InterpolateShapePoint(
-                    line->lpVB[i], line->lpVB[i + 1], 
-                    line->lpVB[i + 2], line->lpVB[i + 3], t);
-                outputIndex++;
-            }
-        }
-        
-        // Replace original points with smoothed ones
-        delete[] line->lpVB;
-        line->lpVB = smoothedPoints;
-        line->dwVecCount = smoothCount;
-    }
-}
-
 XMVECTOR InterpolateShapePoint(XMVECTOR p0, XMVECTOR p1, XMVECTOR p2, XMVECTOR p3, float t)
 {
     // Catmull-Rom spline interpolation
@@ -412,65 +652,18 @@ XMVECTOR InterpolateShapePoint(XMVECTOR p0, XMVECTOR p1, XMVECTOR p2, XMVECTOR p
     return result;
 }
 
-BOOL CreateVertexBuffer(CHShape* shape)
+BOOL UpdateVertexBuffer(CHShape* shape)
 {
-    if (!shape)
+    if (!shape || !shape->vb || shape->dwSegmentCur == 0)
         return FALSE;
     
-    if (shape->vertexBuffer)
-        return TRUE; // Already created
-    
-    D3D11_BUFFER_DESC bufferDesc = {};
-    bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-    bufferDesc.ByteWidth = sizeof(CHShapeOutVertex) * shape->dwSegment * 2;
-    bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    
-    return SUCCEEDED(g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, shape->vertexBuffer.GetAddressOf()));
-}
-
-BOOL CreateIndexBuffer(CHShape* shape)
-{
-    if (!shape)
-        return FALSE;
-    
-    if (shape->indexBuffer)
-        return TRUE; // Already created
-    
-    // Generate indices for line rendering
-    DWORD indexCount = shape->dwSegment * 2;
-    WORD* indices = new WORD[indexCount];
-    
-    for (DWORD i = 0; i < indexCount; i++)
-    {
-        indices[i] = static_cast<WORD>(i);
-    }
-    
-    D3D11_BUFFER_DESC bufferDesc = {};
-    bufferDesc.Usage = D3D11_USAGE_IMMUTABLE;
-    bufferDesc.ByteWidth = sizeof(WORD) * indexCount;
-    bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-    
-    D3D11_SUBRESOURCE_DATA initData = {};
-    initData.pSysMem = indices;
-    
-    BOOL result = SUCCEEDED(g_D3DDevice->CreateBuffer(&bufferDesc, &initData, shape->indexBuffer.GetAddressOf()));
-    
-    delete[] indices;
-    return result;
-}
-
-void UpdateVertexBuffer(CHShape* shape)
-{
-    if (!shape || !shape->vertexBuffer || !shape->vb)
-        return;
-    
-    D3D11_MAPPED_SUBRESOURCE mappedResource;
-    if (SUCCEEDED(g_D3DContext->Map(shape->vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource)))
+    if (!CHInternal::g_DynamicVertexRing.Write(shape->vb, shape->dwSegmentCur * 2, sizeof(CHShapeOutVertex),
+        &shape->baseVertex, &shape->dwRingGeneration))
     {
-        memcpy(mappedResource.pData, shape->vb, sizeof(CHShapeOutVertex) * shape->dwSegmentCur * 2);
-        g_D3DContext->Unmap(shape->vertexBuffer.Get(), 0);
+        shape->dwRingGeneration = 0;
+        return FALSE;
     }
+    return TRUE;
 }
 
 void ReleaseBuffers(CHShape* shape)
@@ -478,8 +671,8 @@ void ReleaseBuffers(CHShape* shape)
     if (!shape)
         return;
     
-    shape->vertexBuffer.Reset();
-    shape->indexBuffer.Reset();
+    // Geometry lives in the shared ring, just forget the allocation
+    shape->dwRingGeneration = 0;
 }
 
 void SetupShapeRenderStates()
@@ -497,11 +690,11 @@ BOOL RenderShape(CHShape* shape, bool enableZ, int srcBlend, int destBlend)
     if (!shape)
         return FALSE;
     
-    // Create buffers if needed
-    if (!shape->vertexBuffer && !CreateVertexBuffer(shape))
-        return FALSE;
+    if (shape->dwSegmentCur == 0)
+        return TRUE;
     
-    if (!shape->indexBuffer && !CreateIndexBuffer(shape))
+    // Resubmit the lines if their ring allocation was discarded
+    if (!CHInternal::g_DynamicVertexRing.IsValid(shape->dwRingGeneration) && !UpdateVertexBuffer(shape))
         return FALSE;
     
     // Set texture if available
@@ -515,37 +708,17 @@ BOOL RenderShape(CHShape* shape, bool enableZ, int srcBlend, int destBlend)
     SetRenderState(CH_RS_DESTBLEND, destBlend);
     SetRenderState(CH_RS_ZENABLE, enableZ ? TRUE : FALSE);
     
-    // Set vertex and index buffers
-    g_D3DContext->IASetVertexBuffers(0, 1, shape->vertexBuffer.GetAddressOf(), &shape->vertexStride, &shape->vertexOffset);
-    g_D3DContext->IASetIndexBuffer(shape->indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+    // Line list vertices are sequential, no index buffer needed
+    CHInternal::g_DynamicVertexRing.Bind(shape->vertexStride);
     g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_LINELIST);
     
     // Draw shape
-    g_D3DContext->DrawIndexed(shape->dwSegmentCur * 2, 0, 0);
+    CHInternal::g_RenderStateManager.CommitStates();
+    CHBackendInternal::Draw(shape->dwSegmentCur * 2, shape->baseVertex);
     
     return TRUE;
 }
 
-void ProcessShapeLine(CHShape* shape, DWORD lineIndex)
-{
-    if (!shape || lineIndex >= shape->dwLineCount)
-        return;
-    
-    CHLine* line = &shape->lpLine[lineIndex];
-    
-    // Apply motion transformation if available
-    if (shape->lpMotion && shape->lpMotion->nFrame < static_cast<int>(shape->lpMotion->dwFrames))
-    {
-        XMMATRIX transform = shape->lpMotion->lpFrames[shape->lpMotion->nFrame];
-        transform = XMMatrixMultiply(transform, shape->lpMotion->matrix);
-        
-        for (DWORD i = 0; i < line->dwVecCount; i++)
-        {
-            line->lpVB[i] = XMVector3TransformCoord(line->lpVB[i], transform);
-        }
-    }
-}
-
 void OptimizeShapeLines(CHShape* shape)
 {
     if (!shape)
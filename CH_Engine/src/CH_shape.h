@@ -58,6 +58,43 @@ BOOL SMotion_Save(char* lpName, CHSMotion* lpSMotion, BOOL bNew);
 CH_CORE_DLL_API
 void SMotion_Unload(CHSMotion** lpSMotion);
 
+// Ribbon trail: control edges in a ring, tessellated once into a persistent strip.
+// Adding an edge rewrites only the rows of the last two control segments, and only
+// those rows are uploaded. u advances by one texture repeat per full trail length.
+struct CHTrail {
+    DWORD dwMaxPoints;          // Control edges kept
+    DWORD dwSmooth;             // Strip rows per control segment (Catmull-Rom)
+    XMVECTOR* lpEdge0;          // Control edge ring, first side of the ribbon
+    XMVECTOR* lpEdge1;          // Control edge ring, second side
+    DWORD dwPointTotal;         // Edges ever added (ring slot = total % max)
+
+    CHShapeOutVertex* lpStrip;  // Strip rows, 2 vertices each, plus a mirror of row 0
+    DWORD dwRowCapacity;        // Rows in the strip ring
+    DWORD dwRowTotal;           // Rows ever written (last one is the newest edge)
+    DWORD dwDirtyRow;           // First row not yet uploaded (dwRowTotal = up to date)
+    DWORD dwColor;              // Vertex colour
+
+    // DirectX 11 specific data (internal use)
+    CHComPtr<ID3D11Buffer> stripBuffer;
+};
+
+// Trail functions
+CH_CORE_DLL_API
+BOOL Trail_Create(CHTrail** lpTrail, DWORD dwMaxPoints, DWORD dwSmooth = 1);
+
+CH_CORE_DLL_API
+void Trail_Release(CHTrail** lpTrail);
+
+CH_CORE_DLL_API
+void Trail_Reset(CHTrail* lpTrail);
+
+// Append one edge; cost depends on dwSmooth only, never on the trail length
+CH_CORE_DLL_API
+void Trail_AddEdge(CHTrail* lpTrail, FXMVECTOR vEdge0, FXMVECTOR vEdge1);
+
+CH_CORE_DLL_API
+BOOL Trail_Draw(CHTrail* lpTrail, int nTex, int nAsb = 5, int nAdb = 6);
+
 struct CHShape {
     char* lpName;               // Shape name
     
@@ -74,12 +111,8 @@ struct CHShape {
     DWORD dwSegment;            // Number of segments
     DWORD dwSegmentCur;         // Current segment
     
-    XMVECTOR last[2];           // Last two points (D3DXVECTOR3 to XMVECTOR)
-    BOOL bFirst;                // First point flag
-    
     DWORD dwSmooth;             // Smoothing level
-    XMVECTOR* lpSmooths0;       // Smoothing points 0 (D3DXVECTOR3 to XMVECTOR)
-    XMVECTOR* lpSmooths1;       // Smoothing points 1 (D3DXVECTOR3 to XMVECTOR)
+    CHTrail* lpTrail;           // Flash trail (created by Shape_SetSegment)
     
     // TearAir effect data
     CHComPtr<ID3D11Texture2D> pTearAirTex;     // Tear air texture
@@ -88,10 +121,9 @@ struct CHShape {
     RECT LastTearAirTexRect;                   // Last texture rect
     
     // DirectX 11 specific data (internal use)
-    CHComPtr<ID3D11Buffer> vertexBuffer;
-    CHComPtr<ID3D11Buffer> indexBuffer;
     UINT vertexStride;
-    UINT vertexOffset;
+    UINT baseVertex;                           // Line list in the dynamic vertex ring
+    DWORD dwRingGeneration;                    // Ring generation of that upload
 };
 
 // Shape functions
@@ -125,6 +157,7 @@ void Shape_ChangeTexture(CHShape* lpShape, int nTexID);
 CH_CORE_DLL_API
 void Shape_Muliply(CHShape* lpShape, XMMATRIX* matrix);
 
+// Advances the motion; a flash shape also appends its blade edge to the trail
 CH_CORE_DLL_API
 void Shape_NextFrame(CHShape* lpShape, int nStep);
 
@@ -139,15 +172,18 @@ BOOL Shape_DrawAlpha(CHShape* lpShape, BOOL bLocal);
 
 // Internal implementation
 namespace CHShapeInternal {
-    // Shape processing
-    void ProcessShapeLines(CHShape* shape);
+    // Shape processing (source lines are never modified)
+    XMMATRIX GetShapeTransform(const CHShape* shape);
     void GenerateShapeGeometry(CHShape* shape);
-    void SmoothShapeLines(CHShape* shape);
+    void AppendTrailEdge(CHShape* shape);
+    
+    // Trail tessellation and upload
+    void WriteTrailRow(CHTrail* trail, DWORD row);
+    void TessellateTrailSegment(CHTrail* trail, DWORD segment);
+    BOOL UploadTrail(CHTrail* trail);
     
     // Buffer management
-    BOOL CreateVertexBuffer(CHShape* shape);
-    BOOL CreateIndexBuffer(CHShape* shape);
-    void UpdateVertexBuffer(CHShape* shape);
+    BOOL UpdateVertexBuffer(CHShape* shape);
     void ReleaseBuffers(CHShape* shape);
     
     // Rendering utilities
@@ -170,7 +206,6 @@ namespace CHShapeInternal {
     BOOL SaveShapeToFile(const char* filename, CHShape* shape, bool newFile);
     
     // Line processing
-    void ProcessShapeLine(CHShape* shape, DWORD lineIndex);
     void OptimizeShapeLines(CHShape* shape);
     XMVECTOR InterpolateShapePoint(XMVECTOR p0, XMVECTOR p1, XMVECTOR p2, XMVECTOR p3, float t);
 }
@@ -181,5 +216,6 @@ typedef CHLine C3Line;
 typedef CHSMotion C3SMotion;
 typedef CHShapeOutVertex ShapeOutVertex;
 typedef CHShapeBackupInfo ShapeBackupInfo;
+typedef CHTrail C3Trail;
 
 #endif
\ No newline at end of file
@@ -1,9 +1,16 @@
 #include "CH_sprite.h"
 #include "CH_main.h"
+#include "CH_backend.h"
+#include "CH_instance.h"
+#include "CH_shader.h"
+#include <algorithm>
 
 // Global sprite shader manager
 CHSpriteInternal::SpriteShaderManager CHSpriteInternal::g_SpriteShaderManager;
 
+// Global sprite batch
+CHSpriteInternal::SpriteBatch CHSpriteInternal::g_SpriteBatch;
+
 // Staging texture for lock/unlock operations
 static CHComPtr<ID3D11Texture2D> g_StagingTexture;
 static D3D11_MAPPED_SUBRESOURCE g_MappedResource = {};
@@ -33,6 +40,7 @@ void Sprite_Clear(CHSprite* lpSprite)
     lpSprite->vertex[3].v = 1.0f;
 
     lpSprite->lpTex = nullptr;
+    lpSprite->lpAtlas = nullptr;
 }
 
 CH_CORE_DLL_API
@@ -45,7 +53,21 @@ BOOL Sprite_Load(CHSprite** lpSprite,
     *lpSprite = new CHSprite;
     Sprite_Clear(*lpSprite);
 
-    if (Texture_Load(&(*lpSprite)->lpTex, lpName, 1, pool, bDuplicate, colorkey) == -1)
+    // Shared images go into an atlas page; private copies (bDuplicate
+    // off, usually locked and edited) keep their own texture
+    if (bDuplicate)
+    {
+        CHTexture* fallback = nullptr;
+        if (CHAtlasInternal::AcquireSprite(*lpSprite, lpName, pool, colorkey, &fallback))
+        {
+            Sprite_SetCoor(*lpSprite, nullptr, 0, 0);
+            return TRUE;
+        }
+        (*lpSprite)->lpTex = fallback;
+    }
+
+    if (!(*lpSprite)->lpTex &&
+        Texture_Load(&(*lpSprite)->lpTex, lpName, 1, pool, bDuplicate, colorkey) == -1)
     {
         delete* lpSprite;
         *lpSprite = nullptr;
@@ -82,7 +104,12 @@ void Sprite_Unload(CHSprite** lpSprite)
     if (!lpSprite || !*lpSprite)
         return;
 
-    if ((*lpSprite)->lpTex)
+    // Queued quads may still reference the texture
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
+    if ((*lpSprite)->lpAtlas)
+        CHAtlasInternal::ReleaseSprite(*lpSprite);
+    else if ((*lpSprite)->lpTex)
         Texture_Unload(&(*lpSprite)->lpTex);
 
     delete* lpSprite;
@@ -122,48 +149,40 @@ void Sprite_SetCoor(CHSprite* lpSprite,
     if (!lpSprite || !lpSprite->lpTex)
         return;
 
-    // Matching original algorithm exactly
-    float uu = 1.0f / static_cast<float>(lpSprite->lpTex->Info.Width);
-    float vv = 1.0f / static_cast<float>(lpSprite->lpTex->Info.Height);
-
-    uu = 0; // Original code sets these to 0
-    vv = 0;
-
-    // Set UV coordinates
-    if (!lpSrc)
+    // Image area inside the texture (the whole texture unless atlased)
+    float texWidth = static_cast<float>(lpSprite->lpTex->Info.Width);
+    float texHeight = static_cast<float>(lpSprite->lpTex->Info.Height);
+    DWORD imageX = 0;
+    DWORD imageY = 0;
+    DWORD imageWidth = lpSprite->lpTex->Info.Width;
+    DWORD imageHeight = lpSprite->lpTex->Info.Height;
+    if (lpSprite->lpAtlas)
     {
-        // Use full texture
-        lpSprite->vertex[0].u = 0.0f + uu;
-        lpSprite->vertex[0].v = 0.0f + vv;
-
-        lpSprite->vertex[1].u = 0.0f + uu;
-        lpSprite->vertex[1].v = 1.0f - vv;
+        imageX = lpSprite->lpAtlas->dwX;
+        imageY = lpSprite->lpAtlas->dwY;
+        imageWidth = lpSprite->lpAtlas->dwWidth;
+        imageHeight = lpSprite->lpAtlas->dwHeight;
+    }
 
-        lpSprite->vertex[2].u = 1.0f - uu;
-        lpSprite->vertex[2].v = 0.0f + vv;
+    // Set UV coordinates (matching original algorithm for plain textures)
+    RECT full = { 0, 0, static_cast<LONG>(imageWidth), static_cast<LONG>(imageHeight) };
+    const RECT* src = lpSrc ? lpSrc : &full;
 
-        lpSprite->vertex[3].u = 1.0f - uu;
-        lpSprite->vertex[3].v = 1.0f - vv;
-    }
-    else
-    {
-        // Use specified rectangle
-        lpSprite->vertex[0].u = static_cast<float>(lpSrc->left) / static_cast<float>(lpSprite->lpTex->Info.Width) + uu;
-        lpSprite->vertex[0].v = static_cast<float>(lpSrc->top) / static_cast<float>(lpSprite->lpTex->Info.Height) + vv;
+    lpSprite->vertex[0].u = static_cast<float>(imageX + src->left) / texWidth;
+    lpSprite->vertex[0].v = static_cast<float>(imageY + src->top) / texHeight;
 
-        lpSprite->vertex[1].u = lpSprite->vertex[0].u;
-        lpSprite->vertex[1].v = static_cast<float>(lpSrc->bottom) / static_cast<float>(lpSprite->lpTex->Info.Height) - vv;
+    lpSprite->vertex[1].u = lpSprite->vertex[0].u;
+    lpSprite->vertex[1].v = static_cast<float>(imageY + src->bottom) / texHeight;
 
-        lpSprite->vertex[2].u = static_cast<float>(lpSrc->right) / static_cast<float>(lpSprite->lpTex->Info.Width) - uu;
-        lpSprite->vertex[2].v = lpSprite->vertex[0].v;
+    lpSprite->vertex[2].u = static_cast<float>(imageX + src->right) / texWidth;
+    lpSprite->vertex[2].v = lpSprite->vertex[0].v;
 
-        lpSprite->vertex[3].u = lpSprite->vertex[2].u;
-        lpSprite->vertex[3].v = lpSprite->vertex[1].v;
-    }
+    lpSprite->vertex[3].u = lpSprite->vertex[2].u;
+    lpSprite->vertex[3].v = lpSprite->vertex[1].v;
 
     // Set screen coordinates (matching original exactly)
-    DWORD actualWidth = dwWidth == 0 ? lpSprite->lpTex->Info.Width : dwWidth;
-    DWORD actualHeight = dwHeight == 0 ? lpSprite->lpTex->Info.Height : dwHeight;
+    DWORD actualWidth = dwWidth == 0 ? imageWidth : dwWidth;
+    DWORD actualHeight = dwHeight == 0 ? imageHeight : dwHeight;
 
     lpSprite->vertex[0].x = static_cast<float>(nX);
     lpSprite->vertex[0].y = static_cast<float>(nY);
@@ -198,25 +217,40 @@ void Sprite_SetVertexColor(CHSprite* lpSprite, DWORD ltColor, DWORD rtColor, DWO
 CH_CORE_DLL_API
 void Sprite_Prepare()
 {
+    // Queued sprites keep the states they were drawn with
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    CHInstanceInternal::FlushPending();
     CHSpriteInternal::SetupSpriteRenderStates();
 }
 
 CH_CORE_DLL_API
 BOOL Sprite_Draw(CHSprite* lpSprite, DWORD dwShowWay)
 {
-    if (!lpSprite || !lpSprite->lpTex)
+    if (!lpSprite || !lpSprite->lpTex || !lpSprite->lpTex->lpSRV)
         return FALSE;
 
-    // Set blend mode based on show way (matching original logic exactly)
-    CHSpriteInternal::SetBlendMode(static_cast<CHSpriteInternal::SpriteBlendMode>(dwShowWay),
-        lpSprite->lpTex, lpSprite->vertex[0].color >> 24);
+    // Queue the quad, the batch draws it with its texture/show way run
+    CHSpriteInternal::g_SpriteBatch.Add(lpSprite, dwShowWay);
+    return TRUE;
+}
 
-    // Set texture
-    if (!SetTexture(0, lpSprite->lpTex->lpSRV.Get()))
-        return FALSE;
+CH_CORE_DLL_API
+void Sprite_FlushBatch()
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
+}
 
-    // Render sprite
-    return SUCCEEDED(CHSpriteInternal::RenderSprite(lpSprite));
+CH_CORE_DLL_API
+void Sprite_SetBatchSort(BOOL bSort)
+{
+    CHSpriteInternal::g_SpriteBatch.Flush();
+    CHSpriteInternal::g_SpriteBatch.SetSort(bSort);
+}
+
+CH_CORE_DLL_API
+void Sprite_GetBatchStats(DWORD* lpSprites, DWORD* lpDraws)
+{
+    CHSpriteInternal::g_SpriteBatch.GetStats(lpSprites, lpDraws);
 }
 
 CH_CORE_DLL_API
@@ -226,6 +260,9 @@ BOOL Sprite_Draw(CHSprite* lpSpriteUp, CHSprite* lpSpriteDn,
     if (!lpSpriteUp || !lpSpriteDn)
         return FALSE;
 
+    // Keep painter's order with the queued single sprites
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     return SUCCEEDED(CHSpriteInternal::RenderDualSprite(lpSpriteUp, lpSpriteDn,
         uAlphaA, uAlphaB, uAlphaC, uAlphaD));
 }
@@ -236,6 +273,9 @@ void Sprite_Lock(CHSprite* lpSprite, RECT* lpRect, CHLockedRect* lpReturn)
     if (!lpSprite || !lpSprite->lpTex || !lpReturn)
         return;
 
+    // Queued quads must sample the texture as it was when drawn
+    CHSpriteInternal::g_SpriteBatch.Flush();
+
     // Create staging texture for CPU access
     if (SUCCEEDED(CHSpriteInternal::CreateStagingTexture(lpSprite->lpTex, g_StagingTexture)))
     {
@@ -243,11 +283,18 @@ void Sprite_Lock(CHSprite* lpSprite, RECT* lpRect, CHLockedRect* lpReturn)
         g_D3DContext->CopyResource(g_StagingTexture.Get(), lpSprite->lpTex->lpTex.Get());
 
         // Map the staging texture
-        HRESULT hr = g_D3DContext->Map(g_StagingTexture.Get(), 0, D3D11_MAP_READ_WRITE, 0, &g_MappedResource);
+        HRESULT hr = CHBackendInternal::Map(g_StagingTexture.Get(), 0, D3D11_MAP_READ_WRITE, &g_MappedResource);
         if (SUCCEEDED(hr))
         {
             lpReturn->Pitch = g_MappedResource.RowPitch;
             lpReturn->pBits = g_MappedResource.pData;
+
+            // Atlased sprites see their own image at the origin
+            if (lpSprite->lpAtlas)
+            {
+                lpReturn->pBits = static_cast<BYTE*>(g_MappedResource.pData) +
+                    lpSprite->lpAtlas->dwY * g_MappedResource.RowPitch + lpSprite->lpAtlas->dwX * 4;
+            }
             g_IsTextureLocked = true;
         }
     }
@@ -295,14 +342,19 @@ namespace CHSpriteInternal {
         SetTextureStageState(1, CH_TSS_ALPHAOP, 1);   // D3DTOP_DISABLE
     }
 
-    void SetBlendMode(SpriteBlendMode mode, CHTexture* texture, DWORD vertexAlpha)
+    bool HasAlpha(CHTexture* texture, DWORD vertexAlpha)
     {
         // Check if texture has alpha (matching original logic exactly)
-        bool hasAlpha = (texture->Info.Format == CH_FMT_A8R8G8B8 ||
+        return (texture->Info.Format == CH_FMT_A8R8G8B8 ||
             texture->Info.Format == CH_FMT_A1R5G5B5 ||
             texture->Info.Format == CH_FMT_A4R4G4B4 ||
             texture->Info.Format == CH_FMT_DXT3 ||
             vertexAlpha < 255);
+    }
+
+    void SetBlendMode(SpriteBlendMode mode, CHTexture* texture, DWORD vertexAlpha)
+    {
+        bool hasAlpha = HasAlpha(texture, vertexAlpha);
 
         switch (mode)
         {
@@ -351,48 +403,6 @@ namespace CHSpriteInternal {
         }
     }
 
-    HRESULT RenderSprite(CHSprite* sprite)
-    {
-        if (!sprite)
-            return E_INVALIDARG;
-
-        // Create temporary vertex buffer for this draw call (immediate mode equivalent)
-        D3D11_BUFFER_DESC bufferDesc = {};
-        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        bufferDesc.ByteWidth = sizeof(CHSpriteVertex) * 4;
-        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-
-        CHComPtr<ID3D11Buffer> vertexBuffer;
-        HRESULT hr = g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, vertexBuffer.GetAddressOf());
-        if (FAILED(hr))
-            return hr;
-
-        // Map and fill vertex buffer
-        D3D11_MAPPED_SUBRESOURCE mappedResource;
-        hr = g_D3DContext->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-        if (FAILED(hr))
-            return hr;
-
-        memcpy(mappedResource.pData, sprite->vertex, sizeof(CHSpriteVertex) * 4);
-        g_D3DContext->Unmap(vertexBuffer.Get(), 0);
-
-        // Set vertex buffer and draw
-        UINT stride = sizeof(CHSpriteVertex);
-        UINT offset = 0;
-        ID3D11Buffer* vb = vertexBuffer.Get();
-        g_D3DContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-        g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
-
-        // Set sprite shaders
-        g_SpriteShaderManager.SetSpriteShaders();
-
-        // Draw triangle strip (2 triangles = 4 vertices) - matching original
-        g_D3DContext->Draw(4, 0);
-
-        return S_OK;
-    }
-
     HRESULT RenderDualSprite(CHSprite* spriteUp, CHSprite* spriteDn,
         UCHAR alphaA, UCHAR alphaB, UCHAR alphaC, UCHAR alphaD)
     {
@@ -420,26 +430,10 @@ namespace CHSpriteInternal {
             vertices[i].v1 = vertices[i].v2 = spriteUp->vertex[i].v;
         }
 
-        // Create vertex buffer
-        D3D11_BUFFER_DESC bufferDesc = {};
-        bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        bufferDesc.ByteWidth = sizeof(CHSpriteVertex2) * 4;
-        bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-
-        CHComPtr<ID3D11Buffer> vertexBuffer;
-        HRESULT hr = g_D3DDevice->CreateBuffer(&bufferDesc, nullptr, vertexBuffer.GetAddressOf());
-        if (FAILED(hr))
-            return hr;
-
-        // Map and fill vertex buffer
-        D3D11_MAPPED_SUBRESOURCE mappedResource;
-        hr = g_D3DContext->Map(vertexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedResource);
-        if (FAILED(hr))
-            return hr;
-
-        memcpy(mappedResource.pData, vertices, sizeof(CHSpriteVertex2) * 4);
-        g_D3DContext->Unmap(vertexBuffer.Get(), 0);
+        // Sub-allocate the quad from the shared dynamic vertex ring
+        UINT baseVertex = 0;
+        if (!CHInternal::g_DynamicVertexRing.Write(vertices, 4, sizeof(CHSpriteVertex2), &baseVertex, nullptr))
+            return E_FAIL;
 
         // Set textures (matching original order)
         SetTexture(0, spriteDn->lpTex->lpSRV.Get());
@@ -463,18 +457,15 @@ namespace CHSpriteInternal {
         SetTextureStageState(0, CH_TSS_MINFILTER, CH_TEXF_LINEAR);
         SetTextureStageState(1, CH_TSS_MINFILTER, CH_TEXF_LINEAR);
 
-        // Set vertex buffer and draw
-        UINT stride = sizeof(CHSpriteVertex2);
-        UINT offset = 0;
-        ID3D11Buffer* vb = vertexBuffer.Get();
-        g_D3DContext->IASetVertexBuffers(0, 1, &vb, &stride, &offset);
-        g_D3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+        // Set vertex and shared quad index buffer
+        CHInternal::g_DynamicVertexRing.Bind(sizeof(CHSpriteVertex2));
+        CHInternal::g_QuadIndexBuffer.Bind();
 
         // Set dual sprite shaders
         g_SpriteShaderManager.SetDualSpriteShaders();
 
         // Draw
-        g_D3DContext->Draw(4, 0);
+        CHInternal::g_QuadIndexBuffer.DrawQuads(1, baseVertex);
 
         // Disable second texture stage (matching original)
         SetTextureStageState(1, CH_TSS_COLOROP, 1); // D3DTOP_DISABLE
@@ -482,6 +473,139 @@ namespace CHSpriteInternal {
         return S_OK;
     }
 
+    // Sprite batch implementation
+    bool SpriteBatch::SameState(const SpriteBatchEntry& a, const SpriteBatchEntry& b)
+    {
+        return a.texture == b.texture &&
+            a.dwShowWay == b.dwShowWay &&
+            a.bHasAlpha == b.bHasAlpha;
+    }
+
+    void SpriteBatch::Add(const CHSprite* sprite, DWORD showWay)
+    {
+        SpriteBatchEntry entry;
+        memcpy(entry.vertex, sprite->vertex, sizeof(entry.vertex));
+        entry.texture = sprite->lpTex;
+        entry.dwShowWay = showWay;
+        entry.dwAlpha = sprite->vertex[0].color >> 24;
+        entry.bHasAlpha = HasAlpha(sprite->lpTex, entry.dwAlpha);
+        m_entries.push_back(entry);
+    }
+
+    void SpriteBatch::Flush()
+    {
+        if (m_entries.empty() || m_flushing)
+            return;
+        m_flushing = TRUE;
+
+        DWORD count = static_cast<DWORD>(m_entries.size());
+        m_order.resize(count);
+        for (DWORD i = 0; i < count; i++)
+            m_order[i] = i;
+
+        // Sorted layers group every run; otherwise only neighbours merge
+        if (m_sort)
+        {
+            std::stable_sort(m_order.begin(), m_order.end(), [this](DWORD a, DWORD b)
+            {
+                const SpriteBatchEntry& ea = m_entries[a];
+                const SpriteBatchEntry& eb = m_entries[b];
+                if (ea.dwShowWay != eb.dwShowWay)
+                    return ea.dwShowWay < eb.dwShowWay;
+                if (ea.bHasAlpha != eb.bHasAlpha)
+                    return ea.bHasAlpha < eb.bHasAlpha;
+                return std::less<CHTexture*>()(ea.texture, eb.texture);
+            });
+        }
+
+        DWORD draws = 0;
+        DWORD first = 0;
+        DWORD chunkLimit = SPRITE_BATCH_CHUNK;
+        while (first < count)
+        {
+            DWORD chunk = std::min(count - first, chunkLimit);
+
+            // A chunk the ring cannot hold is retried smaller
+            UINT baseVertex = 0;
+            CHSpriteVertex* out = static_cast<CHSpriteVertex*>(CHInternal::g_DynamicVertexRing.Lock(
+                chunk * 4, sizeof(CHSpriteVertex), &baseVertex, nullptr));
+            if (!out)
+            {
+                if (chunkLimit > 1)
+                {
+                    chunkLimit = std::max<DWORD>(chunk / 2, 1);
+                    continue;
+                }
+                break;
+            }
+
+            for (DWORD i = 0; i < chunk; i++)
+                memcpy(out + i * 4, m_entries[m_order[first + i]].vertex, sizeof(CHSpriteVertex) * 4);
+
+            CHInternal::g_DynamicVertexRing.Unlock();
+
+            CHInternal::g_DynamicVertexRing.Bind(sizeof(CHSpriteVertex));
+            CHInternal::g_QuadIndexBuffer.Bind();
+            g_SpriteShaderManager.SetSpriteShaders();
+
+            // One draw per run of matching texture and blend mode
+            DWORD run = 0;
+            while (run < chunk)
+            {
+                const SpriteBatchEntry& entry = m_entries[m_order[first + run]];
+
+                DWORD end = run + 1;
+                while (end < chunk && SameState(entry, m_entries[m_order[first + end]]))
+                    end++;
+
+                SetBlendMode(static_cast<SpriteBlendMode>(entry.dwShowWay), entry.texture, entry.dwAlpha);
+                SetTexture(0, entry.texture->lpSRV.Get());
+                CHInternal::g_QuadIndexBuffer.DrawQuads(end - run, baseVertex + run * 4);
+
+                draws++;
+                run = end;
+            }
+
+            first += chunk;
+        }
+
+        m_lastSprites = first;
+        m_lastDraws = draws;
+
+        // Ring unavailable: the next quads not drawn stay queued, in draw order,
+        // up to a cap so a ring that stays lost cannot grow the queue forever
+        if (first < count)
+        {
+            DWORD keep = std::min(count - first, SPRITE_BATCH_RETAIN);
+            std::vector<SpriteBatchEntry> remaining;
+            remaining.reserve(keep);
+            for (DWORD i = first; i < first + keep; i++)
+                remaining.push_back(m_entries[m_order[i]]);
+            m_entries.swap(remaining);
+            m_flushing = FALSE;
+            return;
+        }
+
+        m_entries.clear();
+        m_flushing = FALSE;
+    }
+
+    void SpriteBatch::Clear()
+    {
+        m_entries.clear();
+        m_order.clear();
+        m_entries.shrink_to_fit();
+        m_order.shrink_to_fit();
+    }
+
+    void SpriteBatch::GetStats(DWORD* sprites, DWORD* draws) const
+    {
+        if (sprites)
+            *sprites = m_lastSprites;
+        if (draws)
+            *draws = m_lastDraws;
+    }
+
     HRESULT CreateStagingTexture(CHTexture* texture, CHComPtr<ID3D11Texture2D>& stagingTexture)
     {
         if (!texture || !texture->lpTex)
@@ -492,7 +616,7 @@ namespace CHSpriteInternal {
         desc.BindFlags = 0;
         desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ | D3D11_CPU_ACCESS_WRITE;
 
-        return g_D3DDevice->CreateTexture2D(&desc, nullptr, stagingTexture.GetAddressOf());
+        return CHBackendInternal::CreateTexture2D(&desc, nullptr, stagingTexture.GetAddressOf());
     }
 
     void ReleaseStagingTexture()
@@ -558,8 +682,8 @@ namespace CHSpriteInternal {
         CHComPtr<ID3DBlob> vertexShaderBlob;
         CHComPtr<ID3DBlob> errorBlob;
 
-        HRESULT hr = D3DCompile(vertexShaderSource, strlen(vertexShaderSource), nullptr, nullptr, nullptr,
-            "main", "vs_4_0", 0, 0, vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        HRESULT hr = CHShaderInternal::CompileShader(vertexShaderSource, nullptr,
+            "main", "vs_4_0", vertexShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
         if (FAILED(hr))
             return hr;
 
@@ -571,8 +695,8 @@ namespace CHSpriteInternal {
 
         // Create pixel shader
         CHComPtr<ID3DBlob> pixelShaderBlob;
-        hr = D3DCompile(pixelShaderSource, strlen(pixelShaderSource), nullptr, nullptr, nullptr,
-            "main", "ps_4_0", 0, 0, pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
+        hr = CHShaderInternal::CompileShader(pixelShaderSource, nullptr,
+            "main", "ps_4_0", pixelShaderBlob.GetAddressOf(), errorBlob.GetAddressOf());
         if (FAILED(hr))
             return hr;
 
@@ -10,6 +10,8 @@
 #include "CH_common.h"
 #include "CH_texture.h"
 #include "CH_main.h"
+#include "CH_atlas.h"
+#include <vector>
 
 // Sprite vertex definition (maintaining exact same layout as original)
 struct CHSpriteVertex {
@@ -20,10 +22,11 @@ struct CHSpriteVertex {
     float u, v;         // Texture coordinates
 };
 
-// Sprite structure (maintaining exact same layout as C3Sprite)
+// Sprite structure (C3Sprite fields plus the atlas entry the image comes from)
 struct CHSprite {
     CHSpriteVertex vertex[4];
     CHTexture* lpTex;
+    CHAtlasEntry* lpAtlas;      // Image area when lpTex is an atlas page
 };
 
 // Function declarations (maintaining exact same signatures as original)
@@ -71,6 +74,21 @@ void Sprite_Prepare();
 CH_CORE_DLL_API
 BOOL Sprite_Draw(CHSprite* lpSprite, DWORD dwShowWay = 0);
 
+// Sprite batching: Sprite_Draw queues the quad, and queued sprites that
+// share texture and show way are drawn with one call when the batch is
+// flushed (explicitly, by the dual sprite/text paths, or by End3D)
+CH_CORE_DLL_API
+void Sprite_FlushBatch();
+
+// Group queued sprites by show way and texture instead of keeping draw
+// order (only for layers whose sprites don't overlap)
+CH_CORE_DLL_API
+void Sprite_SetBatchSort(BOOL bSort);
+
+// Sprites and draw calls of the last flush
+CH_CORE_DLL_API
+void Sprite_GetBatchStats(DWORD* lpSprites, DWORD* lpDraws);
+
 // Locked rect structure for sprite pixel access
 struct CHLockedRect {
     INT Pitch;
@@ -108,10 +126,10 @@ namespace CHSpriteInternal {
     
     // Render state setup
     void SetupSpriteRenderStates();
+    bool HasAlpha(CHTexture* texture, DWORD vertexAlpha);
     void SetBlendMode(SpriteBlendMode mode, CHTexture* texture, DWORD vertexAlpha);
     
     // Rendering utilities
-    HRESULT RenderSprite(CHSprite* sprite);
     HRESULT RenderDualSprite(CHSprite* spriteUp, CHSprite* spriteDn,UCHAR alphaA, UCHAR alphaB, UCHAR alphaC, UCHAR alphaD);
     
     // Texture access (for Lock/Unlock simulation)
@@ -135,6 +153,48 @@ namespace CHSpriteInternal {
     };
     
     extern SpriteShaderManager g_SpriteShaderManager;
+
+    // Queued sprite quad
+    struct SpriteBatchEntry {
+        CHSpriteVertex vertex[4];
+        CHTexture* texture;
+        DWORD dwShowWay;
+        DWORD dwAlpha;          // Vertex alpha the blend mode is chosen from
+        bool bHasAlpha;
+    };
+
+    // Sprite quads gathered between flushes. SetRenderState, SetTextureStageState,
+    // SetTexture and Texture_Unload flush it; engine draws that bind their own
+    // buffers or shaders first flush it explicitly before doing so
+    class SpriteBatch {
+    private:
+        std::vector<SpriteBatchEntry> m_entries;
+        std::vector<DWORD> m_order;
+        BOOL m_sort = FALSE;
+        BOOL m_flushing = FALSE;    // Flush's own state changes must not re-enter it
+
+        // Statistics of the last flush
+        DWORD m_lastSprites = 0;
+        DWORD m_lastDraws = 0;
+
+        static bool SameState(const SpriteBatchEntry& a, const SpriteBatchEntry& b);
+
+    public:
+        void Add(const CHSprite* sprite, DWORD showWay);
+        void Flush();
+        void Clear();
+        BOOL IsEmpty() const { return m_entries.empty(); }
+        void SetSort(BOOL sort) { m_sort = sort; }
+        void GetStats(DWORD* sprites, DWORD* draws) const;
+    };
+
+    extern SpriteBatch g_SpriteBatch;
+
+    // Quads written per ring lock when flushing
+    constexpr DWORD SPRITE_BATCH_CHUNK = 8192;
+
+    // Quads kept for the next flush when the ring cannot be locked
+    constexpr DWORD SPRITE_BATCH_RETAIN = SPRITE_BATCH_CHUNK;
 }
 
 // Compatibility types
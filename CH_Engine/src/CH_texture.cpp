@@ -2,6 +2,8 @@
 #include "CH_texture.h"
 #include "CH_main.h"
 #include "CH_datafile.h"
+#include "CH_backend.h"
+#include "CH_sprite.h"
 #include <wincodec.h>
 #include <string>
 #include <algorithm>
@@ -129,6 +131,9 @@ void Texture_Unload(CHTexture** lpTex)
     tex->nDupCount--;
     if (tex->nDupCount <= 0)
     {
+        // Queued sprites may still point at it
+        CHSpriteInternal::g_SpriteBatch.Flush();
+
         int id = tex->nID;
 
         // Unregister from global texture array before delete
@@ -329,7 +334,7 @@ namespace CHTextureInternal {
         initData.pSysMem = rgbaData.data();
         initData.SysMemPitch = width * 4;
 
-        HRESULT hr = g_D3DDevice->CreateTexture2D(&texDesc, &initData, texture->lpTex.GetAddressOf());
+        HRESULT hr = CHBackendInternal::CreateTexture2D(&texDesc, &initData, texture->lpTex.GetAddressOf());
         if (FAILED(hr))
             return FALSE;
 
@@ -428,7 +433,7 @@ namespace CHTextureInternal {
         initData.pSysMem = pixels;
         initData.SysMemPitch = width * 4;
 
-        HRESULT hr = g_D3DDevice->CreateTexture2D(&texDesc, &initData, texture->lpTex.GetAddressOf());
+        HRESULT hr = CHBackendInternal::CreateTexture2D(&texDesc, &initData, texture->lpTex.GetAddressOf());
         if (FAILED(hr))
             return FALSE;
 
@@ -490,7 +495,7 @@ namespace CHTextureInternal {
             desc.MiscFlags |= D3D11_RESOURCE_MISC_GENERATE_MIPS;
         }
 
-        HRESULT hr = g_D3DDevice->CreateTexture2D(&desc, nullptr, texture->lpTex.GetAddressOf());
+        HRESULT hr = CHBackendInternal::CreateTexture2D(&desc, nullptr, texture->lpTex.GetAddressOf());
         if (FAILED(hr))
             return FALSE;
 
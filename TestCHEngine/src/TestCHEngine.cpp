@@ -20,6 +20,8 @@
 #include "CH_phy.h"
 #include "CH_ptcl.h"
 #include "CH_datafile.h"
+#include "CH_backend.h"
+#include "CH_shader.h"
 
 // Test framework
 class CHEngineTest {
@@ -813,6 +815,58 @@ void RunConsoleTests() {
     printf("\n✓ Console tests completed!\n\n");
 }
 
+// CPU-side unit tests (TestCHEngineUnits.cpp), returns the failed checks
+int RunUnitTests();
+
+// Build step (premake postbuild): load every engine shader on the WARP device and
+// write their bytecode to lpFile, which the next CH_Engine build embeds. The file
+// is only replaced when its contents change, so an unchanged header never forces
+// a rebuild. Returns non-zero only when the header could not be written
+int ExportShaderBlobs(const char* lpFile) {
+    if (Init3DHeadless(64, 64, CH_BACKEND_WARP) != 1) {
+        printf("Shader export skipped: no WARP device\n");
+        return 0;
+    }
+
+    // Skinned mesh shaders are created on first use
+    Phy_Prepare();
+
+    char tmpFile[MAX_PATH];
+    sprintf_s(tmpFile, "%s.tmp", lpFile);
+    BOOL exported = Shader_ExportEmbedded(tmpFile);
+    Quit3D();
+    if (!exported) {
+        printf("Shader export failed: cannot write %s\n", tmpFile);
+        return 1;
+    }
+
+    std::vector<char> oldData, newData;
+    auto readAll = [](const char* file, std::vector<char>& data) {
+        FILE* f = nullptr;
+        if (fopen_s(&f, file, "rb") != 0 || !f)
+            return false;
+        char buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), f)) > 0)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(f);
+        return true;
+    };
+
+    if (readAll(lpFile, oldData) && readAll(tmpFile, newData) && oldData == newData) {
+        DeleteFileA(tmpFile);
+        printf("Shader blobs unchanged: %s\n", lpFile);
+        return 0;
+    }
+
+    if (!MoveFileExA(tmpFile, lpFile, MOVEFILE_REPLACE_EXISTING)) {
+        printf("Shader export failed: cannot replace %s\n", lpFile);
+        return 1;
+    }
+    printf("Shader blobs written: %s\n", lpFile);
+    return 0;
+}
+
 // Engine capability demonstration
 void PrintEngineCapabilities() {
     printf("CH Engine Capabilities\n");
@@ -870,6 +924,24 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         getchar();
     }
 
+    // Unit test mode: exit code is the number of failed checks
+    if (lpCmdLine && strstr(lpCmdLine, "-units")) {
+        return RunUnitTests();
+    }
+
+    // Shader export mode: the rest of the command line is the output file
+    const char* exportArg = lpCmdLine ? strstr(lpCmdLine, "-export-shaders") : nullptr;
+    if (exportArg) {
+        char exportFile[MAX_PATH] = {};
+        const char* path = exportArg + strlen("-export-shaders");
+        while (*path == ' ' || *path == '"')
+            path++;
+        strncpy_s(exportFile, path, _TRUNCATE);
+        for (size_t len = strlen(exportFile); len > 0 && (exportFile[len - 1] == ' ' || exportFile[len - 1] == '"'); len--)
+            exportFile[len - 1] = '\0';
+        return ExportShaderBlobs(exportFile);
+    }
+
     // Print engine info
     PrintEngineCapabilities();
 
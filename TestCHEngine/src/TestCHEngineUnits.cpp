@@ -0,0 +1,562 @@
+﻿// CH Engine Unit Tests
+// File: TestCHEngineUnits.cpp
+// Checks of engine internals, run with -units (no window needed; the
+// headless frame section runs on the WARP device and is skipped without it)
+
+#include <windows.h>
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+#include <algorithm>
+
+// CH Engine includes
+#include "CH_main.h"
+#include "CH_affine.h"
+#include "CH_ptcl.h"
+#include "CH_atlas.h"
+#include "CH_queue.h"
+#include "CH_scene.h"
+#include "CH_texture.h"
+#include "CH_backend.h"
+#include "CH_shader.h"
+#include "CH_instance.h"
+#include "CH_batch.h"
+#include <string>
+
+static int g_nChecks = 0;
+static int g_nFailures = 0;
+
+static void Check(bool ok, const char* what) {
+    g_nChecks++;
+    if (!ok)
+        g_nFailures++;
+    printf("   %s %s\n", ok ? "✓" : "✗", what);
+}
+
+static bool NearEqual(const XMMATRIX& a, const XMMATRIX& b, float epsilon = 0.0001f) {
+    for (int i = 0; i < 4; i++) {
+        if (!XMVector4NearEqual(a.r[i], b.r[i], XMVectorReplicate(epsilon)))
+            return false;
+    }
+    return true;
+}
+
+// Affine 3x4 transforms against the equivalent XMMATRIX operations
+static void TestAffine() {
+    printf("1. Affine Transforms:\n");
+
+    XMMATRIX rigid = XMMatrixRotationRollPitchYaw(0.3f, -1.1f, 0.7f) * XMMatrixTranslation(4.0f, -2.0f, 9.0f);
+    XMMATRIX scaled = XMMatrixScaling(2.0f, 0.5f, 3.0f) * XMMatrixRotationY(0.9f) * XMMatrixTranslation(-1.0f, 6.0f, 2.5f);
+    XMMATRIX sheared = XMMatrixSet(
+        1.0f, 0.4f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.7f, 0.0f, 1.5f, 0.0f,
+        3.0f, 1.0f, -2.0f, 1.0f);
+
+    CHAffine a = Affine_FromMatrix(rigid);
+    CHAffine b = Affine_FromMatrix(scaled);
+    CHAffine c = Affine_FromMatrix(sheared);
+
+    Check(NearEqual(Affine_ToMatrix(a), rigid), "FromMatrix/ToMatrix round-trip");
+    Check(NearEqual(Affine_ToMatrix(Affine_Identity()), XMMatrixIdentity()), "Identity");
+    Check(NearEqual(Affine_ToMatrix(Affine_Multiply(a, b)), XMMatrixMultiply(rigid, scaled)),
+        "Multiply matches XMMatrixMultiply order");
+
+    // The inverse must hold for scale and shear, not only rigid transforms
+    Check(NearEqual(Affine_ToMatrix(Affine_Inverse(a)), XMMatrixInverse(nullptr, rigid)), "Inverse of rigid transform");
+    Check(NearEqual(Affine_ToMatrix(Affine_Inverse(b)), XMMatrixInverse(nullptr, scaled)), "Inverse of scaled transform");
+    Check(NearEqual(Affine_ToMatrix(Affine_Inverse(c)), XMMatrixInverse(nullptr, sheared)), "Inverse of sheared transform");
+    Check(NearEqual(Affine_ToMatrix(Affine_Multiply(c, Affine_Inverse(c))), XMMatrixIdentity()),
+        "Transform times inverse is identity");
+
+    // Seven points: one SoA group of four plus a scalar tail of three
+    XMFLOAT3 points[7];
+    XMFLOAT3 transformed[7];
+    for (int i = 0; i < 7; i++)
+        points[i] = XMFLOAT3(i * 1.5f - 3.0f, 2.0f - i, i * 0.25f);
+    Affine_TransformPoints(c, transformed, sizeof(XMFLOAT3), points, sizeof(XMFLOAT3), 7);
+
+    bool pointsValid = true;
+    for (int i = 0; i < 7; i++) {
+        XMVECTOR expected = XMVector3TransformCoord(XMLoadFloat3(&points[i]), sheared);
+        if (!XMVector3NearEqual(XMLoadFloat3(&transformed[i]), expected, XMVectorReplicate(0.0001f)))
+            pointsValid = false;
+    }
+    Check(pointsValid, "TransformPoints matches XMVector3TransformCoord");
+
+    Check(NearEqual(Affine_ToMatrix(Affine_Blend(a, b, 0.0f)), rigid) &&
+        NearEqual(Affine_ToMatrix(Affine_Blend(a, b, 1.0f)), scaled), "Blend end points");
+}
+
+// Particle depth keys and the 16-bit LSD radix sort
+static void TestRadixSort() {
+    printf("2. Depth Radix Sort:\n");
+
+    // Farthest depth maps to key 0 so ascending keys draw back to front
+    float nearZ = 2.0f, farZ = 50.0f;
+    float invRange = 1.0f / (farZ - nearZ);
+    Check(CHPtclInternal::QuantizeDepth(farZ, farZ, invRange) == 0 &&
+        CHPtclInternal::QuantizeDepth(nearZ, farZ, invRange) == 65535, "QuantizeDepth maps far to 0, near to 65535");
+    Check(CHPtclInternal::QuantizeDepth(100.0f, farZ, invRange) == 0 &&
+        CHPtclInternal::QuantizeDepth(-5.0f, farZ, invRange) == 65535, "QuantizeDepth clamps outside the range");
+    Check(CHPtclInternal::QuantizeDepth(7.0f, 7.0f, 0.0f) == 0, "QuantizeDepth of an empty range");
+
+    // Depth round-trip within one key step
+    bool roundTrip = true;
+    for (int i = 0; i <= 100; i++) {
+        float depth = nearZ + (farZ - nearZ) * i / 100.0f;
+        WORD key = CHPtclInternal::QuantizeDepth(depth, farZ, invRange);
+        float decoded = farZ - key / 65535.0f * (farZ - nearZ);
+        if (fabsf(decoded - depth) > (farZ - nearZ) / 65535.0f)
+            roundTrip = false;
+    }
+    Check(roundTrip, "Depth round-trip within one key step");
+
+    // Random keys with many duplicates: sorted, a permutation, and stable
+    const DWORD count = 1000;
+    std::vector<WORD> keys(count);
+    std::vector<DWORD> order(count), scratch(count);
+    srand(1234);
+    for (DWORD i = 0; i < count; i++)
+        keys[i] = static_cast<WORD>((rand() % 300) * 211);
+    CHPtclInternal::RadixSortKeys(keys.data(), count, order.data(), scratch.data());
+
+    bool sorted = true, stable = true;
+    std::vector<BYTE> seen(count, 0);
+    for (DWORD i = 0; i < count; i++) {
+        seen[order[i]]++;
+        if (i > 0 && keys[order[i - 1]] > keys[order[i]])
+            sorted = false;
+        if (i > 0 && keys[order[i - 1]] == keys[order[i]] && order[i - 1] > order[i])
+            stable = false;
+    }
+    bool permutation = true;
+    for (DWORD i = 0; i < count; i++) {
+        if (seen[i] != 1)
+            permutation = false;
+    }
+    Check(sorted, "Keys ascending");
+    Check(permutation, "Order is a permutation");
+    Check(stable, "Equal keys keep their input order");
+
+    // Single byte passes are skipped when that byte never varies
+    WORD lowOnly[5] = { 0x0105, 0x0103, 0x0104, 0x0101, 0x0102 };
+    WORD same[4] = { 0x4242, 0x4242, 0x4242, 0x4242 };
+    DWORD lowOrder[5], sameOrder[4], small[5];
+    CHPtclInternal::RadixSortKeys(lowOnly, 5, lowOrder, small);
+    CHPtclInternal::RadixSortKeys(same, 4, sameOrder, small);
+    Check(lowOrder[0] == 3 && lowOrder[1] == 4 && lowOrder[2] == 1 && lowOrder[3] == 2 && lowOrder[4] == 0,
+        "Constant high byte");
+    Check(sameOrder[0] == 0 && sameOrder[1] == 1 && sameOrder[2] == 2 && sameOrder[3] == 3, "All keys equal");
+}
+
+// Atlas cell of a particle age, as quad generation picks it
+static DWORD AgeCell(float age, DWORD cells) {
+    return std::min(static_cast<DWORD>(floorf(age * cells)), cells - 1);
+}
+
+// Packs one frame with StoreFrame and decodes every particle back
+static bool PackRoundTrip(DWORD dwRow, BOOL bAge16, DWORD count) {
+    CHPtcl ptcl{};
+    ptcl.dwRow = dwRow;
+    ptcl.bPackedAge16 = bAge16;
+
+    std::vector<XMFLOAT3> pos(count);
+    std::vector<float> age(count), size(count);
+    for (DWORD i = 0; i < count; i++) {
+        pos[i] = XMFLOAT3(sinf(i * 0.37f) * 40.0f, i * 0.05f - 3.0f, cosf(i * 0.11f) * 7.5f);
+        age[i] = i / static_cast<float>(count - 1);
+        size[i] = 0.5f + (i % 17) * 0.125f;
+    }
+
+    CHPtclFrame frame{};
+    frame.dwCount = count;
+    std::vector<BYTE> block;
+    CHPtclInternal::StoreFrame(&ptcl, &frame, pos.data(), age.data(), size.data(), &block);
+    CHPtclInternal::FinishPacking(&ptcl, block);
+
+    // Positions and sizes within half a 16-bit step, ages in the same atlas cell
+    DWORD cells = dwRow * dwRow;
+    bool valid = true;
+    for (DWORD i = 0; i < count; i++) {
+        XMFLOAT3 p;
+        float a, s;
+        CHPtclInternal::DecodeParticle(&ptcl, &frame, i, &p, &a, &s);
+        if (fabsf(p.x - pos[i].x) > frame.PackedScale.x * 0.5f + 0.0001f ||
+            fabsf(p.y - pos[i].y) > frame.PackedScale.y * 0.5f + 0.0001f ||
+            fabsf(p.z - pos[i].z) > frame.PackedScale.z * 0.5f + 0.0001f ||
+            fabsf(s - size[i]) > frame.fSizeScale * 0.5f + 0.0001f ||
+            AgeCell(a, cells) != AgeCell(age[i], cells))
+            valid = false;
+    }
+
+    delete[] ptcl.lpPackedData;
+    return valid;
+}
+
+// Compressed particle frames decode back within their quantization step
+static void TestParticlePacking() {
+    printf("3. Particle Frame Packing:\n");
+
+    bool ageCells = true;
+    for (DWORD cells = 1; cells <= 256; cells++) {
+        for (int i = 0; i <= 1000; i++) {
+            float age = i / 1000.0f;
+            DWORD q = CHPtclInternal::QuantizeAge(age, 256, cells);
+            if (q > 255 || AgeCell((q + 0.5f) / 256.0f, cells) != AgeCell(age, cells))
+                ageCells = false;
+        }
+    }
+    Check(ageCells, "8-bit ages keep their atlas cell (up to 256 cells)");
+    Check(CHPtclInternal::QuantizeAge(-1.0f, 256, 16) == 0 &&
+        CHPtclInternal::QuantizeAge(2.0f, 256, 16) == 255, "QuantizeAge clamps");
+
+    Check(PackRoundTrip(4, FALSE, 500), "8-bit age frame round-trip");
+    Check(PackRoundTrip(20, TRUE, 500), "16-bit age frame round-trip (400 cells)");
+}
+
+// Reserved rectangle of a packed image, padding included
+struct PackedRect {
+    DWORD x0, y0, x1, y1;
+};
+
+// Atlas rectangle packing: images stay inside the page and their padding never overlaps
+static void TestAtlasPacking() {
+    printf("4. Atlas Rect Packing:\n");
+
+    const DWORD size = 256;
+    const DWORD pad = CH_ATLAS_PADDING;
+    CHAtlasPage page{};
+    CHAtlasInternal::InitPacker(&page, size, size);
+
+    std::vector<PackedRect> rects;
+    srand(4321);
+    bool inside = true;
+    for (int i = 0; i < 200; i++) {
+        DWORD w = 1 + rand() % 24;
+        DWORD h = 1 + rand() % 24;
+        DWORD x, y;
+        if (!CHAtlasInternal::PackRect(&page, w, h, &x, &y))
+            break;
+        if (x < pad || y < pad || x + w + pad > size || y + h + pad > size)
+            inside = false;
+        rects.push_back({ x - pad, y - pad, x + w + pad, y + h + pad });
+    }
+
+    bool disjoint = true;
+    for (size_t i = 0; i < rects.size(); i++) {
+        for (size_t j = i + 1; j < rects.size(); j++) {
+            const PackedRect& a = rects[i];
+            const PackedRect& b = rects[j];
+            if (a.x0 < b.x1 && b.x0 < a.x1 && a.y0 < b.y1 && b.y0 < a.y1)
+                disjoint = false;
+        }
+    }
+    Check(rects.size() > 50, "Packs many small images");
+    Check(inside, "Images and their padding inside the page");
+    Check(disjoint, "Padded rectangles never overlap");
+    delete[] page.lpNodes;
+
+    // The padding counts against the page size
+    CHAtlasPage full{};
+    CHAtlasInternal::InitPacker(&full, 64, 64);
+    DWORD x, y;
+    Check(!CHAtlasInternal::PackRect(&full, 64, 64, &x, &y), "Page sized image doesn't fit with its padding");
+    Check(CHAtlasInternal::PackRect(&full, 64 - pad * 2, 64 - pad * 2, &x, &y) && x == pad && y == pad,
+        "Largest image starts inside its padding");
+    delete[] full.lpNodes;
+}
+
+// Render queue sort keys: layer, then opaque before alpha, then material or depth
+static void TestQueueKeys() {
+    printf("5. Render Queue Keys:\n");
+
+    using CHQueueInternal::MakeKey;
+
+    Check(MakeKey(0, TRUE, 7, 16383, 16383, 1.0f) < MakeKey(1, FALSE, 0, 0, 0, 1.0f), "Layers sort first");
+    Check(MakeKey(3, FALSE, 7, 16383, 16383, 1000.0f) < MakeKey(3, TRUE, 0, 0, 0, 1.0f),
+        "Opaque before translucent in a layer");
+
+    // Opaque: shader, texture, lightmap, then front to back
+    Check(MakeKey(0, FALSE, 1, 900, 900, 1.0f) < MakeKey(0, FALSE, 2, 0, 0, 0.5f), "Opaque groups by shader first");
+    Check(MakeKey(0, FALSE, 1, 5, 900, 1.0f) < MakeKey(0, FALSE, 1, 6, 0, 0.5f), "Then by texture");
+    Check(MakeKey(0, FALSE, 1, 5, 8, 1.0f) < MakeKey(0, FALSE, 1, 5, 9, 0.5f), "Then by lightmap");
+    Check(MakeKey(0, FALSE, 1, 5, 8, 2.0f) < MakeKey(0, FALSE, 1, 5, 8, 3.0f), "Same material front to back");
+    Check(MakeKey(0, FALSE, 1, 5, 8, 0.0f) < MakeKey(0, FALSE, 1, 5, -1, 0.0f), "No lightmap after every lightmap");
+
+    // Translucent: back to front whatever the material
+    Check(MakeKey(0, TRUE, 7, 16383, 16383, 50.0f) < MakeKey(0, TRUE, 0, 0, 0, 10.0f),
+        "Translucent back to front across materials");
+    Check(MakeKey(0, TRUE, 1, 5, 8, 10.0f) < MakeKey(0, TRUE, 1, 6, 8, 10.0f), "Equal depth by material");
+
+    // Depth order holds over a wide range; behind the camera counts as 0
+    bool monotonic = true;
+    float depth = 0.001f;
+    UINT64 prev = MakeKey(0, FALSE, 0, 0, 0, 0.0f);
+    for (int i = 0; i < 60; i++, depth *= 1.5f) {
+        UINT64 key = MakeKey(0, FALSE, 0, 0, 0, depth);
+        if (key <= prev)
+            monotonic = false;
+        prev = key;
+    }
+    Check(monotonic, "Opaque keys grow with depth");
+    Check(MakeKey(0, FALSE, 0, 0, 0, -4.0f) == MakeKey(0, FALSE, 0, 0, 0, 0.0f), "Negative depth clamps to 0");
+}
+
+// Shader cache keys name disk cache files: same inputs, same key in every run
+static void TestShaderKeys() {
+    printf("6. Shader Cache Keys:\n");
+
+    using CHShaderInternal::MakeKey;
+
+    const char* source = "float4 main(float4 p : POSITION) : SV_POSITION { return p; }";
+    D3D_SHADER_MACRO defines[] = { { "LIGHTMAP", "1" }, { "FOG", "0" }, { nullptr, nullptr } };
+    UINT64 key = MakeKey(source, defines, "main", "vs_4_0");
+
+    // Copies at other addresses hash the same (only contents count)
+    std::string sourceCopy = source;
+    std::string name0 = "LIGHTMAP", value0 = "1", name1 = "FOG", value1 = "0";
+    D3D_SHADER_MACRO definesCopy[] = {
+        { name0.c_str(), value0.c_str() }, { name1.c_str(), value1.c_str() }, { nullptr, nullptr } };
+    Check(MakeKey(sourceCopy.c_str(), definesCopy, std::string("main").c_str(), std::string("vs_4_0").c_str()) == key,
+        "Same inputs from other buffers give the same key");
+    Check(MakeKey(source, defines, "main", "vs_4_0") == key, "Repeated calls give the same key");
+
+    // Every input changes the key
+    std::string edited = source;
+    edited[edited.size() - 3] = 'q';
+    D3D_SHADER_MACRO otherValue[] = { { "LIGHTMAP", "0" }, { "FOG", "0" }, { nullptr, nullptr } };
+    Check(MakeKey(edited.c_str(), defines, "main", "vs_4_0") != key, "Source edit changes the key");
+    Check(MakeKey(source, otherValue, "main", "vs_4_0") != key, "Define value changes the key");
+    Check(MakeKey(source, defines, "VSMain", "vs_4_0") != key, "Entry point changes the key");
+    Check(MakeKey(source, defines, "main", "vs_5_0") != key, "Profile changes the key");
+
+    // Field boundaries are part of the hash
+    D3D_SHADER_MACRO ab[] = { { "AB", "C" }, { nullptr, nullptr } };
+    D3D_SHADER_MACRO a[] = { { "A", "BC" }, { nullptr, nullptr } };
+    Check(MakeKey(source, ab, "main", "vs_4_0") != MakeKey(source, a, "main", "vs_4_0"),
+        "Define name/value boundary is hashed");
+    D3D_SHADER_MACRO none[] = { { nullptr, nullptr } };
+    Check(MakeKey(source, nullptr, "main", "vs_4_0") == MakeKey(source, none, "main", "vs_4_0"),
+        "No defines and an empty define list match");
+}
+
+// Instancing groups: one per (mesh, texture, lightmap), first seen order, contiguous streams
+static void TestInstanceGroups() {
+    printf("7. Scene Instance Groups:\n");
+
+    CHScene meshes[2];
+    struct { int mesh, tex, lightmap; } input[] = {
+        { 0, 1, -1 }, { 1, 1, -1 }, { 0, 1, -1 }, { 0, 2, -1 }, { 0, 1, 5 }, { 1, 1, -1 }, { 0, 1, -1 }
+    };
+    const DWORD count = sizeof(input) / sizeof(input[0]);
+
+    // Each placement's world carries its input index in _41
+    std::vector<CHInstancePlacement> placements(count);
+    for (DWORD i = 0; i < count; i++) {
+        placements[i].lpScene = &meshes[input[i].mesh];
+        placements[i].nTex = input[i].tex;
+        placements[i].nlTex = input[i].lightmap;
+        XMStoreFloat4x4(&placements[i].matWorld, XMMatrixTranslation(static_cast<float>(i), 0.0f, 0.0f));
+    }
+
+    std::vector<CHInstanceGroup> groups;
+    std::vector<XMFLOAT4X4> stream;
+    CHInstanceInternal::BuildGroups(placements, groups, stream);
+
+    Check(groups.size() == 4 &&
+        groups[0].lpScene == &meshes[0] && groups[0].nTex == 1 && groups[0].nlTex == -1 &&
+        groups[1].lpScene == &meshes[1] && groups[1].nTex == 1 && groups[1].nlTex == -1 &&
+        groups[2].lpScene == &meshes[0] && groups[2].nTex == 2 && groups[2].nlTex == -1 &&
+        groups[3].lpScene == &meshes[0] && groups[3].nTex == 1 && groups[3].nlTex == 5,
+        "Groups by mesh, texture and lightmap in first seen order");
+
+    DWORD firsts[4] = { 0, 3, 5, 6 };
+    DWORD counts[4] = { 3, 2, 1, 1 };
+    bool ranges = groups.size() == 4;
+    for (size_t g = 0; ranges && g < groups.size(); g++) {
+        if (groups[g].dwFirstInstance != firsts[g] || groups[g].dwInstanceCount != counts[g])
+            ranges = false;
+    }
+    Check(ranges, "Each group's instances are contiguous");
+
+    int expected[count] = { 0, 2, 6, 1, 5, 3, 4 };
+    bool order = stream.size() == count;
+    for (DWORD i = 0; order && i < count; i++) {
+        if (stream[i]._41 != static_cast<float>(expected[i]))
+            order = false;
+    }
+    Check(order, "Instances keep their recording order within a group");
+
+    // Reused vectors are refilled, not appended to
+    placements.resize(1);
+    CHInstanceInternal::BuildGroups(placements, groups, stream);
+    Check(groups.size() == 1 && groups[0].dwInstanceCount == 1 && stream.size() == 1, "Rebuild replaces the old groups");
+    placements.clear();
+    CHInstanceInternal::BuildGroups(placements, groups, stream);
+    Check(groups.empty() && stream.empty(), "No placements, no groups");
+}
+
+// Static batch culling: frustum planes of a camera at the origin looking down +z
+static void TestFrustumCulling() {
+    printf("8. Frustum Culling:\n");
+
+    XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f),
+        XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    XMMATRIX proj = XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, 1.0f, 100.0f);
+    XMFLOAT4 planes[6];
+    CHBatchInternal::ExtractFrustum(XMMatrixMultiply(view, proj), planes);
+
+    bool normalized = true;
+    for (int p = 0; p < 6; p++) {
+        if (fabsf(sqrtf(planes[p].x * planes[p].x + planes[p].y * planes[p].y + planes[p].z * planes[p].z) - 1.0f) > 0.0001f)
+            normalized = false;
+    }
+    Check(normalized, "Planes are normalized");
+
+    // Near plane at z = 1, far plane at z = 100 (distances in world units)
+    Check(fabsf(planes[4].z * 1.0f + planes[4].w) < 0.0001f && planes[4].z > 0.0f, "Near plane at z = 1");
+    Check(fabsf(planes[5].z * 100.0f + planes[5].w) < 0.001f && planes[5].z < 0.0f, "Far plane at z = 100");
+
+    auto visible = [&planes](float x0, float y0, float z0, float x1, float y1, float z1) {
+        return CHBatchInternal::BoxVisible(planes, XMFLOAT3(x0, y0, z0), XMFLOAT3(x1, y1, z1)) != FALSE;
+    };
+    Check(visible(-1.0f, -1.0f, 10.0f, 1.0f, 1.0f, 12.0f), "Box ahead is visible");
+    Check(!visible(-1.0f, -1.0f, -12.0f, 1.0f, 1.0f, -10.0f), "Box behind is culled");
+    Check(!visible(-1.0f, -1.0f, 101.0f, 1.0f, 1.0f, 110.0f), "Box past the far plane is culled");
+    Check(!visible(-30.0f, -1.0f, 10.0f, -13.0f, 1.0f, 12.0f), "Box left of the 90 degree view is culled");
+    Check(!visible(-1.0f, 13.0f, 10.0f, 1.0f, 30.0f, 12.0f), "Box above the view is culled");
+    Check(visible(-30.0f, -1.0f, 10.0f, -9.0f, 1.0f, 12.0f), "Box crossing the left plane is visible");
+    Check(visible(-1.0f, -1.0f, 0.5f, 1.0f, 1.0f, 2.0f), "Box crossing the near plane is visible");
+    Check(visible(-500.0f, -500.0f, -500.0f, 500.0f, 500.0f, 500.0f), "Box around the camera is visible");
+}
+
+// Draw and buffer traffic of a known frame on a headless device
+static void TestHeadlessFrame() {
+    printf("9. Headless Frame:\n");
+
+    if (Init3DHeadless(320, 240, CH_BACKEND_WARP) != 1) {
+        printf("   (no D3D11 device, skipped)\n");
+        return;
+    }
+
+    // Opaque 8 vertex, 12 triangle box in a global texture slot
+    CHTexture* texture = nullptr;
+    CHScene* scene = new CHScene;
+    Scene_Clear(scene);
+    if (Texture_Create(&texture, 64, 64, 1, CH_FMT_X8R8G8B8, CH_POOL_MANAGED)) {
+        for (int i = 0; i < TEX_MAX; i++) {
+            if (!g_lpTex[i]) {
+                g_lpTex[i] = texture;
+                texture->nID = i;
+                scene->nTex = i;
+                g_dwTexCount++;
+                break;
+            }
+        }
+    }
+
+    scene->dwVecCount = 8;
+    scene->lpVB = new CHSceneVertex[8];
+    for (int i = 0; i < 8; i++) {
+        float x = (i & 1) ? 1.0f : -1.0f;
+        float y = (i & 2) ? 1.0f : -1.0f;
+        float z = (i & 4) ? 1.0f : -1.0f;
+        scene->lpVB[i] = { x, y, z, x, y, z, (i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f, 0.0f, 0.0f };
+    }
+    WORD indices[36] = {
+        0, 2, 1, 1, 2, 3,   4, 5, 6, 5, 7, 6,   0, 1, 4, 1, 5, 4,
+        2, 6, 3, 3, 6, 7,   0, 4, 2, 2, 4, 6,   1, 3, 5, 3, 7, 5
+    };
+    scene->dwTriCount = 12;
+    scene->lpIB = new WORD[36];
+    memcpy(scene->lpIB, indices, sizeof(indices));
+
+    // Frame 1: create the box buffers and draw it three times
+    Backend_Record(TRUE);
+    Begin3D();
+    ClearBuffer(TRUE, TRUE, 0xFF000000);
+    BOOL created = SUCCEEDED(CHSceneInternal::CreateVertexBuffer(scene)) &&
+        SUCCEEDED(CHSceneInternal::CreateIndexBuffer(scene));
+    Scene_Prepare();
+    BOOL drawn = TRUE;
+    for (int i = 0; i < 3; i++)
+        drawn = Scene_Draw(scene) && drawn;
+    End3D();
+    Flip();
+    Backend_Record(FALSE);
+
+    // Frame 2 is empty; each Begin3D publishes the counters of the frame before it
+    Begin3D();
+    CHBackendStats first = {};
+    Backend_GetStats(&first);
+    End3D();
+    Flip();
+
+    Begin3D();
+    CHBackendStats empty = {};
+    Backend_GetStats(&empty);
+    End3D();
+    Flip();
+
+    const CHBackendCommand* commands = nullptr;
+    DWORD count = Backend_GetRecord(&commands);
+    DWORD recordedDraws = 0, boxDraws = 0, boxBuffers = 0;
+    for (DWORD i = 0; i < count; i++) {
+        if (commands[i].dwType == CH_CMD_DRAW || commands[i].dwType == CH_CMD_DRAW_INDEXED ||
+            commands[i].dwType == CH_CMD_DRAW_INDEXED_INSTANCED)
+            recordedDraws++;
+        if (commands[i].dwType == CH_CMD_DRAW_INDEXED && commands[i].dwValue == 36)
+            boxDraws++;
+        if (commands[i].dwType == CH_CMD_CREATE_BUFFER &&
+            (commands[i].dwValue == 8 * sizeof(CHSceneVertex) || commands[i].dwValue == sizeof(indices)))
+            boxBuffers++;
+    }
+
+    Check(texture && created && drawn, "Box created and drawn");
+    Check(first.dwDraws == 3 && first.dwDrawVertices == 3 * 36, "Three draws of 36 indices");
+    Check(first.dwBufferCreates >= 2 &&
+        first.dwBufferBytes >= 8 * sizeof(CHSceneVertex) + sizeof(indices), "Box buffers counted in its frame");
+    Check(recordedDraws == 3 && boxDraws == 3 && boxBuffers == 2, "Recorded commands match the frame");
+    Check(empty.dwDraws == 0 && empty.dwBufferCreates == 0 && empty.dwUpdates == 0, "Empty frame has no traffic");
+
+    // Frame 4: the box as a static batch, in front of the camera
+    g_ViewMatrix = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -5.0f, 1.0f),
+        XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+    g_ProjectMatrix = XMMatrixPerspectiveFovLH(XM_PIDIV4, 320.0f / 240.0f, 1.0f, 100.0f);
+    CHStaticScene* lpStatic = nullptr;
+    BOOL built = StaticScene_Build(&lpStatic, &scene, nullptr, 1);
+    Begin3D();
+    StaticScene_Draw(lpStatic);
+    DWORD visibleCount = 0, culledCount = 0, staticDraws = 0;
+    StaticScene_GetStats(&visibleCount, &culledCount, &staticDraws);
+    End3D();
+    Flip();
+    Check(built && visibleCount == 1 && culledCount == 0 && staticDraws == 1, "Static box: one visible submesh, one draw");
+    StaticScene_Unload(&lpStatic);
+
+    Scene_Unload(&scene);
+    Quit3D();
+}
+
+// Returns the number of failed checks
+int RunUnitTests() {
+    printf("CH Engine Unit Tests\n");
+    printf("====================\n\n");
+
+    g_nChecks = 0;
+    g_nFailures = 0;
+
+    TestAffine();
+    TestRadixSort();
+    TestParticlePacking();
+    TestAtlasPacking();
+    TestQueueKeys();
+    TestShaderKeys();
+    TestInstanceGroups();
+    TestFrustumCulling();
+    TestHeadlessFrame();
+
+    printf("\n%d/%d checks passed\n\n", g_nChecks - g_nFailures, g_nChecks);
+    return g_nFailures;
+}
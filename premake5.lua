@@ -130,6 +130,12 @@ project "TestCHEngine"
 		"CH_Engine"
 	}
 
+	-- Bakes the engine shaders into CH_Engine/src/CH_shader_blobs.h (rewritten only
+	-- when the bytecode changes); the next CH_Engine build embeds them
+	postbuildcommands {
+		"\"%{cfg.buildtarget.abspath}\" -export-shaders \"%{wks.location}/CH_Engine/src/CH_shader_blobs.h\""
+	}
+
 	filter "system:windows"
 		systemversion "latest"
 		buildoptions { "/utf-8" }